@@ -0,0 +1,527 @@
+/*
+ * The table as an array that changes how it is searched as it grows.
+ *
+ * The entries are always kept next to each other in one array. A small
+ * table searches it from the start like arraytable.c. When the table
+ * grows past ADAPTIVE_SORTED_SIZE entries the array is sorted and
+ * searched with binary search, and past ADAPTIVE_HASH_SIZE entries an
+ * open addressing index of the hashes is built over it. A table is also
+ * moved on to the next representation when its lookups call the compare
+ * function more than ADAPTIVE_MAX_COMPARES times each on average, over
+ * the last ADAPTIVE_WINDOW lookups, since that is what makes a lookup
+ * slow when the keys are expensive to compare.
+ *
+ * When entries are removed the table goes back to the previous
+ * representation, but only once it has fewer than a quarter of the
+ * entries it had when it moved on. A table that grows and shrinks around
+ * a threshold thus does not switch back and forth.
+ *
+ * The thresholds can be set when compiling, for example
+ * -DADAPTIVE_HASH_SIZE=1024. The keys are hashed with the function from
+ * table_setHashFunction, a table without one stays a sorted array. A key
+ * that is inserted again replaces the old entry.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "table.h"
+
+// Entries past which the array is sorted
+#ifndef ADAPTIVE_SORTED_SIZE
+#define ADAPTIVE_SORTED_SIZE 16
+#endif
+// Entries past which the array is hashed
+#ifndef ADAPTIVE_HASH_SIZE
+#define ADAPTIVE_HASH_SIZE 256
+#endif
+// Mean comparator calls per lookup past which the table moves on
+#ifndef ADAPTIVE_MAX_COMPARES
+#define ADAPTIVE_MAX_COMPARES 8
+#endif
+// Lookups the mean comparator calls are measured over
+#ifndef ADAPTIVE_WINDOW
+#define ADAPTIVE_WINDOW 64
+#endif
+
+// Entries the array has room for in a new table
+#define ADAPTIVE_MIN_CAPACITY 16
+
+/* How the entries are searched, in the order the table moves through */
+typedef enum AdaptiveMode {
+    ADAPTIVE_ARRAY,         // from the start
+    ADAPTIVE_SORTED,        // with binary search
+    ADAPTIVE_HASH           // through the index
+} AdaptiveMode;
+
+typedef struct AdaptiveEntry {
+    KEY key;
+    VALUE value;
+    uint64_t hash;          // only set while the table is hashed
+} AdaptiveEntry;
+
+/* A slot of the index, found with linear probing */
+typedef struct AdaptiveSlot {
+    uint32_t entry;         // the index of the entry plus one, 0 if empty
+    uint32_t hash;          // the low 32 bits of the hash of the key
+} AdaptiveSlot;
+
+typedef struct AdaptiveTable {
+    AdaptiveMode mode;
+    AdaptiveEntry *entries;
+    size_t size;
+    size_t capacity;
+    AdaptiveSlot *index;    // only while the table is hashed
+    size_t slots;           // of the index, a power of two
+    size_t enteredAt[3];    // entries when each mode was moved to
+    unsigned long long windowLookups;
+    unsigned long long windowCompares;
+    CompareFunction *cf;
+    HashFunction *hash;
+    KeyFreeFunc *keyFree;
+    ValueFreeFunc *valueFree;
+    TableStats stats;
+} AdaptiveTable;
+
+/* Counts a search for the statistics and the choice of mode. Every
+ * search counts for the choice of mode, only lookups for the statistics.
+ *    t - the table
+ *    count - true if the search is a lookup, counted in the statistics
+ *    hit - the key was found
+ *    compares - the comparator calls of the search
+ */
+static void countSearch(AdaptiveTable *t, bool count, bool hit,
+                        unsigned long long compares) {
+    if (count)
+        tablestats_lookup(&t->stats, hit, compares);
+    t->windowLookups++;
+    t->windowCompares += compares;
+}
+
+/* Finds the entry of a key
+ *    t - the table
+ *    key - the key
+ *    h - the hash of the key if the table is hashed
+ *    where - for a sorted table the position the key is or belongs at,
+ *            for a hashed table the slot of the index the key is or
+ *            belongs in
+ *    count - true if the search is a lookup, counted in the statistics
+ * Returns
+ *    the index of the entry, -1 if the key is not in the table
+ */
+static long findEntry(AdaptiveTable *t, KEY key, uint64_t h, size_t *where,
+                      bool count) {
+    unsigned long long compares = 0;
+    if (t->mode == ADAPTIVE_ARRAY) {
+        for(size_t i=0;i<t->size;i++) {
+            compares++;
+            if (t->cf(t->entries[i].key, key) == 0) {
+                countSearch(t, count, true, compares);
+                return i;
+            }
+        }
+    } else if (t->mode == ADAPTIVE_SORTED) {
+        size_t low = 0;
+        size_t high = t->size;
+        while (low < high) {
+            size_t middle = low + (high-low)/2;
+            int c = t->cf(t->entries[middle].key, key);
+            compares++;
+            if (c == 0) {
+                *where = middle;
+                countSearch(t, count, true, compares);
+                return middle;
+            }
+            if (c < 0)
+                low = middle+1;
+            else
+                high = middle;
+        }
+        *where = low;
+    } else {
+        size_t mask = t->slots-1;
+        unsigned long long probes = 1;
+        for(size_t slot=h&mask;t->index[slot].entry!=0;
+            slot=(slot+1)&mask,probes++) {
+            const AdaptiveSlot *s = &t->index[slot];
+            if (s->hash != (uint32_t)h)
+                continue;
+            compares++;
+            if (t->cf(t->entries[s->entry-1].key, key) == 0) {
+                *where = slot;
+                countSearch(t, count, true, compares);
+                if (count)
+                    tablestats_probes(&t->stats, probes);
+                return s->entry-1;
+            }
+        }
+        *where = (h+probes-1) & mask;
+        if (count)
+            tablestats_probes(&t->stats, probes);
+    }
+    countSearch(t, count, false, compares);
+    return -1;
+}
+
+/* Builds the index of a hashed table
+ *    t - the table, with the hashes of the entries set
+ *    slots - the number of slots, a power of two larger than the entries
+ */
+static void buildIndex(AdaptiveTable *t, size_t slots) {
+    free(t->index);
+    t->index = calloc(slots, sizeof(AdaptiveSlot));
+    t->slots = slots;
+    size_t mask = slots-1;
+    for(size_t i=0;i<t->size;i++) {
+        size_t slot = t->entries[i].hash & mask;
+        while (t->index[slot].entry != 0)
+            slot = (slot+1) & mask;
+        t->index[slot].entry = i+1;
+        t->index[slot].hash = (uint32_t)t->entries[i].hash;
+    }
+}
+
+/* Sorts the entries with a merge sort, which unlike qsort can call the
+ * compare function of the table
+ *    t - the table
+ */
+static void sortEntries(AdaptiveTable *t) {
+    AdaptiveEntry *from = t->entries;
+    AdaptiveEntry *to = malloc(t->capacity*sizeof(AdaptiveEntry));
+    for(size_t width=1;width<t->size;width*=2) {
+        for(size_t low=0;low<t->size;low+=2*width) {
+            size_t middle = low+width < t->size ? low+width : t->size;
+            size_t high = low+2*width < t->size ? low+2*width : t->size;
+            size_t i = low;
+            size_t j = middle;
+            for(size_t k=low;k<high;k++) {
+                if (j >= high || (i < middle &&
+                                  t->cf(from[i].key, from[j].key) <= 0))
+                    to[k] = from[i++];
+                else
+                    to[k] = from[j++];
+            }
+        }
+        AdaptiveEntry *swap = from;
+        from = to;
+        to = swap;
+    }
+    t->entries = from;
+    free(to);
+}
+
+/* Changes how the entries are searched
+ *    t - the table
+ *    mode - the new mode, next to the current one
+ */
+static void changeMode(AdaptiveTable *t, AdaptiveMode mode) {
+    if (mode == ADAPTIVE_HASH) {
+        for(size_t i=0;i<t->size;i++)
+            t->entries[i].hash = t->hash(t->entries[i].key);
+        size_t slots = ADAPTIVE_MIN_CAPACITY;
+        while (slots < 2*t->size)
+            slots *= 2;
+        buildIndex(t, slots);
+    } else if (mode == ADAPTIVE_SORTED) {
+        free(t->index);
+        t->index = NULL;
+        t->slots = 0;
+        // A hashed table fills the gaps of removed entries from the end
+        sortEntries(t);
+    }
+    if (mode > t->mode)
+        t->enteredAt[mode] = t->size;
+    t->mode = mode;
+    t->windowLookups = 0;
+    t->windowCompares = 0;
+}
+
+/* Moves the table to the next or the previous mode if it has crossed a
+ * threshold
+ *    t - the table
+ */
+static void adapt(AdaptiveTable *t) {
+    bool slow = false;
+    if (t->windowLookups >= ADAPTIVE_WINDOW) {
+        slow = t->windowCompares >
+            (unsigned long long)ADAPTIVE_MAX_COMPARES*t->windowLookups;
+        t->windowLookups = 0;
+        t->windowCompares = 0;
+    }
+    switch (t->mode) {
+    case ADAPTIVE_ARRAY:
+        if (slow || t->size > ADAPTIVE_SORTED_SIZE)
+            changeMode(t, ADAPTIVE_SORTED);
+        break;
+    case ADAPTIVE_SORTED:
+        if (t->size < t->enteredAt[ADAPTIVE_SORTED]/4)
+            changeMode(t, ADAPTIVE_ARRAY);
+        else if (t->hash != NULL && (slow || t->size > ADAPTIVE_HASH_SIZE))
+            changeMode(t, ADAPTIVE_HASH);
+        break;
+    case ADAPTIVE_HASH:
+        if (t->size < t->enteredAt[ADAPTIVE_HASH]/4)
+            changeMode(t, ADAPTIVE_SORTED);
+        break;
+    }
+}
+
+/* Adds an entry whose key is not in the table
+ *    t - the table
+ *    key - the key
+ *    value - the value
+ *    h - the hash of the key if the table is hashed
+ *    where - the position or slot found by findEntry
+ */
+static void addEntry(AdaptiveTable *t, KEY key, VALUE value, uint64_t h,
+                     size_t where) {
+    if (t->size == t->capacity) {
+        t->capacity *= 2;
+        t->entries = realloc(t->entries,
+                             t->capacity*sizeof(AdaptiveEntry));
+    }
+    AdaptiveEntry e = {key, value, h};
+    if (t->mode == ADAPTIVE_SORTED) {
+        memmove(&t->entries[where+1], &t->entries[where],
+                (t->size-where)*sizeof(AdaptiveEntry));
+        t->entries[where] = e;
+    } else {
+        t->entries[t->size] = e;
+    }
+    t->size++;
+    if (t->mode == ADAPTIVE_HASH) {
+        t->index[where].entry = t->size;
+        t->index[where].hash = (uint32_t)h;
+        if (2*t->size > t->slots)
+            buildIndex(t, 2*t->slots);
+    }
+}
+
+/* Removes a slot from the index, moving the slots after it that are not
+ * in their home slot back into the gap
+ *    t - the hashed table
+ *    slot - the slot
+ */
+static void removeSlot(AdaptiveTable *t, size_t slot) {
+    size_t mask = t->slots-1;
+    size_t hole = slot;
+    for(size_t next=(hole+1)&mask;t->index[next].entry!=0;
+        next=(next+1)&mask) {
+        size_t home = t->index[next].hash & mask;
+        // The slot may move if the hole is between its home and it
+        if (((next-home) & mask) >= ((next-hole) & mask)) {
+            t->index[hole] = t->index[next];
+            hole = next;
+        }
+    }
+    t->index[hole].entry = 0;
+}
+
+/* Creates a table.
+ *  compare_function - Pointer to a function that is called for comparing
+ *                     two keys. The function should return <0 if the left
+ *                     parameter is smaller than the right parameter, 0 if
+ *                     the parameters are equal, and >0 if the left
+ *                     parameter is larger than the right item.
+ * Returns: A pointer to the table. NULL if creation of the table failed. */
+Table *table_create(CompareFunction *compare_function) {
+    AdaptiveTable *t = calloc(1, sizeof(AdaptiveTable));
+    t->cf = compare_function;
+    t->capacity = ADAPTIVE_MIN_CAPACITY;
+    t->entries = malloc(t->capacity*sizeof(AdaptiveEntry));
+    return t;
+}
+
+/* Install a memory handling function responsible for removing a key when
+ * removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by keys inserted into the table*/
+void table_setKeyMemHandler(Table *table, KeyFreeFunc *freeFunc) {
+    AdaptiveTable *t = table;
+    t->keyFree = freeFunc;
+}
+
+/* Install a memory handling function responsible for removing a value
+ * when removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by values inserted into the table*/
+void table_setValueMemHandler(Table *table, ValueFreeFunc *freeFunc) {
+    AdaptiveTable *t = table;
+    t->valueFree = freeFunc;
+}
+
+/* Install the function hashing the keys, without which the table is
+ * never hashed.
+ *  table - Pointer to the table.
+ *  hash  - Pointer to the hash function. */
+void table_setHashFunction(Table *table, HashFunction *hash) {
+    AdaptiveTable *t = table;
+    t->hash = hash;
+}
+
+/* The keys are compared and hashed, so the bytes of the keys are not used */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes) {
+    (void)table;
+    (void)bytes;
+}
+
+/* Determines if the table is empty.
+ *  table - Pointer to the table.
+ * Returns: false if the table is not empty, true if it is. */
+bool table_isEmpty(Table *table) {
+    AdaptiveTable *t = table;
+    return t->size == 0;
+}
+
+/* Inserts a key and value pair into the table, replacing the entry of
+ * the key if it is already in the table.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the key.
+ *  value - Pointer to the value.
+ */
+void table_insert(Table *table, KEY key, VALUE value) {
+    AdaptiveTable *t = table;
+    uint64_t h = t->mode == ADAPTIVE_HASH ? t->hash(key) : 0;
+    size_t where = 0;
+    tablestats_insert(&t->stats);
+
+    long i = findEntry(t, key, h, &where, false);
+    if (i >= 0) {
+        AdaptiveEntry *old = &t->entries[i];
+        if (t->keyFree != NULL)
+            t->keyFree(old->key);
+        if (t->valueFree != NULL)
+            t->valueFree(old->value);
+        old->key = key;
+        old->value = value;
+    } else {
+        addEntry(t, key, value, h, where);
+    }
+    adapt(t);
+}
+
+/* Finds a value given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ * Returns: Pointer to the item's value if the lookup succeded. NULL if the
+ *          lookup failed. */
+VALUE table_lookup(Table *table, KEY key) {
+    AdaptiveTable *t = table;
+    uint64_t h = t->mode == ADAPTIVE_HASH ? t->hash(key) : 0;
+    size_t where;
+    long i = findEntry(t, key, h, &where, true);
+    VALUE value = i >= 0 ? t->entries[i].value : NULL;
+    adapt(t);
+    return value;
+}
+
+/* Removes an item from the table given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ */
+void table_remove(Table *table, KEY key) {
+    AdaptiveTable *t = table;
+    uint64_t h = t->mode == ADAPTIVE_HASH ? t->hash(key) : 0;
+    size_t where;
+    tablestats_remove(&t->stats);
+    long i = findEntry(t, key, h, &where, false);
+    if (i < 0)
+        return;
+    if (t->keyFree != NULL)
+        t->keyFree(t->entries[i].key);
+    if (t->valueFree != NULL)
+        t->valueFree(t->entries[i].value);
+
+    size_t last = t->size-1;
+    if (t->mode != ADAPTIVE_HASH) {
+        // Keep the order, which a sorted table searches by
+        memmove(&t->entries[i], &t->entries[i+1],
+                (last-i)*sizeof(AdaptiveEntry));
+    } else {
+        removeSlot(t, where);
+        if ((size_t)i != last) {
+            // Move the last entry into the gap and point its slot there
+            size_t mask = t->slots-1;
+            size_t slot = t->entries[last].hash & mask;
+            while (t->index[slot].entry != last+1)
+                slot = (slot+1) & mask;
+            t->index[slot].entry = i+1;
+            t->entries[i] = t->entries[last];
+        }
+    }
+    t->size--;
+    adapt(t);
+}
+
+/* Destroys a table, deallocating all the memory it uses.
+ *  table - Pointer to the table. After the function completes this pointer
+ *          will be invalid for further use. */
+void table_free(Table *table) {
+    AdaptiveTable *t = table;
+    for(size_t i=0;i<t->size;i++) {
+        if (t->keyFree != NULL)
+            t->keyFree(t->entries[i].key);
+        if (t->valueFree != NULL)
+            t->valueFree(t->entries[i].value);
+    }
+    free(t->entries);
+    free(t->index);
+    free(t);
+}
+
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h. The lookups include the searches of the inserts and
+ * removes, and the probes are the slots of the index the searches of a
+ * hashed table looked in. */
+bool table_getStats(Table *table, TableStats *stats) {
+    AdaptiveTable *t = table;
+    return tablestats_get(&t->stats, stats);
+}
+
+/* Saves the entries to a snapshot file in the order of the array. */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values) {
+    AdaptiveTable *t = table;
+    SnapshotWriter *w = snapshot_openWriter(path, keys, values);
+    if (w == NULL)
+        return false;
+    for(size_t i=0;i<t->size;i++)
+        snapshot_write(w, t->entries[i].key, t->entries[i].value);
+    return snapshot_closeWriter(w);
+}
+
+/* Creates a table from a snapshot file, hashed with the hash function of
+ * the key serializer if it has one. The table moves through the modes as
+ * the entries are read, as if they were inserted. Of duplicate keys,
+ * which the list tables may save, the first one is kept and the others
+ * are deallocated with free. */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values) {
+    SnapshotReader *r = snapshot_openReader(path, keys, values);
+    if (r == NULL)
+        return NULL;
+    AdaptiveTable *t = table_create(compare_function);
+    t->hash = keys->hash;
+
+    KEY key;
+    VALUE value;
+    while (snapshot_read(r, &key, &value)) {
+        uint64_t h = t->mode == ADAPTIVE_HASH ? t->hash(key) : 0;
+        size_t where = 0;
+        if (findEntry(t, key, h, &where, false) >= 0) {
+            free(key);
+            free(value);
+            continue;
+        }
+        addEntry(t, key, value, h, where);
+        adapt(t);
+    }
+    snapshot_closeReader(r);
+    // Building the table is not counted as lookups
+    memset(&t->stats, 0, sizeof(t->stats));
+    t->windowLookups = 0;
+    t->windowCompares = 0;
+    return t;
+}
@@ -0,0 +1,154 @@
+/*
+ * Allocation tracking for the speed test, see alloctrack.h.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stddef.h>
+#include "alloctrack.h"
+
+// The sanitizers replace malloc themselves
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define ALLOCTRACK_DISABLED
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || \
+    __has_feature(memory_sanitizer)
+#define ALLOCTRACK_DISABLED
+#endif
+#endif
+
+#if defined(__GLIBC__) && !defined(ALLOCTRACK_DISABLED)
+
+#include <malloc.h>
+
+// The allocator of glibc under its own names, which the replacements
+// below call
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+// The counts are updated atomically since the tables may be used from
+// several threads
+static unsigned long long mallocs;
+static unsigned long long frees;
+static long long liveBytes;
+static long long peakBytes;
+
+/* Counts an allocated block
+ *    ptr - the block, NULL if the allocation failed
+ */
+static void countMalloc(void *ptr) {
+    if (ptr == NULL)
+        return;
+    long long size = malloc_usable_size(ptr);
+    long long live = __atomic_add_fetch(&liveBytes, size, __ATOMIC_RELAXED);
+    long long peak = __atomic_load_n(&peakBytes, __ATOMIC_RELAXED);
+    while (live > peak &&
+           !__atomic_compare_exchange_n(&peakBytes, &peak, live, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+    __atomic_add_fetch(&mallocs, 1, __ATOMIC_RELAXED);
+}
+
+/* Counts a block that is about to be freed
+ *    ptr - the block, may be NULL
+ */
+static void countFree(void *ptr) {
+    if (ptr == NULL)
+        return;
+    long long size = malloc_usable_size(ptr);
+    __atomic_sub_fetch(&liveBytes, size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&frees, 1, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size) {
+    void *ptr = __libc_malloc(size);
+    countMalloc(ptr);
+    return ptr;
+}
+
+void *calloc(size_t n, size_t size) {
+    void *ptr = __libc_calloc(n, size);
+    countMalloc(ptr);
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (ptr == NULL)
+        return malloc(size);
+    // Count the block as freed first, it may not exist after the call
+    countFree(ptr);
+    void *result = __libc_realloc(ptr, size);
+    if (result == NULL && size != 0) {
+        // The old block is still there
+        countMalloc(ptr);
+        __atomic_sub_fetch(&mallocs, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&frees, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    countMalloc(result);
+    if (result == ptr) {
+        // Resized in place, only the size changed
+        __atomic_sub_fetch(&mallocs, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&frees, 1, __ATOMIC_RELAXED);
+    }
+    return result;
+}
+
+void free(void *ptr) {
+    countFree(ptr);
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    void *ptr = __libc_memalign(alignment, size);
+    countMalloc(ptr);
+    return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **result, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment-1)) != 0)
+        return EINVAL;
+    void *ptr = memalign(alignment, size);
+    if (ptr == NULL)
+        return ENOMEM;
+    *result = ptr;
+    return 0;
+}
+
+bool alloctrack_enabled(void) {
+    return true;
+}
+
+void alloctrack_get(AllocStats *stats) {
+    stats->mallocs = __atomic_load_n(&mallocs, __ATOMIC_RELAXED);
+    stats->frees = __atomic_load_n(&frees, __ATOMIC_RELAXED);
+    stats->liveBytes = __atomic_load_n(&liveBytes, __ATOMIC_RELAXED);
+    stats->peakBytes = __atomic_load_n(&peakBytes, __ATOMIC_RELAXED);
+}
+
+void alloctrack_resetPeak(void) {
+    __atomic_store_n(&peakBytes, __atomic_load_n(&liveBytes, __ATOMIC_RELAXED),
+                     __ATOMIC_RELAXED);
+}
+
+#else
+
+bool alloctrack_enabled(void) {
+    return false;
+}
+
+void alloctrack_get(AllocStats *stats) {
+    *stats = (AllocStats){0};
+}
+
+void alloctrack_resetPeak(void) {
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Allocation tracking for the speed test.
+ *
+ * Linking alloctrack.c into a program replaces malloc, calloc, realloc,
+ * free and the aligned allocation functions with versions that count the
+ * allocations and frees and keep track of the live and peak number of
+ * allocated bytes, before handing the call on to the C library. This
+ * counts every allocation the tables and the keys make, including the
+ * ones inside the C library such as strdup. The sizes are the usable
+ * sizes of the blocks as reported by malloc_usable_size, so the rounding
+ * of the allocator is included but not its per block header.
+ *
+ * The tracking needs glibc. With other C libraries, and in builds with
+ * the address or thread sanitizer which replace malloc themselves, the
+ * functions are left alone and alloctrack_enabled returns false.
+ */
+
+#ifndef ALLOCTRACK_H
+#define ALLOCTRACK_H
+
+#include <stdbool.h>
+
+/* The allocation counts since the program started */
+typedef struct AllocStats {
+    unsigned long long mallocs; // allocations, a moving realloc included
+    unsigned long long frees;   // frees, a moving realloc included
+    long long liveBytes;        // bytes allocated and not yet freed
+    long long peakBytes;        // most live bytes since alloctrack_resetPeak
+} AllocStats;
+
+/* Returns: true if allocations are being tracked. */
+bool alloctrack_enabled(void);
+
+/* Reads the current counts.
+ *  stats - The counts are stored here. */
+void alloctrack_get(AllocStats *stats);
+
+/* Starts a new peak, the peak is set to the bytes live now. */
+void alloctrack_resetPeak(void);
+
+#endif
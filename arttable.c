@@ -0,0 +1,999 @@
+/*
+ * The table as an adaptive radix tree.
+ *
+ * The tree branches on one byte of the key at each level, so a lookup,
+ * insert or remove looks at each byte of the key at most once and takes
+ * time in proportion to the length of the key, however many entries the
+ * table holds. The compare function is never called, keys are equal when
+ * their bytes are, see table_setKeyBytesFunction, which has to be set
+ * before the first insert.
+ *
+ * The inner nodes come in four sizes that are switched between as their
+ * children come and go. Node4 and Node16 keep up to 4 and 16 key bytes
+ * sorted next to their children, and a Node16 is searched with one SSE2
+ * compare. Node48 has an index of 256 bytes pointing into 48 children,
+ * and Node256 an array of 256 children. A node is grown when it is full
+ * and shrunk when it is well below the size below, so a node that
+ * alternates around a size does not switch back and forth.
+ *
+ * Chains of nodes with a single child are compressed into the prefix of
+ * the node below them. The first ART_MAX_PREFIX bytes of the prefix are
+ * kept in the node, and a lookup skips the rest and checks the whole key
+ * at the leaf it ends in. A key that ends where a node branches, such as
+ * a string that is the beginning of others, is kept in the end leaf of
+ * the node.
+ *
+ * The leaves hold the key, the value and the bytes of the key. Keys are
+ * visited in the order of their bytes, a shorter key before the keys it
+ * is the beginning of, see arttable.h. A cursor follows the prefix down
+ * to the node all its keys are below and walks that part of the tree
+ * with a stack of the nodes it is in, so it never looks at a key that
+ * does not match, and every node it passes has at least one match below
+ * it that has not been returned yet. A key that is inserted again
+ * replaces the old entry. table_getStats reports the nodes a lookup
+ * visited as its depth.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "table.h"
+#include "arttable.h"
+
+// Bytes of the compressed path kept in a node
+#define ART_MAX_PREFIX 8
+
+/* The type of a node, the first byte of every node and leaf */
+enum {
+    ART_LEAF,
+    ART_NODE4,
+    ART_NODE16,
+    ART_NODE48,
+    ART_NODE256
+};
+
+typedef struct ArtLeaf {
+    uint8_t type;
+    KEY key;
+    VALUE value;
+    const unsigned char *bytes;         // of the key
+    size_t length;
+} ArtLeaf;
+
+/* The start of every inner node */
+typedef struct ArtNode {
+    uint8_t type;
+    uint16_t count;                     // children
+    uint32_t prefixLength;              // bytes of the compressed path
+    unsigned char prefix[ART_MAX_PREFIX];
+    ArtLeaf *end;                       // the key that ends here
+} ArtNode;
+
+typedef struct ArtNode4 {
+    ArtNode n;
+    unsigned char keys[4];              // sorted
+    void *children[4];
+} ArtNode4;
+
+typedef struct ArtNode16 {
+    ArtNode n;
+    unsigned char keys[16];             // sorted
+    void *children[16];
+} ArtNode16;
+
+typedef struct ArtNode48 {
+    ArtNode n;
+    unsigned char index[256];           // child plus one, 0 if none
+    void *children[48];
+} ArtNode48;
+
+typedef struct ArtNode256 {
+    ArtNode n;
+    void *children[256];
+} ArtNode256;
+
+typedef struct ArtTable {
+    void *root;                         // a node, a leaf or NULL
+    size_t size;
+    CompareFunction *cf;
+    KeyBytesFunction *keyBytes;
+    KeyFreeFunc *keyFree;
+    ValueFreeFunc *valueFree;
+    TableStats stats;
+} ArtTable;
+
+/* Returns true if a child is a leaf
+ *    child - the child
+ */
+static bool isLeaf(const void *child) {
+    return *(const uint8_t *)child == ART_LEAF;
+}
+
+/* Returns true if a leaf holds a key
+ *    leaf - the leaf
+ *    bytes - the bytes of the key
+ *    length - the number of bytes
+ */
+static bool leafMatches(const ArtLeaf *leaf, const unsigned char *bytes,
+                        size_t length) {
+    return leaf->length == length && memcmp(leaf->bytes, bytes, length) == 0;
+}
+
+/* Returns the smaller of two sizes */
+static size_t smaller(size_t a, size_t b) {
+    return a < b ? a : b;
+}
+
+/* Creates a leaf
+ *    t - the table
+ *    key - the key
+ *    value - the value
+ */
+static ArtLeaf *newLeaf(ArtTable *t, KEY key, VALUE value) {
+    ArtLeaf *leaf = malloc(sizeof(ArtLeaf));
+    leaf->type = ART_LEAF;
+    leaf->key = key;
+    leaf->value = value;
+    leaf->length = t->keyBytes(key, &leaf->bytes);
+    return leaf;
+}
+
+/* Replaces the entry of a leaf, deallocating the old one
+ *    t - the table
+ *    leaf - the leaf
+ *    key - the new key, with the same bytes
+ *    value - the new value
+ */
+static void replaceLeaf(ArtTable *t, ArtLeaf *leaf, KEY key, VALUE value) {
+    if (t->keyFree != NULL)
+        t->keyFree(leaf->key);
+    if (t->valueFree != NULL)
+        t->valueFree(leaf->value);
+    leaf->key = key;
+    leaf->value = value;
+    // The bytes belonged to the old key
+    leaf->length = t->keyBytes(key, &leaf->bytes);
+}
+
+/* Creates an empty inner node
+ *    type - the type of the node
+ */
+static ArtNode *newNode(uint8_t type) {
+    static const size_t sizes[] = {
+        [ART_NODE4] = sizeof(ArtNode4), [ART_NODE16] = sizeof(ArtNode16),
+        [ART_NODE48] = sizeof(ArtNode48), [ART_NODE256] = sizeof(ArtNode256)
+    };
+    ArtNode *node = calloc(1, sizes[type]);
+    node->type = type;
+    return node;
+}
+
+/* Creates a node of another size with the prefix, the end leaf and the
+ * number of children of a node, but without the children
+ *    node - the node
+ *    type - the type of the new node
+ */
+static ArtNode *resized(const ArtNode *node, uint8_t type) {
+    ArtNode *copy = newNode(type);
+    copy->count = node->count;
+    copy->prefixLength = node->prefixLength;
+    memcpy(copy->prefix, node->prefix, ART_MAX_PREFIX);
+    copy->end = node->end;
+    return copy;
+}
+
+/* Finds the child of a node for a byte
+ *    node - the node
+ *    byte - the byte
+ * Returns
+ *    the pointer to the child, NULL if there is none
+ */
+static void **findChild(ArtNode *node, unsigned char byte) {
+    switch (node->type) {
+    case ART_NODE4: {
+        ArtNode4 *n = (ArtNode4 *)node;
+        for(int i=0;i<node->count;i++) {
+            if (n->keys[i] == byte)
+                return &n->children[i];
+        }
+        return NULL;
+    }
+    case ART_NODE16: {
+        ArtNode16 *n = (ArtNode16 *)node;
+#ifdef __SSE2__
+        __m128i keys = _mm_loadu_si128((const __m128i *)n->keys);
+        __m128i equal = _mm_cmpeq_epi8(keys, _mm_set1_epi8((char)byte));
+        int mask = _mm_movemask_epi8(equal) & ((1 << node->count)-1);
+        return mask != 0 ? &n->children[__builtin_ctz(mask)] : NULL;
+#else
+        for(int i=0;i<node->count;i++) {
+            if (n->keys[i] == byte)
+                return &n->children[i];
+        }
+        return NULL;
+#endif
+    }
+    case ART_NODE48: {
+        ArtNode48 *n = (ArtNode48 *)node;
+        return n->index[byte] != 0 ? &n->children[n->index[byte]-1] : NULL;
+    }
+    default: {
+        ArtNode256 *n = (ArtNode256 *)node;
+        return n->children[byte] != NULL ? &n->children[byte] : NULL;
+    }
+    }
+}
+
+/* Returns the leaf with the smallest key below a node
+ *    child - the node or leaf
+ */
+static ArtLeaf *minimum(const void *child) {
+    while (!isLeaf(child)) {
+        const ArtNode *node = child;
+        if (node->end != NULL)
+            return node->end;
+        if (node->type == ART_NODE4) {
+            child = ((const ArtNode4 *)node)->children[0];
+        } else if (node->type == ART_NODE16) {
+            child = ((const ArtNode16 *)node)->children[0];
+        } else if (node->type == ART_NODE48) {
+            const ArtNode48 *n = child;
+            int b = 0;
+            while (n->index[b] == 0)
+                b++;
+            child = n->children[n->index[b]-1];
+        } else {
+            const ArtNode256 *n = child;
+            int b = 0;
+            while (n->children[b] == NULL)
+                b++;
+            child = n->children[b];
+        }
+    }
+    return (ArtLeaf *)child;
+}
+
+/* Adds a child to a node, growing the node if it is full
+ *    ref - the pointer to the node, changed if it grows
+ *    byte - the byte of the child, not yet in the node
+ *    child - the child
+ */
+static void addChild(void **ref, unsigned char byte, void *child) {
+    ArtNode *node = *ref;
+    switch (node->type) {
+    case ART_NODE4:
+    case ART_NODE16: {
+        int capacity = node->type == ART_NODE4 ? 4 : 16;
+        unsigned char *keys = node->type == ART_NODE4 ?
+            ((ArtNode4 *)node)->keys : ((ArtNode16 *)node)->keys;
+        void **children = node->type == ART_NODE4 ?
+            ((ArtNode4 *)node)->children : ((ArtNode16 *)node)->children;
+        if (node->count < capacity) {
+            int i = 0;
+            while (i < node->count && keys[i] < byte)
+                i++;
+            memmove(&keys[i+1], &keys[i], node->count-i);
+            memmove(&children[i+1], &children[i],
+                    (node->count-i)*sizeof(void *));
+            keys[i] = byte;
+            children[i] = child;
+            node->count++;
+            return;
+        }
+        ArtNode *bigger;
+        if (node->type == ART_NODE4) {
+            ArtNode16 *n = (ArtNode16 *)resized(node, ART_NODE16);
+            memcpy(n->keys, keys, 4);
+            memcpy(n->children, children, 4*sizeof(void *));
+            bigger = &n->n;
+        } else {
+            ArtNode48 *n = (ArtNode48 *)resized(node, ART_NODE48);
+            for(int i=0;i<16;i++) {
+                n->index[keys[i]] = i+1;
+                n->children[i] = children[i];
+            }
+            bigger = &n->n;
+        }
+        free(node);
+        *ref = bigger;
+        addChild(ref, byte, child);
+        return;
+    }
+    case ART_NODE48: {
+        ArtNode48 *n = (ArtNode48 *)node;
+        if (node->count < 48) {
+            int slot = 0;
+            while (n->children[slot] != NULL)
+                slot++;
+            n->children[slot] = child;
+            n->index[byte] = slot+1;
+            node->count++;
+            return;
+        }
+        ArtNode256 *bigger = (ArtNode256 *)resized(node, ART_NODE256);
+        for(int b=0;b<256;b++) {
+            if (n->index[b] != 0)
+                bigger->children[b] = n->children[n->index[b]-1];
+        }
+        free(node);
+        *ref = bigger;
+        addChild(ref, byte, child);
+        return;
+    }
+    default: {
+        ArtNode256 *n = (ArtNode256 *)node;
+        n->children[byte] = child;
+        node->count++;
+    }
+    }
+}
+
+/* Replaces a Node4 by its only child, or by its end leaf if it has no
+ * children, moving its prefix and byte onto the child
+ *    ref - the pointer to the node
+ */
+static void collapse(void **ref) {
+    ArtNode *node = *ref;
+    if (node->type != ART_NODE4 || node->count > 1 ||
+        (node->count == 1 && node->end != NULL))
+        return;
+    if (node->count == 0) {
+        *ref = node->end;
+        free(node);
+        return;
+    }
+    ArtNode4 *n = (ArtNode4 *)node;
+    void *child = n->children[0];
+    if (!isLeaf(child)) {
+        ArtNode *c = child;
+        unsigned char prefix[ART_MAX_PREFIX];
+        size_t length = smaller(node->prefixLength, ART_MAX_PREFIX);
+        memcpy(prefix, node->prefix, length);
+        if (length < ART_MAX_PREFIX)
+            prefix[length++] = n->keys[0];
+        size_t more = smaller(c->prefixLength, ART_MAX_PREFIX-length);
+        memcpy(prefix+length, c->prefix, more);
+        memcpy(c->prefix, prefix, length+more);
+        c->prefixLength += node->prefixLength+1;
+    }
+    *ref = child;
+    free(node);
+}
+
+/* Removes the child of a byte from a node, shrinking the node if it has
+ * become small
+ *    ref - the pointer to the node, changed if it shrinks
+ *    byte - the byte of the child
+ */
+static void removeChild(void **ref, unsigned char byte) {
+    ArtNode *node = *ref;
+    ArtNode *smallerNode = NULL;
+    switch (node->type) {
+    case ART_NODE4:
+    case ART_NODE16: {
+        unsigned char *keys = node->type == ART_NODE4 ?
+            ((ArtNode4 *)node)->keys : ((ArtNode16 *)node)->keys;
+        void **children = node->type == ART_NODE4 ?
+            ((ArtNode4 *)node)->children : ((ArtNode16 *)node)->children;
+        int i = 0;
+        while (keys[i] != byte)
+            i++;
+        memmove(&keys[i], &keys[i+1], node->count-i-1);
+        memmove(&children[i], &children[i+1],
+                (node->count-i-1)*sizeof(void *));
+        node->count--;
+        if (node->type == ART_NODE16 && node->count == 3) {
+            ArtNode4 *n = (ArtNode4 *)resized(node, ART_NODE4);
+            memcpy(n->keys, keys, 3);
+            memcpy(n->children, children, 3*sizeof(void *));
+            smallerNode = &n->n;
+        }
+        break;
+    }
+    case ART_NODE48: {
+        ArtNode48 *n = (ArtNode48 *)node;
+        n->children[n->index[byte]-1] = NULL;
+        n->index[byte] = 0;
+        node->count--;
+        if (node->count == 12) {
+            ArtNode16 *s = (ArtNode16 *)resized(node, ART_NODE16);
+            int i = 0;
+            for(int b=0;b<256;b++) {
+                if (n->index[b] != 0) {
+                    s->keys[i] = b;
+                    s->children[i++] = n->children[n->index[b]-1];
+                }
+            }
+            smallerNode = &s->n;
+        }
+        break;
+    }
+    default: {
+        ArtNode256 *n = (ArtNode256 *)node;
+        n->children[byte] = NULL;
+        node->count--;
+        if (node->count == 37) {
+            ArtNode48 *s = (ArtNode48 *)resized(node, ART_NODE48);
+            int slot = 0;
+            for(int b=0;b<256;b++) {
+                if (n->children[b] != NULL) {
+                    s->children[slot] = n->children[b];
+                    s->index[b] = ++slot;
+                }
+            }
+            smallerNode = &s->n;
+        }
+    }
+    }
+    if (smallerNode != NULL) {
+        free(node);
+        *ref = smallerNode;
+    }
+    collapse(ref);
+}
+
+/* Counts the bytes of the prefix of a node that a key matches, looking
+ * at the bytes kept in the node only
+ *    node - the node
+ *    bytes - the bytes of the key
+ *    length - the number of bytes, at least depth
+ *    depth - the bytes of the key above the node
+ */
+static size_t checkPrefix(const ArtNode *node, const unsigned char *bytes,
+                          size_t length, size_t depth) {
+    size_t max = smaller(smaller(node->prefixLength, ART_MAX_PREFIX),
+                         length-depth);
+    size_t i = 0;
+    while (i < max && node->prefix[i] == bytes[depth+i])
+        i++;
+    return i;
+}
+
+/* Counts the bytes of the prefix of a node that a key matches, looking
+ * at the key of a leaf below the node for the bytes not kept in it
+ *    node - the node
+ *    bytes - the bytes of the key
+ *    length - the number of bytes, at least depth
+ *    depth - the bytes of the key above the node
+ */
+static size_t prefixMismatch(const ArtNode *node, const unsigned char *bytes,
+                             size_t length, size_t depth) {
+    size_t i = checkPrefix(node, bytes, length, depth);
+    if (i < ART_MAX_PREFIX || node->prefixLength <= ART_MAX_PREFIX)
+        return i;
+    const ArtLeaf *leaf = minimum(node);
+    size_t max = smaller(node->prefixLength, length-depth);
+    while (i < max && leaf->bytes[depth+i] == bytes[depth+i])
+        i++;
+    return i;
+}
+
+/* Finds the leaf of a key
+ *    t - the table
+ *    bytes - the bytes of the key
+ *    length - the number of bytes
+ * Returns
+ *    the leaf, NULL if the key is not in the table
+ */
+static ArtLeaf *search(ArtTable *t, const unsigned char *bytes,
+                       size_t length) {
+    void *child = t->root;
+    size_t depth = 0;
+    unsigned long long visited = 0;
+    ArtLeaf *found = NULL;
+    while (child != NULL) {
+        visited++;
+        if (isLeaf(child)) {
+            if (leafMatches(child, bytes, length))
+                found = child;
+            break;
+        }
+        ArtNode *node = child;
+        if (node->prefixLength > length-depth ||
+            checkPrefix(node, bytes, length, depth) !=
+            smaller(node->prefixLength, ART_MAX_PREFIX))
+            break;
+        depth += node->prefixLength;
+        if (depth == length) {
+            // The bytes skipped past ART_MAX_PREFIX are checked here
+            if (node->end != NULL && leafMatches(node->end, bytes, length))
+                found = node->end;
+            break;
+        }
+        void **next = findChild(node, bytes[depth]);
+        child = next != NULL ? *next : NULL;
+        depth++;
+    }
+    tablestats_lookup(&t->stats, found != NULL, 0);
+    tablestats_depth(&t->stats, visited);
+    return found;
+}
+
+/* Puts a new leaf in a node, as its end leaf if its key ends there
+ *    ref - the pointer to the node
+ *    leaf - the leaf
+ *    depth - the bytes of the key above the children of the node
+ */
+static void putLeaf(void **ref, ArtLeaf *leaf, size_t depth) {
+    ArtNode *node = *ref;
+    if (leaf->length == depth)
+        node->end = leaf;
+    else
+        addChild(ref, leaf->bytes[depth], leaf);
+}
+
+/* Inserts a key below a node
+ *    t - the table
+ *    ref - the pointer to the node, leaf or NULL where the key belongs
+ *    key - the key
+ *    value - the value
+ *    bytes - the bytes of the key
+ *    length - the number of bytes
+ *    depth - the bytes of the key above the node
+ * Returns
+ *    true if the key was added, false if it replaced an entry
+ */
+static bool insertAt(ArtTable *t, void **ref, KEY key, VALUE value,
+                     const unsigned char *bytes, size_t length,
+                     size_t depth) {
+    if (*ref == NULL) {
+        *ref = newLeaf(t, key, value);
+        return true;
+    }
+
+    if (isLeaf(*ref)) {
+        ArtLeaf *old = *ref;
+        if (leafMatches(old, bytes, length)) {
+            replaceLeaf(t, old, key, value);
+            return false;
+        }
+        // Branch where the keys part
+        size_t limit = smaller(old->length, length);
+        size_t common = depth;
+        while (common < limit && old->bytes[common] == bytes[common])
+            common++;
+        void *node = newNode(ART_NODE4);
+        ((ArtNode *)node)->prefixLength = common-depth;
+        memcpy(((ArtNode *)node)->prefix, bytes+depth,
+               smaller(common-depth, ART_MAX_PREFIX));
+        putLeaf(&node, old, common);
+        putLeaf(&node, newLeaf(t, key, value), common);
+        *ref = node;
+        return true;
+    }
+
+    ArtNode *node = *ref;
+    if (node->prefixLength > 0) {
+        size_t p = prefixMismatch(node, bytes, length, depth);
+        if (p < node->prefixLength) {
+            // Split the prefix where the key parts from it
+            void *parent = newNode(ART_NODE4);
+            ((ArtNode *)parent)->prefixLength = p;
+            memcpy(((ArtNode *)parent)->prefix, node->prefix,
+                   smaller(p, ART_MAX_PREFIX));
+            unsigned char byte;
+            if (node->prefixLength <= ART_MAX_PREFIX) {
+                byte = node->prefix[p];
+                node->prefixLength -= p+1;
+                memmove(node->prefix, node->prefix+p+1, node->prefixLength);
+            } else {
+                const ArtLeaf *leaf = minimum(node);
+                byte = leaf->bytes[depth+p];
+                node->prefixLength -= p+1;
+                memcpy(node->prefix, leaf->bytes+depth+p+1,
+                       smaller(node->prefixLength, ART_MAX_PREFIX));
+            }
+            addChild(&parent, byte, node);
+            putLeaf(&parent, newLeaf(t, key, value), depth+p);
+            *ref = parent;
+            return true;
+        }
+        depth += node->prefixLength;
+    }
+
+    if (depth == length) {
+        if (node->end != NULL) {
+            replaceLeaf(t, node->end, key, value);
+            return false;
+        }
+        node->end = newLeaf(t, key, value);
+        return true;
+    }
+    void **child = findChild(node, bytes[depth]);
+    if (child != NULL)
+        return insertAt(t, child, key, value, bytes, length, depth+1);
+    addChild(ref, bytes[depth], newLeaf(t, key, value));
+    return true;
+}
+
+/* Removes a key from below a node
+ *    ref - the pointer to the node or leaf, changed if the node shrinks
+ *    bytes - the bytes of the key
+ *    length - the number of bytes
+ *    depth - the bytes of the key above the node
+ * Returns
+ *    the leaf of the key, taken out of the tree, NULL if the key is not
+ *    in the table
+ */
+static ArtLeaf *removeAt(void **ref, const unsigned char *bytes,
+                         size_t length, size_t depth) {
+    if (*ref == NULL)
+        return NULL;
+    if (isLeaf(*ref)) {
+        ArtLeaf *leaf = *ref;
+        if (!leafMatches(leaf, bytes, length))
+            return NULL;
+        *ref = NULL;
+        return leaf;
+    }
+
+    ArtNode *node = *ref;
+    if (node->prefixLength > length-depth ||
+        checkPrefix(node, bytes, length, depth) !=
+        smaller(node->prefixLength, ART_MAX_PREFIX))
+        return NULL;
+    depth += node->prefixLength;
+    if (depth == length) {
+        ArtLeaf *leaf = node->end;
+        if (leaf == NULL || !leafMatches(leaf, bytes, length))
+            return NULL;
+        node->end = NULL;
+        collapse(ref);
+        return leaf;
+    }
+
+    unsigned char byte = bytes[depth];
+    void **child = findChild(node, byte);
+    if (child == NULL)
+        return NULL;
+    if (isLeaf(*child)) {
+        ArtLeaf *leaf = *child;
+        if (!leafMatches(leaf, bytes, length))
+            return NULL;
+        removeChild(ref, byte);
+        return leaf;
+    }
+    return removeAt(child, bytes, length, depth+1);
+}
+
+/* Where a cursor is in one node */
+typedef struct ArtFrame {
+    const ArtNode *node;
+    int next;           // -1 before the end leaf, then the next child or
+                        // byte to look at
+} ArtFrame;
+
+struct ArtCursor {
+    const ArtLeaf *leaf;                // the next entry, if known
+    ArtFrame *stack;                    // the nodes above it
+    size_t depth;
+    size_t capacity;
+};
+
+/* Returns the next child of a node a cursor has not been at
+ *    f - the frame of the node
+ * Returns
+ *    the end leaf first, then the children in the order of their bytes,
+ *    NULL when all have been returned
+ */
+static const void *nextChild(ArtFrame *f) {
+    const ArtNode *node = f->node;
+    if (f->next == -1) {
+        f->next = 0;
+        if (node->end != NULL)
+            return node->end;
+    }
+    if (node->type == ART_NODE4 || node->type == ART_NODE16) {
+        void *const *children = node->type == ART_NODE4 ?
+            ((const ArtNode4 *)node)->children :
+            ((const ArtNode16 *)node)->children;
+        return f->next < node->count ? children[f->next++] : NULL;
+    }
+    if (node->type == ART_NODE48) {
+        const ArtNode48 *n = (const ArtNode48 *)node;
+        while (f->next < 256 && n->index[f->next] == 0)
+            f->next++;
+        return f->next < 256 ? n->children[n->index[f->next++]-1] : NULL;
+    }
+    const ArtNode256 *n = (const ArtNode256 *)node;
+    while (f->next < 256 && n->children[f->next] == NULL)
+        f->next++;
+    return f->next < 256 ? n->children[f->next++] : NULL;
+}
+
+/* Puts a node on the stack of a cursor
+ *    c - the cursor
+ *    node - the node
+ */
+static void pushFrame(ArtCursor *c, const ArtNode *node) {
+    if (c->depth == c->capacity) {
+        c->capacity = c->capacity == 0 ? 16 : c->capacity*2;
+        c->stack = realloc(c->stack, c->capacity*sizeof(ArtFrame));
+    }
+    c->stack[c->depth].node = node;
+    c->stack[c->depth].next = -1;
+    c->depth++;
+}
+
+/* Deallocates a node and everything below it
+ *    t - the table
+ *    child - the node or leaf
+ */
+static void freeAll(ArtTable *t, void *child) {
+    if (isLeaf(child)) {
+        ArtLeaf *leaf = child;
+        if (t->keyFree != NULL)
+            t->keyFree(leaf->key);
+        if (t->valueFree != NULL)
+            t->valueFree(leaf->value);
+        free(leaf);
+        return;
+    }
+    ArtNode *node = child;
+    if (node->end != NULL)
+        freeAll(t, node->end);
+    if (node->type == ART_NODE4 || node->type == ART_NODE16) {
+        void **children = node->type == ART_NODE4 ?
+            ((ArtNode4 *)node)->children : ((ArtNode16 *)node)->children;
+        for(int i=0;i<node->count;i++)
+            freeAll(t, children[i]);
+    } else {
+        void **children = node->type == ART_NODE48 ?
+            ((ArtNode48 *)node)->children : ((ArtNode256 *)node)->children;
+        int slots = node->type == ART_NODE48 ? 48 : 256;
+        for(int i=0;i<slots;i++) {
+            if (children[i] != NULL)
+                freeAll(t, children[i]);
+        }
+    }
+    free(node);
+}
+
+/* Creates a cursor over the entries whose key starts with some bytes,
+ * see arttable.h. */
+ArtCursor *arttable_openCursor(Table *table, const void *prefix,
+                               size_t length) {
+    ArtTable *t = table;
+    const unsigned char *bytes = prefix;
+    ArtCursor *c = calloc(1, sizeof(ArtCursor));
+    const void *child = t->root;
+    size_t depth = 0;
+    // Follow the prefix to the node all the matching keys are below,
+    // skipping the compressed paths, which are checked at the end
+    while (child != NULL && depth < length && !isLeaf(child)) {
+        ArtNode *node = (ArtNode *)child;
+        depth += node->prefixLength;
+        if (depth >= length)
+            break;
+        void **next = findChild(node, bytes[depth]);
+        child = next != NULL ? *next : NULL;
+        depth++;
+    }
+    if (child == NULL)
+        return c;
+    // Every key below the node starts with the same bytes
+    const ArtLeaf *leaf = minimum(child);
+    if (leaf->length < length ||
+        (length > 0 && memcmp(leaf->bytes, bytes, length) != 0))
+        return c;
+    if (isLeaf(child))
+        c->leaf = child;
+    else
+        pushFrame(c, child);
+    return c;
+}
+
+/* Moves a cursor to the next entry, see arttable.h. */
+bool arttable_next(ArtCursor *c, KEY *key, VALUE *value) {
+    while (c->leaf == NULL) {
+        if (c->depth == 0)
+            return false;
+        const void *child = nextChild(&c->stack[c->depth-1]);
+        if (child == NULL)
+            c->depth--;
+        else if (isLeaf(child))
+            c->leaf = child;
+        else
+            pushFrame(c, child);
+    }
+    *key = c->leaf->key;
+    *value = c->leaf->value;
+    c->leaf = NULL;
+    return true;
+}
+
+/* Deallocates a cursor, see arttable.h. */
+void arttable_closeCursor(ArtCursor *c) {
+    free(c->stack);
+    free(c);
+}
+
+/* Calls a function for every entry whose key starts with some bytes, see
+ * arttable.h. */
+size_t arttable_iteratePrefix(Table *table, const void *prefix,
+                              size_t length, ArtVisitFunc *visit,
+                              void *context) {
+    ArtCursor *c = arttable_openCursor(table, prefix, length);
+    size_t visited = 0;
+    KEY key;
+    VALUE value;
+    while (arttable_next(c, &key, &value)) {
+        visited++;
+        if (!visit(key, value, context))
+            break;
+    }
+    arttable_closeCursor(c);
+    return visited;
+}
+
+/* Creates a table.
+ *  compare_function - Pointer to a function that is called for comparing
+ *                     two keys. The function should return <0 if the left
+ *                     parameter is smaller than the right parameter, 0 if
+ *                     the parameters are equal, and >0 if the left
+ *                     parameter is larger than the right item.
+ * Returns: A pointer to the table. NULL if creation of the table failed. */
+Table *table_create(CompareFunction *compare_function) {
+    ArtTable *t = calloc(1, sizeof(ArtTable));
+    t->cf = compare_function;
+    return t;
+}
+
+/* Install a memory handling function responsible for removing a key when
+ * removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by keys inserted into the table*/
+void table_setKeyMemHandler(Table *table, KeyFreeFunc *freeFunc) {
+    ArtTable *t = table;
+    t->keyFree = freeFunc;
+}
+
+/* Install a memory handling function responsible for removing a value
+ * when removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by values inserted into the table*/
+void table_setValueMemHandler(Table *table, ValueFreeFunc *freeFunc) {
+    ArtTable *t = table;
+    t->valueFree = freeFunc;
+}
+
+/* The keys are indexed by their bytes, so the hash function is not used */
+void table_setHashFunction(Table *table, HashFunction *hash) {
+    (void)table;
+    (void)hash;
+}
+
+/* Install the function giving the bytes of the keys, needed before the
+ * first insert.
+ *  table - Pointer to the table.
+ *  bytes - Pointer to the key bytes function. */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes) {
+    ArtTable *t = table;
+    t->keyBytes = bytes;
+}
+
+/* Determines if the table is empty.
+ *  table - Pointer to the table.
+ * Returns: false if the table is not empty, true if it is. */
+bool table_isEmpty(Table *table) {
+    ArtTable *t = table;
+    return t->size == 0;
+}
+
+/* Inserts a key and value pair into the table, replacing the entry of
+ * the key if it is already in the table.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the key.
+ *  value - Pointer to the value.
+ */
+void table_insert(Table *table, KEY key, VALUE value) {
+    ArtTable *t = table;
+    const unsigned char *bytes;
+    size_t length = t->keyBytes(key, &bytes);
+    tablestats_insert(&t->stats);
+    if (insertAt(t, &t->root, key, value, bytes, length, 0))
+        t->size++;
+}
+
+/* Finds a value given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ * Returns: Pointer to the item's value if the lookup succeded. NULL if the
+ *          lookup failed. */
+VALUE table_lookup(Table *table, KEY key) {
+    ArtTable *t = table;
+    const unsigned char *bytes;
+    size_t length = t->keyBytes(key, &bytes);
+    ArtLeaf *leaf = search(t, bytes, length);
+    return leaf != NULL ? leaf->value : NULL;
+}
+
+/* Removes an item from the table given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ */
+void table_remove(Table *table, KEY key) {
+    ArtTable *t = table;
+    const unsigned char *bytes;
+    size_t length = t->keyBytes(key, &bytes);
+    tablestats_remove(&t->stats);
+    ArtLeaf *leaf = removeAt(&t->root, bytes, length, 0);
+    if (leaf == NULL)
+        return;
+    if (t->keyFree != NULL)
+        t->keyFree(leaf->key);
+    if (t->valueFree != NULL)
+        t->valueFree(leaf->value);
+    free(leaf);
+    t->size--;
+}
+
+/* Destroys a table, deallocating all the memory it uses.
+ *  table - Pointer to the table. After the function completes this pointer
+ *          will be invalid for further use. */
+void table_free(Table *table) {
+    ArtTable *t = table;
+    if (t->root != NULL)
+        freeAll(t, t->root);
+    free(t);
+}
+
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h. The depth is the nodes and leaves a lookup visited, the
+ * compare function is never called. */
+bool table_getStats(Table *table, TableStats *stats) {
+    ArtTable *t = table;
+    return tablestats_get(&t->stats, stats);
+}
+
+/* Saves the entries to a snapshot file in the order of their keys. */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values) {
+    SnapshotWriter *w = snapshot_openWriter(path, keys, values);
+    if (w == NULL)
+        return false;
+    ArtCursor *c = arttable_openCursor(table, NULL, 0);
+    KEY key;
+    VALUE value;
+    while (arttable_next(c, &key, &value))
+        snapshot_write(w, key, value);
+    arttable_closeCursor(c);
+    return snapshot_closeWriter(w);
+}
+
+/* Creates a table from a snapshot file, with the key bytes function of
+ * the key serializer. Of duplicate keys, which the list tables may save,
+ * the first one is kept and the others are deallocated with free. */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values) {
+    if (keys->bytes == NULL)
+        return NULL;
+    SnapshotReader *r = snapshot_openReader(path, keys, values);
+    if (r == NULL)
+        return NULL;
+    ArtTable *t = table_create(compare_function);
+    t->keyBytes = keys->bytes;
+
+    KEY key;
+    VALUE value;
+    while (snapshot_read(r, &key, &value)) {
+        const unsigned char *bytes;
+        size_t length = t->keyBytes(key, &bytes);
+        if (search(t, bytes, length) != NULL) {
+            free(key);
+            free(value);
+            continue;
+        }
+        insertAt(t, &t->root, key, value, bytes, length, 0);
+        t->size++;
+    }
+    snapshot_closeReader(r);
+    // Building the table is not counted as lookups
+    memset(&t->stats, 0, sizeof(t->stats));
+    return t;
+}
@@ -0,0 +1,72 @@
+/*
+ * Prefix search over the adaptive radix tree table (arttable.c).
+ *
+ * The tree keeps the keys in the order of their bytes, see
+ * table_setKeyBytesFunction, so the entries whose keys start with some
+ * bytes are all below one node of the tree. For string keys the order is
+ * the order of strcmp, a key comes before the keys it is a prefix of.
+ *
+ * A search takes time in the length of the prefix plus the number of
+ * entries it returns, the keys that do not match are never looked at.
+ * For an autocomplete, for example,
+ *
+ *   ArtCursor *c = arttable_openCursor(table, "tab", 3);
+ *   KEY key;
+ *   VALUE value;
+ *   for(int i=0;i<10 && arttable_next(c, &key, &value);i++)
+ *       printf("%s\n", (char *)key);
+ *   arttable_closeCursor(c);
+ *
+ * lists the first ten keys starting with "tab".
+ *
+ * The functions of table.h are used for everything else.
+ */
+
+#ifndef ARTTABLE_H
+#define ARTTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "table.h"
+
+typedef struct ArtCursor ArtCursor;
+
+/* Type for function called for each entry by arttable_iteratePrefix,
+ * returning false to stop */
+typedef bool ArtVisitFunc(KEY key, VALUE value, void *context);
+
+/* Calls a function for every entry whose key starts with some bytes, in
+ * the order of the keys. The table must not be changed until it returns.
+ *  table   - Pointer to the table.
+ *  prefix  - The first bytes of the keys, NULL for all keys if length
+ *            is 0.
+ *  length  - The number of bytes.
+ *  visit   - Pointer to the function.
+ *  context - Passed on to the function.
+ * Returns: The number of entries visited. */
+size_t arttable_iteratePrefix(Table *table, const void *prefix,
+                              size_t length, ArtVisitFunc *visit,
+                              void *context);
+
+/* Creates a cursor over the entries whose key starts with some bytes.
+ * The table must not be changed until the cursor is closed.
+ *  table  - Pointer to the table.
+ *  prefix - The first bytes of the keys, NULL for all keys if length is
+ *           0. Not used after the call.
+ *  length - The number of bytes.
+ * Returns: The cursor, before the first matching entry. */
+ArtCursor *arttable_openCursor(Table *table, const void *prefix,
+                               size_t length);
+
+/* Moves a cursor to the next matching entry, in the order of the keys.
+ *  c     - The cursor.
+ *  key   - The key of the entry is stored here.
+ *  value - The value of the entry is stored here.
+ * Returns: false if all matching entries have been returned. */
+bool arttable_next(ArtCursor *c, KEY *key, VALUE *value);
+
+/* Deallocates a cursor.
+ *  c - The cursor. After the call the pointer is invalid. */
+void arttable_closeCursor(ArtCursor *c);
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * The adaptive table (adaptivetable.c) for the benchmarks, see
+ * tablebackend.h.
+ */
+
+#define TABLE_PREFIX adaptivetable
+#include "tablerename.h"
+#include "adaptivetable.c"
+#include "tablebackend.h"
+
+const TableBackend adaptivetable_backend = {
+    .name = "adaptive",
+    TABLE_BACKEND_FUNCTIONS,
+    .complexity = {.insert = 0, .lookup = 0, .remove = 0}
+};
@@ -0,0 +1,17 @@
+/*
+ * The table as an array (testprogram_table_as_array/arraytable.c) for the
+ * benchmarks, see tablebackend.h. The array has room for NUM_ELEMENTS
+ * entries, so it is skipped for larger tables.
+ */
+
+#define TABLE_PREFIX arraytable
+#include "tablerename.h"
+#include "testprogram_table_as_array/arraytable.c"
+#include "tablebackend.h"
+
+const TableBackend arraytable_backend = {
+    .name = "array",
+    TABLE_BACKEND_FUNCTIONS,
+    .maxEntries = NUM_ELEMENTS,
+    .complexity = {.insert = 1, .lookup = 1, .remove = 1}
+};
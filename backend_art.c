@@ -0,0 +1,16 @@
+/*
+ * The adaptive radix tree (arttable.c) for the benchmarks, see
+ * tablebackend.h. The operations take time in the length of the key,
+ * not in the number of entries.
+ */
+
+#define TABLE_PREFIX arttable
+#include "tablerename.h"
+#include "arttable.c"
+#include "tablebackend.h"
+
+const TableBackend arttable_backend = {
+    .name = "art",
+    TABLE_BACKEND_FUNCTIONS,
+    .complexity = {.insert = 0, .lookup = 0, .remove = 0}
+};
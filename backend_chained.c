@@ -0,0 +1,15 @@
+/*
+ * The hash table with separate chaining (hashtable.c) for the benchmarks,
+ * moving all entries at once when it grows, see tablebackend.h.
+ */
+
+#define TABLE_PREFIX chainedtable
+#include "tablerename.h"
+#include "hashtable.c"
+#include "tablebackend.h"
+
+const TableBackend chainedtable_backend = {
+    .name = "chained",
+    TABLE_BACKEND_FUNCTIONS,
+    .complexity = {.insert = 0, .lookup = 0, .remove = 0}
+};
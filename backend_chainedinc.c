@@ -0,0 +1,17 @@
+/*
+ * The hash table with separate chaining (hashtable.c) for the benchmarks,
+ * moving the entries a few buckets at a time when it grows, see
+ * tablebackend.h.
+ */
+
+#define HASHTABLE_INCREMENTAL
+#define TABLE_PREFIX chainedinctable
+#include "tablerename.h"
+#include "hashtable.c"
+#include "tablebackend.h"
+
+const TableBackend chainedinctable_backend = {
+    .name = "chained-inc",
+    TABLE_BACKEND_FUNCTIONS,
+    .complexity = {.insert = 0, .lookup = 0, .remove = 0}
+};
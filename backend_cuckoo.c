@@ -0,0 +1,15 @@
+/*
+ * The bucketized cuckoo hash table (cuckootable.c) for the benchmarks,
+ * see tablebackend.h.
+ */
+
+#define TABLE_PREFIX cuckootable
+#include "tablerename.h"
+#include "cuckootable.c"
+#include "tablebackend.h"
+
+const TableBackend cuckootable_backend = {
+    .name = "cuckoo",
+    TABLE_BACKEND_FUNCTIONS,
+    .complexity = {.insert = 0, .lookup = 0, .remove = 0}
+};
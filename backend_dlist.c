@@ -0,0 +1,15 @@
+/*
+ * The table as a directed list (table.c) for the benchmarks, see
+ * tablebackend.h.
+ */
+
+#define TABLE_PREFIX dlisttable
+#include "tablerename.h"
+#include "table.c"
+#include "tablebackend.h"
+
+const TableBackend dlisttable_backend = {
+    .name = "dlist",
+    TABLE_BACKEND_FUNCTIONS,
+    .complexity = {.insert = 0, .lookup = 1, .remove = 1}
+};
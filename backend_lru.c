@@ -0,0 +1,16 @@
+/*
+ * The LRU cache (lrutable.c) for the benchmarks, see tablebackend.h. It
+ * is created without limits, so it holds every key like the other
+ * tables.
+ */
+
+#define TABLE_PREFIX lrutable
+#include "tablerename.h"
+#include "lrutable.c"
+#include "tablebackend.h"
+
+const TableBackend lrutable_backend = {
+    .name = "lru",
+    TABLE_BACKEND_FUNCTIONS,
+    .complexity = {.insert = 0, .lookup = 0, .remove = 0}
+};
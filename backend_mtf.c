@@ -0,0 +1,15 @@
+/*
+ * The move-to-front table (mtftable.c) for the benchmarks, see
+ * tablebackend.h.
+ */
+
+#define TABLE_PREFIX mtftable
+#include "tablerename.h"
+#include "mtftable.c"
+#include "tablebackend.h"
+
+const TableBackend mtftable_backend = {
+    .name = "mtf",
+    TABLE_BACKEND_FUNCTIONS,
+    .complexity = {.insert = 0, .lookup = 1, .remove = 1}
+};
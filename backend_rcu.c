@@ -0,0 +1,17 @@
+/*
+ * The hash table with lock-free lookups (rcutable.c) for the benchmarks,
+ * see tablebackend.h. It is thread safe, so the mixed workload calls it
+ * from several threads without the global lock.
+ */
+
+#define TABLE_PREFIX rcutable
+#include "tablerename.h"
+#include "rcutable.c"
+#include "tablebackend.h"
+
+const TableBackend rcutable_backend = {
+    .name = "rcu",
+    TABLE_BACKEND_FUNCTIONS,
+    .complexity = {.insert = 0, .lookup = 0, .remove = 0},
+    .threadSafe = true
+};
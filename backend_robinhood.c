@@ -0,0 +1,15 @@
+/*
+ * The Robin Hood hash table (robinhoodtable.c) for the benchmarks, see
+ * tablebackend.h.
+ */
+
+#define TABLE_PREFIX robinhoodtable
+#include "tablerename.h"
+#include "robinhoodtable.c"
+#include "tablebackend.h"
+
+const TableBackend robinhoodtable_backend = {
+    .name = "robinhood",
+    TABLE_BACKEND_FUNCTIONS,
+    .complexity = {.insert = 0, .lookup = 0, .remove = 0}
+};
@@ -0,0 +1,15 @@
+/*
+ * The hash table with control bytes (swisstable.c) for the benchmarks,
+ * see tablebackend.h.
+ */
+
+#define TABLE_PREFIX swisstable
+#include "tablerename.h"
+#include "swisstable.c"
+#include "tablebackend.h"
+
+const TableBackend swisstable_backend = {
+    .name = "swiss",
+    TABLE_BACKEND_FUNCTIONS,
+    .complexity = {.insert = 0, .lookup = 0, .remove = 0}
+};
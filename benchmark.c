@@ -0,0 +1,96 @@
+/*
+ * Benchmark comparing the table implementations.
+ *
+ * Runs the speed test from speedtest.c, with the same keys and lookups,
+ * on every table implementation registered in tablebackend.c (or the ones
+ * selected with --backend) and prints the results side by side. Run with
+ * --help for the options. With --sweep the speed test is instead run at
+ * a series of sizes to check how each implementation scales, see sweep.h,
+ * with --threads a mix of operations is run from several threads at
+ * once, see mixedtest.h, and with --repeat or a baseline the speed test
+ * is run several times and compared with earlier runs, see repeat.h.
+ *
+ * Build with
+ *   gcc -std=c99 -O2 -pthread -o benchmark benchmark.c speedtest.c \
+ *       sweep.c mixedtest.c repeat.c testkeys.c rng.c histogram.c \
+ *       nanoclock.c workload.c perfcounters.c alloctrack.c tablebackend.c \
+ *       snapshot.c backend_*.c dlist.c testprogram_table_as_array/array.c \
+ *       -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "mixedtest.h"
+#include "repeat.h"
+#include "speedtest.h"
+#include "sweep.h"
+#include "tablebackend.h"
+
+int main(int argc, char *argv[]) {
+    SpeedConfig config;
+    const TableBackend *backends[MAX_BACKENDS];
+    SpeedResults results[MAX_BACKENDS];
+    int n = 0;
+
+    speedtest_parseArguments(argc, argv, &config, true);
+    if (config.listBackends) {
+        for(int i=0;tablebackend_all[i]!=NULL;i++)
+            printf("%s\n", tablebackend_all[i]->name);
+        return 0;
+    }
+
+    if (config.numBackends == 0) {
+        for(int i=0;tablebackend_all[i]!=NULL && n<MAX_BACKENDS;i++)
+            backends[n++] = tablebackend_all[i];
+    } else {
+        for(int i=0;i<config.numBackends;i++) {
+            backends[n] = tablebackend_find(config.backendNames[i]);
+            if (backends[n] == NULL) {
+                fprintf(stderr, "Unknown backend: %s\n",
+                        config.backendNames[i]);
+                return EXIT_FAILURE;
+            }
+            n++;
+        }
+    }
+
+    if (config.sweep)
+        return sweep_run(&config, backends, n) > 0 ? EXIT_FAILURE : 0;
+    if (config.numThreadCounts > 0) {
+        mixedtest_run(&config, backends, n);
+        return 0;
+    }
+
+    // Leave out the implementations that can not hold the whole table
+    int kept = 0;
+    for(int i=0;i<n;i++) {
+        if (backends[i]->maxEntries != 0 &&
+            backends[i]->maxEntries < speedtest_maxEntries(&config)) {
+            fprintf(stderr, "Skipping %s, it holds at most %d entries\n",
+                    backends[i]->name, backends[i]->maxEntries);
+            continue;
+        }
+        backends[kept++] = backends[i];
+    }
+    n = kept;
+    if (n == 0) {
+        fprintf(stderr, "No backend can run a table of size %d\n",
+                config.tableSize);
+        return EXIT_FAILURE;
+    }
+
+    if (config.repetitions > 1 || config.saveBaseline != NULL ||
+        config.baseline != NULL)
+        return repeat_run(&config, backends, n) != 0 ? EXIT_FAILURE : 0;
+    for(int i=0;i<n;i++) {
+        for(int w=0;w<config.warmup;w++) {
+            speedtest_run(backends[i], &config, &results[i]);
+            speedtest_freeResults(&results[i]);
+        }
+        speedtest_run(backends[i], &config, &results[i]);
+    }
+    speedtest_report(&config, backends, results, n);
+    for(int i=0;i<n;i++)
+        speedtest_freeResults(&results[i]);
+    return 0;
+}
@@ -0,0 +1,598 @@
+/*
+ * The table as a bucketized cuckoo hash table.
+ *
+ * Every key has two buckets of CUCKOO_SLOTS slots each and is always in
+ * one of them, so a lookup looks in at most two buckets whether it finds
+ * the key or not. Each slot has a 16 bit tag taken from the hash of its
+ * key, 0 for an empty slot. The tags of a bucket are kept together in 16
+ * bytes, apart from the keys and values, and are compared with the tag
+ * of the key in one SSE2 instruction. A miss reads at most two groups of
+ * tags, two cache lines, and only calls the compare function for the few
+ * keys whose tag matches by chance. A hit also reads the slot and the
+ * key that matched.
+ *
+ * The second bucket is found from the first and the tag alone (partial
+ * key cuckoo hashing), so a key can be moved to its other bucket without
+ * hashing it again. An insert into two full buckets moves a key out to
+ * its other bucket, which may move another key and so on for at most
+ * CUCKOO_MAX_KICKS moves. If that finds no room the moves are undone and
+ * the entry is put in a stash of CUCKOO_STASH_SLOTS entries, which the
+ * lookups only search when it is in use. With the stash full as well,
+ * the table is rebuilt with other hashes, at most CUCKOO_MAX_RESEEDS
+ * times, and then with twice the buckets, at most CUCKOO_MAX_GROWS
+ * times. The table is doubled when it is CUCKOO_MAX_LOAD full. Only
+ * more keys with the same hash than fit in two buckets and the stash
+ * leave no room after that, which no size or seed can separate, and the
+ * insert then ends the program with a message rather than lose the key.
+ *
+ * The keys are hashed with the function from table_setHashFunction,
+ * which has to be set before the first insert. Its hashes are mixed with
+ * the seed of the table before the bucket and the tag are taken from
+ * them, so hashes that only differ in a few bits still spread over the
+ * buckets. A key that is inserted again replaces the old entry.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "table.h"
+
+// Slots in a bucket, the 16 bit tags of a bucket fill an SSE2 register
+#define CUCKOO_SLOTS 8
+// Buckets of a new table
+#define CUCKOO_MIN_BUCKETS 2
+// Share of the slots in use before the table is doubled
+#define CUCKOO_MAX_LOAD 0.9
+// Most keys moved to their other bucket by one insert
+#define CUCKOO_MAX_KICKS 256
+// Entries that may be kept outside of the buckets
+#define CUCKOO_STASH_SLOTS 8
+// Most times the table is rebuilt with other hashes to make room for one
+// entry
+#define CUCKOO_MAX_RESEEDS 4
+// Most times the table is doubled to make room for one entry
+#define CUCKOO_MAX_GROWS 4
+
+/* The tags of the slots of a bucket, 0 for an empty slot */
+typedef struct CuckooBucket {
+    uint16_t tags[CUCKOO_SLOTS];
+} CuckooBucket;
+
+typedef struct CuckooEntry {
+    KEY key;
+    VALUE value;
+} CuckooEntry;
+
+typedef struct CuckooTable {
+    CuckooBucket *buckets;
+    CuckooEntry *entries;       // CUCKOO_SLOTS per bucket, followed by the
+                                // CUCKOO_STASH_SLOTS of the stash
+    size_t numBuckets;          // a power of two
+    size_t size;
+    int stashSize;              // entries in the stash, the first ones
+    uint64_t seed;              // mixed into the hashes
+    uint64_t random;            // picks the keys that are moved
+    CompareFunction *cf;
+    HashFunction *hash;
+    KeyFreeFunc *keyFree;
+    ValueFreeFunc *valueFree;
+    TableStats stats;
+} CuckooTable;
+
+/* Returns the next number of the random sequence of a table, xorshift64
+ *    t - the table
+ */
+static uint64_t nextRandom(CuckooTable *t) {
+    t->random ^= t->random << 13;
+    t->random ^= t->random >> 7;
+    t->random ^= t->random << 17;
+    return t->random;
+}
+
+/* Returns the hash of a key, the hash from the hash function mixed with
+ * the seed of the table by the finalizer of MurmurHash3, so every bit of
+ * it affects the bucket and the tag
+ *    t - the table
+ *    key - the key
+ */
+static uint64_t hashOf(const CuckooTable *t, KEY key) {
+    uint64_t h = t->hash(key) ^ t->seed;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* Returns the tag of a hash, never 0
+ *    h - the hash of a key
+ */
+static uint16_t tagOf(uint64_t h) {
+    uint16_t tag = h >> 48;
+    return tag != 0 ? tag : 1;
+}
+
+/* Returns the other bucket of a key
+ *    t - the table
+ *    b - one bucket of the key
+ *    tag - the tag of the key
+ */
+static size_t otherBucket(const CuckooTable *t, size_t b, uint16_t tag) {
+    // Odd, so the two buckets always differ
+    size_t offset = (tag*0xc6a4a7935bd1e995ULL) >> 32 | 1;
+    return (b ^ offset) & (t->numBuckets-1);
+}
+
+/* Finds the slots of a bucket that have a tag
+ *    bucket - the bucket
+ *    tag - the tag
+ * Returns
+ *    bit 2*i set if slot i has the tag
+ */
+static unsigned int matchTags(const CuckooBucket *bucket, uint16_t tag) {
+#ifdef __SSE2__
+    __m128i tags = _mm_loadu_si128((const __m128i *)bucket->tags);
+    __m128i equal = _mm_cmpeq_epi16(tags, _mm_set1_epi16((short)tag));
+    // Both bytes of a matching tag are set, keep the low one
+    return _mm_movemask_epi8(equal) & 0x5555;
+#else
+    unsigned int mask = 0;
+    for(int i=0;i<CUCKOO_SLOTS;i++) {
+        if (bucket->tags[i] == tag)
+            mask |= 1u << 2*i;
+    }
+    return mask;
+#endif
+}
+
+/* Returns the index of the first slot of the stash
+ *    t - the table
+ */
+static size_t stashStart(const CuckooTable *t) {
+    return t->numBuckets*CUCKOO_SLOTS;
+}
+
+/* Determines if a slot holds an entry
+ *    t - the table
+ *    slot - index of a slot of the buckets or the stash
+ */
+static bool inUse(const CuckooTable *t, size_t slot) {
+    if (slot >= stashStart(t))
+        return slot < stashStart(t)+t->stashSize;
+    return t->buckets[slot/CUCKOO_SLOTS].tags[slot%CUCKOO_SLOTS] != 0;
+}
+
+/* Finds the slot of a key, the stash is searched after the buckets when
+ * it is in use
+ *    t - the table
+ *    key - the key
+ *    h - the hash of the key
+ *    count - true if the search is a lookup, counted in the statistics
+ * Returns
+ *    the index of the slot, -1 if the key is not in the table
+ */
+static long findSlot(CuckooTable *t, KEY key, uint64_t h, bool count) {
+    uint16_t tag = tagOf(h);
+    size_t b = h & (t->numBuckets-1);
+    unsigned long long compares = 0;
+    for(int probe=1;probe<=2;probe++) {
+        unsigned int mask = matchTags(&t->buckets[b], tag);
+        while (mask != 0) {
+            long slot = b*CUCKOO_SLOTS + __builtin_ctz(mask)/2;
+            mask &= mask-1;
+            compares++;
+            if (t->cf(t->entries[slot].key, key) == 0) {
+                if (count) {
+                    tablestats_lookup(&t->stats, true, compares);
+                    tablestats_probes(&t->stats, probe);
+                }
+                return slot;
+            }
+        }
+        b = otherBucket(t, b, tag);
+    }
+    for(int i=0;i<t->stashSize;i++) {
+        long slot = stashStart(t)+i;
+        compares++;
+        if (t->cf(t->entries[slot].key, key) == 0) {
+            if (count) {
+                tablestats_lookup(&t->stats, true, compares);
+                tablestats_probes(&t->stats, 3);
+            }
+            return slot;
+        }
+    }
+    if (count) {
+        tablestats_lookup(&t->stats, false, compares);
+        tablestats_probes(&t->stats, t->stashSize > 0 ? 3 : 2);
+    }
+    return -1;
+}
+
+/* Puts an entry in an empty slot of a bucket
+ *    t - the table
+ *    b - the bucket
+ *    tag - the tag of the entry
+ *    e - the entry
+ * Returns
+ *    false if the bucket is full
+ */
+static bool putInBucket(CuckooTable *t, size_t b, uint16_t tag,
+                        const CuckooEntry *e) {
+    unsigned int empty = matchTags(&t->buckets[b], 0);
+    if (empty == 0)
+        return false;
+    int i = __builtin_ctz(empty)/2;
+    t->buckets[b].tags[i] = tag;
+    t->entries[b*CUCKOO_SLOTS+i] = *e;
+    return true;
+}
+
+/* Swaps an entry with the one in a slot of a bucket
+ *    t - the table
+ *    slot - the slot
+ *    e - the entry, replaced by the one that was in the slot
+ *    tag - the tag of the entry, replaced by the tag of the slot
+ */
+static void swapSlot(CuckooTable *t, size_t slot, CuckooEntry *e,
+                     uint16_t *tag) {
+    CuckooEntry moved = t->entries[slot];
+    uint16_t movedTag = t->buckets[slot/CUCKOO_SLOTS].tags[slot%CUCKOO_SLOTS];
+    t->entries[slot] = *e;
+    t->buckets[slot/CUCKOO_SLOTS].tags[slot%CUCKOO_SLOTS] = *tag;
+    *e = moved;
+    *tag = movedTag;
+}
+
+/* Puts an entry in one of its buckets, moving other entries to their
+ * other bucket to make room if both are full
+ *    t - the table
+ *    e - the entry
+ *    h - the hash of the key of the entry
+ * Returns
+ *    false if there was no room within CUCKOO_MAX_KICKS moves, the moves
+ *    are then undone so the table is as before
+ */
+static bool place(CuckooTable *t, const CuckooEntry *e, uint64_t h) {
+    size_t path[CUCKOO_MAX_KICKS];
+    CuckooEntry homeless = *e;
+    uint16_t tag = tagOf(h);
+    size_t b = h & (t->numBuckets-1);
+    if (putInBucket(t, b, tag, e))
+        return true;
+    b = otherBucket(t, b, tag);
+    if (putInBucket(t, b, tag, e))
+        return true;
+    for(int kick=0;kick<CUCKOO_MAX_KICKS;kick++) {
+        path[kick] = b*CUCKOO_SLOTS + nextRandom(t)%CUCKOO_SLOTS;
+        swapSlot(t, path[kick], &homeless, &tag);
+        b = otherBucket(t, b, tag);
+        if (putInBucket(t, b, tag, &homeless))
+            return true;
+    }
+    // Every move was a swap, swapping back in reverse order undoes them
+    for(int kick=CUCKOO_MAX_KICKS-1;kick>=0;kick--)
+        swapSlot(t, path[kick], &homeless, &tag);
+    return false;
+}
+
+/* Puts an entry in one of its buckets or, if there is no room, in the
+ * stash
+ *    t - the table
+ *    e - the entry
+ *    h - the hash of the key of the entry
+ * Returns
+ *    false if there was no room in the stash either, the table is then as
+ *    before
+ */
+static bool placeOrStash(CuckooTable *t, const CuckooEntry *e, uint64_t h) {
+    if (place(t, e, h))
+        return true;
+    if (t->stashSize == CUCKOO_STASH_SLOTS)
+        return false;
+    t->entries[stashStart(t)+t->stashSize++] = *e;
+    return true;
+}
+
+/* Allocates empty buckets, slots and stash
+ *    t - the table
+ *    numBuckets - the number of buckets, a power of two
+ */
+static void allocateBuckets(CuckooTable *t, size_t numBuckets) {
+    t->numBuckets = numBuckets;
+    t->stashSize = 0;
+    t->buckets = calloc(numBuckets, sizeof(CuckooBucket));
+    t->entries = malloc((numBuckets*CUCKOO_SLOTS+CUCKOO_STASH_SLOTS)*
+                        sizeof(CuckooEntry));
+}
+
+/* Moves the entries to new buckets, hashed with a new seed
+ *    t - the table
+ *    numBuckets - the number of new buckets, a power of two
+ *    seed - the new seed
+ * Returns
+ *    false if the entries did not fit, the table is then as before
+ */
+static bool rebuild(CuckooTable *t, size_t numBuckets, uint64_t seed) {
+    CuckooTable old = *t;
+    allocateBuckets(t, numBuckets);
+    t->seed = seed;
+    for(size_t slot=0;slot<stashStart(&old)+CUCKOO_STASH_SLOTS;slot++) {
+        if (!inUse(&old, slot))
+            continue;
+        const CuckooEntry *e = &old.entries[slot];
+        if (!placeOrStash(t, e, hashOf(t, e->key))) {
+            free(t->buckets);
+            free(t->entries);
+            old.random = t->random;
+            *t = old;
+            return false;
+        }
+    }
+    free(old.buckets);
+    free(old.entries);
+    return true;
+}
+
+/* Moves the entries to a number of buckets, rebuilding with other seeds
+ * if they do not fit with the current one
+ *    t - the table
+ *    numBuckets - the number of new buckets, a power of two
+ * Returns
+ *    false if the entries did not fit with CUCKOO_MAX_RESEEDS other seeds
+ *    either, the table is then as before
+ */
+static bool resize(CuckooTable *t, size_t numBuckets) {
+    if (rebuild(t, numBuckets, t->seed))
+        return true;
+    for(int i=0;i<CUCKOO_MAX_RESEEDS;i++) {
+        if (rebuild(t, numBuckets, nextRandom(t)))
+            return true;
+    }
+    return false;
+}
+
+/* Adds an entry whose key is not in the table, rebuilding the table with
+ * other seeds and then with twice the buckets if there is no room for it
+ *    t - the table
+ *    e - the entry
+ * Returns
+ *    false if there was no room after CUCKOO_MAX_GROWS doublings either,
+ *    the table then holds the same entries as before
+ */
+static bool add(CuckooTable *t, const CuckooEntry *e) {
+    if (placeOrStash(t, e, hashOf(t, e->key)))
+        return true;
+    for(int i=0;i<CUCKOO_MAX_RESEEDS;i++) {
+        if (rebuild(t, t->numBuckets, nextRandom(t)) &&
+            placeOrStash(t, e, hashOf(t, e->key)))
+            return true;
+    }
+    for(int i=0;i<CUCKOO_MAX_GROWS;i++) {
+        if (resize(t, 2*t->numBuckets) &&
+            placeOrStash(t, e, hashOf(t, e->key)))
+            return true;
+    }
+    return false;
+}
+
+/* Deallocates the key and value of an entry with the memory handlers
+ *    t - the table
+ *    e - the entry
+ */
+static void freeEntry(const CuckooTable *t, const CuckooEntry *e) {
+    if (t->keyFree != NULL)
+        t->keyFree(e->key);
+    if (t->valueFree != NULL)
+        t->valueFree(e->value);
+}
+
+/* Creates a table.
+ *  compare_function - Pointer to a function that is called for comparing
+ *                     two keys. The function should return <0 if the left
+ *                     parameter is smaller than the right parameter, 0 if
+ *                     the parameters are equal, and >0 if the left
+ *                     parameter is larger than the right item.
+ * Returns: A pointer to the table. NULL if creation of the table failed. */
+Table *table_create(CompareFunction *compare_function) {
+    CuckooTable *t = calloc(1, sizeof(CuckooTable));
+    t->cf = compare_function;
+    t->random = 0x9e3779b97f4a7c15ULL;
+    t->seed = nextRandom(t);
+    allocateBuckets(t, CUCKOO_MIN_BUCKETS);
+    return t;
+}
+
+/* Install a memory handling function responsible for removing a key when removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by keys inserted into the table*/
+void table_setKeyMemHandler(Table *table, KeyFreeFunc *freeFunc) {
+    CuckooTable *t = table;
+    t->keyFree = freeFunc;
+}
+
+/* Install a memory handling function responsible for removing a value when removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by values inserted into the table*/
+void table_setValueMemHandler(Table *table, ValueFreeFunc *freeFunc) {
+    CuckooTable *t = table;
+    t->valueFree = freeFunc;
+}
+
+/* Install the function hashing the keys, needed before the first
+ * insert.
+ *  table - Pointer to the table.
+ *  hash  - Pointer to the hash function. */
+void table_setHashFunction(Table *table, HashFunction *hash) {
+    CuckooTable *t = table;
+    t->hash = hash;
+}
+
+/* The keys are hashed, so the bytes of the keys are not used */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes) {
+    (void)table;
+    (void)bytes;
+}
+
+/* Determines if the table is empty.
+ *  table - Pointer to the table.
+ * Returns: false if the table is not empty, true if it is. */
+bool table_isEmpty(Table *table) {
+    CuckooTable *t = table;
+    return t->size == 0;
+}
+
+/* Inserts a key and value pair into the table, replacing the entry of
+ * the key if it is already in the table. Ends the program if there is no
+ * room for the key, when more keys than fit in two buckets and the stash
+ * have the same hash.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the key.
+ *  value - Pointer to the value.
+ */
+void table_insert(Table *table, KEY key, VALUE value) {
+    CuckooTable *t = table;
+    CuckooEntry e = {key, value};
+    tablestats_insert(&t->stats);
+
+    long slot = findSlot(t, key, hashOf(t, key), false);
+    if (slot >= 0) {
+        freeEntry(t, &t->entries[slot]);
+        t->entries[slot] = e;
+        return;
+    }
+
+    // If the entries do not fit in twice the buckets the table stays as
+    // it is, add tries to make room for the entry itself
+    if (t->size+1 > CUCKOO_MAX_LOAD*t->numBuckets*CUCKOO_SLOTS)
+        resize(t, 2*t->numBuckets);
+    if (!add(t, &e)) {
+        fprintf(stderr, "No room for a key in the cuckoo table, more than "
+                "%d keys have the same hash\n",
+                2*CUCKOO_SLOTS+CUCKOO_STASH_SLOTS);
+        exit(EXIT_FAILURE);
+    }
+    t->size++;
+}
+
+/* Finds a value given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ * Returns: Pointer to the item's value if the lookup succeded. NULL if the
+ *          lookup failed. */
+VALUE table_lookup(Table *table, KEY key) {
+    CuckooTable *t = table;
+    long slot = findSlot(t, key, hashOf(t, key), true);
+    return slot >= 0 ? t->entries[slot].value : NULL;
+}
+
+/* Removes an item from the table given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ */
+void table_remove(Table *table, KEY key) {
+    CuckooTable *t = table;
+    tablestats_remove(&t->stats);
+    long slot = findSlot(t, key, hashOf(t, key), false);
+    if (slot < 0)
+        return;
+    freeEntry(t, &t->entries[slot]);
+    // The stash is kept without gaps by moving its last entry
+    if ((size_t)slot >= stashStart(t))
+        t->entries[slot] = t->entries[stashStart(t) + --t->stashSize];
+    else
+        t->buckets[slot/CUCKOO_SLOTS].tags[slot%CUCKOO_SLOTS] = 0;
+    t->size--;
+}
+
+/* Destroys a table, deallocating all the memory it uses.
+ *  table - Pointer to the table. After the function completes this pointer
+ *          will be invalid for further use. */
+void table_free(Table *table) {
+    CuckooTable *t = table;
+    for(size_t slot=0;slot<stashStart(t)+CUCKOO_STASH_SLOTS;slot++) {
+        if (inUse(t, slot))
+            freeEntry(t, &t->entries[slot]);
+    }
+    free(t->buckets);
+    free(t->entries);
+    free(t);
+}
+
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h. The probes are the buckets a lookup looked in, and the
+ * stash when it is in use. */
+bool table_getStats(Table *table, TableStats *stats) {
+    CuckooTable *t = table;
+    return tablestats_get(&t->stats, stats);
+}
+
+/* Saves the entries to a snapshot file in the order of the slots, the
+ * stash last. */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values) {
+    CuckooTable *t = table;
+    SnapshotWriter *w = snapshot_openWriter(path, keys, values);
+    if (w == NULL)
+        return false;
+    for(size_t slot=0;slot<stashStart(t)+CUCKOO_STASH_SLOTS;slot++) {
+        if (inUse(t, slot))
+            snapshot_write(w, t->entries[slot].key, t->entries[slot].value);
+    }
+    return snapshot_closeWriter(w);
+}
+
+/* Creates a table from a snapshot file, hashed with the hash function of
+ * the key serializer. The buckets are allocated for all entries at once,
+ * so the table is never grown while it is built. Of duplicate keys, which
+ * the list tables may save, the first one is kept and the others are
+ * deallocated with free. Returns NULL if there is no room for every key,
+ * where table_insert would have ended the program. */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values) {
+    if (keys->hash == NULL)
+        return NULL;
+    SnapshotReader *r = snapshot_openReader(path, keys, values);
+    if (r == NULL)
+        return NULL;
+    CuckooTable *t = calloc(1, sizeof(CuckooTable));
+    t->cf = compare_function;
+    t->hash = keys->hash;
+    t->random = 0x9e3779b97f4a7c15ULL;
+    t->seed = nextRandom(t);
+    // Until the table is returned its entries are deallocated with free
+    t->keyFree = free;
+    t->valueFree = free;
+    size_t numBuckets = CUCKOO_MIN_BUCKETS;
+    while (snapshot_count(r) > CUCKOO_MAX_LOAD*numBuckets*CUCKOO_SLOTS)
+        numBuckets *= 2;
+    allocateBuckets(t, numBuckets);
+
+    CuckooEntry e;
+    while (snapshot_read(r, &e.key, &e.value)) {
+        if (findSlot(t, e.key, hashOf(t, e.key), false) >= 0) {
+            freeEntry(t, &e);
+            continue;
+        }
+        if (!add(t, &e)) {
+            freeEntry(t, &e);
+            snapshot_closeReader(r);
+            table_free(t);
+            return NULL;
+        }
+        t->size++;
+    }
+    snapshot_closeReader(r);
+    t->keyFree = NULL;
+    t->valueFree = NULL;
+    // Building the table is not counted as lookups
+    memset(&t->stats, 0, sizeof(t->stats));
+    return t;
+}
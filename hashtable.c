@@ -0,0 +1,389 @@
+/*
+ * The table as a hash table with separate chaining.
+ *
+ * Each bucket holds a linked list of the entries whose hash leads to it,
+ * and the number of buckets is doubled when the entries outnumber them.
+ * Normally all entries are moved to the new buckets at once, inside the
+ * insert that filled the table, which makes that insert take time in
+ * proportion to the size of the table.
+ *
+ * Compiled with -DHASHTABLE_INCREMENTAL the entries are instead moved a
+ * few buckets at a time. The old and the new buckets are kept side by
+ * side until the move is done, every insert, lookup and remove first
+ * moves the entries of HASHTABLE_REHASH_STEP more old buckets (passing
+ * at most ten times as many empty ones), new entries go to the new
+ * buckets, and keys are looked for in both. The move is done after
+ * about a quarter as many operations as there are entries, before the
+ * new buckets can fill up, so no single call does more than a bounded
+ * amount of work.
+ *
+ * The hash of each key is kept in its entry, so moving the entries does
+ * not hash them again and the compare function is only called for keys
+ * with the same hash. The keys are hashed with the function from
+ * table_setHashFunction, which has to be set before the first insert. A
+ * key that is inserted again replaces the old entry.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "table.h"
+
+// Buckets of a new table, a power of two
+#define HASHTABLE_MIN_BUCKETS 16
+// Non-empty old buckets moved by each operation while the table grows
+#define HASHTABLE_REHASH_STEP 4
+
+typedef struct HashNode {
+    KEY key;
+    VALUE value;
+    uint64_t hash;
+    struct HashNode *next;
+} HashNode;
+
+/* An array of buckets */
+typedef struct HashBuckets {
+    HashNode **heads;
+    size_t count;               // a power of two
+} HashBuckets;
+
+typedef struct HashTable {
+    HashBuckets buckets;
+    HashBuckets next;           // the new buckets while the table grows
+    long rehashIndex;           // next old bucket to move, -1 if the
+                                // table is not growing
+    size_t size;
+    CompareFunction *cf;
+    HashFunction *hash;
+    KeyFreeFunc *keyFree;
+    ValueFreeFunc *valueFree;
+    TableStats stats;
+} HashTable;
+
+/* Allocates empty buckets
+ *    b - the buckets
+ *    count - the number of buckets, a power of two
+ */
+static void allocateBuckets(HashBuckets *b, size_t count) {
+    b->count = count;
+    b->heads = calloc(count, sizeof(HashNode *));
+}
+
+/* Returns the head of the list a hash belongs in
+ *    b - the buckets
+ *    h - the hash
+ */
+static HashNode **bucketOf(const HashBuckets *b, uint64_t h) {
+    return &b->heads[h & (b->count-1)];
+}
+
+/* Moves the entries of some old buckets to the new ones, and ends the
+ * growing of the table when all are moved
+ *    t - the table
+ *    steps - the number of non-empty buckets to move, ten times as many
+ *            empty ones are passed at most
+ */
+static void rehashStep(HashTable *t, size_t steps) {
+    size_t emptyLeft = 10*steps;
+    while (t->rehashIndex >= 0 && steps > 0) {
+        HashNode **head = &t->buckets.heads[t->rehashIndex];
+        if (*head == NULL) {
+            if (--emptyLeft == 0)
+                break;
+        } else {
+            steps--;
+        }
+        while (*head != NULL) {
+            HashNode *node = *head;
+            *head = node->next;
+            HashNode **to = bucketOf(&t->next, node->hash);
+            node->next = *to;
+            *to = node;
+        }
+        if ((size_t)++t->rehashIndex == t->buckets.count) {
+            free(t->buckets.heads);
+            t->buckets = t->next;
+            t->next = (HashBuckets){NULL, 0};
+            t->rehashIndex = -1;
+        }
+    }
+}
+
+/* Starts moving the entries to twice as many buckets, and moves all of
+ * them unless the table grows incrementally
+ *    t - the table
+ */
+static void grow(HashTable *t) {
+    allocateBuckets(&t->next, 2*t->buckets.count);
+    t->rehashIndex = 0;
+#ifndef HASHTABLE_INCREMENTAL
+    rehashStep(t, SIZE_MAX/10);
+#endif
+}
+
+/* Finds the link to the entry of a key
+ *    t - the table
+ *    key - the key
+ *    h - the hash of the key
+ *    count - true if the search is a lookup, counted in the statistics
+ * Returns
+ *    the pointer to the entry, NULL if the key is not in the table
+ */
+static HashNode **findLink(HashTable *t, KEY key, uint64_t h, bool count) {
+    unsigned long long compares = 0;
+    unsigned long long probes = 0;
+    for(int i=0;i<2;i++) {
+        const HashBuckets *b = i == 0 ? &t->buckets : &t->next;
+        if (b->count == 0)
+            break;
+        size_t index = h & (b->count-1);
+        // The old buckets before rehashIndex are already moved
+        if (i == 0 && t->rehashIndex > 0 && index < (size_t)t->rehashIndex)
+            continue;
+        probes++;
+        for(HashNode **link=&b->heads[index];*link!=NULL;
+            link=&(*link)->next) {
+            if ((*link)->hash != h)
+                continue;
+            compares++;
+            if (t->cf((*link)->key, key) == 0) {
+                if (count) {
+                    tablestats_lookup(&t->stats, true, compares);
+                    tablestats_probes(&t->stats, probes);
+                }
+                return link;
+            }
+        }
+    }
+    if (count) {
+        tablestats_lookup(&t->stats, false, compares);
+        tablestats_probes(&t->stats, probes);
+    }
+    return NULL;
+}
+
+/* Adds an entry whose key is not in the table
+ *    t - the table
+ *    key - the key
+ *    value - the value
+ *    h - the hash of the key
+ */
+static void addNode(HashTable *t, KEY key, VALUE value, uint64_t h) {
+    HashNode *node = malloc(sizeof(HashNode));
+    HashNode **head = bucketOf(t->rehashIndex >= 0 ? &t->next :
+                                                     &t->buckets, h);
+    node->key = key;
+    node->value = value;
+    node->hash = h;
+    node->next = *head;
+    *head = node;
+    t->size++;
+}
+
+/* Creates a table.
+ *  compare_function - Pointer to a function that is called for comparing
+ *                     two keys. The function should return <0 if the left
+ *                     parameter is smaller than the right parameter, 0 if
+ *                     the parameters are equal, and >0 if the left
+ *                     parameter is larger than the right item.
+ * Returns: A pointer to the table. NULL if creation of the table failed. */
+Table *table_create(CompareFunction *compare_function) {
+    HashTable *t = calloc(1, sizeof(HashTable));
+    t->cf = compare_function;
+    t->rehashIndex = -1;
+    allocateBuckets(&t->buckets, HASHTABLE_MIN_BUCKETS);
+    return t;
+}
+
+/* Install a memory handling function responsible for removing a key when
+ * removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by keys inserted into the table*/
+void table_setKeyMemHandler(Table *table, KeyFreeFunc *freeFunc) {
+    HashTable *t = table;
+    t->keyFree = freeFunc;
+}
+
+/* Install a memory handling function responsible for removing a value
+ * when removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by values inserted into the table*/
+void table_setValueMemHandler(Table *table, ValueFreeFunc *freeFunc) {
+    HashTable *t = table;
+    t->valueFree = freeFunc;
+}
+
+/* Install the function hashing the keys, needed before the first
+ * insert.
+ *  table - Pointer to the table.
+ *  hash  - Pointer to the hash function. */
+void table_setHashFunction(Table *table, HashFunction *hash) {
+    HashTable *t = table;
+    t->hash = hash;
+}
+
+/* The keys are hashed, so the bytes of the keys are not used */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes) {
+    (void)table;
+    (void)bytes;
+}
+
+/* Determines if the table is empty.
+ *  table - Pointer to the table.
+ * Returns: false if the table is not empty, true if it is. */
+bool table_isEmpty(Table *table) {
+    HashTable *t = table;
+    return t->size == 0;
+}
+
+/* Inserts a key and value pair into the table, replacing the entry of
+ * the key if it is already in the table.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the key.
+ *  value - Pointer to the value.
+ */
+void table_insert(Table *table, KEY key, VALUE value) {
+    HashTable *t = table;
+    uint64_t h = t->hash(key);
+    tablestats_insert(&t->stats);
+    rehashStep(t, HASHTABLE_REHASH_STEP);
+
+    HashNode **link = findLink(t, key, h, false);
+    if (link != NULL) {
+        HashNode *old = *link;
+        if (t->keyFree != NULL)
+            t->keyFree(old->key);
+        if (t->valueFree != NULL)
+            t->valueFree(old->value);
+        old->key = key;
+        old->value = value;
+        return;
+    }
+
+    if (t->rehashIndex < 0 && t->size+1 > t->buckets.count)
+        grow(t);
+    addNode(t, key, value, h);
+}
+
+/* Finds a value given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ * Returns: Pointer to the item's value if the lookup succeded. NULL if the
+ *          lookup failed. */
+VALUE table_lookup(Table *table, KEY key) {
+    HashTable *t = table;
+    rehashStep(t, HASHTABLE_REHASH_STEP);
+    HashNode **link = findLink(t, key, t->hash(key), true);
+    return link != NULL ? (*link)->value : NULL;
+}
+
+/* Removes an item from the table given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ */
+void table_remove(Table *table, KEY key) {
+    HashTable *t = table;
+    tablestats_remove(&t->stats);
+    rehashStep(t, HASHTABLE_REHASH_STEP);
+    HashNode **link = findLink(t, key, t->hash(key), false);
+    if (link == NULL)
+        return;
+    HashNode *node = *link;
+    *link = node->next;
+    if (t->keyFree != NULL)
+        t->keyFree(node->key);
+    if (t->valueFree != NULL)
+        t->valueFree(node->value);
+    free(node);
+    t->size--;
+}
+
+/* Destroys a table, deallocating all the memory it uses.
+ *  table - Pointer to the table. After the function completes this pointer
+ *          will be invalid for further use. */
+void table_free(Table *table) {
+    HashTable *t = table;
+    HashBuckets *arrays[] = {&t->buckets, &t->next};
+    for(int i=0;i<2;i++) {
+        for(size_t b=0;b<arrays[i]->count;b++) {
+            HashNode *node = arrays[i]->heads[b];
+            while (node != NULL) {
+                HashNode *next = node->next;
+                if (t->keyFree != NULL)
+                    t->keyFree(node->key);
+                if (t->valueFree != NULL)
+                    t->valueFree(node->value);
+                free(node);
+                node = next;
+            }
+        }
+        free(arrays[i]->heads);
+    }
+    free(t);
+}
+
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h. The probes are the bucket lists a lookup looked in, two
+ * for some keys while the table grows. */
+bool table_getStats(Table *table, TableStats *stats) {
+    HashTable *t = table;
+    return tablestats_get(&t->stats, stats);
+}
+
+/* Saves the entries to a snapshot file in the order of the buckets. */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values) {
+    HashTable *t = table;
+    SnapshotWriter *w = snapshot_openWriter(path, keys, values);
+    if (w == NULL)
+        return false;
+    const HashBuckets *arrays[] = {&t->buckets, &t->next};
+    for(int i=0;i<2;i++) {
+        for(size_t b=0;b<arrays[i]->count;b++) {
+            for(HashNode *node=arrays[i]->heads[b];node!=NULL;
+                node=node->next)
+                snapshot_write(w, node->key, node->value);
+        }
+    }
+    return snapshot_closeWriter(w);
+}
+
+/* Creates a table from a snapshot file, hashed with the hash function of
+ * the key serializer. The buckets are allocated for all entries at once,
+ * so the table is never grown while it is loaded. Of duplicate keys,
+ * which the list tables may save, the first one is kept and the others
+ * are deallocated with free. */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values) {
+    if (keys->hash == NULL)
+        return NULL;
+    SnapshotReader *r = snapshot_openReader(path, keys, values);
+    if (r == NULL)
+        return NULL;
+    HashTable *t = calloc(1, sizeof(HashTable));
+    t->cf = compare_function;
+    t->hash = keys->hash;
+    t->rehashIndex = -1;
+    size_t count = HASHTABLE_MIN_BUCKETS;
+    while (snapshot_count(r) > count)
+        count *= 2;
+    allocateBuckets(&t->buckets, count);
+
+    KEY key;
+    VALUE value;
+    while (snapshot_read(r, &key, &value)) {
+        uint64_t h = t->hash(key);
+        if (findLink(t, key, h, false) != NULL) {
+            free(key);
+            free(value);
+            continue;
+        }
+        addNode(t, key, value, h);
+    }
+    snapshot_closeReader(r);
+    // Building the table is not counted as lookups
+    memset(&t->stats, 0, sizeof(t->stats));
+    return t;
+}
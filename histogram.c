@@ -0,0 +1,132 @@
+/*
+ * Log-linear histogram for recording latencies, see histogram.h.
+ *
+ * Bucket layout: values below 2*SUB_COUNT have a bucket each. A larger
+ * value v in [2^e, 2^(e+1)) is shifted right by e-SUB_BITS, leaving a
+ * number in [SUB_COUNT, 2*SUB_COUNT) that selects one of the SUB_COUNT
+ * sub-buckets for that power of two.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "histogram.h"
+
+#define SUB_BITS 5
+#define SUB_COUNT (1<<SUB_BITS)
+#define NUM_BUCKETS ((64-SUB_BITS+1)*SUB_COUNT)
+
+struct Histogram {
+    unsigned long long counts[NUM_BUCKETS];
+    unsigned long long total;   // number of recorded values
+    double sum;                 // sum of the recorded values
+    unsigned long long min;
+    unsigned long long max;
+};
+
+/* Finds the bucket a value is counted in.
+ *  value - the value
+ * Returns: the index of the bucket */
+static int bucketIndex(unsigned long long value) {
+    if (value < SUB_COUNT)
+        return (int)value;
+    int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+    return (shift+1)*SUB_COUNT + (int)(value>>shift) - SUB_COUNT;
+}
+
+/* Finds the largest value that is counted in a bucket.
+ *  index - the index of the bucket
+ * Returns: the largest value of the bucket */
+static unsigned long long bucketHighest(int index) {
+    if (index < SUB_COUNT)
+        return index;
+    int shift = index/SUB_COUNT - 1;
+    unsigned long long low =
+        (unsigned long long)(index%SUB_COUNT + SUB_COUNT) << shift;
+    return low + ((1ULL<<shift) - 1);
+}
+
+Histogram *histogram_create(void) {
+    Histogram *h = malloc(sizeof(Histogram));
+    if (!h)
+        return NULL;
+    histogram_reset(h);
+    return h;
+}
+
+void histogram_reset(Histogram *h) {
+    memset(h, 0, sizeof(Histogram));
+}
+
+void histogram_record(Histogram *h, unsigned long long value) {
+    histogram_recordBatch(h, value, 1);
+}
+
+void histogram_recordBatch(Histogram *h, unsigned long long total,
+                           unsigned long long count) {
+    if (count == 0)
+        return;
+    unsigned long long value = total/count;
+    if (h->total == 0 || value < h->min)
+        h->min = value;
+    if (value > h->max)
+        h->max = value;
+    h->counts[bucketIndex(value)] += count;
+    h->total += count;
+    h->sum += (double)total;
+}
+
+void histogram_merge(Histogram *dst, const Histogram *src) {
+    if (src->total == 0)
+        return;
+    for(int i=0;i<NUM_BUCKETS;i++)
+        dst->counts[i] += src->counts[i];
+    if (dst->total == 0 || src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+    dst->total += src->total;
+    dst->sum += src->sum;
+}
+
+unsigned long long histogram_count(const Histogram *h) {
+    return h->total;
+}
+
+unsigned long long histogram_min(const Histogram *h) {
+    return h->min;
+}
+
+unsigned long long histogram_max(const Histogram *h) {
+    return h->max;
+}
+
+double histogram_mean(const Histogram *h) {
+    return h->total ? h->sum/h->total : 0;
+}
+
+unsigned long long histogram_percentile(const Histogram *h,
+                                        double percentile) {
+    if (h->total == 0)
+        return 0;
+    // The rank of the value asked for, counted from 1
+    double wanted = percentile/100.0*h->total;
+    unsigned long long rank = wanted < 1 ? 1 : (unsigned long long)wanted;
+    if (wanted > rank)
+        rank++;
+    if (rank > h->total)
+        rank = h->total;
+
+    unsigned long long seen = 0;
+    for(int i=0;i<NUM_BUCKETS;i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            unsigned long long value = bucketHighest(i);
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+void histogram_free(Histogram *h) {
+    free(h);
+}
@@ -0,0 +1,68 @@
+/*
+ * Log-linear histogram for recording latencies.
+ *
+ * Values are counted in buckets where every power of two range is split
+ * into 32 equally wide sub-buckets, so any recorded value is represented
+ * with a relative error below 1/32 (about 3%). Small values are counted
+ * exactly. Recording a value is a few instructions and never allocates,
+ * which makes it cheap enough to do for every table operation.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+typedef struct Histogram Histogram;
+
+/* Creates an empty histogram.
+ * Returns: A pointer to the histogram. NULL if the creation failed. */
+Histogram *histogram_create(void);
+
+/* Removes all recorded values from a histogram.
+ *  h - Pointer to the histogram. */
+void histogram_reset(Histogram *h);
+
+/* Records a value.
+ *  h     - Pointer to the histogram.
+ *  value - The value to record, for example a latency in nanoseconds. */
+void histogram_record(Histogram *h, unsigned long long value);
+
+/* Records the time taken by a batch of operations as count values of
+ * total/count each. Used when the operations are too fast to be timed
+ * one at a time.
+ *  h     - Pointer to the histogram.
+ *  total - The time taken by the whole batch.
+ *  count - The number of operations in the batch. */
+void histogram_recordBatch(Histogram *h, unsigned long long total,
+                           unsigned long long count);
+
+/* Adds all values recorded in one histogram to another.
+ *  dst - Pointer to the histogram to add the values to.
+ *  src - Pointer to the histogram to add the values from. */
+void histogram_merge(Histogram *dst, const Histogram *src);
+
+/* Returns: The number of values recorded. */
+unsigned long long histogram_count(const Histogram *h);
+
+/* Returns: The smallest value recorded, 0 if the histogram is empty. */
+unsigned long long histogram_min(const Histogram *h);
+
+/* Returns: The largest value recorded, 0 if the histogram is empty. */
+unsigned long long histogram_max(const Histogram *h);
+
+/* Returns: The mean of the recorded values, 0 if the histogram is empty. */
+double histogram_mean(const Histogram *h);
+
+/* Finds the value at a given percentile.
+ *  h          - Pointer to the histogram.
+ *  percentile - The percentile, between 0 and 100.
+ * Returns: The largest value in the bucket holding the percentile,
+ *          capped to the largest value recorded. 0 if the histogram is
+ *          empty. */
+unsigned long long histogram_percentile(const Histogram *h,
+                                        double percentile);
+
+/* Deallocates a histogram.
+ *  h - Pointer to the histogram. After the call the pointer is invalid. */
+void histogram_free(Histogram *h);
+
+#endif
@@ -0,0 +1,407 @@
+/*
+ * The table as a bounded LRU cache, see lrutable.h.
+ *
+ * Every entry is a node of two lists at once. The recency list is
+ * doubly linked and circular around a sentinel node, with the most
+ * recently used entry first, so an entry is moved to the front or
+ * evicted from the back without walking the list. The hash index is an
+ * array of buckets, each a singly linked chain through the same nodes,
+ * doubled when the entries outnumber the buckets. The hash of each key
+ * is kept in its node, so doubling the buckets does not hash the keys
+ * again.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "table.h"
+#include "lrutable.h"
+
+// Buckets of a new cache, a power of two
+#define LRU_MIN_BUCKETS 16
+
+typedef struct LruNode {
+    KEY key;
+    VALUE value;
+    uint64_t hash;
+    size_t bytes;               // from the size function, 0 without one
+    struct LruNode *prev;       // more recently used
+    struct LruNode *next;       // less recently used
+    struct LruNode *chain;      // next in the bucket
+} LruNode;
+
+typedef struct LruTable {
+    LruNode recency;            // sentinel, next is the most recently used
+    LruNode **buckets;
+    size_t bucketCount;         // a power of two
+    size_t size;
+    size_t bytes;
+    size_t maxEntries;          // 0 for no limit
+    size_t maxBytes;            // 0 for no limit
+    LruSizeFunc *sizeOf;
+    LruEvictFunc *evict;
+    void *evictContext;
+    unsigned long long evictions;
+    CompareFunction *cf;
+    HashFunction *hash;
+    KeyFreeFunc *keyFree;
+    ValueFreeFunc *valueFree;
+    TableStats stats;
+} LruTable;
+
+/* Takes a node out of the recency list
+ *    node - the node
+ */
+static void detach(LruNode *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+}
+
+/* Puts a node first in the recency list
+ *    t - the cache
+ *    node - the node, not in the list
+ */
+static void pushFront(LruTable *t, LruNode *node) {
+    node->prev = &t->recency;
+    node->next = t->recency.next;
+    t->recency.next->prev = node;
+    t->recency.next = node;
+}
+
+/* Finds the link to the node of a key in its bucket
+ *    t - the cache
+ *    key - the key
+ *    h - the hash of the key
+ *    count - true if the search is a lookup, counted in the statistics
+ * Returns
+ *    the pointer to the node, NULL if the key is not in the cache
+ */
+static LruNode **findLink(LruTable *t, KEY key, uint64_t h, bool count) {
+    unsigned long long compares = 0;
+    for(LruNode **link=&t->buckets[h & (t->bucketCount-1)];*link!=NULL;
+        link=&(*link)->chain) {
+        if ((*link)->hash != h)
+            continue;
+        compares++;
+        if (t->cf((*link)->key, key) == 0) {
+            if (count) {
+                tablestats_lookup(&t->stats, true, compares);
+                tablestats_probes(&t->stats, 1);
+            }
+            return link;
+        }
+    }
+    if (count) {
+        tablestats_lookup(&t->stats, false, compares);
+        tablestats_probes(&t->stats, 1);
+    }
+    return NULL;
+}
+
+/* Moves the nodes to twice as many buckets
+ *    t - the cache
+ */
+static void grow(LruTable *t) {
+    size_t count = 2*t->bucketCount;
+    LruNode **buckets = calloc(count, sizeof(LruNode *));
+    for(size_t b=0;b<t->bucketCount;b++) {
+        LruNode *node = t->buckets[b];
+        while (node != NULL) {
+            LruNode *next = node->chain;
+            LruNode **head = &buckets[node->hash & (count-1)];
+            node->chain = *head;
+            *head = node;
+            node = next;
+        }
+    }
+    free(t->buckets);
+    t->buckets = buckets;
+    t->bucketCount = count;
+}
+
+/* Takes a node out of both lists and deallocates it, handing its entry
+ * to the eviction function or the memory handlers
+ *    t - the cache
+ *    link - the pointer to the node in its bucket
+ *    evicted - the node is evicted rather than removed
+ */
+static void dropNode(LruTable *t, LruNode **link, bool evicted) {
+    LruNode *node = *link;
+    *link = node->chain;
+    detach(node);
+    if (evicted && t->evict != NULL) {
+        t->evict(node->key, node->value, t->evictContext);
+    } else {
+        if (t->keyFree != NULL)
+            t->keyFree(node->key);
+        if (t->valueFree != NULL)
+            t->valueFree(node->value);
+    }
+    t->size--;
+    t->bytes -= node->bytes;
+    free(node);
+}
+
+/* Evicts the least recently used entries until the cache is within its
+ * limits, keeping the most recently used one
+ *    t - the cache
+ */
+static void evictOverflow(LruTable *t) {
+    while (t->size > 1 &&
+           ((t->maxEntries != 0 && t->size > t->maxEntries) ||
+            (t->maxBytes != 0 && t->bytes > t->maxBytes))) {
+        LruNode *last = t->recency.prev;
+        LruNode **link = &t->buckets[last->hash & (t->bucketCount-1)];
+        while (*link != last)
+            link = &(*link)->chain;
+        dropNode(t, link, true);
+        t->evictions++;
+    }
+}
+
+/* Puts a key and value pair in the cache as its most recently used entry
+ * and evicts entries if the cache grows past its limits
+ *    t - the cache
+ *    link - the link to the node of the key from findLink, its entry is
+ *           replaced, or NULL if the key is not in the cache
+ *    key - the key
+ *    value - the value
+ *    h - the hash of the key
+ */
+static void insertAt(LruTable *t, LruNode **link, KEY key, VALUE value,
+                     uint64_t h) {
+    LruNode *node;
+    if (link != NULL) {
+        node = *link;
+        if (t->keyFree != NULL)
+            t->keyFree(node->key);
+        if (t->valueFree != NULL)
+            t->valueFree(node->value);
+        detach(node);
+        t->bytes -= node->bytes;
+    } else {
+        if (t->size+1 > t->bucketCount)
+            grow(t);
+        node = malloc(sizeof(LruNode));
+        node->hash = h;
+        LruNode **head = &t->buckets[h & (t->bucketCount-1)];
+        node->chain = *head;
+        *head = node;
+        t->size++;
+    }
+    node->key = key;
+    node->value = value;
+    node->bytes = t->sizeOf != NULL ? t->sizeOf(key, value) : 0;
+    t->bytes += node->bytes;
+    pushFront(t, node);
+    evictOverflow(t);
+}
+
+/* Limits the size of the cache, see lrutable.h. */
+void lrutable_setLimits(Table *table, size_t maxEntries, size_t maxBytes,
+                        LruSizeFunc *size) {
+    LruTable *t = table;
+    t->maxEntries = maxEntries;
+    t->maxBytes = maxBytes;
+    if (size != t->sizeOf) {
+        t->sizeOf = size;
+        t->bytes = 0;
+        for(LruNode *node=t->recency.next;node!=&t->recency;
+            node=node->next) {
+            node->bytes = size != NULL ? size(node->key, node->value) : 0;
+            t->bytes += node->bytes;
+        }
+    }
+    evictOverflow(t);
+}
+
+/* Install a function called for evicted entries, see lrutable.h. */
+void lrutable_setEvictHandler(Table *table, LruEvictFunc *evict,
+                              void *context) {
+    LruTable *t = table;
+    t->evict = evict;
+    t->evictContext = context;
+}
+
+/* Returns the number of evicted entries, see lrutable.h. */
+unsigned long long lrutable_evictions(Table *table) {
+    LruTable *t = table;
+    return t->evictions;
+}
+
+/* Creates a table.
+ *  compare_function - Pointer to a function that is called for comparing
+ *                     two keys. The function should return <0 if the left
+ *                     parameter is smaller than the right parameter, 0 if
+ *                     the parameters are equal, and >0 if the left
+ *                     parameter is larger than the right item.
+ * Returns: A pointer to the table. NULL if creation of the table failed. */
+Table *table_create(CompareFunction *compare_function) {
+    LruTable *t = calloc(1, sizeof(LruTable));
+    t->cf = compare_function;
+    t->recency.prev = &t->recency;
+    t->recency.next = &t->recency;
+    t->bucketCount = LRU_MIN_BUCKETS;
+    t->buckets = calloc(t->bucketCount, sizeof(LruNode *));
+    return t;
+}
+
+/* Install a memory handling function responsible for removing a key when
+ * removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by keys inserted into the table*/
+void table_setKeyMemHandler(Table *table, KeyFreeFunc *freeFunc) {
+    LruTable *t = table;
+    t->keyFree = freeFunc;
+}
+
+/* Install a memory handling function responsible for removing a value
+ * when removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by values inserted into the table*/
+void table_setValueMemHandler(Table *table, ValueFreeFunc *freeFunc) {
+    LruTable *t = table;
+    t->valueFree = freeFunc;
+}
+
+/* Install the function hashing the keys, needed before the first
+ * insert.
+ *  table - Pointer to the table.
+ *  hash  - Pointer to the hash function. */
+void table_setHashFunction(Table *table, HashFunction *hash) {
+    LruTable *t = table;
+    t->hash = hash;
+}
+
+/* The keys are hashed, so the bytes of the keys are not used */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes) {
+    (void)table;
+    (void)bytes;
+}
+
+/* Determines if the table is empty.
+ *  table - Pointer to the table.
+ * Returns: false if the table is not empty, true if it is. */
+bool table_isEmpty(Table *table) {
+    LruTable *t = table;
+    return t->size == 0;
+}
+
+/* Inserts a key and value pair into the cache as its most recently used
+ * entry, replacing the entry of the key if it is already in the cache,
+ * and evicts entries if the cache grows past its limits.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the key.
+ *  value - Pointer to the value.
+ */
+void table_insert(Table *table, KEY key, VALUE value) {
+    LruTable *t = table;
+    uint64_t h = t->hash(key);
+    tablestats_insert(&t->stats);
+    insertAt(t, findLink(t, key, h, false), key, value, h);
+}
+
+/* Finds a value given its key and makes it the most recently used entry.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ * Returns: Pointer to the item's value if the lookup succeded. NULL if the
+ *          lookup failed. */
+VALUE table_lookup(Table *table, KEY key) {
+    LruTable *t = table;
+    LruNode **link = findLink(t, key, t->hash(key), true);
+    if (link == NULL)
+        return NULL;
+    LruNode *node = *link;
+    if (t->recency.next != node) {
+        tablestats_move(&t->stats);
+        detach(node);
+        pushFront(t, node);
+    }
+    return node->value;
+}
+
+/* Removes an item from the table given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ */
+void table_remove(Table *table, KEY key) {
+    LruTable *t = table;
+    tablestats_remove(&t->stats);
+    LruNode **link = findLink(t, key, t->hash(key), false);
+    if (link != NULL)
+        dropNode(t, link, false);
+}
+
+/* Destroys a table, deallocating all the memory it uses. The entries are
+ * deallocated with the memory handlers, not evicted.
+ *  table - Pointer to the table. After the function completes this pointer
+ *          will be invalid for further use. */
+void table_free(Table *table) {
+    LruTable *t = table;
+    LruNode *node = t->recency.next;
+    while (node != &t->recency) {
+        LruNode *next = node->next;
+        if (t->keyFree != NULL)
+            t->keyFree(node->key);
+        if (t->valueFree != NULL)
+            t->valueFree(node->value);
+        free(node);
+        node = next;
+    }
+    free(t->buckets);
+    free(t);
+}
+
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h. The moves are the entries a lookup moved to the front. */
+bool table_getStats(Table *table, TableStats *stats) {
+    LruTable *t = table;
+    return tablestats_get(&t->stats, stats);
+}
+
+/* Saves the entries to a snapshot file from the least to the most
+ * recently used, so a load restores the recency order. */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values) {
+    LruTable *t = table;
+    SnapshotWriter *w = snapshot_openWriter(path, keys, values);
+    if (w == NULL)
+        return false;
+    for(LruNode *node=t->recency.prev;node!=&t->recency;node=node->prev)
+        snapshot_write(w, node->key, node->value);
+    return snapshot_closeWriter(w);
+}
+
+/* Creates a cache without limits from a snapshot file, hashed with the
+ * hash function of the key serializer. The limits are not saved, and are
+ * set again with lrutable_setLimits. Of duplicate keys, which the list
+ * tables may save, the first one is kept and the others are deallocated
+ * with free. */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values) {
+    if (keys->hash == NULL)
+        return NULL;
+    SnapshotReader *r = snapshot_openReader(path, keys, values);
+    if (r == NULL)
+        return NULL;
+    LruTable *t = table_create(compare_function);
+    t->hash = keys->hash;
+
+    KEY key;
+    VALUE value;
+    while (snapshot_read(r, &key, &value)) {
+        uint64_t h = t->hash(key);
+        if (findLink(t, key, h, false) != NULL) {
+            free(key);
+            free(value);
+            continue;
+        }
+        insertAt(t, NULL, key, value, h);
+    }
+    snapshot_closeReader(r);
+    // Building the table is not counted as lookups
+    memset(&t->stats, 0, sizeof(t->stats));
+    return t;
+}
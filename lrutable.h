@@ -0,0 +1,55 @@
+/*
+ * Bounded LRU cache mode of the table (lrutable.c).
+ *
+ * The cache keeps its entries in recency order like the move-to-front
+ * list of mtftable.c, a lookup or insert moves the entry to the front,
+ * and it finds them through a hash index into the list, so a lookup,
+ * the move to the front and an eviction all take constant time. Once
+ * the cache holds more than the entries or bytes it is limited to, the
+ * least recently used entries are evicted from the back of the list.
+ *
+ * An evicted entry is handed to the eviction function if one is set,
+ * which then owns its key and value. Otherwise it is deallocated with
+ * the key and value memory handlers like a removed entry.
+ *
+ * The functions of table.h are used for everything else, and the keys
+ * are hashed with the function from table_setHashFunction, which has to
+ * be set before the first insert. A cache without limits never evicts.
+ */
+
+#ifndef LRUTABLE_H
+#define LRUTABLE_H
+
+#include <stddef.h>
+#include "table.h"
+
+/* Type for function told about an evicted entry, which it owns */
+typedef void LruEvictFunc(KEY key, VALUE value, void *context);
+
+/* Type for function returning the bytes an entry uses */
+typedef size_t LruSizeFunc(KEY key, VALUE value);
+
+/* Limits the size of the cache, evicting the least recently used entries
+ * at once if it is already too large. The most recently used entry is
+ * never evicted, even if it alone is larger than the limit.
+ *  table      - Pointer to the cache.
+ *  maxEntries - Most entries the cache holds, 0 for no limit.
+ *  maxBytes   - Most bytes the entries use, 0 for no limit.
+ *  size       - Pointer to a function returning the bytes of an entry,
+ *               needed for maxBytes. */
+void lrutable_setLimits(Table *table, size_t maxEntries, size_t maxBytes,
+                        LruSizeFunc *size);
+
+/* Install a function that is called for every evicted entry instead of
+ * the memory handlers.
+ *  table   - Pointer to the cache.
+ *  evict   - Pointer to the function, NULL to use the memory handlers.
+ *  context - Passed on to the function. */
+void lrutable_setEvictHandler(Table *table, LruEvictFunc *evict,
+                              void *context);
+
+/* Returns: The number of entries evicted since the cache was created.
+ *  table - Pointer to the cache. */
+unsigned long long lrutable_evictions(Table *table);
+
+#endif
@@ -0,0 +1,536 @@
+/*
+ * Multithreaded mixed workload for the benchmark, see mixedtest.h.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "mixedtest.h"
+#include "nanoclock.h"
+
+static const char *opNames[MIX_NUM_OPS] = {"lookups", "inserts", "removes"};
+
+/* What all the threads of one run share */
+typedef struct Shared {
+    const TableBackend *b;
+    Table *table;
+    KeySet *keys;           // 2*size keys, any of them may be in the table
+    bool locked;            // the table is used with the lock held
+    pthread_mutex_t lock;
+    pthread_barrier_t start;    // the threads start at the same time
+    const int *mix;
+    int writeRatio;         // one write in every writeRatio operations
+    int ops;                // operations per thread
+    int batch;              // operations timed together
+} Shared;
+
+/* One thread of a run */
+typedef struct Worker {
+    Shared *shared;
+    pthread_t thread;
+    Rng rng;
+    // The keys the thread owns, by whether they are in the table
+    int *present;
+    int numPresent;
+    int *absent;
+    int numAbsent;
+    // The operations of the thread and their keys, drawn before it starts
+    unsigned char *ops;
+    int *stream;
+    // The copies of the key and the values the inserts put in the table,
+    // made before the thread starts, NULL for the other operations
+    void **copies;
+    int **values;
+    // The results
+    unsigned long long start;   // nanoclock_now when the thread started
+    unsigned long long ns;      // time from the start to the last operation
+    unsigned long long done[MIX_NUM_OPS];
+    Histogram *latency;
+} Worker;
+
+/* The results of one thread count on one implementation */
+typedef struct MixedRun {
+    int threads;
+    unsigned long long ns;      // time until the last thread was done
+    Histogram *latency;         // all the operations of all threads
+    Worker workers[MAX_THREADS];
+} MixedRun;
+
+/* Takes the table lock if the implementation needs it
+ *    s - the shared state
+ */
+static void lockTable(Shared *s) {
+    if (s->locked)
+        pthread_mutex_lock(&s->lock);
+}
+
+/* Releases the table lock if the implementation needs it
+ *    s - the shared state
+ */
+static void unlockTable(Shared *s) {
+    if (s->locked)
+        pthread_mutex_unlock(&s->lock);
+}
+
+/* Moves a random key from one list of keys to another
+ *    from, numFrom - the list to take the key from
+ *    to, numTo - the list to put the key in
+ *    rng - the random numbers of the thread
+ * Returns
+ *    the key
+ */
+static int moveRandomKey(int *from, int *numFrom, int *to, int *numTo,
+                         Rng *rng) {
+    int i = rng_below(rng, *numFrom);
+    int key = from[i];
+    from[i] = from[--*numFrom];
+    to[(*numTo)++] = key;
+    return key;
+}
+
+/* Draws the kind of an operation from the mix or the write ratio
+ *    s - the shared state
+ *    rng - the random numbers of the thread
+ * Returns
+ *    the operation
+ */
+static MixOp drawOperation(const Shared *s, Rng *rng) {
+    if (s->writeRatio > 0) {
+        if (rng_below(rng, s->writeRatio) != 0)
+            return MIX_LOOKUP;
+        return rng_below(rng, 2) == 0 ? MIX_INSERT : MIX_REMOVE;
+    }
+    int r = rng_below(rng, 100);
+    if (r < s->mix[MIX_LOOKUP])
+        return MIX_LOOKUP;
+    if (r < s->mix[MIX_LOOKUP]+s->mix[MIX_INSERT])
+        return MIX_INSERT;
+    return MIX_REMOVE;
+}
+
+/* Draws the operations of a thread before it starts, so the timed loop
+ * neither draws random numbers, keeps track of which keys are in the
+ * table nor allocates the entries it inserts. The keys the thread owns
+ * are moved between present and absent as the operations would move
+ * them.
+ *    w - the thread
+ */
+static void planOperations(Worker *w) {
+    Shared *s = w->shared;
+
+    w->ops = malloc(s->ops > 0 ? s->ops : 1);
+    w->stream = malloc((s->ops > 0 ? s->ops : 1)*sizeof(int));
+    w->copies = calloc(s->ops > 0 ? s->ops : 1, sizeof(void *));
+    w->values = calloc(s->ops > 0 ? s->ops : 1, sizeof(int *));
+    for(int i=0;i<s->ops;i++) {
+        MixOp op = drawOperation(s, &w->rng);
+        if (op == MIX_INSERT && w->numAbsent > 0) {
+            w->ops[i] = MIX_INSERT;
+            w->stream[i] = moveRandomKey(w->absent, &w->numAbsent,
+                                         w->present, &w->numPresent,
+                                         &w->rng);
+            w->copies[i] = copyKey(s->keys, w->stream[i]);
+            w->values[i] = intPtrFromInt(w->stream[i]);
+        } else if (op == MIX_REMOVE && w->numPresent > 0) {
+            w->ops[i] = MIX_REMOVE;
+            w->stream[i] = moveRandomKey(w->present, &w->numPresent,
+                                         w->absent, &w->numAbsent, &w->rng);
+        } else {
+            w->ops[i] = MIX_LOOKUP;
+            w->stream[i] = rng_below(&w->rng, s->keys->n);
+        }
+    }
+}
+
+/* Does one operation of the mix
+ *    w - the thread
+ *    i - index of the operation in the plan of the thread
+ * Returns
+ *    the operation that was done
+ */
+static MixOp doOperation(Worker *w, int i) {
+    Shared *s = w->shared;
+    int key = w->stream[i];
+
+    switch (w->ops[i]) {
+    case MIX_INSERT:
+        lockTable(s);
+        s->b->insert(s->table, w->copies[i], w->values[i]);
+        unlockTable(s);
+        return MIX_INSERT;
+    case MIX_REMOVE:
+        lockTable(s);
+        s->b->remove(s->table, s->keys->keys[key]);
+        unlockTable(s);
+        return MIX_REMOVE;
+    default:
+        lockTable(s);
+        s->b->lookup(s->table, s->keys->keys[key]);
+        unlockTable(s);
+        return MIX_LOOKUP;
+    }
+}
+
+/* The body of a thread, runs its operations in timed batches
+ *    arg - the Worker of the thread
+ * Returns
+ *    NULL
+ */
+static void *runWorker(void *arg) {
+    Worker *w = arg;
+    Shared *s = w->shared;
+
+    pthread_barrier_wait(&s->start);
+    w->start = nanoclock_now();
+    for(int i=0;i<s->ops;) {
+        int stop = s->ops-i > s->batch ? i+s->batch : s->ops;
+        int first = i;
+        unsigned long long batchStart = nanoclock_now();
+        for(;i<stop;i++)
+            w->done[doOperation(w, i)]++;
+        histogram_recordBatch(w->latency, nanoclock_now()-batchStart,
+                              stop-first);
+    }
+    w->ns = nanoclock_now()-w->start;
+    return NULL;
+}
+
+/* Runs the workload with a number of threads on a new table
+ *    b - the implementation
+ *    config - the settings
+ *    keys - the keys, the first half is put in the table
+ *    run - the results are stored here, threads is filled in by the caller
+ */
+static void runThreads(const TableBackend *b, const SpeedConfig *config,
+                       KeySet *keys, MixedRun *run) {
+    Shared s = {
+        .b = b, .keys = keys, .locked = !b->threadSafe, .mix = config->mix,
+        .writeRatio = config->writeRatio,
+        .ops = config->numOps, .batch = config->sampleBatch
+    };
+    int threads = run->threads;
+
+    s.table = b->create(compareFunctionFor(config->keyType));
+    b->setHashFunction(s.table, hashFunctionFor(config->keyType));
+    b->setKeyBytesFunction(s.table, keyBytesFunctionFor(config->keyType));
+    b->setKeyMemHandler(s.table, free);
+    b->setValueMemHandler(s.table, free);
+    for(int i=0;i<config->tableSize;i++)
+        b->insert(s.table, copyKey(keys, i), intPtrFromInt(i));
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_barrier_init(&s.start, NULL, threads+1);
+
+    // Key k is owned by thread k%threads
+    for(int t=0;t<threads;t++) {
+        Worker *w = &run->workers[t];
+        int owned = keys->n/threads+1;
+        *w = (Worker){
+            .shared = &s,
+            .present = malloc(owned*sizeof(int)),
+            .absent = malloc(owned*sizeof(int)),
+            .latency = histogram_create()
+        };
+        for(int k=t;k<keys->n;k+=threads) {
+            if (k < config->tableSize)
+                w->present[w->numPresent++] = k;
+            else
+                w->absent[w->numAbsent++] = k;
+        }
+        rng_seed(&w->rng, config->seed+t);
+        planOperations(w);
+    }
+    for(int t=0;t<threads;t++) {
+        if (pthread_create(&run->workers[t].thread, NULL, runWorker,
+                           &run->workers[t]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_barrier_wait(&s.start);
+    for(int t=0;t<threads;t++)
+        pthread_join(run->workers[t].thread, NULL);
+
+    // From when the first thread started until the last one was done
+    unsigned long long start = run->workers[0].start;
+    unsigned long long end = 0;
+    run->latency = histogram_create();
+    for(int t=0;t<threads;t++) {
+        Worker *w = &run->workers[t];
+        if (w->start < start)
+            start = w->start;
+        if (w->start+w->ns > end)
+            end = w->start+w->ns;
+        histogram_merge(run->latency, w->latency);
+        free(w->present);
+        free(w->absent);
+        free(w->ops);
+        free(w->stream);
+        free(w->copies);
+        free(w->values);
+        w->present = w->absent = NULL;
+        w->ops = NULL;
+        w->stream = NULL;
+        w->copies = NULL;
+        w->values = NULL;
+    }
+    run->ns = end-start;
+    pthread_barrier_destroy(&s.start);
+    pthread_mutex_destroy(&s.lock);
+    b->free(s.table);
+}
+
+/* Returns the operations per second of a number of operations
+ *    ops - the number of operations
+ *    ns - the time they took
+ */
+static double opsPerSecond(unsigned long long ops, unsigned long long ns) {
+    return ns > 0 ? ops*1e9/ns : 0;
+}
+
+/* Returns the total number of operations of a thread
+ *    w - the thread
+ */
+static unsigned long long workerOps(const Worker *w) {
+    return w->done[MIX_LOOKUP]+w->done[MIX_INSERT]+w->done[MIX_REMOVE];
+}
+
+/* Returns the total number of operations of a run
+ *    run - the run
+ */
+static unsigned long long runOps(const MixedRun *run) {
+    unsigned long long ops = 0;
+    for(int t=0;t<run->threads;t++)
+        ops += workerOps(&run->workers[t]);
+    return ops;
+}
+
+/* Prints the runs of one implementation as text, with the speedup over
+ * the run with one thread if there is one
+ *    out - the stream to print to
+ *    b - the implementation
+ *    runs - the runs, one per thread count
+ *    n - the number of runs
+ */
+static void printText(FILE *out, const TableBackend *b,
+                      const MixedRun runs[], int n) {
+    double single = 0;
+    for(int r=0;r<n;r++)
+        if (runs[r].threads == 1)
+            single = opsPerSecond(runOps(&runs[r]), runs[r].ns);
+    fprintf(out, "%s (%s)\n%-9s %14s %8s %10s %10s %10s\n", b->name,
+            b->threadSafe ? "thread safe" : "global lock", "threads",
+            "ops/s", "speedup", "p50 ns", "p99 ns", "max ns");
+    for(int r=0;r<n;r++) {
+        const MixedRun *run = &runs[r];
+        double opsPerS = opsPerSecond(runOps(run), run->ns);
+        char speedup[16] = "-";
+        if (single > 0)
+            snprintf(speedup, sizeof(speedup), "%.2f", opsPerS/single);
+        fprintf(out, "%-9d %14.0f %8s %10llu %10llu %10llu\n",
+                run->threads, opsPerS, speedup,
+                histogram_percentile(run->latency, 50),
+                histogram_percentile(run->latency, 99),
+                histogram_max(run->latency));
+        if (run->threads == 1)
+            continue;
+        for(int t=0;t<run->threads;t++) {
+            const Worker *w = &run->workers[t];
+            char label[32];
+            snprintf(label, sizeof(label), "  thread %d", t);
+            fprintf(out, "%-9s %14.0f %8s %10llu %10llu %10llu\n", label,
+                    opsPerSecond(workerOps(w), w->ns), "",
+                    histogram_percentile(w->latency, 50),
+                    histogram_percentile(w->latency, 99),
+                    histogram_max(w->latency));
+        }
+    }
+    fprintf(out, "\n");
+}
+
+/* Prints one CSV row
+ *    out - the stream to print to
+ *    b - the implementation
+ *    threads - the number of threads of the run
+ *    thread - the thread, or -1 for the aggregate of all threads
+ *    done - the operations of each kind
+ *    ns - the time they took
+ *    latency - their latencies
+ */
+static void printCsvRow(FILE *out, const TableBackend *b, int threads,
+                        int thread, const unsigned long long done[],
+                        unsigned long long ns, const Histogram *latency) {
+    unsigned long long ops = done[MIX_LOOKUP]+done[MIX_INSERT]+
+                             done[MIX_REMOVE];
+    fprintf(out, "%s,%s,%d,", b->name,
+            b->threadSafe ? "none" : "global", threads);
+    if (thread < 0)
+        fprintf(out, "all,");
+    else
+        fprintf(out, "%d,", thread);
+    fprintf(out, "%llu,%llu,%llu,%llu,%llu,%.0f,%llu,%llu,%llu\n", ops,
+            done[MIX_LOOKUP], done[MIX_INSERT], done[MIX_REMOVE], ns,
+            opsPerSecond(ops, ns), histogram_percentile(latency, 50),
+            histogram_percentile(latency, 99), histogram_max(latency));
+}
+
+/* Prints the runs of one implementation as CSV rows, one for all threads
+ * of a run followed by one for each thread
+ *    out - the stream to print to
+ *    b - the implementation
+ *    runs - the runs, one per thread count
+ *    n - the number of runs
+ */
+static void printCsv(FILE *out, const TableBackend *b,
+                     const MixedRun runs[], int n) {
+    for(int r=0;r<n;r++) {
+        const MixedRun *run = &runs[r];
+        unsigned long long done[MIX_NUM_OPS] = {0};
+        for(int t=0;t<run->threads;t++)
+            for(int o=0;o<MIX_NUM_OPS;o++)
+                done[o] += run->workers[t].done[o];
+        printCsvRow(out, b, run->threads, -1, done, run->ns, run->latency);
+        for(int t=0;t<run->threads;t++)
+            printCsvRow(out, b, run->threads, t, run->workers[t].done,
+                        run->workers[t].ns, run->workers[t].latency);
+    }
+}
+
+/* Prints the operations, time and latency of a run or a thread as the
+ * members of a JSON object
+ *    out - the stream to print to
+ *    done - the operations of each kind
+ *    ns - the time they took
+ *    latency - their latencies
+ */
+static void printJsonMembers(FILE *out, const unsigned long long done[],
+                             unsigned long long ns,
+                             const Histogram *latency) {
+    unsigned long long ops = 0;
+    for(int o=0;o<MIX_NUM_OPS;o++) {
+        fprintf(out, "\"%s\": %llu, ", opNames[o], done[o]);
+        ops += done[o];
+    }
+    fprintf(out, "\"ns\": %llu, \"ops_per_s\": %.0f, \"latency_ns\": "
+            "{\"p50\": %llu, \"p99\": %llu, \"max\": %llu}", ns,
+            opsPerSecond(ops, ns), histogram_percentile(latency, 50),
+            histogram_percentile(latency, 99), histogram_max(latency));
+}
+
+/* Prints the runs of one implementation as a JSON object
+ *    out - the stream to print to
+ *    b - the implementation
+ *    runs - the runs, one per thread count
+ *    n - the number of runs
+ */
+static void printJson(FILE *out, const TableBackend *b,
+                      const MixedRun runs[], int n) {
+    fprintf(out, "{\"name\": \"%s\", \"locking\": \"%s\", \"runs\": [",
+            b->name, b->threadSafe ? "none" : "global");
+    for(int r=0;r<n;r++) {
+        const MixedRun *run = &runs[r];
+        unsigned long long done[MIX_NUM_OPS] = {0};
+        for(int t=0;t<run->threads;t++)
+            for(int o=0;o<MIX_NUM_OPS;o++)
+                done[o] += run->workers[t].done[o];
+        fprintf(out, "%s\n    {\"threads\": %d, ", r ? "," : "",
+                run->threads);
+        printJsonMembers(out, done, run->ns, run->latency);
+        fprintf(out, ", \"per_thread\": [");
+        for(int t=0;t<run->threads;t++) {
+            fprintf(out, "%s{", t ? ", " : "");
+            printJsonMembers(out, run->workers[t].done, run->workers[t].ns,
+                             run->workers[t].latency);
+            fprintf(out, "}");
+        }
+        fprintf(out, "]}");
+    }
+    fprintf(out, "\n  ]}");
+}
+
+void mixedtest_run(const SpeedConfig *config,
+                   const TableBackend *const backends[], int n) {
+    int numRuns = config->numThreadCounts;
+    // Large enough to be kept off the stack
+    MixedRun *runs = malloc(numRuns*sizeof(MixedRun));
+    FILE *out = speedtest_openOutput(config);
+    bool first = true;
+    Rng rng;
+
+    rng_seed(&rng, config->seed);
+    KeySet *keys = createKeySet(config->keyType, config->keyLength,
+                                2*config->tableSize, &rng);
+
+    switch (config->format) {
+    case FORMAT_TEXT:
+        fprintf(out, "Mixed workload on %d of %d keys, ", config->tableSize,
+                keys->n);
+        if (config->writeRatio > 0)
+            fprintf(out, "one write in %d operations", config->writeRatio);
+        else
+            fprintf(out, "%d%% lookups, %d%% inserts, %d%% removes",
+                    config->mix[MIX_LOOKUP], config->mix[MIX_INSERT],
+                    config->mix[MIX_REMOVE]);
+        fprintf(out, ", %d operations per thread\n", config->numOps);
+        if (config->sampleBatch > 1)
+            fprintf(out, "Latencies are averages of batches of %d "
+                    "operations\n", config->sampleBatch);
+        fprintf(out, "\n");
+        break;
+    case FORMAT_CSV:
+        fprintf(out, "backend,locking,threads,thread,ops,lookups,inserts,"
+                "removes,ns,ops_per_s,p50_ns,p99_ns,max_ns\n");
+        break;
+    case FORMAT_JSON:
+        fprintf(out, "{\"size\": %d, \"keys\": %d, \"ops_per_thread\": %d, ",
+                config->tableSize, keys->n, config->numOps);
+        if (config->writeRatio > 0)
+            fprintf(out, "\"write_ratio\": %d", config->writeRatio);
+        else
+            fprintf(out, "\"mix\": {\"lookups\": %d, \"inserts\": %d, "
+                    "\"removes\": %d}", config->mix[MIX_LOOKUP],
+                    config->mix[MIX_INSERT], config->mix[MIX_REMOVE]);
+        fprintf(out, ", \"sample_batch\": %d, \"backends\": [",
+                config->sampleBatch);
+        break;
+    }
+
+    for(int b=0;b<n;b++) {
+        // Inserts may put all the keys in the table
+        if (backends[b]->maxEntries != 0 &&
+            backends[b]->maxEntries < keys->n) {
+            fprintf(stderr, "Skipping %s, it holds at most %d entries\n",
+                    backends[b]->name, backends[b]->maxEntries);
+            continue;
+        }
+        for(int r=0;r<numRuns;r++) {
+            runs[r].threads = config->threadCounts[r];
+            runThreads(backends[b], config, keys, &runs[r]);
+        }
+        switch (config->format) {
+        case FORMAT_TEXT:
+            printText(out, backends[b], runs, numRuns);
+            break;
+        case FORMAT_CSV:
+            printCsv(out, backends[b], runs, numRuns);
+            break;
+        case FORMAT_JSON:
+            fprintf(out, "%s\n  ", first ? "" : ",");
+            printJson(out, backends[b], runs, numRuns);
+            break;
+        }
+        first = false;
+        fflush(out);
+        for(int r=0;r<numRuns;r++) {
+            histogram_free(runs[r].latency);
+            for(int t=0;t<runs[r].threads;t++)
+                histogram_free(runs[r].workers[t].latency);
+        }
+    }
+
+    if (config->format == FORMAT_JSON)
+        fprintf(out, "\n]}\n");
+    freeKeySet(keys);
+    free(runs);
+    speedtest_closeOutput(out);
+}
@@ -0,0 +1,34 @@
+/*
+ * Multithreaded mixed workload for the benchmark.
+ *
+ * A table is filled with the first half of 2*size keys and then a number
+ * of threads run a mix of lookups, inserts and removes on it at the same
+ * time. Lookups pick any of the 2*size keys, so about half of them find
+ * their key. Each key is owned by one thread, which inserts it only when
+ * it is not in the table and removes it only when it is, so the table
+ * stays consistent whatever the order of the threads. An insert or
+ * remove that is not possible because the thread owns no such key is done
+ * as a lookup instead. For read mostly tables, where writes are rarer
+ * than one percent, the mix can instead be one write, an insert or a
+ * remove, in every so many operations. Implementations that are not
+ * thread safe are called with a global lock held, which is what the
+ * workload measures for them. The aggregate throughput and the latency
+ * of every thread are reported for each thread count, with the speedup
+ * over one thread when one of the counts is 1, so it shows how an
+ * implementation scales across cores.
+ */
+
+#ifndef MIXEDTEST_H
+#define MIXEDTEST_H
+
+#include "speedtest.h"
+
+/* Runs the mixed workload on each implementation with each of the
+ * thread counts in the settings and prints the results.
+ *  config   - The settings, numOps is the operations per thread.
+ *  backends - The table implementations.
+ *  n        - The number of implementations. */
+void mixedtest_run(const SpeedConfig *config,
+                   const TableBackend *const backends[], int n);
+
+#endif
@@ -11,6 +11,7 @@ typedef struct MyTable {
 	CompareFunction *cf;
 	KeyFreeFunc *keyFree;
 	ValueFreeFunc *valueFree;
+	TableStats stats;
 } MyTable;
 
 typedef struct TableElement{
@@ -22,10 +23,11 @@ typedef struct TableElement{
  *  		the time to find inputs which are often looked up. 
  *	table - a table created as a directional list.
  *  pos	  - the position which is to be moved to the front of the table*/
-void table_MTF(Table *table, dlist_position pos){
+static void table_MTF(Table *table, dlist_position pos){
 
 	MyTable *t = (MyTable*)table;
 	if(pos != t->values->head){ //no need to swich if pos is first
+		tablestats_move(&t->stats);
 
 		dlist_position temp = pos->next->next;
 		dlist_position first = dlist_first(t->values); 
@@ -70,6 +72,18 @@ void table_setValueMemHandler(Table *table,ValueFreeFunc *freeFunc) {
 	t->valueFree=freeFunc;
 }
 
+/* The table is not hashed, so the hash function is not used */
+void table_setHashFunction(Table *table, HashFunction *hash) {
+	(void)table;
+	(void)hash;
+}
+
+/* The keys are only compared, so the bytes of the keys are not used */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes) {
+	(void)table;
+	(void)bytes;
+}
+
 /* Determines if the table is empty.
  *  table - Pointer to the table.
  * Returns: false if the table is not empty, true if it is. */
@@ -92,21 +106,26 @@ void table_insert(Table *table, KEY key,VALUE value) {
 	e->key = key;
 	e->value = value;
 	dlist_insert(t->values,dlist_first(t->values),e);
+	tablestats_insert(&t->stats);
   
 }
 
 VALUE table_lookup(Table *table, KEY key) {
 	MyTable *t = (MyTable*)table;
 	TableElement *i;
+	unsigned long long compares = 0;
 	dlist_position p=dlist_first(t->values);
 	while (!dlist_isEnd(t->values,p)) {
 		i=dlist_inspect(t->values,p);
+		compares++;
 		if (t->cf(i->key,key)==0){
+			tablestats_lookup(&t->stats, true, compares);
 			table_MTF(table,p);
 			return i->value;		
 		}
 		p=dlist_next(t->values,p);
 	}
+	tablestats_lookup(&t->stats, false, compares);
 	return NULL;
 }
 
@@ -116,6 +135,7 @@ void table_remove(Table *table, KEY key) {
 	TableElement *i;
 	dlist_position p=dlist_first(t->values);
 	
+	tablestats_remove(&t->stats);
 	while (!dlist_isEnd(t->values,p)) {
 		i=dlist_inspect(t->values,p);
 		if (t->cf(i->key,key)==0) {
@@ -149,3 +169,48 @@ void table_free(Table *table) {
 	free(t);
 }
 
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h. */
+bool table_getStats(Table *table, TableStats *stats) {
+	MyTable *t = (MyTable*)table;
+	return tablestats_get(&t->stats, stats);
+}
+
+/* Saves the entries to a snapshot file in the order of the list, so
+ * duplicate keys are found in the same order after a load. */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values) {
+	MyTable *t = (MyTable*)table;
+	SnapshotWriter *w = snapshot_openWriter(path, keys, values);
+	if (w == NULL)
+		return false;
+	dlist_position p=dlist_first(t->values);
+	while (!dlist_isEnd(t->values,p)) {
+		TableElement *i=dlist_inspect(t->values,p);
+		snapshot_write(w, i->key, i->value);
+		p=dlist_next(t->values,p);
+	}
+	return snapshot_closeWriter(w);
+}
+
+/* Creates a table from a snapshot file, appending the entries to the
+ * list in the order they were saved. */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values) {
+	SnapshotReader *r = snapshot_openReader(path, keys, values);
+	if (r == NULL)
+		return NULL;
+	MyTable *t = table_create(compare_function);
+	dlist_position p=dlist_first(t->values);
+	KEY key;
+	VALUE value;
+	while (snapshot_read(r, &key, &value)) {
+		TableElement *e=malloc(sizeof(TableElement));
+		e->key = key;
+		e->value = value;
+		p=dlist_next(t->values,dlist_insert(t->values,p,e));
+	}
+	snapshot_closeReader(r);
+	return t;
+}
+
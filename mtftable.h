@@ -7,6 +7,9 @@
 #ifndef TableTest_TableTest_h
 #define TableTest_TableTest_h
 #include <stdbool.h>
+#include <stddef.h>
+#include "snapshot.h"
+#include "tablestats.h"
 
 /* Type for keys in the table */
 typedef void *KEY;
@@ -16,6 +19,13 @@ typedef void *VALUE;
 /* Type for function comparing two keys (see create for details)*/
 typedef int CompareFunction(KEY,KEY);
 
+/* Type for function hashing a key (see setHashFunction for details) */
+typedef unsigned long long HashFunction(KEY);
+
+/* Type for function giving the bytes of a key (see setKeyBytesFunction for
+ * details) */
+typedef size_t KeyBytesFunction(KEY key, const unsigned char **bytes);
+
 /*Types for memory deallocation functions */
 typedef void KeyFreeFunc(KEY);
 typedef void ValueFreeFunc(VALUE);
@@ -43,6 +53,23 @@ void table_setKeyMemHandler(Table *table,KeyFreeFunc *freeFunc);
  *                     the memory used by values inserted into the table*/
 void table_setValueMemHandler(Table *table,ValueFreeFunc *freeFunc);
 
+/* Install the function hashing the keys of the table. Tables that hash
+ * their keys need it before the first insert, the others ignore it.
+ *  table - Pointer to the table.
+ *  hash  - Pointer to a function returning the hash of a key. Keys that
+ *          are equal by the compare function must get the same hash. */
+void table_setHashFunction(Table *table, HashFunction *hash);
+
+/* Install the function giving the bytes of the keys of the table. Tables
+ * that index the bytes of their keys need it before the first insert, the
+ * others ignore it.
+ *  table - Pointer to the table.
+ *  bytes - Pointer to a function that points its second parameter at the
+ *          bytes of a key and returns how many they are. The bytes must
+ *          stay the same while the key is in the table, and keys that are
+ *          equal by the compare function must have the same bytes. */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes);
+
 /* Determines if the table is empty.
  *  table - Pointer to the table.
  * Returns: false if the table is not empty, true if it is. */
@@ -78,4 +105,34 @@ void table_remove(Table *table, KEY key);
  *          will be invalid for further use. */
 void table_free(Table *table);
 
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h.
+ *  table - Pointer to the table.
+ *  stats - The statistics are stored here, all 0 if they are not counted.
+ * Returns: true if the operations are counted, false if the program was
+ *          compiled without TABLE_STATS. */
+bool table_getStats(Table *table, TableStats *stats);
+
+/* Saves the entries of the table to a snapshot file, see snapshot.h.
+ *  table  - Pointer to the table.
+ *  path   - The file, replaced if it exists.
+ *  keys   - Turns the keys into bytes.
+ *  values - Turns the values into bytes.
+ * Returns: false if the file could not be written. */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values);
+
+/* Creates a table from a snapshot file written by table_save, building
+ * it directly from the entries without looking any of them up. The
+ * memory handlers are set afterwards as for a table from table_create.
+ *  path             - The file.
+ *  compare_function - Pointer to the function comparing keys, see
+ *                     table_create.
+ *  keys             - Creates the keys from bytes.
+ *  values           - Creates the values from bytes.
+ * Returns: A pointer to the table. NULL if the file could not be read or
+ *          the table can not hold its entries. */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values);
+
 #endif
\ No newline at end of file
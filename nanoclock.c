@@ -0,0 +1,15 @@
+/*
+ * Monotonic clock with nanosecond resolution, see nanoclock.h.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include "nanoclock.h"
+
+/* Reads the monotonic clock.
+ * Returns: nanoseconds since an unspecified starting point. */
+unsigned long long nanoclock_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
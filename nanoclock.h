@@ -0,0 +1,15 @@
+/*
+ * Monotonic clock with nanosecond resolution used for timing the speed
+ * tests. Unlike gettimeofday the clock is not affected by changes to the
+ * system time, so differences between two readings are always valid.
+ */
+
+#ifndef NANOCLOCK_H
+#define NANOCLOCK_H
+
+/* Reads the monotonic clock.
+ * Returns: nanoseconds since an unspecified starting point. Only the
+ *          difference between two readings is meaningful. */
+unsigned long long nanoclock_now(void);
+
+#endif
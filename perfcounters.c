@@ -0,0 +1,143 @@
+/*
+ * Hardware performance counters for the speed test phases, see
+ * perfcounters.h. On systems other than Linux no counters are available.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include "perfcounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct PerfCounters {
+    int fds[PERF_NUM_EVENTS];       // -1 for counters that are not available
+};
+
+static const char *names[PERF_NUM_EVENTS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses",
+    "dtlb_misses"
+};
+
+const char *perfcounters_name(PerfEvent event) {
+    return names[event];
+}
+
+#ifdef __linux__
+
+/* Encodes a cache event for perf_event_attr.config */
+#define CACHE_EVENT(cache, op, result) \
+    ((cache) | ((op) << 8) | ((result) << 16))
+
+/* Opens one counter for the calling process on any CPU
+ *  type, config - the event, as in perf_event_attr
+ * Returns: the file descriptor of the counter, -1 if it is not available */
+static int openCounter(unsigned int type, unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+PerfCounters *perfcounters_open(void) {
+    static const struct {
+        unsigned int type;
+        unsigned long long config;
+    } events[PERF_NUM_EVENTS] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D,
+                                         PERF_COUNT_HW_CACHE_OP_READ,
+                                         PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_DTLB,
+                                         PERF_COUNT_HW_CACHE_OP_READ,
+                                         PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    };
+    PerfCounters *pc = malloc(sizeof(PerfCounters));
+    bool any = false;
+    if (!pc)
+        return NULL;
+    for(int i=0;i<PERF_NUM_EVENTS;i++) {
+        pc->fds[i] = openCounter(events[i].type, events[i].config);
+        if (pc->fds[i] >= 0)
+            any = true;
+    }
+    if (!any) {
+        free(pc);
+        return NULL;
+    }
+    return pc;
+}
+
+void perfcounters_start(PerfCounters *pc) {
+    for(int i=0;i<PERF_NUM_EVENTS;i++) {
+        if (pc->fds[i] >= 0) {
+            ioctl(pc->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(pc->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void perfcounters_stop(PerfCounters *pc, PerfSample *sample) {
+    for(int i=0;i<PERF_NUM_EVENTS;i++) {
+        if (pc->fds[i] >= 0)
+            ioctl(pc->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for(int i=0;i<PERF_NUM_EVENTS;i++) {
+        // value, time enabled, time running
+        unsigned long long data[3];
+        sample->valid[i] = false;
+        sample->counts[i] = 0;
+        if (pc->fds[i] < 0 ||
+            read(pc->fds[i], data, sizeof(data)) != sizeof(data) ||
+            data[2] == 0)
+            continue;
+        // The kernel multiplexes the counters if there are more than the
+        // CPU has registers for, scale up to the whole interval
+        sample->counts[i] = (double)data[0]*data[1]/data[2];
+        sample->valid[i] = true;
+    }
+}
+
+void perfcounters_close(PerfCounters *pc) {
+    for(int i=0;i<PERF_NUM_EVENTS;i++) {
+        if (pc->fds[i] >= 0)
+            close(pc->fds[i]);
+    }
+    free(pc);
+}
+
+#else
+
+PerfCounters *perfcounters_open(void) {
+    return NULL;
+}
+
+void perfcounters_start(PerfCounters *pc) {
+    (void)pc;
+}
+
+void perfcounters_stop(PerfCounters *pc, PerfSample *sample) {
+    (void)pc;
+    memset(sample, 0, sizeof(*sample));
+}
+
+void perfcounters_close(PerfCounters *pc) {
+    (void)pc;
+}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Hardware performance counters for the speed test phases.
+ *
+ * Uses perf_event_open on Linux to count cycles, instructions, L1 data
+ * cache misses, last level cache misses, branch misses and data TLB misses
+ * in the benchmark process (user space only). Each counter is opened on
+ * its own, so a counter the CPU or kernel does not support is just left
+ * out. When no counter can be opened, for example in a container or
+ * when perf_event_paranoid forbids it, perfcounters_open returns NULL and
+ * the speed test reports timing only.
+ */
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <stdbool.h>
+
+/* The events that are counted */
+typedef enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_NUM_EVENTS
+} PerfEvent;
+
+/* Counts for one measured interval */
+typedef struct PerfSample {
+    bool valid[PERF_NUM_EVENTS];    // false if the event could not be counted
+    double counts[PERF_NUM_EVENTS]; // scaled up if the counter was multiplexed
+} PerfSample;
+
+typedef struct PerfCounters PerfCounters;
+
+/* Opens the counters for the calling process.
+ * Returns: The counters, NULL if none of them are available. */
+PerfCounters *perfcounters_open(void);
+
+/* Resets the counters and starts counting.
+ *  pc - The counters. */
+void perfcounters_start(PerfCounters *pc);
+
+/* Stops counting and reads the counts since perfcounters_start.
+ *  pc     - The counters.
+ *  sample - The counts are stored here. */
+void perfcounters_stop(PerfCounters *pc, PerfSample *sample);
+
+/* Returns: A short name for an event, used in the benchmark output. */
+const char *perfcounters_name(PerfEvent event);
+
+/* Closes the counters.
+ *  pc - The counters. After the call the pointer is invalid. */
+void perfcounters_close(PerfCounters *pc);
+
+#endif
@@ -0,0 +1,548 @@
+/*
+ * The table as a hash table with separate chaining whose lookups take no
+ * lock, see rcutable.h.
+ *
+ * The buckets are published through a single pointer, and the entries of
+ * a bucket form a singly linked list whose links are only changed with
+ * atomic stores. A new key is linked in at the front of its bucket, a
+ * key that is inserted again gets a new entry that is linked in place of
+ * the old one, and a removed entry is unlinked by pointing past it. A
+ * lookup that is already at an unlinked entry can still follow its next
+ * pointer, which is left alone. When the entries outnumber the buckets
+ * all entries are copied to twice as many new buckets, which are then
+ * published, so a lookup sees either the old or the new buckets, never a
+ * mix. The writers take turns on a mutex.
+ *
+ * Memory that is unlinked is retired rather than deallocated, with a
+ * grace period reclamation built on a global epoch counter. Every thread
+ * has a slot of its own in the table, on a cache line of its own, where
+ * it announces the epoch it read when it last started a lookup, or 0 if
+ * it is quiescent. Retiring memory moves the epoch on and tags the
+ * memory with the new epoch, and the memory is deallocated once every
+ * slot is quiescent or has announced an epoch at least as new, since a
+ * lookup that started then can no longer reach it. A lookup only stores
+ * to its slot, and fences, when the epoch has moved since its last one,
+ * which with few writes is seldom. A thread calling insert or remove is
+ * quiescent, it takes the lock and needs no protection.
+ *
+ * The hash of each key is kept in its entry, so the compare function is
+ * only called for keys with the same hash. Only the inserts and removes
+ * are counted by table_getStats, counting the lookups would make them
+ * write to the table.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "table.h"
+#include "rcutable.h"
+
+// Buckets of a new table, a power of two
+#define RCU_MIN_BUCKETS 16
+// Retired memory collected before the writers try to reclaim it
+#define RCU_RECLAIM_BATCH 32
+// Bytes of a cache line, the slots of the threads are one apart
+#define RCU_CACHE_LINE 64
+
+typedef struct RcuNode {
+    KEY key;
+    VALUE value;
+    uint64_t hash;
+    struct RcuNode *next;
+} RcuNode;
+
+/* An array of buckets, replaced as a whole when the table grows */
+typedef struct RcuBuckets {
+    size_t count;               // a power of two
+    RcuNode *heads[];
+} RcuBuckets;
+
+/* Memory waiting for a grace period to end */
+typedef struct RcuRetired {
+    struct RcuRetired *next;
+    unsigned long long epoch;   // deallocated when no slot is older
+    RcuNode *entry;             // with its key and value, or NULL
+    RcuBuckets *buckets;        // with the copies of the entries, or NULL
+} RcuRetired;
+
+/* The epoch a thread announced, 0 if it is quiescent */
+typedef struct RcuSlot {
+    unsigned long long epoch;
+} __attribute__((aligned(RCU_CACHE_LINE))) RcuSlot;
+
+typedef struct RcuTable {
+    // Read by the lookups
+    RcuBuckets *buckets;
+    unsigned long long epoch;
+    CompareFunction *cf;
+    HashFunction *hash;
+    // Used by the writers
+    pthread_mutex_t writeLock __attribute__((aligned(RCU_CACHE_LINE)));
+    size_t size;
+    RcuRetired *retired;
+    size_t numRetired;
+    KeyFreeFunc *keyFree;
+    ValueFreeFunc *valueFree;
+    TableStats stats;
+    RcuSlot slots[RCU_MAX_THREADS];
+} RcuTable;
+
+// The slot of each thread, given out on its first call to any table and
+// handed back when it exits
+static pthread_once_t threadIdOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t threadIdKey;
+static pthread_mutex_t threadIdLock = PTHREAD_MUTEX_INITIALIZER;
+static bool threadIdUsed[RCU_MAX_THREADS];
+static int threadIdLimit;      // slots that have ever been given out
+static __thread int threadId = -1;
+
+/* Hands back the slot of a thread that exits
+ *    id - the slot plus one
+ */
+static void releaseThreadId(void *id) {
+    pthread_mutex_lock(&threadIdLock);
+    threadIdUsed[(intptr_t)id-1] = false;
+    pthread_mutex_unlock(&threadIdLock);
+}
+
+/* Creates the key that tells when a thread exits */
+static void createThreadIdKey(void) {
+    pthread_key_create(&threadIdKey, releaseThreadId);
+}
+
+/* Returns the slot of the calling thread, giving it one on its first
+ * call. Exits if more than RCU_MAX_THREADS threads use the tables.
+ */
+static int getThreadId(void) {
+    if (threadId >= 0)
+        return threadId;
+    pthread_once(&threadIdOnce, createThreadIdKey);
+    pthread_mutex_lock(&threadIdLock);
+    int id = 0;
+    while (id < RCU_MAX_THREADS && threadIdUsed[id])
+        id++;
+    if (id == RCU_MAX_THREADS) {
+        fprintf(stderr, "More than %d threads use the RCU tables\n",
+                RCU_MAX_THREADS);
+        exit(EXIT_FAILURE);
+    }
+    threadIdUsed[id] = true;
+    if (id >= threadIdLimit)
+        __atomic_store_n(&threadIdLimit, id+1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&threadIdLock);
+    pthread_setspecific(threadIdKey, (void *)(intptr_t)(id+1));
+    threadId = id;
+    return id;
+}
+
+/* Announces that the calling thread starts a lookup
+ *    t - the table
+ */
+static void enterReader(RcuTable *t) {
+    RcuSlot *slot = &t->slots[getThreadId()];
+    unsigned long long epoch = __atomic_load_n(&t->epoch, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->epoch, __ATOMIC_RELAXED) != epoch) {
+        __atomic_store_n(&slot->epoch, epoch, __ATOMIC_RELAXED);
+        // The writers must see the slot before the lookup reads anything
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+/* Allocates empty buckets
+ *    count - the number of buckets, a power of two
+ */
+static RcuBuckets *allocateBuckets(size_t count) {
+    RcuBuckets *b = calloc(1, sizeof(RcuBuckets)+count*sizeof(RcuNode *));
+    b->count = count;
+    return b;
+}
+
+/* Returns the head of the list a hash belongs in
+ *    b - the buckets
+ *    h - the hash
+ */
+static RcuNode **bucketOf(RcuBuckets *b, uint64_t h) {
+    return &b->heads[h & (b->count-1)];
+}
+
+/* Deallocates retired memory
+ *    t - the table
+ *    r - the retired memory
+ */
+static void freeRetired(RcuTable *t, RcuRetired *r) {
+    if (r->entry != NULL) {
+        if (t->keyFree != NULL)
+            t->keyFree(r->entry->key);
+        if (t->valueFree != NULL)
+            t->valueFree(r->entry->value);
+        free(r->entry);
+    }
+    if (r->buckets != NULL) {
+        // The keys and values were moved on to the copies
+        for(size_t b=0;b<r->buckets->count;b++) {
+            RcuNode *node = r->buckets->heads[b];
+            while (node != NULL) {
+                RcuNode *next = node->next;
+                free(node);
+                node = next;
+            }
+        }
+        free(r->buckets);
+    }
+    free(r);
+}
+
+/* Deallocates the retired memory that no thread can reach any more, with
+ * the write lock held
+ *    t - the table
+ */
+static void reclaim(RcuTable *t) {
+    // Read the slots only after the memory was unlinked
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    unsigned long long oldest = ULLONG_MAX;
+    int limit = __atomic_load_n(&threadIdLimit, __ATOMIC_ACQUIRE);
+    for(int i=0;i<limit;i++) {
+        unsigned long long epoch = __atomic_load_n(&t->slots[i].epoch,
+                                                   __ATOMIC_ACQUIRE);
+        if (epoch != 0 && epoch < oldest)
+            oldest = epoch;
+    }
+    RcuRetired **link = &t->retired;
+    while (*link != NULL) {
+        RcuRetired *r = *link;
+        if (r->epoch <= oldest) {
+            *link = r->next;
+            freeRetired(t, r);
+            t->numRetired--;
+        } else {
+            link = &r->next;
+        }
+    }
+}
+
+/* Retires unlinked memory, with the write lock held
+ *    t - the table
+ *    entry - an entry to deallocate with its key and value, or NULL
+ *    buckets - buckets to deallocate with their entries, or NULL
+ */
+static void retire(RcuTable *t, RcuNode *entry, RcuBuckets *buckets) {
+    RcuRetired *r = malloc(sizeof(RcuRetired));
+    r->entry = entry;
+    r->buckets = buckets;
+    // A lookup that reads the new epoch sees the memory unlinked
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    r->epoch = __atomic_add_fetch(&t->epoch, 1, __ATOMIC_SEQ_CST);
+    r->next = t->retired;
+    t->retired = r;
+    t->numRetired++;
+    if (t->numRetired >= RCU_RECLAIM_BATCH)
+        reclaim(t);
+}
+
+/* Copies all entries to twice as many buckets and publishes them, with
+ * the write lock held
+ *    t - the table
+ */
+static void grow(RcuTable *t) {
+    RcuBuckets *old = t->buckets;
+    RcuBuckets *b = allocateBuckets(2*old->count);
+    for(size_t i=0;i<old->count;i++) {
+        for(RcuNode *node=old->heads[i];node!=NULL;node=node->next) {
+            RcuNode *copy = malloc(sizeof(RcuNode));
+            RcuNode **head = bucketOf(b, node->hash);
+            *copy = *node;
+            copy->next = *head;
+            *head = copy;
+        }
+    }
+    __atomic_store_n(&t->buckets, b, __ATOMIC_RELEASE);
+    retire(t, NULL, old);
+}
+
+/* Finds the link to the entry of a key, with the write lock held
+ *    t - the table
+ *    key - the key
+ *    h - the hash of the key
+ * Returns
+ *    the pointer to the entry, NULL if the key is not in the table
+ */
+static RcuNode **findLink(RcuTable *t, KEY key, uint64_t h) {
+    for(RcuNode **link=bucketOf(t->buckets, h);*link!=NULL;
+        link=&(*link)->next) {
+        if ((*link)->hash == h && t->cf((*link)->key, key) == 0)
+            return link;
+    }
+    return NULL;
+}
+
+/* Adds an entry whose key is not in the table, with the write lock held
+ * or before the table is shared
+ *    t - the table
+ *    key - the key
+ *    value - the value
+ *    h - the hash of the key
+ */
+static void addNode(RcuTable *t, KEY key, VALUE value, uint64_t h) {
+    RcuNode *node = malloc(sizeof(RcuNode));
+    RcuNode **head = bucketOf(t->buckets, h);
+    node->key = key;
+    node->value = value;
+    node->hash = h;
+    node->next = *head;
+    __atomic_store_n(head, node, __ATOMIC_RELEASE);
+    __atomic_store_n(&t->size, t->size+1, __ATOMIC_RELAXED);
+}
+
+/* Allocates an empty table with its buckets
+ *    compare_function - the compare function
+ *    count - the number of buckets, a power of two
+ */
+static RcuTable *allocateTable(CompareFunction *compare_function,
+                               size_t count) {
+    void *memory;
+    // The slots must not share cache lines with anything else
+    if (posix_memalign(&memory, RCU_CACHE_LINE, sizeof(RcuTable)) != 0)
+        return NULL;
+    RcuTable *t = memory;
+    memset(t, 0, sizeof(RcuTable));
+    t->cf = compare_function;
+    t->epoch = 1;
+    t->buckets = allocateBuckets(count);
+    pthread_mutex_init(&t->writeLock, NULL);
+    return t;
+}
+
+/* Creates a table.
+ *  compare_function - Pointer to a function that is called for comparing
+ *                     two keys. The function should return <0 if the left
+ *                     parameter is smaller than the right parameter, 0 if
+ *                     the parameters are equal, and >0 if the left
+ *                     parameter is larger than the right item.
+ * Returns: A pointer to the table. NULL if creation of the table failed. */
+Table *table_create(CompareFunction *compare_function) {
+    return allocateTable(compare_function, RCU_MIN_BUCKETS);
+}
+
+/* Install a memory handling function responsible for removing a key when
+ * removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by keys inserted into the table*/
+void table_setKeyMemHandler(Table *table, KeyFreeFunc *freeFunc) {
+    RcuTable *t = table;
+    t->keyFree = freeFunc;
+}
+
+/* Install a memory handling function responsible for removing a value
+ * when removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by values inserted into the table*/
+void table_setValueMemHandler(Table *table, ValueFreeFunc *freeFunc) {
+    RcuTable *t = table;
+    t->valueFree = freeFunc;
+}
+
+/* Install the function hashing the keys, needed before the table is
+ * shared.
+ *  table - Pointer to the table.
+ *  hash  - Pointer to the hash function. */
+void table_setHashFunction(Table *table, HashFunction *hash) {
+    RcuTable *t = table;
+    t->hash = hash;
+}
+
+/* The keys are hashed, so the bytes of the keys are not used */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes) {
+    (void)table;
+    (void)bytes;
+}
+
+/* Determines if the table is empty.
+ *  table - Pointer to the table.
+ * Returns: false if the table is not empty, true if it is. */
+bool table_isEmpty(Table *table) {
+    RcuTable *t = table;
+    return __atomic_load_n(&t->size, __ATOMIC_RELAXED) == 0;
+}
+
+/* Inserts a key and value pair into the table, replacing the entry of
+ * the key if it is already in the table.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the key.
+ *  value - Pointer to the value.
+ */
+void table_insert(Table *table, KEY key, VALUE value) {
+    RcuTable *t = table;
+    uint64_t h = t->hash(key);
+    rcutable_quiescent(table);
+    pthread_mutex_lock(&t->writeLock);
+    tablestats_insert(&t->stats);
+
+    RcuNode **link = findLink(t, key, h);
+    if (link != NULL) {
+        RcuNode *old = *link;
+        RcuNode *node = malloc(sizeof(RcuNode));
+        node->key = key;
+        node->value = value;
+        node->hash = h;
+        node->next = old->next;
+        __atomic_store_n(link, node, __ATOMIC_RELEASE);
+        retire(t, old, NULL);
+    } else {
+        if (t->size+1 > t->buckets->count)
+            grow(t);
+        addNode(t, key, value, h);
+    }
+    pthread_mutex_unlock(&t->writeLock);
+}
+
+/* Finds a value given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ * Returns: Pointer to the item's value if the lookup succeded. NULL if the
+ *          lookup failed. */
+VALUE table_lookup(Table *table, KEY key) {
+    RcuTable *t = table;
+    uint64_t h = t->hash(key);
+    enterReader(t);
+    RcuBuckets *b = __atomic_load_n(&t->buckets, __ATOMIC_ACQUIRE);
+    RcuNode *node = __atomic_load_n(bucketOf(b, h), __ATOMIC_ACQUIRE);
+    while (node != NULL) {
+        if (node->hash == h && t->cf(node->key, key) == 0)
+            return node->value;
+        node = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    }
+    return NULL;
+}
+
+/* Removes an item from the table given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ */
+void table_remove(Table *table, KEY key) {
+    RcuTable *t = table;
+    uint64_t h = t->hash(key);
+    rcutable_quiescent(table);
+    pthread_mutex_lock(&t->writeLock);
+    tablestats_remove(&t->stats);
+    RcuNode **link = findLink(t, key, h);
+    if (link != NULL) {
+        RcuNode *node = *link;
+        __atomic_store_n(link, node->next, __ATOMIC_RELEASE);
+        __atomic_store_n(&t->size, t->size-1, __ATOMIC_RELAXED);
+        retire(t, node, NULL);
+    }
+    pthread_mutex_unlock(&t->writeLock);
+}
+
+/* Tells the table that the calling thread holds nothing from it, see
+ * rcutable.h. */
+void rcutable_quiescent(Table *table) {
+    RcuTable *t = table;
+    // The thread is done with what it read before the slot is cleared
+    __atomic_store_n(&t->slots[getThreadId()].epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* Reclaims what it can and returns the retired memory that is still
+ * waiting, see rcutable.h. */
+size_t rcutable_pending(Table *table) {
+    RcuTable *t = table;
+    pthread_mutex_lock(&t->writeLock);
+    reclaim(t);
+    size_t pending = t->numRetired;
+    pthread_mutex_unlock(&t->writeLock);
+    return pending;
+}
+
+/* Destroys a table, deallocating all the memory it uses.
+ *  table - Pointer to the table. After the function completes this pointer
+ *          will be invalid for further use. */
+void table_free(Table *table) {
+    RcuTable *t = table;
+    // No thread uses the table any more, so nothing needs to wait
+    while (t->retired != NULL) {
+        RcuRetired *next = t->retired->next;
+        freeRetired(t, t->retired);
+        t->retired = next;
+    }
+    for(size_t b=0;b<t->buckets->count;b++) {
+        RcuNode *node = t->buckets->heads[b];
+        while (node != NULL) {
+            RcuNode *next = node->next;
+            if (t->keyFree != NULL)
+                t->keyFree(node->key);
+            if (t->valueFree != NULL)
+                t->valueFree(node->value);
+            free(node);
+            node = next;
+        }
+    }
+    free(t->buckets);
+    pthread_mutex_destroy(&t->writeLock);
+    free(t);
+}
+
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h. The lookups are not counted. */
+bool table_getStats(Table *table, TableStats *stats) {
+    RcuTable *t = table;
+    pthread_mutex_lock(&t->writeLock);
+    bool counted = tablestats_get(&t->stats, stats);
+    pthread_mutex_unlock(&t->writeLock);
+    return counted;
+}
+
+/* Saves the entries to a snapshot file in the order of the buckets. The
+ * writers wait until it is done, the lookups do not. */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values) {
+    RcuTable *t = table;
+    SnapshotWriter *w = snapshot_openWriter(path, keys, values);
+    if (w == NULL)
+        return false;
+    pthread_mutex_lock(&t->writeLock);
+    for(size_t b=0;b<t->buckets->count;b++) {
+        for(RcuNode *node=t->buckets->heads[b];node!=NULL;node=node->next)
+            snapshot_write(w, node->key, node->value);
+    }
+    pthread_mutex_unlock(&t->writeLock);
+    return snapshot_closeWriter(w);
+}
+
+/* Creates a table from a snapshot file, hashed with the hash function of
+ * the key serializer. The buckets are allocated for all entries at once,
+ * so the table is never grown while it is loaded. Of duplicate keys,
+ * which the list tables may save, the first one is kept and the others
+ * are deallocated with free. */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values) {
+    if (keys->hash == NULL)
+        return NULL;
+    SnapshotReader *r = snapshot_openReader(path, keys, values);
+    if (r == NULL)
+        return NULL;
+    size_t count = RCU_MIN_BUCKETS;
+    while (snapshot_count(r) > count)
+        count *= 2;
+    RcuTable *t = allocateTable(compare_function, count);
+    t->hash = keys->hash;
+
+    KEY key;
+    VALUE value;
+    while (snapshot_read(r, &key, &value)) {
+        uint64_t h = t->hash(key);
+        if (findLink(t, key, h) != NULL) {
+            free(key);
+            free(value);
+            continue;
+        }
+        addNode(t, key, value, h);
+    }
+    snapshot_closeReader(r);
+    return t;
+}
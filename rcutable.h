@@ -0,0 +1,47 @@
+/*
+ * Concurrent table with lock-free lookups (rcutable.c).
+ *
+ * The table may be used from several threads at once. Lookups take no
+ * lock and write nothing that another thread reads in the common case,
+ * so they scale with the number of cores. Inserts and removes are
+ * serialized by a lock of their own and never wait for the lookups.
+ *
+ * A writer does not change an entry that a lookup may be reading. It
+ * publishes a new version with a single atomic store and retires the old
+ * one. A retired entry is only deallocated, with the key and value memory
+ * handlers, after a grace period, when no thread can still hold it.
+ *
+ * A key or value returned by table_lookup stays valid until the calling
+ * thread calls a function of the table again, or calls
+ * rcutable_quiescent. A thread that has used the table and then leaves
+ * it alone for a long time should call rcutable_quiescent, or its last
+ * lookup holds up the reclaiming of every entry retired since.
+ *
+ * The functions of table.h are used for everything else. The keys are
+ * hashed with the function from table_setHashFunction, which has to be
+ * set before the table is shared.
+ */
+
+#ifndef RCUTABLE_H
+#define RCUTABLE_H
+
+#include "table.h"
+
+// Most threads that may use the tables at once
+#define RCU_MAX_THREADS 256
+
+/* Tells the table that the calling thread holds no key or value it got
+ * from the table, so the entries retired since its last call can be
+ * reclaimed without waiting for it.
+ *  table - Pointer to the table. */
+void rcutable_quiescent(Table *table);
+
+/* Deallocates the retired entries and buckets that no thread can reach
+ * any more. Retired memory is otherwise only reclaimed by the inserts
+ * and removes, once enough of it has been collected.
+ *  table - Pointer to the table.
+ * Returns: The number of retired entries and buckets that are still
+ *          waiting for a grace period to end. */
+size_t rcutable_pending(Table *table);
+
+#endif
@@ -0,0 +1,712 @@
+/*
+ * Repeated runs and baseline comparison for the benchmark, see repeat.h.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "repeat.h"
+
+// Longest name of a backend, phase, distribution or workload in a series
+#define NAME_LENGTH 64
+
+/* The ns/op of one phase of one implementation in every run */
+typedef struct Series {
+    char backend[NAME_LENGTH];
+    char phase[NAME_LENGTH];
+    char distribution[NAME_LENGTH];    // empty if the phase has none
+    char workload[NAME_LENGTH];        // empty if the phase has none
+    int n;
+    double *nsPerOp;
+} Series;
+
+/* A baseline read back from its file */
+typedef struct Baseline {
+    double size;
+    double ops;
+    double seed;
+    char keyType[NAME_LENGTH];
+    int n;
+    Series *series;
+} Baseline;
+
+/* How a series compares with the baseline */
+typedef enum Verdict {
+    VERDICT_NONE,           // no baseline was given
+    VERDICT_NEW,            // the baseline does not have the phase
+    VERDICT_UNCHANGED,
+    VERDICT_REGRESSION,
+    VERDICT_IMPROVEMENT
+} Verdict;
+
+static const char *verdictNames[] = {
+    "", "new", "unchanged", "regression", "improvement"
+};
+
+/* The comparison of a series with the baseline */
+typedef struct Comparison {
+    const Series *baseline; // the same phase in the baseline, or NULL
+    double change;          // relative change of the median
+    double p;               // p-value in the direction of the change
+    Verdict verdict;
+} Comparison;
+
+/* Compares two numbers for qsort
+ *    a, b - the numbers
+ */
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y)-(x < y);
+}
+
+/* Returns the median of some numbers
+ *    values - the numbers, left as they are
+ *    n - the number of numbers, at least 1
+ */
+static double median(const double values[], int n) {
+    double *sorted = malloc(n*sizeof(double));
+    memcpy(sorted, values, n*sizeof(double));
+    qsort(sorted, n, sizeof(double), compareDoubles);
+    double m = n%2 ? sorted[n/2] : (sorted[n/2-1]+sorted[n/2])/2;
+    free(sorted);
+    return m;
+}
+
+/* Returns the median absolute deviation of some numbers from their
+ * median
+ *    values - the numbers
+ *    n - the number of numbers, at least 1
+ */
+static double mad(const double values[], int n) {
+    double m = median(values, n);
+    double *deviations = malloc(n*sizeof(double));
+    for(int i=0;i<n;i++)
+        deviations[i] = fabs(values[i]-m);
+    double result = median(deviations, n);
+    free(deviations);
+    return result;
+}
+
+/* Returns the smallest of some numbers
+ *    values - the numbers
+ *    n - the number of numbers, at least 1
+ */
+static double minimum(const double values[], int n) {
+    double min = values[0];
+    for(int i=1;i<n;i++)
+        if (values[i] < min)
+            min = values[i];
+    return min;
+}
+
+/* A number in the Mann-Whitney test and the sample it came from */
+typedef struct Ranked {
+    double value;
+    bool first;
+} Ranked;
+
+/* Compares two ranked numbers for qsort
+ *    a, b - the numbers
+ */
+static int compareRanked(const void *a, const void *b) {
+    return compareDoubles(&((const Ranked *)a)->value,
+                          &((const Ranked *)b)->value);
+}
+
+/* The Mann-Whitney U test of whether the values of one sample tend to be
+ * larger or smaller than those of another, with the normal approximation
+ * corrected for ties and for continuity
+ *    a, na - the first sample
+ *    b, nb - the second sample
+ *    larger - the p-value of a being larger is stored here
+ *    smaller - the p-value of a being smaller is stored here
+ */
+static void mannWhitney(const double a[], int na, const double b[], int nb,
+                        double *larger, double *smaller) {
+    int n = na+nb;
+    Ranked *all = malloc(n*sizeof(Ranked));
+    for(int i=0;i<na;i++)
+        all[i] = (Ranked){a[i], true};
+    for(int i=0;i<nb;i++)
+        all[na+i] = (Ranked){b[i], false};
+    qsort(all, n, sizeof(Ranked), compareRanked);
+
+    // Equal values all get the mean of their ranks
+    double rankSum = 0;
+    double ties = 0;
+    for(int i=0;i<n;) {
+        int j = i;
+        while (j < n && all[j].value == all[i].value)
+            j++;
+        double rank = (i+1+j)/2.0;
+        for(int k=i;k<j;k++)
+            if (all[k].first)
+                rankSum += rank;
+        double t = j-i;
+        ties += t*t*t-t;
+        i = j;
+    }
+    free(all);
+
+    double u = rankSum-na*(na+1)/2.0;
+    double mean = (double)na*nb/2;
+    double variance = (double)na*nb/12*((n+1)-ties/((double)n*(n-1)));
+    if (n < 2 || variance <= 0) {
+        *larger = *smaller = 1;
+        return;
+    }
+    double sd = sqrt(variance);
+    *larger = erfc((u-mean-0.5)/sd/sqrt(2))/2;
+    *smaller = erfc((mean-u-0.5)/sd/sqrt(2))/2;
+}
+
+/* Compares a series with the same phase in the baseline
+ *    config - the settings, with the significance level and threshold
+ *    s - the series
+ *    baseline - the baseline, or NULL if none was given
+ * Returns
+ *    the comparison
+ */
+static Comparison compare(const SpeedConfig *config, const Series *s,
+                          const Baseline *baseline) {
+    Comparison c = {.verdict = VERDICT_NONE};
+    if (baseline == NULL)
+        return c;
+    c.verdict = VERDICT_NEW;
+    for(int i=0;i<baseline->n && c.baseline==NULL;i++) {
+        const Series *b = &baseline->series[i];
+        if (strcmp(b->backend, s->backend) == 0 &&
+            strcmp(b->phase, s->phase) == 0 &&
+            strcmp(b->distribution, s->distribution) == 0 &&
+            strcmp(b->workload, s->workload) == 0 && b->n > 0)
+            c.baseline = b;
+    }
+    if (c.baseline == NULL)
+        return c;
+
+    double before = median(c.baseline->nsPerOp, c.baseline->n);
+    double after = median(s->nsPerOp, s->n);
+    double slower, faster;
+    mannWhitney(s->nsPerOp, s->n, c.baseline->nsPerOp, c.baseline->n,
+                &slower, &faster);
+    c.change = before > 0 ? after/before-1 : 0;
+    c.p = c.change >= 0 ? slower : faster;
+    if (slower < config->alpha && c.change > config->threshold)
+        c.verdict = VERDICT_REGRESSION;
+    else if (faster < config->alpha && c.change < -config->threshold)
+        c.verdict = VERDICT_IMPROVEMENT;
+    else
+        c.verdict = VERDICT_UNCHANGED;
+    return c;
+}
+
+/* Skips white space in JSON text
+ *    p - the position in the text, moved past the space
+ */
+static void skipSpace(const char **p) {
+    while (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r')
+        (*p)++;
+}
+
+/* Reads a character that must come next in JSON text
+ *    p - the position in the text, moved past the character
+ *    c - the character
+ * Returns
+ *    false if the character is not next
+ */
+static bool expect(const char **p, char c) {
+    skipSpace(p);
+    if (**p != c)
+        return false;
+    (*p)++;
+    return true;
+}
+
+/* Reads a JSON string, cut to fit the buffer
+ *    p - the position in the text, moved past the string
+ *    buffer - the string is stored here
+ *    size - the size of the buffer
+ * Returns
+ *    false if there is no string at the position
+ */
+static bool readString(const char **p, char *buffer, int size) {
+    int length = 0;
+    if (!expect(p, '"'))
+        return false;
+    for(;**p!='"';(*p)++) {
+        if (**p == '\0')
+            return false;
+        if (**p == '\\' && (*p)[1] != '\0')
+            (*p)++;
+        if (length < size-1)
+            buffer[length++] = **p;
+    }
+    (*p)++;
+    buffer[length] = '\0';
+    return true;
+}
+
+/* Reads a JSON number
+ *    p - the position in the text, moved past the number
+ *    value - the number is stored here
+ * Returns
+ *    false if there is no number at the position
+ */
+static bool readNumber(const char **p, double *value) {
+    char *end;
+    skipSpace(p);
+    *value = strtod(*p, &end);
+    if (end == *p)
+        return false;
+    *p = end;
+    return true;
+}
+
+/* Skips any JSON value
+ *    p - the position in the text, moved past the value
+ * Returns
+ *    false if the text is not valid JSON
+ */
+static bool skipValue(const char **p) {
+    static const char *literals[] = {"true", "false", "null"};
+    char buffer[NAME_LENGTH];
+    double number;
+    skipSpace(p);
+    if (**p == '"')
+        return readString(p, buffer, sizeof(buffer));
+    if (**p == '[' || **p == '{') {
+        char close = **p == '[' ? ']' : '}';
+        (*p)++;
+        if (expect(p, close))
+            return true;
+        do {
+            if (close == '}' && (!readString(p, buffer, sizeof(buffer)) ||
+                                 !expect(p, ':')))
+                return false;
+            if (!skipValue(p))
+                return false;
+        } while (expect(p, ','));
+        return expect(p, close);
+    }
+    for(int i=0;i<3;i++) {
+        if (strncmp(*p, literals[i], strlen(literals[i])) == 0) {
+            *p += strlen(literals[i]);
+            return true;
+        }
+    }
+    return readNumber(p, &number);
+}
+
+/* Reads the JSON array of the ns/op of a series
+ *    p - the position in the text, moved past the array
+ *    s - the numbers are stored here
+ * Returns
+ *    false if there is no array of numbers at the position
+ */
+static bool readSamples(const char **p, Series *s) {
+    int capacity = 16;
+    s->nsPerOp = malloc(capacity*sizeof(double));
+    if (!expect(p, '['))
+        return false;
+    if (expect(p, ']'))
+        return true;
+    do {
+        if (s->n == capacity) {
+            capacity *= 2;
+            s->nsPerOp = realloc(s->nsPerOp, capacity*sizeof(double));
+        }
+        if (!readNumber(p, &s->nsPerOp[s->n++]))
+            return false;
+    } while (expect(p, ','));
+    return expect(p, ']');
+}
+
+/* Reads a series of the baseline, a JSON object
+ *    p - the position in the text, moved past the object
+ *    s - the series is stored here
+ * Returns
+ *    false if there is no series at the position
+ */
+static bool readSeries(const char **p, Series *s) {
+    char key[NAME_LENGTH];
+    *s = (Series){.n = 0};
+    if (!expect(p, '{'))
+        return false;
+    do {
+        bool ok;
+        if (!readString(p, key, sizeof(key)) || !expect(p, ':'))
+            return false;
+        if (strcmp(key, "backend") == 0)
+            ok = readString(p, s->backend, NAME_LENGTH);
+        else if (strcmp(key, "phase") == 0)
+            ok = readString(p, s->phase, NAME_LENGTH);
+        else if (strcmp(key, "distribution") == 0)
+            ok = readString(p, s->distribution, NAME_LENGTH);
+        else if (strcmp(key, "workload") == 0)
+            ok = readString(p, s->workload, NAME_LENGTH);
+        else if (strcmp(key, "ns_per_op") == 0 && s->nsPerOp == NULL)
+            ok = readSamples(p, s);
+        else
+            ok = skipValue(p);
+        if (!ok)
+            return false;
+    } while (expect(p, ','));
+    return expect(p, '}');
+}
+
+/* Parses the text of a baseline file
+ *    p - the text
+ *    b - the baseline is stored here
+ * Returns
+ *    false if the text is not a baseline
+ */
+static bool parseBaseline(const char *p, Baseline *b) {
+    char key[NAME_LENGTH];
+    int capacity = 16;
+    b->series = malloc(capacity*sizeof(Series));
+    if (!expect(&p, '{'))
+        return false;
+    do {
+        bool ok = true;
+        if (!readString(&p, key, sizeof(key)) || !expect(&p, ':'))
+            return false;
+        if (strcmp(key, "size") == 0)
+            ok = readNumber(&p, &b->size);
+        else if (strcmp(key, "ops") == 0)
+            ok = readNumber(&p, &b->ops);
+        else if (strcmp(key, "seed") == 0)
+            ok = readNumber(&p, &b->seed);
+        else if (strcmp(key, "key_type") == 0)
+            ok = readString(&p, b->keyType, NAME_LENGTH);
+        else if (strcmp(key, "results") == 0) {
+            ok = expect(&p, '[');
+            if (ok && !expect(&p, ']')) {
+                do {
+                    if (b->n == capacity) {
+                        capacity *= 2;
+                        b->series = realloc(b->series,
+                                            capacity*sizeof(Series));
+                    }
+                    ok = readSeries(&p, &b->series[b->n++]);
+                } while (ok && expect(&p, ','));
+                ok = ok && expect(&p, ']');
+            }
+        } else
+            ok = skipValue(&p);
+        if (!ok)
+            return false;
+    } while (expect(&p, ','));
+    return expect(&p, '}');
+}
+
+/* Deallocates the series of a baseline
+ *    series - the series
+ *    n - the number of series
+ */
+static void freeSeries(Series series[], int n) {
+    for(int i=0;i<n;i++)
+        free(series[i].nsPerOp);
+    free(series);
+}
+
+/* Reads a baseline saved by saveBaseline
+ *    path - the file
+ *    b - the baseline is stored here
+ * Returns
+ *    false if the file could not be read or is not a baseline
+ */
+static bool readBaseline(const char *path, Baseline *b) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    size_t capacity = 1<<16;
+    size_t length = 0;
+    size_t n;
+    char *text = malloc(capacity);
+    while ((n = fread(text+length, 1, capacity-length-1, file)) > 0) {
+        length += n;
+        if (length == capacity-1) {
+            capacity *= 2;
+            text = realloc(text, capacity);
+        }
+    }
+    text[length] = '\0';
+    bool ok = !ferror(file);
+    fclose(file);
+    if (!ok)
+        perror(path);
+    *b = (Baseline){.n = 0};
+    if (ok && !parseBaseline(text, b)) {
+        fprintf(stderr, "%s: not a baseline saved with --save-baseline\n",
+                path);
+        ok = false;
+    }
+    free(text);
+    if (!ok)
+        freeSeries(b->series, b->n);
+    return ok;
+}
+
+/* Saves the runs as a baseline
+ *    config - the settings the runs were made with
+ *    series - the runs of each phase
+ *    n - the number of series
+ * Returns
+ *    false if the file could not be written
+ */
+static bool saveBaseline(const SpeedConfig *config, const Series series[],
+                         int n) {
+    FILE *out = fopen(config->saveBaseline, "w");
+    if (out == NULL) {
+        perror(config->saveBaseline);
+        return false;
+    }
+    fprintf(out, "{\"size\": %d, \"ops\": %d, \"seed\": %u, "
+            "\"key_type\": \"%s\", \"key_length\": %d, \"warmup\": %d, "
+            "\"results\": [", config->tableSize, config->numOps,
+            config->seed, config->keyType == KEY_STRING ? "string" : "int",
+            config->keyType == KEY_STRING ? config->keyLength : 0,
+            config->warmup);
+    for(int i=0;i<n;i++) {
+        const Series *s = &series[i];
+        fprintf(out, "%s\n  {\"backend\": \"%s\", \"phase\": \"%s\", "
+                "\"distribution\": \"%s\", \"workload\": \"%s\", "
+                "\"ns_per_op\": [", i ? "," : "", s->backend, s->phase,
+                s->distribution, s->workload);
+        for(int r=0;r<s->n;r++)
+            fprintf(out, "%s%.2f", r ? ", " : "", s->nsPerOp[r]);
+        fprintf(out, "]}");
+    }
+    fprintf(out, "\n]}\n");
+    bool ok = !ferror(out);
+    ok = fclose(out) == 0 && ok;
+    if (!ok)
+        perror(config->saveBaseline);
+    return ok;
+}
+
+/* Warns when a baseline was run with other settings, which makes the
+ * times differ for other reasons than the implementations
+ *    config - the settings of this run
+ *    b - the baseline
+ */
+static void checkSettings(const SpeedConfig *config, const Baseline *b) {
+    const char *keyType = config->keyType == KEY_STRING ? "string" : "int";
+    if (b->size != config->tableSize || b->ops != config->numOps ||
+        b->seed != config->seed || strcmp(b->keyType, keyType) != 0)
+        fprintf(stderr, "Warning: the baseline was run with size %.0f, "
+                "%.0f ops, seed %.0f and %s keys\n", b->size, b->ops,
+                b->seed, b->keyType);
+}
+
+/* Runs the speed test repeatedly on one implementation and adds the
+ * ns/op of every phase to series of their own
+ *    config - the settings
+ *    backend - the implementation
+ *    series - the series are stored here
+ * Returns
+ *    the number of series added
+ */
+static int repeatBackend(const SpeedConfig *config,
+                         const TableBackend *backend, Series series[]) {
+    SpeedResults results;
+    int n = 0;
+
+    for(int w=0;w<config->warmup;w++) {
+        speedtest_run(backend, config, &results);
+        speedtest_freeResults(&results);
+    }
+    for(int r=0;r<config->repetitions;r++) {
+        speedtest_run(backend, config, &results);
+        if (r == 0) {
+            n = results.n;
+            for(int i=0;i<n;i++) {
+                const PhaseResult *p = &results.phases[i];
+                Series *s = &series[i];
+                *s = (Series){
+                    .nsPerOp = malloc(config->repetitions*sizeof(double))
+                };
+                snprintf(s->backend, NAME_LENGTH, "%s", backend->name);
+                snprintf(s->phase, NAME_LENGTH, "%s",
+                         speedtest_phaseName(p->phase));
+                snprintf(s->distribution, NAME_LENGTH, "%s",
+                         p->distribution ? p->distribution : "");
+                snprintf(s->workload, NAME_LENGTH, "%s",
+                         p->workload ? p->workload : "");
+            }
+        }
+        for(int i=0;i<n;i++) {
+            const PhaseResult *p = &results.phases[i];
+            series[i].nsPerOp[series[i].n++] = (double)p->ns/p->ops;
+        }
+        speedtest_freeResults(&results);
+    }
+    return n;
+}
+
+/* Prints the statistics of the runs as text
+ *    out - the stream to print to
+ *    config - the settings
+ *    series - the runs of each phase
+ *    comparisons - how each series compares with the baseline
+ *    n - the number of series
+ */
+static void printText(FILE *out, const SpeedConfig *config,
+                      const Series series[], const Comparison comparisons[],
+                      int n) {
+    fprintf(out, "ns/op of %d runs after %d warmup runs\n",
+            config->repetitions, config->warmup);
+    fprintf(out, "%-12s %-28s %11s %11s %9s", "backend", "phase", "min",
+            "median", "mad");
+    if (config->baseline != NULL)
+        fprintf(out, " %11s %8s %8s  %s", "baseline", "change", "p",
+                "verdict");
+    fprintf(out, "\n");
+    for(int i=0;i<n;i++) {
+        const Series *s = &series[i];
+        const Comparison *c = &comparisons[i];
+        char label[3*NAME_LENGTH+8];
+        snprintf(label, sizeof(label), "%s%s%s%s%s%s", s->phase,
+                 *s->workload ? " " : "", s->workload,
+                 *s->distribution ? " (" : "", s->distribution,
+                 *s->distribution ? ")" : "");
+        fprintf(out, "%-12s %-28s %11.1f %11.1f %9.1f", s->backend, label,
+                minimum(s->nsPerOp, s->n), median(s->nsPerOp, s->n),
+                mad(s->nsPerOp, s->n));
+        if (c->baseline != NULL)
+            fprintf(out, " %11.1f %+7.1f%% %8.4f  %s",
+                    median(c->baseline->nsPerOp, c->baseline->n),
+                    100*c->change, c->p, verdictNames[c->verdict]);
+        else if (c->verdict != VERDICT_NONE)
+            fprintf(out, " %11s %8s %8s  %s", "-", "-", "-",
+                    verdictNames[c->verdict]);
+        fprintf(out, "\n");
+    }
+}
+
+/* Prints the statistics of the runs as CSV
+ *    out - the stream to print to
+ *    config - the settings
+ *    series - the runs of each phase
+ *    comparisons - how each series compares with the baseline
+ *    n - the number of series
+ */
+static void printCsv(FILE *out, const SpeedConfig *config,
+                     const Series series[], const Comparison comparisons[],
+                     int n) {
+    fprintf(out, "backend,phase,distribution,workload,runs,warmup,"
+            "min_ns_per_op,median_ns_per_op,mad_ns_per_op,baseline_runs,"
+            "baseline_median_ns_per_op,change,p_value,verdict\n");
+    for(int i=0;i<n;i++) {
+        const Series *s = &series[i];
+        const Comparison *c = &comparisons[i];
+        fprintf(out, "%s,%s,%s,%s,%d,%d,%.1f,%.1f,%.1f,", s->backend,
+                s->phase, s->distribution, s->workload, s->n,
+                config->warmup, minimum(s->nsPerOp, s->n),
+                median(s->nsPerOp, s->n), mad(s->nsPerOp, s->n));
+        if (c->baseline != NULL)
+            fprintf(out, "%d,%.1f,%.4f,%.4g,", c->baseline->n,
+                    median(c->baseline->nsPerOp, c->baseline->n),
+                    c->change, c->p);
+        else
+            fprintf(out, ",,,,");
+        fprintf(out, "%s\n", verdictNames[c->verdict]);
+    }
+}
+
+/* Prints the statistics of the runs as JSON
+ *    out - the stream to print to
+ *    config - the settings
+ *    series - the runs of each phase
+ *    comparisons - how each series compares with the baseline
+ *    n - the number of series
+ */
+static void printJson(FILE *out, const SpeedConfig *config,
+                      const Series series[], const Comparison comparisons[],
+                      int n) {
+    fprintf(out, "{\"size\": %d, \"ops\": %d, \"seed\": %u, \"runs\": %d, "
+            "\"warmup\": %d, ", config->tableSize, config->numOps,
+            config->seed, config->repetitions, config->warmup);
+    if (config->baseline != NULL)
+        fprintf(out, "\"baseline\": \"%s\", \"alpha\": %g, "
+                "\"threshold\": %g, ", config->baseline, config->alpha,
+                config->threshold);
+    fprintf(out, "\"results\": [");
+    for(int i=0;i<n;i++) {
+        const Series *s = &series[i];
+        const Comparison *c = &comparisons[i];
+        fprintf(out, "%s\n  {\"backend\": \"%s\", \"phase\": \"%s\", ",
+                i ? "," : "", s->backend, s->phase);
+        if (*s->distribution)
+            fprintf(out, "\"distribution\": \"%s\", ", s->distribution);
+        if (*s->workload)
+            fprintf(out, "\"workload\": \"%s\", ", s->workload);
+        fprintf(out, "\"ns_per_op\": {\"min\": %.1f, \"median\": %.1f, "
+                "\"mad\": %.1f}", minimum(s->nsPerOp, s->n),
+                median(s->nsPerOp, s->n), mad(s->nsPerOp, s->n));
+        if (c->baseline != NULL)
+            fprintf(out, ", \"baseline_median\": %.1f, \"change\": %.4f, "
+                    "\"p_value\": %.4g",
+                    median(c->baseline->nsPerOp, c->baseline->n),
+                    c->change, c->p);
+        if (c->verdict != VERDICT_NONE)
+            fprintf(out, ", \"verdict\": \"%s\"", verdictNames[c->verdict]);
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n]}\n");
+}
+
+int repeat_run(const SpeedConfig *config,
+               const TableBackend *const backends[], int n) {
+    Baseline baseline;
+    int regressions = 0;
+    int numSeries = 0;
+
+    if (config->baseline != NULL) {
+        if (!readBaseline(config->baseline, &baseline))
+            return -1;
+        checkSettings(config, &baseline);
+    }
+    Series *series = malloc(n*MAX_RESULTS*sizeof(Series));
+    for(int b=0;b<n;b++)
+        numSeries += repeatBackend(config, backends[b], series+numSeries);
+
+    Comparison *comparisons = malloc((numSeries+1)*sizeof(Comparison));
+    for(int i=0;i<numSeries;i++) {
+        comparisons[i] = compare(config, &series[i],
+                                 config->baseline ? &baseline : NULL);
+        if (comparisons[i].verdict == VERDICT_REGRESSION)
+            regressions++;
+    }
+
+    FILE *out = speedtest_openOutput(config);
+    switch (config->format) {
+    case FORMAT_TEXT:
+        printText(out, config, series, comparisons, numSeries);
+        if (config->baseline != NULL)
+            fprintf(out, "%d of %d phases regressed by more than %g%% at "
+                    "significance level %g\n", regressions, numSeries,
+                    100*config->threshold, config->alpha);
+        break;
+    case FORMAT_CSV:
+        printCsv(out, config, series, comparisons, numSeries);
+        break;
+    case FORMAT_JSON:
+        printJson(out, config, series, comparisons, numSeries);
+        break;
+    }
+    speedtest_closeOutput(out);
+
+    if (config->saveBaseline != NULL &&
+        !saveBaseline(config, series, numSeries))
+        regressions = -1;
+    if (config->baseline != NULL)
+        freeSeries(baseline.series, baseline.n);
+    freeSeries(series, numSeries);
+    free(comparisons);
+    return regressions;
+}
@@ -0,0 +1,36 @@
+/*
+ * Repeated runs and baseline comparison for the benchmark.
+ *
+ * A single run of the speed test is noisy, the time of a phase varies
+ * from run to run with the state of the caches, the frequency of the CPU
+ * and what else the machine is doing. Here the speed test is run a number
+ * of times on each table implementation, after some unmeasured warmup
+ * runs, and the ns/op of every phase is reported as the minimum, the
+ * median and the median absolute deviation (MAD) of the runs.
+ *
+ * The runs can be saved as a JSON baseline and a later benchmark compared
+ * with it. Each phase is compared with the Mann-Whitney U test, which
+ * makes no assumption about the distribution of the times, and counts as
+ * a regression when its runs are slower than the baseline at the given
+ * significance level and its median is slower by more than the threshold.
+ * The p-value uses the normal approximation of U with the correction for
+ * ties, which is close enough from about five runs on each side.
+ */
+
+#ifndef REPEAT_H
+#define REPEAT_H
+
+#include "speedtest.h"
+
+/* Runs the speed test repeatedly on each implementation and prints the
+ * statistics of the runs, saving them to and comparing them with the
+ * baselines given in the settings.
+ *  config   - The settings, warmup and repetitions decide the runs.
+ *  backends - The table implementations.
+ *  n        - The number of implementations.
+ * Returns: The number of phases that regressed against the baseline, or
+ *          -1 if a baseline could not be read or saved. */
+int repeat_run(const SpeedConfig *config,
+               const TableBackend *const backends[], int n);
+
+#endif
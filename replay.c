@@ -0,0 +1,542 @@
+/*
+ * Replays a trace of table operations against the table implementations.
+ *
+ * The trace is recorded from a real program with the shim in
+ * tracetable.c, see tracetable.h. Every operation in it is done again on
+ * each implementation registered in tablebackend.c (or the ones selected
+ * with --backend), either as fast as possible or, with --paced, at the
+ * times they were recorded. The throughput of the whole replay and the
+ * latency percentiles of each kind of operation are reported. The keys
+ * and values are allocated before the replay starts so that only the
+ * table operations are timed. Run with --help for the options.
+ *
+ * Build with
+ *   gcc -std=c99 -O2 -o replay replay.c trace.c testkeys.c rng.c \
+ *       histogram.c nanoclock.c snapshot.c tablebackend.c backend_*.c \
+ *       dlist.c testprogram_table_as_array/array.c -lm
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nanoclock.h"
+#include "speedtest.h"
+#include "trace.h"
+
+// Waits longer than this are slept, shorter ones spun
+#define SPIN_NS 200000
+
+/* A trace decoded into the keys and values handed to the tables */
+typedef struct Replay {
+    int n;              // number of records
+    TraceRecord *records;
+    KEY *keys;          // the key of each record, NULL for create and free
+    VALUE *values;      // the value of each insert, NULL for the others
+    unsigned int numTables;
+} Replay;
+
+/* The measurements of replaying a trace on one implementation */
+typedef struct ReplayResult {
+    unsigned long long ns;          // time for the whole replay
+    unsigned long long maxLag;      // paced: most an operation was late
+    int skipped;                    // operations on tables that do not exist
+    int count[TRACE_NUM_OPS];
+    unsigned long long total[TRACE_NUM_OPS];    // summed latencies
+    Histogram *latency[TRACE_NUM_OPS];
+} ReplayResult;
+
+/* Settings from the command line */
+typedef struct ReplayConfig {
+    const char *tracePath;
+    int numBackends;
+    const char *backendNames[MAX_BACKENDS];
+    bool paced;
+    double speed;       // paced: how many times faster than recorded
+    OutputFormat format;
+    const char *outputPath; // NULL for stdout
+} ReplayConfig;
+
+/* The operations whose latency is reported */
+static const TraceOp reported[] = {TRACE_INSERT, TRACE_LOOKUP, TRACE_REMOVE};
+#define NUM_REPORTED (int)(sizeof(reported)/sizeof(reported[0]))
+
+/* Decodes the records of a trace and allocates their keys and values
+ *    r - the trace
+ *    replay - the decoded trace is stored here
+ * Returns
+ *    false if the trace is corrupt
+ */
+static bool decodeTrace(TraceReader *r, Replay *replay) {
+    TraceRecord record;
+    int capacity = 1024;
+    bool strings = trace_keyType(r) == TRACE_KEY_STRING;
+
+    *replay = (Replay){.records = malloc(capacity*sizeof(TraceRecord))};
+    trace_rewind(r);
+    while (trace_next(r, &record)) {
+        if (replay->n == capacity) {
+            capacity *= 2;
+            replay->records = realloc(replay->records,
+                                      capacity*sizeof(TraceRecord));
+        }
+        if (record.table >= replay->numTables)
+            replay->numTables = record.table+1;
+        if (record.key != NULL && !strings && record.keyLength != 4)
+            return false;
+        replay->records[replay->n++] = record;
+    }
+
+    replay->keys = calloc(replay->n, sizeof(KEY));
+    replay->values = calloc(replay->n, sizeof(VALUE));
+    for(int i=0;i<replay->n;i++) {
+        const TraceRecord *rec = &replay->records[i];
+        if (rec->key == NULL)
+            continue;
+        if (strings) {
+            char *key = malloc(rec->keyLength+1);
+            memcpy(key, rec->key, rec->keyLength);
+            key[rec->keyLength] = '\0';
+            replay->keys[i] = key;
+        } else {
+            unsigned int key = 0;
+            for(int b=0;b<4;b++)
+                key |= (unsigned int)rec->key[b] << 8*b;
+            replay->keys[i] = intPtrFromInt((int)key);
+        }
+        if (rec->op == TRACE_INSERT)
+            replay->values[i] = intPtrFromInt(i);
+    }
+    return true;
+}
+
+/* Deallocates a decoded trace, except the keys and values that were
+ * handed over to the tables
+ *    replay - the trace
+ */
+static void freeReplay(Replay *replay) {
+    for(int i=0;i<replay->n;i++) {
+        if (replay->records[i].op != TRACE_INSERT)
+            free(replay->keys[i]);
+    }
+    free(replay->keys);
+    free(replay->values);
+    free(replay->records);
+}
+
+/* Estimates the most entries any table of a trace holds, as inserts
+ * minus removes, which is too high if keys are inserted again
+ *    replay - the trace
+ * Returns
+ *    the estimate
+ */
+static int maxEntries(const Replay *replay) {
+    int *entries = calloc(replay->numTables, sizeof(int));
+    int max = 0;
+    for(int i=0;i<replay->n;i++) {
+        const TraceRecord *rec = &replay->records[i];
+        if (rec->op == TRACE_INSERT && ++entries[rec->table] > max)
+            max = entries[rec->table];
+        else if (rec->op == TRACE_REMOVE && entries[rec->table] > 0)
+            entries[rec->table]--;
+    }
+    free(entries);
+    return max;
+}
+
+/* Waits until a point in time
+ *    until - the time to wait for, as given by nanoclock_now
+ */
+static void waitUntil(unsigned long long until) {
+    unsigned long long now = nanoclock_now();
+    while (now < until) {
+        if (until-now > SPIN_NS) {
+            unsigned long long ns = until-now-SPIN_NS/2;
+            struct timespec t = {ns/1000000000, ns%1000000000};
+            nanosleep(&t, NULL);
+        }
+        now = nanoclock_now();
+    }
+}
+
+/* Replays a decoded trace on an implementation
+ *    b - the implementation
+ *    config - the settings
+ *    replay - the trace, its keys and values are handed to the tables
+ *    keyType - the type of the keys of the trace
+ *    result - the measurements are stored here
+ */
+static void replayOn(const TableBackend *b, const ReplayConfig *config,
+                     Replay *replay, KeyType keyType,
+                     ReplayResult *result) {
+    CompareFunction *compare = compareFunctionFor(keyType);
+    Table **tables = calloc(replay->numTables, sizeof(Table *));
+
+    *result = (ReplayResult){0};
+    for(int o=0;o<TRACE_NUM_OPS;o++)
+        result->latency[o] = histogram_create();
+
+    unsigned long long start = nanoclock_now();
+    for(int i=0;i<replay->n;i++) {
+        const TraceRecord *rec = &replay->records[i];
+        Table **table = &tables[rec->table];
+        if (config->paced) {
+            unsigned long long due = start+rec->ns/config->speed;
+            waitUntil(due);
+            unsigned long long lag = nanoclock_now()-due;
+            if (lag > result->maxLag)
+                result->maxLag = lag;
+        }
+        if (rec->op != TRACE_CREATE && *table == NULL) {
+            // The operation can not be done, so the key is not handed over
+            if (rec->op == TRACE_INSERT) {
+                free(replay->keys[i]);
+                free(replay->values[i]);
+            }
+            result->skipped++;
+            continue;
+        }
+
+        unsigned long long opStart = nanoclock_now();
+        switch (rec->op) {
+        case TRACE_CREATE:
+            if (*table != NULL)
+                b->free(*table);
+            *table = b->create(compare);
+            b->setHashFunction(*table, hashFunctionFor(keyType));
+            b->setKeyBytesFunction(*table, keyBytesFunctionFor(keyType));
+            b->setKeyMemHandler(*table, free);
+            b->setValueMemHandler(*table, free);
+            break;
+        case TRACE_INSERT:
+            b->insert(*table, replay->keys[i], replay->values[i]);
+            break;
+        case TRACE_LOOKUP:
+            b->lookup(*table, replay->keys[i]);
+            break;
+        case TRACE_REMOVE:
+            b->remove(*table, replay->keys[i]);
+            break;
+        case TRACE_FREE:
+            b->free(*table);
+            *table = NULL;
+            break;
+        default:
+            break;
+        }
+        unsigned long long ns = nanoclock_now()-opStart;
+        histogram_record(result->latency[rec->op], ns);
+        result->total[rec->op] += ns;
+        result->count[rec->op]++;
+    }
+    result->ns = nanoclock_now()-start;
+
+    for(unsigned int t=0;t<replay->numTables;t++) {
+        if (tables[t] != NULL)
+            b->free(tables[t]);
+    }
+    free(tables);
+}
+
+/* Returns the number of table operations in a replay */
+static int replayOps(const ReplayResult *result) {
+    int ops = 0;
+    for(int o=0;o<TRACE_NUM_OPS;o++)
+        ops += result->count[o];
+    return ops;
+}
+
+/* Prints the result of one implementation as text
+ *    out - the stream to print to
+ *    config - the settings
+ *    b - the implementation
+ *    result - the result
+ */
+static void printText(FILE *out, const ReplayConfig *config,
+                      const TableBackend *b, const ReplayResult *result) {
+    int ops = replayOps(result);
+    fprintf(out, "%s: %d operations in %.3f ms, %.0f ops/s", b->name, ops,
+            result->ns/1e6, ops*1e9/result->ns);
+    if (config->paced)
+        fprintf(out, ", at most %.3f ms late", result->maxLag/1e6);
+    if (result->skipped > 0)
+        fprintf(out, ", %d skipped", result->skipped);
+    fprintf(out, "\n  %-10s %10s %10s %10s %10s %10s\n", "operation",
+            "count", "mean ns", "p50 ns", "p99 ns", "max ns");
+    for(int i=0;i<NUM_REPORTED;i++) {
+        TraceOp o = reported[i];
+        if (result->count[o] == 0)
+            continue;
+        fprintf(out, "  %-10s %10d %10.1f %10llu %10llu %10llu\n",
+                trace_opName(o), result->count[o],
+                (double)result->total[o]/result->count[o],
+                histogram_percentile(result->latency[o], 50),
+                histogram_percentile(result->latency[o], 99),
+                histogram_max(result->latency[o]));
+    }
+    fprintf(out, "\n");
+}
+
+/* Prints the result of one implementation as CSV rows, one for the whole
+ * replay followed by one per kind of operation
+ *    out - the stream to print to
+ *    config - the settings
+ *    b - the implementation
+ *    result - the result
+ */
+static void printCsv(FILE *out, const ReplayConfig *config,
+                     const TableBackend *b, const ReplayResult *result) {
+    int ops = replayOps(result);
+    fprintf(out, "%s,%d,all,%d,%llu,%.0f,,,,,%llu,%d\n", b->name,
+            config->paced, ops, result->ns, ops*1e9/result->ns,
+            result->maxLag, result->skipped);
+    for(int i=0;i<NUM_REPORTED;i++) {
+        TraceOp o = reported[i];
+        if (result->count[o] == 0)
+            continue;
+        fprintf(out, "%s,%d,%s,%d,%llu,,%.1f,%llu,%llu,%llu,,\n", b->name,
+                config->paced, trace_opName(o), result->count[o],
+                result->total[o], (double)result->total[o]/result->count[o],
+                histogram_percentile(result->latency[o], 50),
+                histogram_percentile(result->latency[o], 99),
+                histogram_max(result->latency[o]));
+    }
+}
+
+/* Prints the result of one implementation as a JSON object
+ *    out - the stream to print to
+ *    b - the implementation
+ *    result - the result
+ */
+static void printJson(FILE *out, const TableBackend *b,
+                      const ReplayResult *result) {
+    int ops = replayOps(result);
+    bool any = false;
+    fprintf(out, "{\"name\": \"%s\", \"ops\": %d, \"ns\": %llu, "
+            "\"ops_per_s\": %.0f, \"max_lag_ns\": %llu, \"skipped\": %d, "
+            "\"operations\": {", b->name, ops, result->ns,
+            ops*1e9/result->ns, result->maxLag, result->skipped);
+    for(int i=0;i<NUM_REPORTED;i++) {
+        TraceOp o = reported[i];
+        if (result->count[o] == 0)
+            continue;
+        fprintf(out, "%s\n    \"%s\": {\"count\": %d, \"mean_ns\": %.1f, "
+                "\"p50_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}",
+                any ? "," : "", trace_opName(o), result->count[o],
+                (double)result->total[o]/result->count[o],
+                histogram_percentile(result->latency[o], 50),
+                histogram_percentile(result->latency[o], 99),
+                histogram_max(result->latency[o]));
+        any = true;
+    }
+    fprintf(out, "\n  }}");
+}
+
+/* Prints the command line options
+ *    out - the stream to print to
+ *    program - the name of the program
+ */
+static void usage(FILE *out, const char *program) {
+    fprintf(out,
+        "Usage: %s [options] TRACE\n"
+        "  -x, --backend NAME    table implementation to replay on, may be\n"
+        "                        given several times (default all)\n"
+        "  -L, --list            list the table implementations\n"
+        "  -r, --paced           do the operations at the recorded times\n"
+        "                        instead of as fast as possible\n"
+        "  -S, --speed X         with --paced, replay X times faster than\n"
+        "                        recorded (default 1)\n"
+        "  -f, --format FORMAT   text, csv or json (default text)\n"
+        "  -O, --output FILE     print the results to FILE\n"
+        "  -h, --help            show this text\n", program);
+}
+
+/* Fills in the settings from the command line, prints the usage and
+ * exits for --help and on errors
+ *    argc, argv - the arguments given to main
+ *    config - the settings to fill in
+ */
+static void parseArguments(int argc, char *argv[], ReplayConfig *config) {
+    static const struct option options[] = {
+        {"backend", required_argument, NULL, 'x'},
+        {"list", no_argument, NULL, 'L'},
+        {"paced", no_argument, NULL, 'r'},
+        {"speed", required_argument, NULL, 'S'},
+        {"format", required_argument, NULL, 'f'},
+        {"output", required_argument, NULL, 'O'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    char *end;
+
+    *config = (ReplayConfig){.speed = 1, .format = FORMAT_TEXT};
+    while ((opt = getopt_long(argc, argv, "x:LrS:f:O:h", options,
+                              NULL)) != -1) {
+        switch (opt) {
+        case 'x':
+            if (config->numBackends == MAX_BACKENDS) {
+                fprintf(stderr, "At most %d backends can be given\n",
+                        MAX_BACKENDS);
+                exit(EXIT_FAILURE);
+            }
+            config->backendNames[config->numBackends++] = optarg;
+            break;
+        case 'L':
+            for(int i=0;tablebackend_all[i]!=NULL;i++)
+                printf("%s\n", tablebackend_all[i]->name);
+            exit(EXIT_SUCCESS);
+        case 'r':
+            config->paced = true;
+            break;
+        case 'S':
+            config->speed = strtod(optarg, &end);
+            if (*end != '\0' || !(config->speed > 0)) {
+                fprintf(stderr, "Invalid value for --speed: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'f':
+            if (strcmp(optarg, "text") == 0)
+                config->format = FORMAT_TEXT;
+            else if (strcmp(optarg, "csv") == 0)
+                config->format = FORMAT_CSV;
+            else if (strcmp(optarg, "json") == 0)
+                config->format = FORMAT_JSON;
+            else {
+                fprintf(stderr, "Unknown format: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'O':
+            config->outputPath = optarg;
+            break;
+        case 'h':
+            usage(stdout, argv[0]);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(stderr, argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc-1) {
+        usage(stderr, argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    config->tracePath = argv[optind];
+}
+
+int main(int argc, char *argv[]) {
+    ReplayConfig config;
+    const TableBackend *backends[MAX_BACKENDS];
+    int n = 0;
+
+    parseArguments(argc, argv, &config);
+    if (config.numBackends == 0) {
+        for(int i=0;tablebackend_all[i]!=NULL && n<MAX_BACKENDS;i++)
+            backends[n++] = tablebackend_all[i];
+    } else {
+        for(int i=0;i<config.numBackends;i++) {
+            backends[n] = tablebackend_find(config.backendNames[i]);
+            if (backends[n] == NULL) {
+                fprintf(stderr, "Unknown backend: %s\n",
+                        config.backendNames[i]);
+                return EXIT_FAILURE;
+            }
+            n++;
+        }
+    }
+
+    TraceReader *reader = trace_openReader(config.tracePath);
+    if (reader == NULL)
+        return EXIT_FAILURE;
+    KeyType keyType = trace_keyType(reader) == TRACE_KEY_STRING ?
+                      KEY_STRING : KEY_INT;
+
+    FILE *out = stdout;
+    if (config.outputPath != NULL) {
+        out = fopen(config.outputPath, "w");
+        if (out == NULL) {
+            perror(config.outputPath);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool first = true;
+    int printed = 0;
+    for(int b=0;b<n;b++) {
+        Replay replay;
+        ReplayResult result;
+        // A new copy of the keys and values for every implementation,
+        // since the tables take them over
+        if (!decodeTrace(reader, &replay)) {
+            fprintf(stderr, "%s: corrupt trace\n", config.tracePath);
+            return EXIT_FAILURE;
+        }
+        if (first) {
+            unsigned long long length = replay.n > 0 ?
+                replay.records[replay.n-1].ns : 0;
+            if (config.format == FORMAT_TEXT) {
+                fprintf(out, "%s: %d operations on %u tables with %s keys "
+                        "recorded over %.3f s, replayed %s\n\n",
+                        config.tracePath, replay.n, replay.numTables,
+                        keyType == KEY_STRING ? "string" : "int",
+                        length/1e9, config.paced ? "at the recorded pace" :
+                        "as fast as possible");
+            } else if (config.format == FORMAT_CSV) {
+                fprintf(out, "backend,paced,operation,count,ns,ops_per_s,"
+                        "mean_ns,p50_ns,p99_ns,max_ns,max_lag_ns,skipped\n");
+            } else {
+                fprintf(out, "{\"trace\": \"%s\", \"records\": %d, "
+                        "\"tables\": %u, \"key_type\": \"%s\", "
+                        "\"recorded_ns\": %llu, \"paced\": %s, "
+                        "\"speed\": %g, \"backends\": [", config.tracePath,
+                        replay.n, replay.numTables,
+                        keyType == KEY_STRING ? "string" : "int", length,
+                        config.paced ? "true" : "false", config.speed);
+            }
+        }
+        if (backends[b]->maxEntries != 0 &&
+            maxEntries(&replay) > backends[b]->maxEntries) {
+            fprintf(stderr, "Skipping %s, it holds at most %d entries\n",
+                    backends[b]->name, backends[b]->maxEntries);
+            for(int i=0;i<replay.n;i++) {
+                if (replay.records[i].op == TRACE_INSERT) {
+                    free(replay.keys[i]);
+                    free(replay.values[i]);
+                }
+            }
+            freeReplay(&replay);
+            first = false;
+            continue;
+        }
+
+        replayOn(backends[b], &config, &replay, keyType, &result);
+        switch (config.format) {
+        case FORMAT_TEXT:
+            printText(out, &config, backends[b], &result);
+            break;
+        case FORMAT_CSV:
+            printCsv(out, &config, backends[b], &result);
+            break;
+        case FORMAT_JSON:
+            fprintf(out, "%s\n  ", printed > 0 ? "," : "");
+            printJson(out, backends[b], &result);
+            break;
+        }
+        for(int o=0;o<TRACE_NUM_OPS;o++)
+            histogram_free(result.latency[o]);
+        freeReplay(&replay);
+        first = false;
+        printed++;
+    }
+    if (config.format == FORMAT_JSON)
+        fprintf(out, "\n]}\n");
+
+    trace_closeReader(reader);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
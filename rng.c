@@ -0,0 +1,62 @@
+/*
+ * Fast seedable random numbers for the benchmarks, see rng.h.
+ */
+
+#include "rng.h"
+
+/* Rotates a 64 bit number left
+ *    x - the number
+ *    k - the number of bits, 1 to 63
+ */
+static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64-k));
+}
+
+/* The splitmix64 generator, used to fill the xoshiro state from a seed
+ *    state - the state of splitmix64, advanced by the call
+ * Returns
+ *    the next number
+ */
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(Rng *rng, uint64_t seed) {
+    for(int i=0;i<4;i++)
+        rng->s[i] = splitmix64(&seed);
+}
+
+uint64_t rng_next(Rng *rng) {
+    uint64_t *s = rng->s;
+    uint64_t result = rotl(s[1]*5, 7)*9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+uint32_t rng_below(Rng *rng, uint32_t n) {
+    // Lemire's multiply and shift, rejecting the few low products that
+    // would make some values more likely than others
+    uint64_t m = (rng_next(rng) >> 32)*n;
+    uint32_t low = (uint32_t)m;
+    if (low < n) {
+        uint32_t threshold = -n % n;
+        while (low < threshold) {
+            m = (rng_next(rng) >> 32)*n;
+            low = (uint32_t)m;
+        }
+    }
+    return m >> 32;
+}
+
+double rng_double(Rng *rng) {
+    return (rng_next(rng) >> 11)*0x1.0p-53;
+}
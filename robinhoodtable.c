@@ -0,0 +1,379 @@
+/*
+ * The table as a Robin Hood hash table with backward shift deletion.
+ *
+ * The entries are kept in one array with linear probing. The distance
+ * of an entry from its home slot, the slot its hash points to, is kept
+ * with it, and an insert that meets an entry closer to its home than the
+ * new one puts the new entry there and carries on with the one it took
+ * the slot from. Every entry thus stays about as far from home as the
+ * others, which keeps the longest probe sequences short even when the
+ * table is nearly full. A lookup also ends as soon as it meets an entry
+ * closer to home than the key would be at that slot, so misses are as
+ * cheap as hits.
+ *
+ * A remove does not leave a tombstone. The entries after the removed one
+ * that are not in their home slot are moved back one slot each, until an
+ * empty slot or an entry at home. The table is thus exactly as it would
+ * be if the removed key had never been inserted, and any number of
+ * inserts and removes leave the probe lengths as they were.
+ *
+ * Next to the distance each slot keeps 32 bits of the hash of its key,
+ * so the compare function is almost only called for the key that is
+ * looked for. The slots are chosen with the top bits of the hash. The
+ * table holds up to 7/8 of its slots before it is doubled.
+ *
+ * The keys are hashed with the function from table_setHashFunction,
+ * which has to be set before the first insert. A key that is inserted
+ * again replaces the old entry. table_getStats reports the mean and
+ * largest distance of the entries from their home slots.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "table.h"
+
+// Slots of a new table, a power of two
+#define ROBIN_MIN_CAPACITY 16
+
+/* Where the entry of a slot is, read by every probe */
+typedef struct RobinMeta {
+    uint32_t hash;              // the low 32 bits of the hash of the key
+    uint32_t distance;          // from the home slot plus one, 0 if empty
+} RobinMeta;
+
+typedef struct RobinEntry {
+    KEY key;
+    VALUE value;
+} RobinEntry;
+
+typedef struct RobinTable {
+    RobinMeta *meta;
+    RobinEntry *entries;
+    size_t capacity;            // slots, a power of two
+    int shift;                  // 64 minus the bits of the slot index
+    size_t size;
+    CompareFunction *cf;
+    HashFunction *hash;
+    KeyFreeFunc *keyFree;
+    ValueFreeFunc *valueFree;
+    TableStats stats;
+} RobinTable;
+
+/* Returns the home slot of a key
+ *    t - the table
+ *    h - the hash of the key
+ */
+static size_t homeSlot(const RobinTable *t, uint64_t h) {
+    return h >> t->shift;
+}
+
+/* Finds the slot of a key
+ *    t - the table
+ *    key - the key
+ *    h - the hash of the key
+ *    count - true if the search is a lookup, counted in the statistics
+ * Returns
+ *    the index of the slot, -1 if the key is not in the table
+ */
+static long findSlot(RobinTable *t, KEY key, uint64_t h, bool count) {
+    size_t mask = t->capacity-1;
+    size_t slot = homeSlot(t, h);
+    unsigned long long compares = 0;
+    for(uint32_t distance=1;;distance++) {
+        const RobinMeta *m = &t->meta[slot];
+        // An entry closer to home would have been moved for the key
+        if (m->distance < distance) {
+            if (count) {
+                tablestats_lookup(&t->stats, false, compares);
+                tablestats_probes(&t->stats, distance);
+            }
+            return -1;
+        }
+        if (m->hash == (uint32_t)h) {
+            compares++;
+            if (t->cf(t->entries[slot].key, key) == 0) {
+                if (count) {
+                    tablestats_lookup(&t->stats, true, compares);
+                    tablestats_probes(&t->stats, distance);
+                }
+                return slot;
+            }
+        }
+        slot = (slot+1) & mask;
+    }
+}
+
+/* Puts an entry whose key is not in the table in its place, moving the
+ * entries after it that are closer to home
+ *    t - the table, with a free slot
+ *    e - the entry
+ *    h - the hash of the key
+ */
+static void place(RobinTable *t, RobinEntry e, uint64_t h) {
+    size_t mask = t->capacity-1;
+    size_t slot = homeSlot(t, h);
+    RobinMeta m = {.hash = (uint32_t)h, .distance = 1};
+    for(;;) {
+        RobinMeta *other = &t->meta[slot];
+        if (other->distance == 0) {
+            *other = m;
+            t->entries[slot] = e;
+            return;
+        }
+        if (other->distance < m.distance) {
+            RobinMeta movedMeta = *other;
+            RobinEntry moved = t->entries[slot];
+            *other = m;
+            t->entries[slot] = e;
+            m = movedMeta;
+            e = moved;
+        }
+        slot = (slot+1) & mask;
+        m.distance++;
+    }
+}
+
+/* Allocates empty slots
+ *    t - the table
+ *    capacity - the number of slots, a power of two
+ */
+static void allocateSlots(RobinTable *t, size_t capacity) {
+    t->capacity = capacity;
+    t->shift = 64;
+    for(size_t c=capacity;c>1;c/=2)
+        t->shift--;
+    t->meta = calloc(capacity, sizeof(RobinMeta));
+    t->entries = malloc(capacity*sizeof(RobinEntry));
+}
+
+/* Moves the entries to twice as many slots
+ *    t - the table
+ */
+static void grow(RobinTable *t) {
+    RobinMeta *oldMeta = t->meta;
+    RobinEntry *oldEntries = t->entries;
+    size_t oldCapacity = t->capacity;
+    allocateSlots(t, 2*oldCapacity);
+    for(size_t slot=0;slot<oldCapacity;slot++) {
+        if (oldMeta[slot].distance != 0)
+            place(t, oldEntries[slot], t->hash(oldEntries[slot].key));
+    }
+    free(oldMeta);
+    free(oldEntries);
+}
+
+/* Creates a table.
+ *  compare_function - Pointer to a function that is called for comparing
+ *                     two keys. The function should return <0 if the left
+ *                     parameter is smaller than the right parameter, 0 if
+ *                     the parameters are equal, and >0 if the left
+ *                     parameter is larger than the right item.
+ * Returns: A pointer to the table. NULL if creation of the table failed. */
+Table *table_create(CompareFunction *compare_function) {
+    RobinTable *t = calloc(1, sizeof(RobinTable));
+    t->cf = compare_function;
+    allocateSlots(t, ROBIN_MIN_CAPACITY);
+    return t;
+}
+
+/* Install a memory handling function responsible for removing a key when
+ * removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by keys inserted into the table*/
+void table_setKeyMemHandler(Table *table, KeyFreeFunc *freeFunc) {
+    RobinTable *t = table;
+    t->keyFree = freeFunc;
+}
+
+/* Install a memory handling function responsible for removing a value
+ * when removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by values inserted into the table*/
+void table_setValueMemHandler(Table *table, ValueFreeFunc *freeFunc) {
+    RobinTable *t = table;
+    t->valueFree = freeFunc;
+}
+
+/* Install the function hashing the keys, needed before the first
+ * insert.
+ *  table - Pointer to the table.
+ *  hash  - Pointer to the hash function. */
+void table_setHashFunction(Table *table, HashFunction *hash) {
+    RobinTable *t = table;
+    t->hash = hash;
+}
+
+/* The keys are hashed, so the bytes of the keys are not used */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes) {
+    (void)table;
+    (void)bytes;
+}
+
+/* Determines if the table is empty.
+ *  table - Pointer to the table.
+ * Returns: false if the table is not empty, true if it is. */
+bool table_isEmpty(Table *table) {
+    RobinTable *t = table;
+    return t->size == 0;
+}
+
+/* Inserts a key and value pair into the table, replacing the entry of
+ * the key if it is already in the table.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the key.
+ *  value - Pointer to the value.
+ */
+void table_insert(Table *table, KEY key, VALUE value) {
+    RobinTable *t = table;
+    uint64_t h = t->hash(key);
+    tablestats_insert(&t->stats);
+
+    long slot = findSlot(t, key, h, false);
+    if (slot >= 0) {
+        RobinEntry *old = &t->entries[slot];
+        if (t->keyFree != NULL)
+            t->keyFree(old->key);
+        if (t->valueFree != NULL)
+            t->valueFree(old->value);
+        old->key = key;
+        old->value = value;
+        return;
+    }
+
+    if (t->size+1 > t->capacity/8*7)
+        grow(t);
+    place(t, (RobinEntry){key, value}, h);
+    t->size++;
+}
+
+/* Finds a value given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ * Returns: Pointer to the item's value if the lookup succeded. NULL if the
+ *          lookup failed. */
+VALUE table_lookup(Table *table, KEY key) {
+    RobinTable *t = table;
+    long slot = findSlot(t, key, t->hash(key), true);
+    return slot >= 0 ? t->entries[slot].value : NULL;
+}
+
+/* Removes an item from the table given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ */
+void table_remove(Table *table, KEY key) {
+    RobinTable *t = table;
+    tablestats_remove(&t->stats);
+    long slot = findSlot(t, key, t->hash(key), false);
+    if (slot < 0)
+        return;
+    if (t->keyFree != NULL)
+        t->keyFree(t->entries[slot].key);
+    if (t->valueFree != NULL)
+        t->valueFree(t->entries[slot].value);
+
+    // Move the entries after it that are away from home back one slot
+    size_t mask = t->capacity-1;
+    size_t hole = slot;
+    size_t next = (hole+1) & mask;
+    while (t->meta[next].distance > 1) {
+        t->meta[hole] = t->meta[next];
+        t->meta[hole].distance--;
+        t->entries[hole] = t->entries[next];
+        hole = next;
+        next = (next+1) & mask;
+    }
+    t->meta[hole].distance = 0;
+    t->size--;
+}
+
+/* Destroys a table, deallocating all the memory it uses.
+ *  table - Pointer to the table. After the function completes this pointer
+ *          will be invalid for further use. */
+void table_free(Table *table) {
+    RobinTable *t = table;
+    for(size_t slot=0;slot<t->capacity;slot++) {
+        if (t->meta[slot].distance == 0)
+            continue;
+        if (t->keyFree != NULL)
+            t->keyFree(t->entries[slot].key);
+        if (t->valueFree != NULL)
+            t->valueFree(t->entries[slot].value);
+    }
+    free(t->meta);
+    free(t->entries);
+    free(t);
+}
+
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h. The probes are the slots a lookup looked in. The
+ * distances of the entries from their home slots are filled in even if
+ * the operations are not counted. */
+bool table_getStats(Table *table, TableStats *stats) {
+    RobinTable *t = table;
+    bool counted = tablestats_get(&t->stats, stats);
+    stats->entries = t->size;
+    for(size_t slot=0;slot<t->capacity;slot++) {
+        if (t->meta[slot].distance == 0)
+            continue;
+        unsigned long long distance = t->meta[slot].distance-1;
+        stats->displacement += distance;
+        if (distance > stats->maxDisplacement)
+            stats->maxDisplacement = distance;
+    }
+    return counted;
+}
+
+/* Saves the entries to a snapshot file in the order of the slots. */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values) {
+    RobinTable *t = table;
+    SnapshotWriter *w = snapshot_openWriter(path, keys, values);
+    if (w == NULL)
+        return false;
+    for(size_t slot=0;slot<t->capacity;slot++) {
+        if (t->meta[slot].distance != 0)
+            snapshot_write(w, t->entries[slot].key, t->entries[slot].value);
+    }
+    return snapshot_closeWriter(w);
+}
+
+/* Creates a table from a snapshot file, hashed with the hash function of
+ * the key serializer. The slots are allocated for all entries at once,
+ * so the table is never grown while it is loaded. Of duplicate keys,
+ * which the list tables may save, the first one is kept and the others
+ * are deallocated with free. */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values) {
+    if (keys->hash == NULL)
+        return NULL;
+    SnapshotReader *r = snapshot_openReader(path, keys, values);
+    if (r == NULL)
+        return NULL;
+    RobinTable *t = calloc(1, sizeof(RobinTable));
+    t->cf = compare_function;
+    t->hash = keys->hash;
+    size_t capacity = ROBIN_MIN_CAPACITY;
+    while (snapshot_count(r) > capacity/8*7)
+        capacity *= 2;
+    allocateSlots(t, capacity);
+
+    RobinEntry e;
+    while (snapshot_read(r, &e.key, &e.value)) {
+        uint64_t h = t->hash(e.key);
+        if (findSlot(t, e.key, h, false) >= 0) {
+            free(e.key);
+            free(e.value);
+            continue;
+        }
+        place(t, e, h);
+        t->size++;
+    }
+    snapshot_closeReader(r);
+    // Building the table is not counted as lookups
+    memset(&t->stats, 0, sizeof(t->stats));
+    return t;
+}
@@ -0,0 +1,286 @@
+/*
+ * Binary snapshot files of the entries of a table, see snapshot.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+
+#define SNAPSHOT_MAGIC "TBLSNAP1"
+#define SNAPSHOT_MAGIC_LENGTH 8
+// Bytes in the header, the magic, the count and the two fixed sizes
+#define SNAPSHOT_HEADER_LENGTH (SNAPSHOT_MAGIC_LENGTH+8+4+4)
+// Buffer of the writer, so saving seldom calls the system
+#define SNAPSHOT_BUFFER_SIZE (1<<20)
+
+struct SnapshotWriter {
+    FILE *file;
+    const TableSerializer *keys;
+    const TableSerializer *values;
+    unsigned long long count;
+    unsigned char *scratch;     // the bytes of an item with a write function
+    size_t scratchSize;
+};
+
+struct SnapshotReader {
+    unsigned char *data;
+    size_t length;
+    size_t pos;
+    const TableSerializer *keys;
+    const TableSerializer *values;
+    unsigned long long count;
+    unsigned long long read;    // entries read so far
+};
+
+/* Writes a number as little endian bytes
+ *    file - the file to write to
+ *    value - the number
+ *    bytes - the number of bytes
+ */
+static void writeLittleEndian(FILE *file, unsigned long long value,
+                              int bytes) {
+    for(int b=0;b<bytes;b++)
+        putc((value >> 8*b) & 0xff, file);
+}
+
+/* Reads a number stored as little endian bytes
+ *    data - the bytes
+ *    bytes - the number of bytes
+ * Returns
+ *    the number
+ */
+static unsigned long long readLittleEndian(const unsigned char *data,
+                                           int bytes) {
+    unsigned long long value = 0;
+    for(int b=0;b<bytes;b++)
+        value |= (unsigned long long)data[b] << 8*b;
+    return value;
+}
+
+/* Writes a varint
+ *    file - the file to write to
+ *    value - the value
+ */
+static void writeVarint(FILE *file, unsigned long long value) {
+    while (value >= 0x80) {
+        putc((int)(value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    putc((int)value, file);
+}
+
+/* Reads a varint
+ *    r - the reader
+ *    value - the value is stored here
+ * Returns
+ *    false if the data ends before the varint does
+ */
+static bool readVarint(SnapshotReader *r, unsigned long long *value) {
+    *value = 0;
+    for(int shift=0;r->pos<r->length && shift<64;shift+=7) {
+        unsigned char byte = r->data[r->pos++];
+        *value |= (unsigned long long)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+/* Writes a key or a value
+ *    w - the writer
+ *    s - the serializer of the item
+ *    item - the item
+ */
+static void writeItem(SnapshotWriter *w, const TableSerializer *s,
+                      const void *item) {
+    size_t size = s->fixedSize;
+    if (size == 0) {
+        size = s->size(item);
+        writeVarint(w->file, size);
+    }
+    if (s->write == NULL) {
+        fwrite(item, 1, size, w->file);
+        return;
+    }
+    if (size > w->scratchSize) {
+        free(w->scratch);
+        w->scratchSize = 2*size;
+        w->scratch = malloc(w->scratchSize);
+    }
+    s->write(item, w->scratch);
+    fwrite(w->scratch, 1, size, w->file);
+}
+
+/* Finds the next key or value in the data of a reader
+ *    r - the reader, moved past the item
+ *    s - the serializer of the item
+ *    size - the size of the item is stored here
+ * Returns
+ *    the bytes of the item, NULL if the data ends before the item does
+ */
+static const unsigned char *nextItem(SnapshotReader *r,
+                                     const TableSerializer *s,
+                                     size_t *size) {
+    unsigned long long length = s->fixedSize;
+    if (length == 0 && !readVarint(r, &length))
+        return NULL;
+    if (length > r->length-r->pos)
+        return NULL;
+    const unsigned char *bytes = r->data+r->pos;
+    r->pos += length;
+    *size = length;
+    return bytes;
+}
+
+/* Creates a key or a value from its bytes
+ *    s - the serializer of the item
+ *    bytes - the bytes
+ *    size - the number of bytes
+ * Returns
+ *    the item
+ */
+static void *readItem(const TableSerializer *s, const unsigned char *bytes,
+                      size_t size) {
+    if (s->read != NULL)
+        return s->read(bytes, size);
+    void *item = malloc(size > 0 ? size : 1);
+    memcpy(item, bytes, size);
+    return item;
+}
+
+SnapshotWriter *snapshot_openWriter(const char *path,
+                                    const TableSerializer *keys,
+                                    const TableSerializer *values) {
+    SnapshotWriter *w = calloc(1, sizeof(SnapshotWriter));
+    w->file = fopen(path, "wb");
+    if (w->file == NULL) {
+        perror(path);
+        free(w);
+        return NULL;
+    }
+    setvbuf(w->file, NULL, _IOFBF, SNAPSHOT_BUFFER_SIZE);
+    w->keys = keys;
+    w->values = values;
+    fwrite(SNAPSHOT_MAGIC, 1, SNAPSHOT_MAGIC_LENGTH, w->file);
+    // The count is filled in when the snapshot is complete
+    writeLittleEndian(w->file, 0, 8);
+    writeLittleEndian(w->file, keys->fixedSize, 4);
+    writeLittleEndian(w->file, values->fixedSize, 4);
+    return w;
+}
+
+void snapshot_write(SnapshotWriter *w, const void *key, const void *value) {
+    writeItem(w, w->keys, key);
+    writeItem(w, w->values, value);
+    w->count++;
+}
+
+bool snapshot_closeWriter(SnapshotWriter *w) {
+    bool ok = fseek(w->file, SNAPSHOT_MAGIC_LENGTH, SEEK_SET) == 0;
+    writeLittleEndian(w->file, w->count, 8);
+    ok = !ferror(w->file) && ok;
+    ok = fclose(w->file) == 0 && ok;
+    free(w->scratch);
+    free(w);
+    return ok;
+}
+
+SnapshotReader *snapshot_openReader(const char *path,
+                                    const TableSerializer *keys,
+                                    const TableSerializer *values) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return NULL;
+    }
+    SnapshotReader *r = calloc(1, sizeof(SnapshotReader));
+    size_t capacity = 1<<16;
+    r->data = malloc(capacity);
+    bool outOfMemory = r->data == NULL;
+    size_t n;
+    while (!outOfMemory &&
+           (n = fread(r->data+r->length, 1, capacity-r->length, file)) > 0) {
+        r->length += n;
+        if (r->length == capacity) {
+            unsigned char *data = realloc(r->data, 2*capacity);
+            if (data == NULL) {
+                outOfMemory = true;
+                break;
+            }
+            r->data = data;
+            capacity *= 2;
+        }
+    }
+    bool failed = ferror(file);
+    fclose(file);
+    if (failed) {
+        perror(path);
+        snapshot_closeReader(r);
+        return NULL;
+    }
+    if (outOfMemory) {
+        fprintf(stderr, "%s: not enough memory to read the snapshot\n",
+                path);
+        snapshot_closeReader(r);
+        return NULL;
+    }
+    r->keys = keys;
+    r->values = values;
+    if (r->length < SNAPSHOT_HEADER_LENGTH ||
+        memcmp(r->data, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH) != 0) {
+        fprintf(stderr, "%s: not a table snapshot\n", path);
+        snapshot_closeReader(r);
+        return NULL;
+    }
+    const unsigned char *header = r->data+SNAPSHOT_MAGIC_LENGTH;
+    r->count = readLittleEndian(header, 8);
+    if (readLittleEndian(header+8, 4) != keys->fixedSize ||
+        readLittleEndian(header+12, 4) != values->fixedSize) {
+        fprintf(stderr, "%s: the keys or values have other sizes than the "
+                "snapshot\n", path);
+        snapshot_closeReader(r);
+        return NULL;
+    }
+
+    // Check every entry now, so a table is never built from part of one
+    size_t size;
+    r->pos = SNAPSHOT_HEADER_LENGTH;
+    for(unsigned long long i=0;i<r->count;i++) {
+        if (nextItem(r, keys, &size) == NULL ||
+            nextItem(r, values, &size) == NULL) {
+            fprintf(stderr, "%s: the snapshot is truncated\n", path);
+            snapshot_closeReader(r);
+            return NULL;
+        }
+    }
+    if (r->pos != r->length) {
+        fprintf(stderr, "%s: data after the end of the snapshot\n", path);
+        snapshot_closeReader(r);
+        return NULL;
+    }
+    r->pos = SNAPSHOT_HEADER_LENGTH;
+    return r;
+}
+
+unsigned long long snapshot_count(const SnapshotReader *r) {
+    return r->count;
+}
+
+bool snapshot_read(SnapshotReader *r, void **key, void **value) {
+    size_t keySize, valueSize;
+    if (r->read == r->count)
+        return false;
+    // The entries were checked when the file was opened
+    const unsigned char *keyBytes = nextItem(r, r->keys, &keySize);
+    const unsigned char *valueBytes = nextItem(r, r->values, &valueSize);
+    *key = readItem(r->keys, keyBytes, keySize);
+    *value = readItem(r->values, valueBytes, valueSize);
+    r->read++;
+    return true;
+}
+
+void snapshot_closeReader(SnapshotReader *r) {
+    free(r->data);
+    free(r);
+}
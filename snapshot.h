@@ -0,0 +1,99 @@
+/*
+ * Binary snapshot files of the entries of a table, written by table_save
+ * and read by table_load.
+ *
+ * The keys and values are turned into bytes by a TableSerializer given
+ * by the user. A file is the magic "TBLSNAP1", the number of entries as
+ * 8 bytes, and the fixed size of the keys and of the values as 4 bytes
+ * each, all little endian, 0 for items whose size varies. Then come the
+ * entries in the order of the table, the key followed by the value, each
+ * preceded by its size as a varint if the size varies. Items whose
+ * serializer has no write or read function are copied as they are, with
+ * one fwrite into the buffer of the file when saving and one malloc and
+ * memcpy when loading, since the table deallocates every key and value
+ * on its own.
+ *
+ * The whole file is read and checked when it is opened, so a table is
+ * only built from a complete snapshot, and the table implementations put
+ * the entries straight into their own layout in one pass. A file is
+ * written in the order the table keeps its entries, which for the list
+ * tables keeps duplicate keys behaving as they did before the save.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* How the keys or the values of a table are turned into bytes */
+typedef struct TableSerializer {
+    // Bytes of every item if they all have the same size, 0 otherwise
+    size_t fixedSize;
+    // Returns the bytes of an item, used when fixedSize is 0
+    size_t (*size)(const void *item);
+    // Stores the bytes of an item in bytes, NULL to copy the bytes of the
+    // item as they are
+    void (*write)(const void *item, void *bytes);
+    // Creates an item from its bytes, deallocated by the memory handler
+    // of the table, NULL to copy the bytes into memory from malloc
+    void *(*read)(const void *bytes, size_t size);
+    // Hashes a key for the tables that hash their keys when they are
+    // loaded, see table_setHashFunction, NULL for values
+    unsigned long long (*hash)(void *item);
+    // Gives the bytes of a key for the tables that index the bytes of
+    // their keys when they are loaded, see table_setKeyBytesFunction, NULL
+    // for values
+    size_t (*bytes)(void *item, const unsigned char **bytes);
+} TableSerializer;
+
+typedef struct SnapshotWriter SnapshotWriter;
+typedef struct SnapshotReader SnapshotReader;
+
+/* Creates a snapshot file.
+ *  path   - The file, replaced if it exists.
+ *  keys   - Turns the keys into bytes.
+ *  values - Turns the values into bytes.
+ * Returns: The writer, NULL if the file could not be created. */
+SnapshotWriter *snapshot_openWriter(const char *path,
+                                    const TableSerializer *keys,
+                                    const TableSerializer *values);
+
+/* Adds an entry to a snapshot.
+ *  w     - The writer.
+ *  key   - The key.
+ *  value - The value. */
+void snapshot_write(SnapshotWriter *w, const void *key, const void *value);
+
+/* Completes a snapshot and deallocates the writer.
+ *  w - The writer.
+ * Returns: false if writing the file failed. */
+bool snapshot_closeWriter(SnapshotWriter *w);
+
+/* Reads and checks a snapshot file. Prints a message if it fails.
+ *  path   - The file.
+ *  keys   - Creates the keys from bytes, with the same fixed size as the
+ *           serializer the file was written with.
+ *  values - Creates the values from bytes.
+ * Returns: The reader, NULL if the file could not be read or is not a
+ *          complete snapshot written with the same fixed sizes. */
+SnapshotReader *snapshot_openReader(const char *path,
+                                    const TableSerializer *keys,
+                                    const TableSerializer *values);
+
+/* Returns: The number of entries in a snapshot.
+ *  r - The reader. */
+unsigned long long snapshot_count(const SnapshotReader *r);
+
+/* Creates the next entry of a snapshot.
+ *  r     - The reader.
+ *  key   - The new key is stored here.
+ *  value - The new value is stored here.
+ * Returns: false if all entries have been read. */
+bool snapshot_read(SnapshotReader *r, void **key, void **value);
+
+/* Deallocates a reader.
+ *  r - The reader. */
+void snapshot_closeReader(SnapshotReader *r);
+
+#endif
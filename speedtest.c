@@ -0,0 +1,1524 @@
+/*
+ * The speed test shared by the test program and the benchmark, see
+ * speedtest.h.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "nanoclock.h"
+#include "perfcounters.h"
+#include "speedtest.h"
+
+/* Name of each phase as used by --phases and in the CSV/JSON output, and
+ * the heading printed before its time in the text output */
+static const struct {
+    int flag;
+    const char *name;
+    const char *heading;
+} phases[] = {
+    {PHASE_INSERT, "insert", "Insert %d items"},
+    {PHASE_LOOKUP, "lookup", "%d random lookups"},
+    {PHASE_NONEXISTING, "nonexisting", "%d lookups with non-existent keys"},
+    {PHASE_SKEWED, "skewed", "%d skewed lookups"},
+    {PHASE_REMOVE, "remove", "Remove all items"},
+    {PHASE_WORKLOAD, "workload", "%d operations of workload"},
+    {PHASE_SAVE, "save", "Save %d items to a snapshot"},
+    {PHASE_LOAD, "load", "Load %d items from a snapshot"},
+};
+#define NUM_PHASES (int)(sizeof(phases)/sizeof(phases[0]))
+
+/* Defaults for the size sweep */
+#define SWEEP_MIN 100
+#define SWEEP_MAX 10000000
+#define SWEEP_STEPS 1
+#define SWEEP_BUDGET 60.0
+#define SWEEP_TOLERANCE 0.35
+
+/* Default mix of the mixed workload, in percent */
+#define MIX_LOOKUPS 90
+#define MIX_INSERTS 5
+#define MIX_REMOVES 5
+
+/* Default number of operations timed together for the latencies. Every
+ * batch costs two clock reads and a histogram update that count towards
+ * the phase time, so timing single operations makes fast tables look
+ * slower than they are. The percentiles are of the batch averages, and a
+ * large batch averages a slow operation away with the fast ones around
+ * it until p99, p99.9 and max all come out the same. A batch of 8 keeps
+ * the clock overhead small while a single slow operation still shows in
+ * the tail. The latencies are labelled as batch averages when batched. */
+#define SAMPLE_BATCH 8
+
+/* Defaults for the repetitions and the baseline comparison */
+#define BASELINE_REPETITIONS 10
+#define BASELINE_ALPHA 0.01
+#define BASELINE_THRESHOLD 0.05
+
+/* Values getopt_long returns for the options that only have a long name */
+enum {
+    OPT_SWEEP_MIN = 256,
+    OPT_SWEEP_MAX,
+    OPT_SWEEP_STEPS,
+    OPT_BUDGET,
+    OPT_TOLERANCE,
+    OPT_MIX,
+    OPT_WRITE_RATIO,
+    OPT_SAVE_BASELINE,
+    OPT_BASELINE,
+    OPT_ALPHA,
+    OPT_THRESHOLD
+};
+
+/* The latency percentiles reported for each phase */
+static const double percentiles[] = {50, 90, 99, 99.9};
+#define NUM_PERCENTILES (int)(sizeof(percentiles)/sizeof(percentiles[0]))
+
+/* What the phases of one speed test run work on */
+typedef struct PhaseContext {
+    const TableBackend *b;  // the table implementation
+    Table *table;
+    KeySet *keys;           // the first tableSize keys are in the table
+    int tableSize;
+    int keyLength;          // length of string keys
+    int batch;              // the number of operations timed together
+    PerfCounters *counters; // NULL if hardware counters are not used
+    Rng *rng;               // the random numbers of the phases
+} PhaseContext;
+
+/* Creates the result for a phase with an empty latency histogram
+ *    phase - index into phases
+ *    ops - the number of operations the phase does
+ * Returns
+ *    the result, the histogram is deallocated with histogram_free
+ */
+static PhaseResult newPhaseResult(int phase, int ops) {
+    PhaseResult result = {.phase = phase, .ops = ops,
+                          .latency = histogram_create()};
+    return result;
+}
+
+/* Starts the measurements of a phase
+ *    c - the context of the phase
+ *    result - the allocation counts at the start are kept here
+ * Returns
+ *    the time the phase started
+ */
+static unsigned long long beginPhase(const PhaseContext *c,
+                                     PhaseResult *result) {
+    alloctrack_resetPeak();
+    alloctrack_get(&result->alloc);
+    if (c->counters != NULL)
+        perfcounters_start(c->counters);
+    return nanoclock_now();
+}
+
+/* Ends the measurements of a phase
+ *    c - the context of the phase
+ *    result - the time, counters and allocations are stored here
+ *    start - the time the phase started
+ */
+static void endPhase(const PhaseContext *c, PhaseResult *result,
+                     unsigned long long start) {
+    AllocStats alloc;
+    result->ns = nanoclock_now()-start;
+    if (c->counters != NULL)
+        perfcounters_stop(c->counters, &result->counters);
+    alloctrack_get(&alloc);
+    result->alloc.mallocs = alloc.mallocs-result->alloc.mallocs;
+    result->alloc.frees = alloc.frees-result->alloc.frees;
+    result->alloc.peakBytes = alloc.peakBytes-result->alloc.liveBytes;
+    result->alloc.liveBytes = alloc.liveBytes-result->alloc.liveBytes;
+}
+
+/* Returns the index where a batch of timed operations ends
+ *    i - index of the first operation in the batch
+ *    batch - the maximum number of operations in the batch
+ *    n - the total number of operations
+ */
+static int batchEnd(int i, int batch, int n) {
+    return n-i > batch ? i+batch : n;
+}
+
+/* Allocates the keys a phase works on, so the random numbers are drawn
+ * before the measurement starts and not counted in its time
+ *    n - the number of keys
+ * Returns
+ *    the stream of keys, deallocated with free
+ */
+static KEY *newKeyStream(int n) {
+    return malloc((n > 0 ? n : 1)*sizeof(KEY));
+}
+
+/* Measures time taken to fill a table with values
+ *    c - the context of the phase
+ *    keys - copies of the first tableSize keys, handed over to the table
+ *    values - the values to insert with them, handed over to the table
+ */
+static PhaseResult getInsertSpeed(const PhaseContext *c, void **keys,
+                                  int **values){
+    int n = c->tableSize;
+    PhaseResult result = newPhaseResult(0, n);
+    unsigned long long start;
+    unsigned long long batchStart;
+
+    // Insert all items
+    start = beginPhase(c, &result);
+    for(int i=0;i<n;) {
+        int stop = batchEnd(i, c->batch, n);
+        int first = i;
+        batchStart = nanoclock_now();
+        for(;i<stop;i++) {
+            c->b->insert(c->table, keys[i], values[i]);
+        }
+        histogram_recordBatch(result.latency, nanoclock_now()-batchStart,
+                              stop-first);
+    }
+    endPhase(c, &result, start);
+    return result;
+}
+
+/* Measures time taken to do n lookups of existing keys in a table
+ *    c - the context of the phase
+ *    n - the number of lookups to perform
+ */
+static PhaseResult getRandomExistingLookupSpeed(const PhaseContext *c,
+                                                int n){
+    PhaseResult result = newPhaseResult(1, n);
+    unsigned long long start;
+    unsigned long long batchStart;
+    KEY *stream = newKeyStream(n);
+
+    // The existing keys in the table are stored in index
+    // [0, tableSize-1] in the key-array
+    for(int i=0;i<n;i++)
+        stream[i] = c->keys->keys[rng_below(c->rng, c->tableSize)];
+    start = beginPhase(c, &result);
+    for(int i=0;i<n;) {
+        int stop = batchEnd(i, c->batch, n);
+        int first = i;
+        batchStart = nanoclock_now();
+        for(;i<stop;i++) {
+            c->b->lookup(c->table,stream[i]);
+        }
+        histogram_recordBatch(result.latency, nanoclock_now()-batchStart,
+                              stop-first);
+    }
+    endPhase(c, &result, start);
+    free(stream);
+    return result;
+}
+
+/* Measures time taken to do n lookups of non-existing keys in a table
+ *    c - the context of the phase
+ *    n - the number of lookups to perform
+ */
+static PhaseResult getRandomNonExistingLookupSpeed(const PhaseContext *c,
+                                                   int n){
+    PhaseResult result = newPhaseResult(2, n);
+    unsigned long long start;
+    unsigned long long batchStart;
+
+    // We know the exisiting keys have indexes in [0, tableSize-1] so if we
+    // try to lookup keys in the area [tableSize, 2*tableSize-1]
+    // they will not exist
+    start = beginPhase(c, &result);
+    int startindex = c->tableSize;
+    for(int i=0;i<n;) {
+        int stop = batchEnd(i, c->batch, n);
+        int first = i;
+        batchStart = nanoclock_now();
+        for(;i<stop;i++) {
+            c->b->lookup(c->table,
+                         c->keys->keys[startindex + (i%c->tableSize)]);
+        }
+        histogram_recordBatch(result.latency, nanoclock_now()-batchStart,
+                              stop-first);
+    }
+    endPhase(c, &result, start);
+    return result;
+}
+
+/* Measures time taken to do n lookups of existing keys in a table when
+ * some keys are looked up more often than others
+ *    c - the context of the phase
+ *    n - the number of lookups to perform
+ *    distribution - how the keys to look up are chosen
+ */
+static PhaseResult getSkewedLookupSpeed(const PhaseContext *c, int n,
+                                        const WorkloadSpec *distribution){
+    PhaseResult result = newPhaseResult(3, n);
+    unsigned long long start;
+    unsigned long long batchStart;
+    Workload *workload = workload_create(distribution, c->tableSize, c->rng);
+    KEY *stream = newKeyStream(n);
+
+    for(int i=0;i<n;i++)
+        stream[i] = c->keys->keys[workload_next(workload)];
+    workload_free(workload);
+    start = beginPhase(c, &result);
+    for(int i=0;i<n;) {
+        int stop = batchEnd(i, c->batch, n);
+        int first = i;
+        batchStart = nanoclock_now();
+        for(;i<stop;i++) {
+            c->b->lookup(c->table,stream[i]);
+        }
+        histogram_recordBatch(result.latency, nanoclock_now()-batchStart,
+                              stop-first);
+    }
+    endPhase(c, &result, start);
+    free(stream);
+    return result;
+}
+
+/* Measures time taken remove all keys from a table
+ *    c - the context of the phase
+ */
+static PhaseResult getRemoveSpeed(const PhaseContext *c){
+    int n = c->tableSize;
+    PhaseResult result = newPhaseResult(4, n);
+    unsigned long long start;
+    unsigned long long batchStart;
+
+    // Remove all items, not in the same order as they were inserted
+    int *order = malloc(n*sizeof(int));
+    KEY *stream = newKeyStream(n);
+    createRandomSample(order, n, c->rng);
+    for(int i=0;i<n;i++)
+        stream[i] = c->keys->keys[order[i]];
+    free(order);
+    start = beginPhase(c, &result);
+    for(int i=0;i<n;) {
+        int stop = batchEnd(i, c->batch, n);
+        int first = i;
+        batchStart = nanoclock_now();
+        for(;i<stop;i++) {
+            c->b->remove(c->table,stream[i]);
+        }
+        histogram_recordBatch(result.latency, nanoclock_now()-batchStart,
+                              stop-first);
+    }
+    endPhase(c, &result, start);
+    free(stream);
+    return result;
+}
+
+/* Gives an existing key a new value. The table.h API has no update and
+ * not all implementations replace the value when a key is inserted
+ * again, so the key is removed and inserted with the new value.
+ *    c - the context of the phase
+ *    table - the table
+ *    keys - the keys of the table
+ *    i - index of the key
+ *    copy - copy of the key, handed over to the table
+ *    value - the new value, handed over to the table
+ */
+static void updateKey(const PhaseContext *c, Table *table, KeySet *keys,
+                      int i, void *copy, int *value) {
+    c->b->remove(table, keys->keys[i]);
+    c->b->insert(table, copy, value);
+}
+
+/* Measures time taken to run a mixed workload preset on a table of its
+ * own, filled with tableSize keys before the measurement starts
+ *    c - the context of the phase
+ *    n - the number of operations to perform
+ *    preset - the mix of operations and the keys they use
+ */
+static PhaseResult getWorkloadSpeed(const PhaseContext *c, int n,
+                                    const WorkloadPreset *preset){
+    PhaseResult result = newPhaseResult(5, n);
+    unsigned long long start;
+    unsigned long long batchStart;
+    int size = c->tableSize;
+    // Room for every operation to be an insert of a new key
+    int inserts = preset->percent[PRESET_INSERT] > 0 ? n : 0;
+    KeySet *keys = createKeySet(c->keys->type, c->keyLength, size+inserts,
+                                c->rng);
+    Table *table = c->b->create(compareFunctionFor(keys->type));
+    c->b->setHashFunction(table, hashFunctionFor(keys->type));
+    c->b->setKeyBytesFunction(table, keyBytesFunctionFor(keys->type));
+    Workload *workload = workload_create(&preset->distribution, size,
+                                         c->rng);
+    // With the latest distribution the reads follow the inserts
+    int shift = preset->distribution.kind == WORKLOAD_LATEST;
+    int numKeys = size;
+    unsigned char *ops = malloc(n > 0 ? n : 1);
+    int *stream = malloc((n > 0 ? n : 1)*sizeof(int));
+
+    // Draw the operations and the keys they use, an insert uses the next
+    // new key
+    for(int i=0;i<n;i++) {
+        int r = rng_below(c->rng, 100);
+        PresetOp op = 0;
+        while (r >= preset->percent[op]) {
+            r -= preset->percent[op];
+            op++;
+        }
+        ops[i] = op;
+        stream[i] = workload_next(workload)+shift*(numKeys-size);
+        if (op == PRESET_INSERT)
+            stream[i] = numKeys++;
+    }
+    workload_free(workload);
+
+    // The keys and values handed over to the table are made before the
+    // time starts, a read-modify-write fills in its value when it runs
+    void **copies = malloc((n > 0 ? n : 1)*sizeof(void *));
+    int **values = malloc((n > 0 ? n : 1)*sizeof(int *));
+    for(int i=0;i<n;i++) {
+        if (ops[i] != PRESET_READ) {
+            copies[i] = copyKey(keys, stream[i]);
+            values[i] = intPtrFromInt(ops[i] == PRESET_INSERT ? stream[i] :
+                                      i);
+        }
+    }
+
+    c->b->setKeyMemHandler(table, free);
+    c->b->setValueMemHandler(table, free);
+    for(int i=0;i<size;i++)
+        c->b->insert(table, copyKey(keys, i), intPtrFromInt(i));
+
+    start = beginPhase(c, &result);
+    for(int i=0;i<n;) {
+        int stop = batchEnd(i, c->batch, n);
+        int first = i;
+        batchStart = nanoclock_now();
+        for(;i<stop;i++) {
+            int key = stream[i];
+            int *value;
+            switch (ops[i]) {
+            case PRESET_READ:
+                c->b->lookup(table, keys->keys[key]);
+                break;
+            case PRESET_UPDATE:
+                updateKey(c, table, keys, key, copies[i], values[i]);
+                break;
+            case PRESET_INSERT:
+                c->b->insert(table, copies[i], values[i]);
+                break;
+            default:
+                value = c->b->lookup(table, keys->keys[key]);
+                *values[i] = value ? *value+1 : 0;
+                updateKey(c, table, keys, key, copies[i], values[i]);
+                break;
+            }
+        }
+        histogram_recordBatch(result.latency, nanoclock_now()-batchStart,
+                              stop-first);
+    }
+    endPhase(c, &result, start);
+    free(ops);
+    free(stream);
+    free(copies);
+    free(values);
+    c->b->free(table);
+    freeKeySet(keys);
+    return result;
+}
+
+/* Measures time taken to save the table to a snapshot file. The table
+ * saves itself in one call, so the phase has no latencies of its own.
+ *    c - the context of the phase
+ *    path - the file
+ */
+static PhaseResult getSaveSpeed(const PhaseContext *c, const char *path){
+    const TableSerializer *keys = serializerFor(c->keys->type);
+    const TableSerializer *values = serializerFor(KEY_INT);
+    PhaseResult result = newPhaseResult(6, c->tableSize);
+    unsigned long long start;
+
+    start = beginPhase(c, &result);
+    if (!c->b->save(c->table, path, keys, values)) {
+        fprintf(stderr, "Saving the table failed\n");
+        exit(EXIT_FAILURE);
+    }
+    endPhase(c, &result, start);
+    return result;
+}
+
+/* Measures time taken to build a new table from a snapshot file. The
+ * table loads itself in one call, so the phase has no latencies of its
+ * own.
+ *    c - the context of the phase
+ *    path - the file, saved from the full table
+ */
+static PhaseResult getLoadSpeed(const PhaseContext *c, const char *path){
+    const TableSerializer *keys = serializerFor(c->keys->type);
+    const TableSerializer *values = serializerFor(KEY_INT);
+    PhaseResult result = newPhaseResult(7, c->tableSize);
+    unsigned long long start;
+
+    start = beginPhase(c, &result);
+    Table *table = c->b->load(path, compareFunctionFor(c->keys->type),
+                              keys, values);
+    endPhase(c, &result, start);
+    if (table == NULL) {
+        fprintf(stderr, "Loading the table failed\n");
+        exit(EXIT_FAILURE);
+    }
+    c->b->setKeyMemHandler(table, free);
+    c->b->setValueMemHandler(table, free);
+    c->b->free(table);
+    return result;
+}
+
+/* Opens the hardware counters if they are asked for, warns once if they
+ * are not available
+ *    config - the settings for the test
+ * Returns
+ *    the counters, NULL if they are not used
+ */
+static PerfCounters *openCounters(const SpeedConfig *config) {
+    static bool warned = false;
+    if (!config->counters)
+        return NULL;
+    PerfCounters *pc = perfcounters_open();
+    if (pc == NULL && !warned) {
+        fprintf(stderr, "Hardware performance counters are not available, "
+                "reporting timing only\n");
+        warned = true;
+    }
+    return pc;
+}
+
+/* Tests the speed of a table using random keys. First a number of
+ * elements are inserted. Second a random lookup among the elements are
+ * done followed by a skewed lookup (where a subset of the keys are
+ * looked up more frequently). Finally all elements are removed.
+ * Only the phases selected in config are reported, but the table is
+ * always filled so the lookup phases can be measured on their own.
+ */
+void speedtest_run(const TableBackend *b, const SpeedConfig *config,
+                   SpeedResults *results) {
+    PhaseResult *r = results->phases;
+    PhaseContext c;
+    int n = 0;
+    int size = config->tableSize;
+
+    AllocStats before, after, copiesBefore, copiesAfter;
+    Rng rng;
+
+    rng_seed(&rng, config->seed);
+    c.rng = &rng;
+    c.b = b;
+    alloctrack_get(&before);
+    c.table = b->create(compareFunctionFor(config->keyType));
+    b->setHashFunction(c.table, hashFunctionFor(config->keyType));
+    b->setKeyBytesFunction(c.table, keyBytesFunctionFor(config->keyType));
+    alloctrack_get(&after);
+    b->setKeyMemHandler(c.table, free);
+    b->setValueMemHandler(c.table, free);
+    c.tableSize = size;
+    c.keyLength = config->keyLength;
+    c.batch = config->sampleBatch;
+    c.counters = openCounters(config);
+
+    // To make it easier testing non-existing keys later
+    c.keys = createKeySet(config->keyType, config->keyLength, 2*size, &rng);
+    int *values = malloc(size*sizeof(int));
+    createRandomSample(values, size, &rng);
+    // The keys and values handed over to the table are made before the
+    // time starts
+    void **keyCopies = malloc((size > 0 ? size : 1)*sizeof(void *));
+    int **valueCopies = malloc((size > 0 ? size : 1)*sizeof(int *));
+    alloctrack_get(&copiesBefore);
+    for(int i=0;i<size;i++) {
+        keyCopies[i] = copyKey(c.keys, i);
+        valueCopies[i] = intPtrFromInt(values[i]);
+    }
+    alloctrack_get(&copiesAfter);
+
+    r[n] = getInsertSpeed(&c, keyCopies, valueCopies);
+    free(keyCopies);
+    free(valueCopies);
+    // The memory of the full table with the keys and values it owns,
+    // without the histogram and the other things the harness allocated
+    // in between
+    results->tableBytes = after.liveBytes-before.liveBytes+
+                          copiesAfter.liveBytes-copiesBefore.liveBytes+
+                          r[n].alloc.liveBytes;
+    if (config->phases & PHASE_INSERT)
+        n++;
+    else
+        histogram_free(r[n].latency);
+    if (config->phases & PHASE_LOOKUP)
+        r[n++] = getRandomExistingLookupSpeed(&c, config->numOps);
+    if (config->phases & PHASE_NONEXISTING)
+        r[n++] = getRandomNonExistingLookupSpeed(&c, config->numOps);
+    if (config->phases & PHASE_SKEWED) {
+        for(int d=0;d<config->numDistributions;d++) {
+            r[n] = getSkewedLookupSpeed(&c, config->numOps,
+                                        &config->distributions[d]);
+            r[n++].distribution = config->distributionNames[d];
+        }
+    }
+    if (config->phases & PHASE_WORKLOAD) {
+        for(int w=0;w<config->numWorkloads;w++) {
+            const WorkloadPreset *preset = &config->workloads[w];
+            r[n] = getWorkloadSpeed(&c, config->numOps, preset);
+            r[n].workload = preset->name;
+            r[n++].distribution = preset->distributionName;
+        }
+    }
+    if (config->phases & (PHASE_SAVE | PHASE_LOAD)) {
+        char path[] = "/tmp/speedtest-XXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0) {
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+        close(fd);
+        // The load phase needs the snapshot even if the save phase is not
+        // reported
+        r[n] = getSaveSpeed(&c, path);
+        if (config->phases & PHASE_SAVE)
+            n++;
+        else
+            histogram_free(r[n].latency);
+        if (config->phases & PHASE_LOAD)
+            r[n++] = getLoadSpeed(&c, path);
+        remove(path);
+    }
+    // The layout of the entries is read while the table is full
+    TableStats full;
+    b->getStats(c.table, &full);
+    if (config->phases & PHASE_REMOVE)
+        r[n++] = getRemoveSpeed(&c);
+    results->n = n;
+
+    if (c.counters != NULL)
+        perfcounters_close(c.counters);
+    freeKeySet(c.keys);
+    free(values);
+    results->hasStats = b->getStats(c.table, &results->stats);
+    results->stats.entries = full.entries;
+    results->stats.displacement = full.displacement;
+    results->stats.maxDisplacement = full.maxDisplacement;
+    b->free(c.table);
+}
+
+void speedtest_freeResults(SpeedResults *results) {
+    for(int i=0;i<results->n;i++)
+        histogram_free(results->phases[i].latency);
+    results->n = 0;
+}
+
+/* Prints the heading of a phase in the text output
+ *    out - the stream to print to
+ *    r - the result of the phase
+ */
+static void printHeading(FILE *out, const PhaseResult *r) {
+    fprintf(out, phases[r->phase].heading, r->ops);
+    if (r->workload != NULL)
+        fprintf(out, " %s", r->workload);
+    if (r->distribution != NULL)
+        fprintf(out, " (%s)", r->distribution);
+}
+
+/* Returns the throughput of a phase in operations per second
+ *    r - the result of the phase
+ */
+static double opsPerSecond(const PhaseResult *r) {
+    return r->ns > 0 ? r->ops*1e9/r->ns : 0;
+}
+
+/* Formats a latency of a phase. The phases that are only timed as a
+ * whole have no latencies, and are given a text in place of them.
+ *    text - room for the latency
+ *    size - the size of text
+ *    latency - the latencies of the phase
+ *    p - the percentile, or a negative number for the maximum
+ *    none - the text used when the phase has no latencies
+ * Returns
+ *    text or none
+ */
+static const char *latencyText(char *text, size_t size,
+                               const Histogram *latency, double p,
+                               const char *none) {
+    if (histogram_count(latency) == 0)
+        return none;
+    snprintf(text, size, "%llu", p < 0 ? histogram_max(latency) :
+             histogram_percentile(latency, p));
+    return text;
+}
+
+/* Prints the hardware counters of a phase per operation, if there are any
+ *    out - the stream to print to
+ *    r - the result of the phase
+ */
+static void printCounters(FILE *out, const PhaseResult *r) {
+    bool any = false;
+    for(int e=0;e<PERF_NUM_EVENTS;e++) {
+        if (!r->counters.valid[e])
+            continue;
+        fprintf(out, "%s %s: %.1f", any ? "," : "Per op:",
+                perfcounters_name(e), r->counters.counts[e]/r->ops);
+        any = true;
+    }
+    if (any)
+        fprintf(out, "\n");
+}
+
+/* Prints the allocations of a phase per operation, if they are tracked
+ *    out - the stream to print to
+ *    r - the result of the phase
+ */
+static void printAllocs(FILE *out, const PhaseResult *r) {
+    if (!alloctrack_enabled())
+        return;
+    fprintf(out, "Per op: %.2f mallocs, %.2f frees, %+.1f bytes. "
+            "Peak %lld bytes\n", (double)r->alloc.mallocs/r->ops,
+            (double)r->alloc.frees/r->ops,
+            (double)r->alloc.liveBytes/r->ops, r->alloc.peakBytes);
+}
+
+/* Returns the bytes per entry of the full table
+ *    config - the settings the test was run with
+ *    results - the results
+ */
+static double bytesPerEntry(const SpeedConfig *config,
+                            const SpeedResults *results) {
+    return (double)results->tableBytes/config->tableSize;
+}
+
+/* The statistics of the table in the output, see tablestats.h */
+static const struct {
+    const char *name;
+    const char *label;
+    bool average;       // printed with a decimal
+} stats[] = {
+    {"lookups", "lookups", false},
+    {"hits", "hits", false},
+    {"misses", "misses", false},
+    {"compares_per_lookup", "avg compares", true},
+    {"max_compares", "max compares", false},
+    {"inserts", "inserts", false},
+    {"removes", "removes", false},
+    {"moves", "moves", false},
+    {"probes_per_lookup", "avg probes", true},
+    {"max_probes", "max probes", false},
+    {"depth_per_lookup", "avg depth", true},
+    {"max_depth", "max depth", false},
+    {"mean_displacement", "avg distance", true},
+    {"max_displacement", "max distance", false}
+};
+#define NUM_STATS (int)(sizeof(stats)/sizeof(stats[0]))
+
+/* Returns one of the statistics of a table
+ *    s - the statistics
+ *    i - index into stats
+ */
+static double statValue(const TableStats *s, int i) {
+    double lookups = s->lookups > 0 ? s->lookups : 1;
+    switch (i) {
+    case 0: return s->lookups;
+    case 1: return s->hits;
+    case 2: return s->misses;
+    case 3: return s->compares/lookups;
+    case 4: return s->maxCompares;
+    case 5: return s->inserts;
+    case 6: return s->removes;
+    case 7: return s->moves;
+    case 8: return s->probes/lookups;
+    case 9: return s->maxProbes;
+    case 10: return s->depth/lookups;
+    case 11: return s->maxDepth;
+    case 12: return (double)s->displacement/
+                    (s->entries > 0 ? s->entries : 1);
+    default: return s->maxDisplacement;
+    }
+}
+
+/* Returns true if a statistic is printed, the ones of other kinds of
+ * tables than those in the results are left out
+ *    results - the results for each implementation
+ *    n - the number of implementations
+ *    i - index into stats
+ */
+static bool showStat(const SpeedResults results[], int n, int i) {
+    for(int b=0;b<n;b++) {
+        const TableStats *s = &results[b].stats;
+        if (!results[b].hasStats)
+            continue;
+        if (i < 7 || (i == 7 && s->moves > 0) ||
+            (i >= 8 && i < 10 && s->probes > 0) ||
+            (i >= 10 && i < 12 && s->depth > 0) ||
+            (i >= 12 && s->entries > 0))
+            return true;
+    }
+    return false;
+}
+
+/* Prints the results of one table implementation as text
+ *    out - the stream to print to
+ *    config - the settings the test was run with
+ *    results - the results
+ */
+static void printText(FILE *out, const SpeedConfig *config,
+                      const SpeedResults *results) {
+    char text[32];
+    for(int i=0;i<results->n;i++) {
+        const PhaseResult *r = &results->phases[i];
+        printHeading(out, r);
+        fprintf(out, ": \n%.3f ms, %.1f ns/op, %.0f ops/s. Latency (ns",
+                r->ns/1e6, (double)r->ns/r->ops, opsPerSecond(r));
+        if (config->sampleBatch > 1 && histogram_count(r->latency) > 0)
+            fprintf(out, ", averages of batches of %d", config->sampleBatch);
+        fprintf(out, ")");
+        for(int p=0;p<NUM_PERCENTILES;p++)
+            fprintf(out, " p%g: %s", percentiles[p],
+                    latencyText(text, sizeof(text), r->latency,
+                                percentiles[p], "n/a"));
+        fprintf(out, " max: %s\n",
+                latencyText(text, sizeof(text), r->latency, -1, "n/a"));
+        printAllocs(out, r);
+        printCounters(out, r);
+    }
+    if (alloctrack_enabled())
+        fprintf(out, "Memory of the full table: %lld bytes, %.1f bytes per "
+                "entry\n", results->tableBytes,
+                bytesPerEntry(config, results));
+    if (results->hasStats) {
+        fprintf(out, "Table statistics:");
+        for(int s=0;s<NUM_STATS;s++)
+            if (showStat(results, 1, s))
+                fprintf(out, "%s %s %.*f", s ? "," : "", stats[s].label,
+                        stats[s].average ? 1 : 0,
+                        statValue(&results->stats, s));
+        fprintf(out, "\n");
+    }
+}
+
+/* Prints the results of several table implementations as a text table
+ * with one column per implementation
+ *    out - the stream to print to
+ *    config - the settings the tests were run with
+ *    backends - the implementations
+ *    results - the results for each implementation
+ *    n - the number of implementations
+ */
+static void printTextSideBySide(FILE *out, const SpeedConfig *config,
+                                const TableBackend *const backends[],
+                                const SpeedResults results[], int n) {
+    if (config->sampleBatch > 1)
+        fprintf(out, "Latencies are averages of batches of %d operations\n\n",
+                config->sampleBatch);
+    fprintf(out, "%-14s", "");
+    for(int b=0;b<n;b++)
+        fprintf(out, " %14s", backends[b]->name);
+    fprintf(out, "\n");
+    for(int i=0;i<results[0].n;i++) {
+        printHeading(out, &results[0].phases[i]);
+        fprintf(out, ":\n%-14s", "  ms");
+        for(int b=0;b<n;b++)
+            fprintf(out, " %14.3f", results[b].phases[i].ns/1e6);
+        fprintf(out, "\n%-14s", "  ns/op");
+        for(int b=0;b<n;b++)
+            fprintf(out, " %14.1f", (double)results[b].phases[i].ns/
+                                    results[b].phases[i].ops);
+        fprintf(out, "\n%-14s", "  ops/s");
+        for(int b=0;b<n;b++)
+            fprintf(out, " %14.0f", opsPerSecond(&results[b].phases[i]));
+        for(int p=0;p<=NUM_PERCENTILES;p++) {
+            char label[32];
+            if (p < NUM_PERCENTILES)
+                snprintf(label, sizeof(label), "  p%g ns", percentiles[p]);
+            else
+                snprintf(label, sizeof(label), "  max ns");
+            fprintf(out, "\n%-14s", label);
+            for(int b=0;b<n;b++) {
+                char text[32];
+                fprintf(out, " %14s",
+                        latencyText(text, sizeof(text),
+                                    results[b].phases[i].latency,
+                                    p < NUM_PERCENTILES ? percentiles[p] : -1,
+                                    "n/a"));
+            }
+        }
+        if (alloctrack_enabled()) {
+            fprintf(out, "\n%-14s", "  mallocs/op");
+            for(int b=0;b<n;b++)
+                fprintf(out, " %14.2f", (double)results[b].phases[i].alloc.
+                        mallocs/results[b].phases[i].ops);
+            fprintf(out, "\n%-14s", "  frees/op");
+            for(int b=0;b<n;b++)
+                fprintf(out, " %14.2f", (double)results[b].phases[i].alloc.
+                        frees/results[b].phases[i].ops);
+            fprintf(out, "\n%-14s", "  bytes/op");
+            for(int b=0;b<n;b++)
+                fprintf(out, " %+14.1f", (double)results[b].phases[i].alloc.
+                        liveBytes/results[b].phases[i].ops);
+        }
+        for(int e=0;e<PERF_NUM_EVENTS;e++) {
+            bool any = false;
+            for(int b=0;b<n;b++)
+                any = any || results[b].phases[i].counters.valid[e];
+            if (!any)
+                continue;
+            char label[32];
+            snprintf(label, sizeof(label), "  %s/op", perfcounters_name(e));
+            fprintf(out, "\n%-14s", label);
+            for(int b=0;b<n;b++) {
+                const PhaseResult *r = &results[b].phases[i];
+                if (r->counters.valid[e])
+                    fprintf(out, " %14.1f", r->counters.counts[e]/r->ops);
+                else
+                    fprintf(out, " %14s", "-");
+            }
+        }
+        fprintf(out, "\n");
+    }
+    if (alloctrack_enabled()) {
+        fprintf(out, "Memory of the full table:\n%-14s", "  bytes/entry");
+        for(int b=0;b<n;b++)
+            fprintf(out, " %14.1f", bytesPerEntry(config, &results[b]));
+        fprintf(out, "\n");
+    }
+    if (showStat(results, n, 0)) {
+        fprintf(out, "Table statistics:\n");
+        for(int s=0;s<NUM_STATS;s++) {
+            if (!showStat(results, n, s))
+                continue;
+            char label[32];
+            snprintf(label, sizeof(label), "  %s", stats[s].label);
+            fprintf(out, "%-14s", label);
+            for(int b=0;b<n;b++) {
+                if (results[b].hasStats)
+                    fprintf(out, " %14.*f", stats[s].average ? 1 : 0,
+                            statValue(&results[b].stats, s));
+                else
+                    fprintf(out, " %14s", "-");
+            }
+            fprintf(out, "\n");
+        }
+    }
+}
+
+/* Prints the results of one table implementation as CSV rows
+ *    out - the stream to print to
+ *    config - the settings the test was run with
+ *    backend - the implementation
+ *    results - the results
+ */
+static void printCsv(FILE *out, const SpeedConfig *config,
+                     const TableBackend *backend,
+                     const SpeedResults *results) {
+    const char *keyType = config->keyType == KEY_STRING ? "string" : "int";
+    int keyLength = config->keyType == KEY_STRING ? config->keyLength : 0;
+    char text[32];
+
+    for(int i=0;i<results->n;i++) {
+        const PhaseResult *r = &results->phases[i];
+        fprintf(out, "%s,%s,%s,%s,%d,%d,%s,%d,%u,%d,%llu,%.1f,%.0f",
+                backend->name, phases[r->phase].name,
+                r->distribution ? r->distribution : "",
+                r->workload ? r->workload : "",
+                config->tableSize, r->ops, keyType, keyLength, config->seed,
+                config->sampleBatch, r->ns, (double)r->ns/r->ops,
+                opsPerSecond(r));
+        for(int p=0;p<NUM_PERCENTILES;p++)
+            fprintf(out, ",%s", latencyText(text, sizeof(text), r->latency,
+                                            percentiles[p], ""));
+        fprintf(out, ",%s",
+                latencyText(text, sizeof(text), r->latency, -1, ""));
+        if (alloctrack_enabled())
+            fprintf(out, ",%.2f,%.2f,%.1f,%lld,%.1f",
+                    (double)r->alloc.mallocs/r->ops,
+                    (double)r->alloc.frees/r->ops,
+                    (double)r->alloc.liveBytes/r->ops, r->alloc.peakBytes,
+                    bytesPerEntry(config, results));
+        else
+            fprintf(out, ",,,,,");
+        for(int e=0;e<PERF_NUM_EVENTS;e++) {
+            if (r->counters.valid[e])
+                fprintf(out, ",%.2f", r->counters.counts[e]/r->ops);
+            else
+                fprintf(out, ",");
+        }
+        fprintf(out, "\n");
+    }
+}
+
+/* Prints the results of one table implementation as a JSON object
+ *    out - the stream to print to
+ *    config - the settings the test was run with
+ *    backend - the implementation
+ *    results - the results
+ */
+static void printJson(FILE *out, const SpeedConfig *config,
+                      const TableBackend *backend,
+                      const SpeedResults *results) {
+    char text[32];
+    fprintf(out, "{\"name\": \"%s\", ", backend->name);
+    if (alloctrack_enabled())
+        fprintf(out, "\"table_bytes\": %lld, \"bytes_per_entry\": %.1f, ",
+                results->tableBytes, bytesPerEntry(config, results));
+    if (results->hasStats) {
+        fprintf(out, "\"stats\": {");
+        for(int s=0;s<NUM_STATS;s++)
+            fprintf(out, "%s\"%s\": %g", s ? ", " : "", stats[s].name,
+                    statValue(&results->stats, s));
+        fprintf(out, "}, ");
+    }
+    fprintf(out, "\"phases\": [");
+    for(int i=0;i<results->n;i++) {
+        const PhaseResult *r = &results->phases[i];
+        fprintf(out, "%s\n    {\"phase\": \"%s\", ",
+                i ? "," : "", phases[r->phase].name);
+        if (r->distribution != NULL)
+            fprintf(out, "\"distribution\": \"%s\", ", r->distribution);
+        if (r->workload != NULL)
+            fprintf(out, "\"workload\": \"%s\", ", r->workload);
+        fprintf(out, "\"ops\": %d, \"ns\": %llu, \"ns_per_op\": %.1f, "
+                "\"ops_per_s\": %.0f, \"latency_ns\": {", r->ops, r->ns,
+                (double)r->ns/r->ops, opsPerSecond(r));
+        for(int p=0;p<NUM_PERCENTILES;p++)
+            fprintf(out, "\"p%g\": %s, ", percentiles[p],
+                    latencyText(text, sizeof(text), r->latency,
+                                percentiles[p], "null"));
+        fprintf(out, "\"max\": %s}",
+                latencyText(text, sizeof(text), r->latency, -1, "null"));
+        if (alloctrack_enabled())
+            fprintf(out, ", \"alloc\": {\"mallocs_per_op\": %.2f, "
+                    "\"frees_per_op\": %.2f, \"bytes_per_op\": %.1f, "
+                    "\"peak_bytes\": %lld}", (double)r->alloc.mallocs/r->ops,
+                    (double)r->alloc.frees/r->ops,
+                    (double)r->alloc.liveBytes/r->ops, r->alloc.peakBytes);
+        bool any = false;
+        for(int e=0;e<PERF_NUM_EVENTS;e++) {
+            if (!r->counters.valid[e])
+                continue;
+            fprintf(out, "%s\"%s\": %.2f", any ? ", " :
+                    ", \"counters_per_op\": {", perfcounters_name(e),
+                    r->counters.counts[e]/r->ops);
+            any = true;
+        }
+        fprintf(out, any ? "}}" : "}");
+    }
+    fprintf(out, "\n  ]}");
+}
+
+void speedtest_report(const SpeedConfig *config,
+                      const TableBackend *const backends[],
+                      const SpeedResults results[], int n) {
+    FILE *out = speedtest_openOutput(config);
+
+    switch (config->format) {
+    case FORMAT_TEXT:
+        if (n == 1)
+            printText(out, config, &results[0]);
+        else
+            printTextSideBySide(out, config, backends, results, n);
+        break;
+    case FORMAT_CSV:
+        fprintf(out, "backend,phase,distribution,workload,size,ops,key_type,"
+                "key_length,seed,sample_batch,ns,ns_per_op,ops_per_s,"
+                "p50_ns,p90_ns,p99_ns,p99.9_ns,max_ns,mallocs_per_op,"
+                "frees_per_op,bytes_per_op,peak_bytes,bytes_per_entry");
+        for(int e=0;e<PERF_NUM_EVENTS;e++)
+            fprintf(out, ",%s_per_op", perfcounters_name(e));
+        fprintf(out, "\n");
+        for(int b=0;b<n;b++)
+            printCsv(out, config, backends[b], &results[b]);
+        break;
+    case FORMAT_JSON:
+        fprintf(out, "{\"size\": %d, \"ops\": %d, \"seed\": %u, "
+                "\"key_type\": \"%s\", \"key_length\": %d, "
+                "\"sample_batch\": %d, \"backends\": [",
+                config->tableSize, config->numOps, config->seed,
+                config->keyType == KEY_STRING ? "string" : "int",
+                config->keyType == KEY_STRING ? config->keyLength : 0,
+                config->sampleBatch);
+        for(int b=0;b<n;b++) {
+            fprintf(out, "%s\n  ", b ? "," : "");
+            printJson(out, config, backends[b], &results[b]);
+        }
+        fprintf(out, "\n]}\n");
+        break;
+    }
+
+    speedtest_closeOutput(out);
+}
+
+FILE *speedtest_openOutput(const SpeedConfig *config) {
+    if (config->outputPath == NULL)
+        return stdout;
+    FILE *out = fopen(config->outputPath, "w");
+    if (out == NULL) {
+        perror(config->outputPath);
+        exit(EXIT_FAILURE);
+    }
+    return out;
+}
+
+void speedtest_closeOutput(FILE *out) {
+    if (out != stdout)
+        fclose(out);
+}
+
+int speedtest_maxEntries(const SpeedConfig *config) {
+    if (config->phases & PHASE_WORKLOAD) {
+        for(int w=0;w<config->numWorkloads;w++) {
+            if (config->workloads[w].percent[PRESET_INSERT] > 0)
+                return config->tableSize+config->numOps;
+        }
+    }
+    return config->tableSize;
+}
+
+const char *speedtest_phaseName(int phase) {
+    return phases[phase].name;
+}
+
+/* Prints the command line options
+ *    out - the stream to print to
+ *    program - the name of the program
+ *    multiBackend - print the benchmark options instead of the test
+ *                   program options
+ */
+static void usage(FILE *out, const char *program, bool multiBackend) {
+    fprintf(out,
+        "Usage: %s [options]\n"
+        "  -n, --size N          number of items in the table (default %d)\n"
+        "  -o, --ops N           lookups in each lookup phase (default 2*size)\n"
+        "  -s, --seed N          seed for the random numbers (default 1)\n"
+        "  -k, --keys TYPE       key type, int or string (default int)\n"
+        "  -l, --key-length N    length of string keys (default %d)\n"
+        "  -p, --phases LIST     comma separated phases to measure, any of\n"
+        "                        insert,lookup,nonexisting,skewed,workload,\n"
+        "                        save,load,remove or all\n"
+        "  -f, --format FORMAT   text, csv or json (default text)\n"
+        "  -O, --output FILE     print the results to FILE\n"
+        "  -d, --distribution D  key distribution for the skewed lookups, may\n"
+        "                        be given several times (default middle):\n"
+        "                        uniform, middle (middle third of the keys),\n"
+        "                        zipf[:theta], latest[:theta],\n"
+        "                        hotspot[:opsfraction[:keysfraction]],\n"
+        "                        shifting[:opsfraction[:keysfraction[:interval]]]\n"
+        "  -w, --workload W      mixed workload run with --ops operations on a\n"
+        "                        filled table, may be given several times:\n"
+        "                        a or update-heavy (50%% reads, 50%% updates),\n"
+        "                        b or read-mostly (95%% reads, 5%% updates),\n"
+        "                        c or read-only, d or read-latest (95%% reads,\n"
+        "                        5%% inserts), e or insert-heavy (10%% reads,\n"
+        "                        90%% inserts), f or read-modify-write (50%%\n"
+        "                        reads, 50%% read-modify-writes), with zipf\n"
+        "                        keys (latest for d) unless followed by\n"
+        "                        @distribution, for example a@uniform\n"
+        "  -B, --sample-batch N  operations timed together when recording\n"
+        "                        latencies, 1 for the latency of single\n"
+        "                        operations at the cost of adding the clock\n"
+        "                        overhead to the phase times (default %d)\n"
+        "  -P, --counters        report hardware performance counters per\n"
+        "                        operation, if the system allows it\n",
+        program, TABLESIZE, KEYLENGTH, SAMPLE_BATCH);
+    if (multiBackend)
+        fprintf(out,
+        "  -x, --backend NAME    table implementation to run, may be given\n"
+        "                        several times (default all)\n"
+        "  -L, --list            list the table implementations\n"
+        "  -S, --sweep           run the speed test at a series of sizes and\n"
+        "                        check how the time per operation grows\n"
+        "      --sweep-min N     smallest size of the sweep (default %d)\n"
+        "      --sweep-max N     largest size of the sweep (default %d)\n"
+        "      --sweep-steps N   sizes per factor of ten (default %d)\n"
+        "      --budget SECONDS  time each implementation may use in the\n"
+        "                        sweep, larger sizes are left out when the\n"
+        "                        next one is expected to exceed it (default %g)\n"
+        "      --tolerance X     how much the fitted growth exponent may\n"
+        "                        exceed the expected one (default %g)\n"
+        "  -T, --threads LIST    run a mixed workload on one shared table from\n"
+        "                        each comma separated number of threads, with\n"
+        "                        --ops operations per thread\n"
+        "      --mix L:I:R       percent of lookups, inserts and removes in the\n"
+        "                        mixed workload (default %d:%d:%d)\n"
+        "      --write-ratio N   one write in every N operations of the mixed\n"
+        "                        workload instead of --mix, half of them\n"
+        "                        inserts and half removes\n"
+        "  -W, --warmup N        unmeasured runs of each implementation before\n"
+        "                        the measured ones (default 0)\n"
+        "  -R, --repeat N        measured runs of each implementation, reported\n"
+        "                        as the min, median and median absolute\n"
+        "                        deviation of ns/op (default 1, or %d with a\n"
+        "                        baseline)\n"
+        "      --save-baseline FILE  save the runs to FILE as JSON\n"
+        "      --baseline FILE   compare the runs with a saved baseline and\n"
+        "                        fail on significant regressions\n"
+        "      --alpha X         significance level of the comparison\n"
+        "                        (default %g)\n"
+        "      --threshold X     smallest relative change of the median that\n"
+        "                        counts as a regression (default %g)\n",
+        SWEEP_MIN, SWEEP_MAX, SWEEP_STEPS, SWEEP_BUDGET, SWEEP_TOLERANCE,
+        MIX_LOOKUPS, MIX_INSERTS, MIX_REMOVES, BASELINE_REPETITIONS,
+        BASELINE_ALPHA, BASELINE_THRESHOLD);
+    else
+        fprintf(out,
+        "  -c, --check           run the correctness tests (default for text)\n"
+        "  -C, --no-check        skip the correctness tests\n"
+        "  -b, --batch           do not wait for enter after the tests\n");
+    fprintf(out,
+        "  -h, --help            show this text\n");
+}
+
+/* Parses a positive integer command line argument, exits on errors
+ *    option - the name of the option, used in the error message
+ *    arg - the argument to parse
+ * Returns
+ *    the value of the argument
+ */
+static long parsePositive(const char *option, const char *arg) {
+    char *end;
+    long value = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || value < 1) {
+        fprintf(stderr, "Invalid value for %s: %s\n", option, arg);
+        exit(EXIT_FAILURE);
+    }
+    return value;
+}
+
+/* Parses a non-negative number command line argument, exits on errors
+ *    option - the name of the option, used in the error message
+ *    arg - the argument to parse
+ * Returns
+ *    the value of the argument
+ */
+static double parseNumber(const char *option, const char *arg) {
+    char *end;
+    double value = strtod(arg, &end);
+    if (*arg == '\0' || *end != '\0' || !(value >= 0)) {
+        fprintf(stderr, "Invalid value for %s: %s\n", option, arg);
+        exit(EXIT_FAILURE);
+    }
+    return value;
+}
+
+/* Parses a comma separated list of phase names, exits on errors
+ *    arg - the list
+ * Returns
+ *    the PHASE_* flags for the phases in the list
+ */
+static int parsePhases(const char *arg) {
+    int flags = 0;
+    char *list = strdup(arg);
+    for(char *name=strtok(list, ",");name!=NULL;name=strtok(NULL, ",")) {
+        int i;
+        if (strcmp(name, "all") == 0) {
+            flags |= PHASE_ALL;
+            continue;
+        }
+        for(i=0;i<NUM_PHASES && strcmp(name, phases[i].name);i++)
+            ;
+        if (i == NUM_PHASES) {
+            fprintf(stderr, "Unknown phase: %s\n", name);
+            exit(EXIT_FAILURE);
+        }
+        flags |= phases[i].flag;
+    }
+    free(list);
+    return flags;
+}
+
+/* Parses a comma separated list of thread counts, exits on errors
+ *    arg - the list
+ *    config - the counts are stored here
+ */
+static void parseThreads(const char *arg, SpeedConfig *config) {
+    char *list = strdup(arg);
+    config->numThreadCounts = 0;
+    for(char *n=strtok(list, ",");n!=NULL;n=strtok(NULL, ",")) {
+        long threads = parsePositive("--threads", n);
+        if (threads > MAX_THREADS ||
+            config->numThreadCounts == MAX_THREAD_COUNTS) {
+            fprintf(stderr, "At most %d thread counts of at most %d threads "
+                    "can be given\n", MAX_THREAD_COUNTS, MAX_THREADS);
+            exit(EXIT_FAILURE);
+        }
+        config->threadCounts[config->numThreadCounts++] = threads;
+    }
+    free(list);
+    if (config->numThreadCounts == 0) {
+        fprintf(stderr, "Invalid value for --threads: %s\n", arg);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Parses the percentages of the mixed workload, exits on errors
+ *    arg - lookups:inserts:removes
+ *    mix - the percentages are stored here
+ */
+static void parseMix(const char *arg, int mix[]) {
+    int length;
+    if (sscanf(arg, "%d:%d:%d%n", &mix[MIX_LOOKUP], &mix[MIX_INSERT],
+               &mix[MIX_REMOVE], &length) != 3 || arg[length] != '\0' ||
+        mix[MIX_LOOKUP] < 0 || mix[MIX_INSERT] < 0 || mix[MIX_REMOVE] < 0 ||
+        mix[MIX_LOOKUP]+mix[MIX_INSERT]+mix[MIX_REMOVE] != 100) {
+        fprintf(stderr, "Invalid value for --mix, the percentages must add "
+                "up to 100: %s\n", arg);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void speedtest_parseArguments(int argc, char *argv[], SpeedConfig *config,
+                              bool multiBackend) {
+    static const struct option options[] = {
+        {"size", required_argument, NULL, 'n'},
+        {"ops", required_argument, NULL, 'o'},
+        {"seed", required_argument, NULL, 's'},
+        {"keys", required_argument, NULL, 'k'},
+        {"key-length", required_argument, NULL, 'l'},
+        {"phases", required_argument, NULL, 'p'},
+        {"format", required_argument, NULL, 'f'},
+        {"output", required_argument, NULL, 'O'},
+        {"sample-batch", required_argument, NULL, 'B'},
+        {"distribution", required_argument, NULL, 'd'},
+        {"workload", required_argument, NULL, 'w'},
+        {"counters", no_argument, NULL, 'P'},
+        {"backend", required_argument, NULL, 'x'},
+        {"list", no_argument, NULL, 'L'},
+        {"sweep", no_argument, NULL, 'S'},
+        {"sweep-min", required_argument, NULL, OPT_SWEEP_MIN},
+        {"sweep-max", required_argument, NULL, OPT_SWEEP_MAX},
+        {"sweep-steps", required_argument, NULL, OPT_SWEEP_STEPS},
+        {"budget", required_argument, NULL, OPT_BUDGET},
+        {"tolerance", required_argument, NULL, OPT_TOLERANCE},
+        {"threads", required_argument, NULL, 'T'},
+        {"mix", required_argument, NULL, OPT_MIX},
+        {"write-ratio", required_argument, NULL, OPT_WRITE_RATIO},
+        {"warmup", required_argument, NULL, 'W'},
+        {"repeat", required_argument, NULL, 'R'},
+        {"save-baseline", required_argument, NULL, OPT_SAVE_BASELINE},
+        {"baseline", required_argument, NULL, OPT_BASELINE},
+        {"alpha", required_argument, NULL, OPT_ALPHA},
+        {"threshold", required_argument, NULL, OPT_THRESHOLD},
+        {"check", no_argument, NULL, 'c'},
+        {"no-check", no_argument, NULL, 'C'},
+        {"batch", no_argument, NULL, 'b'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int check = -1;
+    int opt;
+
+    *config = (SpeedConfig){
+        .tableSize = TABLESIZE,
+        .seed = 1,
+        .keyType = KEY_INT,
+        .keyLength = KEYLENGTH,
+        .phases = PHASE_ALL,
+        .format = FORMAT_TEXT,
+        .pause = true,
+        .sampleBatch = SAMPLE_BATCH,
+        .sweepMin = SWEEP_MIN,
+        .sweepMax = SWEEP_MAX,
+        .sweepSteps = SWEEP_STEPS,
+        .budget = SWEEP_BUDGET,
+        .tolerance = SWEEP_TOLERANCE,
+        .mix = {MIX_LOOKUPS, MIX_INSERTS, MIX_REMOVES},
+        .alpha = BASELINE_ALPHA,
+        .threshold = BASELINE_THRESHOLD
+    };
+    while ((opt = getopt_long(argc, argv,
+                              "n:o:s:k:l:p:f:O:B:d:w:Px:LST:W:R:cCbh",
+                              options, NULL)) != -1) {
+        // Options that only one of the programs takes
+        if ((multiBackend && (opt == 'c' || opt == 'C' || opt == 'b')) ||
+            (!multiBackend && (opt == 'x' || opt == 'L' || opt == 'S' ||
+                               opt == 'T' || opt == 'W' || opt == 'R' ||
+                               opt >= OPT_SWEEP_MIN)))
+            opt = '?';
+        switch (opt) {
+        case 'n':
+            config->tableSize = parsePositive("--size", optarg);
+            break;
+        case 'o':
+            config->numOps = parsePositive("--ops", optarg);
+            break;
+        case 's':
+            config->seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'k':
+            if (strcmp(optarg, "int") == 0)
+                config->keyType = KEY_INT;
+            else if (strcmp(optarg, "string") == 0)
+                config->keyType = KEY_STRING;
+            else {
+                fprintf(stderr, "Unknown key type: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'l':
+            config->keyLength = parsePositive("--key-length", optarg);
+            break;
+        case 'p':
+            config->phases = parsePhases(optarg);
+            break;
+        case 'f':
+            if (strcmp(optarg, "text") == 0)
+                config->format = FORMAT_TEXT;
+            else if (strcmp(optarg, "csv") == 0)
+                config->format = FORMAT_CSV;
+            else if (strcmp(optarg, "json") == 0)
+                config->format = FORMAT_JSON;
+            else {
+                fprintf(stderr, "Unknown format: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'O':
+            config->outputPath = optarg;
+            break;
+        case 'B':
+            config->sampleBatch = parsePositive("--sample-batch", optarg);
+            break;
+        case 'd':
+            if (config->numDistributions == MAX_DISTRIBUTIONS) {
+                fprintf(stderr, "At most %d distributions can be given\n",
+                        MAX_DISTRIBUTIONS);
+                exit(EXIT_FAILURE);
+            }
+            if (!workload_parse(optarg,
+                    &config->distributions[config->numDistributions])) {
+                fprintf(stderr, "Invalid distribution: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            config->distributionNames[config->numDistributions++] = optarg;
+            break;
+        case 'w':
+            if (config->numWorkloads == MAX_WORKLOADS) {
+                fprintf(stderr, "At most %d workloads can be given\n",
+                        MAX_WORKLOADS);
+                exit(EXIT_FAILURE);
+            }
+            if (!workload_parsePreset(optarg,
+                    &config->workloads[config->numWorkloads])) {
+                fprintf(stderr, "Invalid workload: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            config->numWorkloads++;
+            break;
+        case 'P':
+            config->counters = true;
+            break;
+        case 'x':
+            if (config->numBackends == MAX_BACKENDS) {
+                fprintf(stderr, "At most %d backends can be given\n",
+                        MAX_BACKENDS);
+                exit(EXIT_FAILURE);
+            }
+            config->backendNames[config->numBackends++] = optarg;
+            break;
+        case 'L':
+            config->listBackends = true;
+            break;
+        case 'S':
+            config->sweep = true;
+            break;
+        case OPT_SWEEP_MIN:
+            config->sweepMin = parsePositive("--sweep-min", optarg);
+            break;
+        case OPT_SWEEP_MAX:
+            config->sweepMax = parsePositive("--sweep-max", optarg);
+            break;
+        case OPT_SWEEP_STEPS:
+            config->sweepSteps = parsePositive("--sweep-steps", optarg);
+            break;
+        case OPT_BUDGET:
+            config->budget = parseNumber("--budget", optarg);
+            break;
+        case OPT_TOLERANCE:
+            config->tolerance = parseNumber("--tolerance", optarg);
+            break;
+        case 'T':
+            parseThreads(optarg, config);
+            break;
+        case OPT_MIX:
+            parseMix(optarg, config->mix);
+            break;
+        case OPT_WRITE_RATIO:
+            config->writeRatio = parsePositive("--write-ratio", optarg);
+            break;
+        case 'W':
+            config->warmup = parsePositive("--warmup", optarg);
+            break;
+        case 'R':
+            config->repetitions = parsePositive("--repeat", optarg);
+            break;
+        case OPT_SAVE_BASELINE:
+            config->saveBaseline = optarg;
+            break;
+        case OPT_BASELINE:
+            config->baseline = optarg;
+            break;
+        case OPT_ALPHA:
+            config->alpha = parseNumber("--alpha", optarg);
+            if (config->alpha <= 0 || config->alpha >= 1) {
+                fprintf(stderr, "--alpha must be between 0 and 1\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_THRESHOLD:
+            config->threshold = parseNumber("--threshold", optarg);
+            break;
+        case 'c':
+            check = 1;
+            break;
+        case 'C':
+            check = 0;
+            break;
+        case 'b':
+            config->pause = false;
+            break;
+        case 'h':
+            usage(stdout, argv[0], multiBackend);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(stderr, argv[0], multiBackend);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind < argc) {
+        usage(stderr, argv[0], multiBackend);
+        exit(EXIT_FAILURE);
+    }
+    if (config->sweep && config->numThreadCounts > 0) {
+        fprintf(stderr, "--sweep and --threads can not be combined\n");
+        exit(EXIT_FAILURE);
+    }
+    if ((config->sweep || config->numThreadCounts > 0) &&
+        (config->warmup > 0 || config->repetitions > 0 ||
+         config->saveBaseline != NULL || config->baseline != NULL)) {
+        fprintf(stderr, "--warmup, --repeat and the baselines can not be "
+                "combined with --sweep or --threads\n");
+        exit(EXIT_FAILURE);
+    }
+    // A baseline needs several runs to tell a change from noise
+    if (config->repetitions == 0)
+        config->repetitions = config->saveBaseline != NULL ||
+                              config->baseline != NULL ?
+                              BASELINE_REPETITIONS : 1;
+    if (config->sweepMin > config->sweepMax) {
+        fprintf(stderr, "--sweep-min is larger than --sweep-max\n");
+        exit(EXIT_FAILURE);
+    }
+    // The sweep picks the number of lookups for each size itself
+    if (config->numOps == 0 && !config->sweep)
+        config->numOps = 2*config->tableSize;
+    if (config->numDistributions == 0) {
+        config->distributionNames[0] = "middle";
+        workload_parse("middle", &config->distributions[0]);
+        config->numDistributions = 1;
+    }
+    // The machine readable formats are meant for scripts, so the
+    // correctness tests and their output are left out unless asked for
+    if (check == -1)
+        config->check = !multiBackend && config->format == FORMAT_TEXT;
+    else
+        config->check = check;
+    if (config->format != FORMAT_TEXT)
+        config->pause = false;
+}
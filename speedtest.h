@@ -0,0 +1,208 @@
+/*
+ * The speed test shared by the test program and the benchmark.
+ *
+ * A number of keys are inserted into a table, followed by random lookups
+ * of existing keys, lookups of keys that do not exist and skewed lookups
+ * where some keys are looked up more often than others. Then the mixed
+ * workload presets that were asked for, see workload.h, are run, each on
+ * a table of its own. The full table is then saved to a snapshot file and
+ * loaded back, see snapshot.h, and finally all keys are removed. Every
+ * phase reports its total time and the latency percentiles of its
+ * operations, the allocations per operation and the bytes per entry of
+ * the full table when alloctrack.c tracks them, and optionally the
+ * hardware performance counters per operation. Programs compiled with
+ * -DTABLE_STATS also report the statistics the table kept of its
+ * operations, see tablestats.h. The test is configured from the command
+ * line with speedtest_parseArguments.
+ */
+
+#ifndef SPEEDTEST_H
+#define SPEEDTEST_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "alloctrack.h"
+#include "histogram.h"
+#include "perfcounters.h"
+#include "tablebackend.h"
+#include "testkeys.h"
+#include "workload.h"
+
+// Default size of the table to generate, changed with --size
+#define TABLESIZE 500
+#define SAMPLESIZE TABLESIZE*2
+// Default length of string keys, changed with --key-length
+#define KEYLENGTH 16
+// Maximum number of --distribution options
+#define MAX_DISTRIBUTIONS 8
+// Maximum number of --workload options
+#define MAX_WORKLOADS 8
+// Maximum number of --backend options
+#define MAX_BACKENDS 16
+// Maximum number of --threads counts
+#define MAX_THREAD_COUNTS 8
+// Maximum number of threads in the mixed workload
+#define MAX_THREADS 64
+// Maximum number of results from one run, one per phase, distribution
+// and workload
+#define MAX_RESULTS (6+MAX_DISTRIBUTIONS+MAX_WORKLOADS)
+
+/* Formats the speed test results can be printed in */
+typedef enum OutputFormat {
+    FORMAT_TEXT,
+    FORMAT_CSV,
+    FORMAT_JSON
+} OutputFormat;
+
+/* The phases of the speed test, combined as bit flags */
+enum {
+    PHASE_INSERT = 1<<0,
+    PHASE_LOOKUP = 1<<1,
+    PHASE_NONEXISTING = 1<<2,
+    PHASE_SKEWED = 1<<3,
+    PHASE_REMOVE = 1<<4,
+    PHASE_WORKLOAD = 1<<5,
+    PHASE_SAVE = 1<<6,
+    PHASE_LOAD = 1<<7,
+    PHASE_ALL = (1<<8)-1
+};
+
+/* The operations of the mixed workload */
+typedef enum MixOp {
+    MIX_LOOKUP,
+    MIX_INSERT,
+    MIX_REMOVE,
+    MIX_NUM_OPS
+} MixOp;
+
+/* Settings for the speed test, filled in from the command line */
+typedef struct SpeedConfig {
+    int tableSize;          // number of items inserted into the table
+    int numOps;             // number of lookups done in each lookup phase
+    unsigned int seed;      // seed of the random numbers of the keys and ops
+    KeyType keyType;
+    int keyLength;          // length of string keys
+    int phases;             // PHASE_* flags for the phases to measure
+    OutputFormat format;
+    const char *outputPath; // file to print the results to, NULL for stdout
+    bool check;             // run the correctness tests before the speed test
+    bool pause;             // wait for enter after the correctness tests
+    int sampleBatch;        // operations timed together for the latencies,
+                            // see SAMPLE_BATCH in speedtest.c
+    bool counters;          // read the hardware performance counters
+    // Key distributions for the skewed lookups, one phase is run for each
+    int numDistributions;
+    const char *distributionNames[MAX_DISTRIBUTIONS];
+    WorkloadSpec distributions[MAX_DISTRIBUTIONS];
+    // Mixed workload presets, each is run on a table of its own
+    int numWorkloads;
+    WorkloadPreset workloads[MAX_WORKLOADS];
+    // Names of the table implementations to run, benchmark only
+    int numBackends;
+    const char *backendNames[MAX_BACKENDS];
+    bool listBackends;      // list the implementations instead of running
+    // Size sweep, benchmark only, see sweep.h
+    bool sweep;             // run the sweep instead of a single size
+    int sweepMin;           // smallest table size
+    int sweepMax;           // largest table size
+    int sweepSteps;         // sizes per factor of ten
+    double budget;          // seconds each implementation may use
+    double tolerance;       // allowed excess of the fitted exponent
+    // Multithreaded mixed workload, benchmark only, see mixedtest.h
+    int numThreadCounts;    // number of thread counts, 0 if not run
+    int threadCounts[MAX_THREAD_COUNTS];
+    int mix[MIX_NUM_OPS];   // percent of each MixOp
+    int writeRatio;         // one write in every writeRatio operations
+                            // instead of the mix, 0 to use the mix
+    // Repetitions and baselines, benchmark only, see repeat.h
+    int warmup;             // unmeasured runs before the measured ones
+    int repetitions;        // measured runs of each implementation
+    const char *saveBaseline;   // file to save the runs to, or NULL
+    const char *baseline;   // file to compare the runs with, or NULL
+    double alpha;           // significance level of the comparison
+    double threshold;       // smallest relative change that is reported
+} SpeedConfig;
+
+/* Time measured for one phase of the speed test */
+typedef struct PhaseResult {
+    int phase;          // index of the phase, in the order they are run
+    int ops;            // number of table operations done
+    unsigned long long ns;  // time for the whole phase
+    Histogram *latency; // nanoseconds per operation, empty for the phases
+                        // that are only timed as a whole
+    const char *distribution; // key distribution of skewed lookups and
+                              // workloads, or NULL
+    const char *workload;   // name of the workload preset, or NULL
+    PerfSample counters;    // hardware counters for the phase, if used
+    // Allocations made in the phase, liveBytes is the change of the live
+    // bytes and peakBytes the most bytes live above the start
+    AllocStats alloc;
+} PhaseResult;
+
+/* The results of running the speed test on one table implementation */
+typedef struct SpeedResults {
+    int n;
+    PhaseResult phases[MAX_RESULTS];
+    // Bytes allocated by the table holding all the entries, the keys and
+    // values included, 0 if allocations are not tracked
+    long long tableBytes;
+    // The operations of the table over all phases but the workloads,
+    // which run on tables of their own, see tablestats.h
+    bool hasStats;
+    TableStats stats;
+} SpeedResults;
+
+/* Fills in the speed test settings from the command line. Prints the
+ * usage and exits for --help and on errors.
+ *  argc, argv   - The arguments given to main.
+ *  config       - The settings to fill in.
+ *  multiBackend - true for the benchmark, which takes --backend and
+ *                 --list, false for the test program, which takes the
+ *                 options for the correctness tests instead. */
+void speedtest_parseArguments(int argc, char *argv[], SpeedConfig *config,
+                              bool multiBackend);
+
+/* Runs the speed test on a table implementation.
+ *  backend - The table implementation.
+ *  config  - The settings for the test.
+ *  results - The measured times are stored here, deallocate them with
+ *            speedtest_freeResults. */
+void speedtest_run(const TableBackend *backend, const SpeedConfig *config,
+                   SpeedResults *results);
+
+/* Prints the results of one or more speed test runs, next to each other,
+ * in the format and to the file given by the settings. Exits if the file
+ * can not be opened.
+ *  config   - The settings the tests were run with.
+ *  backends - The table implementations the tests were run on.
+ *  results  - The results for each implementation.
+ *  n        - The number of implementations. */
+void speedtest_report(const SpeedConfig *config,
+                      const TableBackend *const backends[],
+                      const SpeedResults results[], int n);
+
+/* Opens the file the results are printed to, given by --output.
+ * Exits if the file can not be opened.
+ *  config - The settings.
+ * Returns: The file, or stdout if no file was given. Close it with
+ *          speedtest_closeOutput. */
+FILE *speedtest_openOutput(const SpeedConfig *config);
+
+/* Closes the file opened by speedtest_openOutput.
+ *  out - The file. */
+void speedtest_closeOutput(FILE *out);
+
+/* Returns: The most entries a table holds during the speed test, more
+ *          than the table size when a workload inserts new keys.
+ *  config - The settings for the test. */
+int speedtest_maxEntries(const SpeedConfig *config);
+
+/* Returns: The name of a phase as used by --phases and in the output.
+ *  phase - The index of the phase, as in PhaseResult. */
+const char *speedtest_phaseName(int phase);
+
+/* Deallocates the memory used by the results of a run.
+ *  results - The results. */
+void speedtest_freeResults(SpeedResults *results);
+
+#endif
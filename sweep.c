@@ -0,0 +1,383 @@
+/*
+ * Size sweep for the benchmark, see sweep.h.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nanoclock.h"
+#include "sweep.h"
+
+// Maximum number of sizes in one sweep
+#define MAX_SIZES 128
+// Lookups done in each lookup phase at most, so the large sizes of the
+// O(n) tables finish
+#define MAX_SWEEP_OPS 100000
+
+/* The measurements of one phase at one size */
+typedef struct SweepPoint {
+    int ops;
+    double nsPerOp;
+    bool timed;     // the operations were timed, so p50 to max are set
+    unsigned long long p50;
+    unsigned long long p99;
+    unsigned long long max;
+} SweepPoint;
+
+/* The sweep of one table implementation */
+typedef struct BackendSweep {
+    const TableBackend *backend;
+    int numSizes;
+    int sizes[MAX_SIZES];
+    // The phases are the same at every size, described by the first run
+    int numPhases;
+    int phase[MAX_RESULTS];
+    const char *distribution[MAX_RESULTS];
+    const char *workload[MAX_RESULTS];
+    SweepPoint points[MAX_SIZES][MAX_RESULTS];
+} BackendSweep;
+
+/* The fitted growth of one phase */
+typedef struct Fit {
+    double exponent;    // k in t(n) ~ n^k, NAN if too few sizes
+    double expected;    // the exponent declared by the implementation
+    bool exceeds;
+} Fit;
+
+/* Creates the table sizes of the sweep, spread evenly on log scale
+ *    config - the settings
+ *    sizes - the sizes are stored here
+ * Returns
+ *    the number of sizes
+ */
+static int sweepSizes(const SpeedConfig *config, int sizes[]) {
+    int n = 0;
+    for(int i=0;n<MAX_SIZES;i++) {
+        double size = config->sweepMin*pow(10, (double)i/config->sweepSteps);
+        int rounded = (int)(size+0.5);
+        if (size > config->sweepMax) {
+            // End on the largest size even if it is not a step
+            if (sizes[n-1] < config->sweepMax)
+                sizes[n++] = config->sweepMax;
+            break;
+        }
+        if (n == 0 || rounded > sizes[n-1])
+            sizes[n++] = rounded;
+    }
+    return n;
+}
+
+/* The exponent an implementation declares for a phase
+ *    backend - the implementation
+ *    phase - the index of the phase
+ * Returns
+ *    the exponent of the time per operation
+ */
+static double expectedExponent(const TableBackend *backend, int phase) {
+    const char *name = speedtest_phaseName(phase);
+    // Saving and loading do the same work for every entry
+    if (strcmp(name, "save") == 0 || strcmp(name, "load") == 0)
+        return 0;
+    if (name[0] == 'i')
+        return backend->complexity.insert;
+    if (name[0] == 'r')
+        return backend->complexity.remove;
+    if (name[0] == 'w') {
+        // A mix of lookups, inserts and removes grows like the slowest
+        double k = backend->complexity.lookup;
+        if (backend->complexity.insert > k)
+            k = backend->complexity.insert;
+        if (backend->complexity.remove > k)
+            k = backend->complexity.remove;
+        return k;
+    }
+    return backend->complexity.lookup;
+}
+
+/* Fits the growth exponent of a phase with least squares of
+ * log(ns/op) against log(size), over the larger half of the sizes where
+ * the constant costs matter the least
+ *    s - the sweep
+ *    j - the index of the phase in the sweep
+ *    tolerance - allowed excess over the expected exponent
+ * Returns
+ *    the fit
+ */
+static Fit fitPhase(const BackendSweep *s, int j, double tolerance) {
+    Fit fit = {.exponent = NAN,
+               .expected = expectedExponent(s->backend, s->phase[j])};
+    int first = s->numSizes/2;
+    if (s->numSizes-first < 2)
+        first = s->numSizes-2;
+    if (first < 0)
+        return fit;
+
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int n = 0;
+    for(int i=first;i<s->numSizes;i++) {
+        if (s->points[i][j].nsPerOp <= 0)
+            continue;
+        double x = log(s->sizes[i]);
+        double y = log(s->points[i][j].nsPerOp);
+        sx += x;
+        sy += y;
+        sxx += x*x;
+        sxy += x*y;
+        n++;
+    }
+    if (n < 2)
+        return fit;
+    fit.exponent = (n*sxy-sx*sy)/(n*sxx-sx*sx);
+    fit.exceeds = fit.exponent > fit.expected+tolerance;
+    return fit;
+}
+
+/* Runs the sweep on one table implementation
+ *    config - the settings
+ *    s - the sweep, backend is filled in by the caller
+ *    sizes - the sizes to run
+ *    numSizes - the number of sizes
+ */
+static void sweepBackend(const SpeedConfig *config, BackendSweep *s,
+                         const int sizes[], int numSizes) {
+    double budget = config->budget*1e9;
+    double used = 0, last = 0, prev = 0;
+    s->numSizes = 0;
+
+    for(int i=0;i<numSizes;i++) {
+        int size = sizes[i];
+        SpeedConfig run = *config;
+        SpeedResults results;
+        run.tableSize = size;
+        if (run.numOps == 0)
+            run.numOps = size*2 < MAX_SWEEP_OPS ? size*2 : MAX_SWEEP_OPS;
+        if (s->backend->maxEntries != 0 &&
+            speedtest_maxEntries(&run) > s->backend->maxEntries) {
+            fprintf(stderr, "Sweep of %s stops before %d, it holds at most "
+                    "%d entries\n", s->backend->name, size,
+                    s->backend->maxEntries);
+            break;
+        }
+        // Guess the time of the next size from how the time grew between
+        // the last two, and stop if it would not fit in the budget
+        if (s->numSizes > 0) {
+            double predicted = last*size/s->sizes[s->numSizes-1];
+            if (s->numSizes >= 2 && prev > 0) {
+                double k = log(last/prev)/log((double)s->sizes[s->numSizes-1]
+                                             /s->sizes[s->numSizes-2]);
+                if (k > 1)
+                    predicted = last*pow((double)size/s->sizes[s->numSizes-1],
+                                         k);
+            }
+            if (used+predicted > budget) {
+                fprintf(stderr, "Sweep of %s stops at %d, size %d would "
+                        "take about %.1f s of the budget\n", s->backend->name,
+                        s->sizes[s->numSizes-1], size, predicted/1e9);
+                break;
+            }
+        }
+
+        unsigned long long start = nanoclock_now();
+        speedtest_run(s->backend, &run, &results);
+        prev = last;
+        last = nanoclock_now()-start;
+        used += last;
+
+        s->sizes[s->numSizes] = size;
+        s->numPhases = results.n;
+        for(int j=0;j<results.n;j++) {
+            const PhaseResult *r = &results.phases[j];
+            s->phase[j] = r->phase;
+            s->distribution[j] = r->distribution;
+            s->workload[j] = r->workload;
+            s->points[s->numSizes][j] = (SweepPoint){
+                .ops = r->ops,
+                .nsPerOp = (double)r->ns/r->ops,
+                .timed = histogram_count(r->latency) > 0,
+                .p50 = histogram_percentile(r->latency, 50),
+                .p99 = histogram_percentile(r->latency, 99),
+                .max = histogram_max(r->latency)
+            };
+        }
+        s->numSizes++;
+        speedtest_freeResults(&results);
+    }
+}
+
+/* Prints the sweep of one implementation as text, the time per operation
+ * at each size followed by the fitted exponents
+ *    out - the stream to print to
+ *    s - the sweep
+ *    fits - the fit of each phase
+ */
+static void printText(FILE *out, const BackendSweep *s, const Fit fits[]) {
+    char label[32];
+
+    fprintf(out, "%s, ns per operation\n%10s", s->backend->name, "size");
+    for(int j=0;j<s->numPhases;j++) {
+        if (s->workload[j] != NULL)
+            snprintf(label, sizeof(label), "workload %s", s->workload[j]);
+        else if (s->distribution[j] != NULL)
+            snprintf(label, sizeof(label), "%s", s->distribution[j]);
+        else
+            snprintf(label, sizeof(label), "%s",
+                     speedtest_phaseName(s->phase[j]));
+        fprintf(out, " %12s", label);
+    }
+    fprintf(out, "\n");
+    for(int i=0;i<s->numSizes;i++) {
+        fprintf(out, "%10d", s->sizes[i]);
+        for(int j=0;j<s->numPhases;j++)
+            fprintf(out, " %12.1f", s->points[i][j].nsPerOp);
+        fprintf(out, "\n");
+    }
+    for(int j=0;j<s->numPhases;j++) {
+        fprintf(out, "  %s", speedtest_phaseName(s->phase[j]));
+        if (s->workload[j] != NULL)
+            fprintf(out, " %s", s->workload[j]);
+        if (s->distribution[j] != NULL)
+            fprintf(out, " (%s)", s->distribution[j]);
+        if (isnan(fits[j].exponent))
+            fprintf(out, ": too few sizes to fit\n");
+        else
+            fprintf(out, ": n^%.2f per operation, expected n^%g%s\n",
+                    fits[j].exponent, fits[j].expected,
+                    fits[j].exceeds ? "  EXCEEDS" : "");
+    }
+    fprintf(out, "\n");
+}
+
+/* Prints the points of the sweep of one implementation as CSV rows
+ *    out - the stream to print to
+ *    config - the settings
+ *    s - the sweep
+ */
+static void printCsv(FILE *out, const SpeedConfig *config,
+                     const BackendSweep *s) {
+    for(int j=0;j<s->numPhases;j++) {
+        for(int i=0;i<s->numSizes;i++) {
+            const SweepPoint *p = &s->points[i][j];
+            fprintf(out, "%s,%s,%s,%s,%d,%d,%s,%.2f",
+                    s->backend->name, speedtest_phaseName(s->phase[j]),
+                    s->distribution[j] != NULL ? s->distribution[j] : "",
+                    s->workload[j] != NULL ? s->workload[j] : "",
+                    s->sizes[i], p->ops,
+                    config->keyType == KEY_STRING ? "string" : "int",
+                    p->nsPerOp);
+            // The phases timed as a whole have no latencies
+            if (p->timed)
+                fprintf(out, ",%llu,%llu,%llu\n", p->p50, p->p99, p->max);
+            else
+                fprintf(out, ",,,\n");
+        }
+    }
+}
+
+/* Prints the fitted exponents of one implementation, as CSV rows on
+ * stderr in the CSV output so the points can be plotted directly
+ *    out - the stream to print to
+ *    s - the sweep
+ *    fits - the fit of each phase
+ */
+static void printFitsCsv(FILE *out, const BackendSweep *s, const Fit fits[]) {
+    for(int j=0;j<s->numPhases;j++)
+        fprintf(out, "%s,%s,%s,%s,%.3f,%g,%d\n", s->backend->name,
+                speedtest_phaseName(s->phase[j]),
+                s->distribution[j] != NULL ? s->distribution[j] : "",
+                s->workload[j] != NULL ? s->workload[j] : "",
+                fits[j].exponent, fits[j].expected, fits[j].exceeds);
+}
+
+/* Prints the sweep of one implementation as a JSON object
+ *    out - the stream to print to
+ *    s - the sweep
+ *    fits - the fit of each phase
+ */
+static void printJson(FILE *out, const BackendSweep *s, const Fit fits[]) {
+    fprintf(out, "{\"name\": \"%s\", \"sizes\": [", s->backend->name);
+    for(int i=0;i<s->numSizes;i++)
+        fprintf(out, "%s%d", i ? ", " : "", s->sizes[i]);
+    fprintf(out, "], \"phases\": [");
+    for(int j=0;j<s->numPhases;j++) {
+        fprintf(out, "%s\n    {\"phase\": \"%s\"", j ? "," : "",
+                speedtest_phaseName(s->phase[j]));
+        if (s->distribution[j] != NULL)
+            fprintf(out, ", \"distribution\": \"%s\"", s->distribution[j]);
+        if (s->workload[j] != NULL)
+            fprintf(out, ", \"workload\": \"%s\"", s->workload[j]);
+        fprintf(out, ", \"ns_per_op\": [");
+        for(int i=0;i<s->numSizes;i++)
+            fprintf(out, "%s%.2f", i ? ", " : "", s->points[i][j].nsPerOp);
+        fprintf(out, "], \"p99_ns\": [");
+        for(int i=0;i<s->numSizes;i++) {
+            if (s->points[i][j].timed)
+                fprintf(out, "%s%llu", i ? ", " : "", s->points[i][j].p99);
+            else
+                fprintf(out, "%snull", i ? ", " : "");
+        }
+        fprintf(out, "], ");
+        if (isnan(fits[j].exponent))
+            fprintf(out, "\"exponent\": null");
+        else
+            fprintf(out, "\"exponent\": %.3f", fits[j].exponent);
+        fprintf(out, ", \"expected\": %g, \"exceeds\": %s}",
+                fits[j].expected, fits[j].exceeds ? "true" : "false");
+    }
+    fprintf(out, "\n  ]}");
+}
+
+int sweep_run(const SpeedConfig *config,
+              const TableBackend *const backends[], int n) {
+    int sizes[MAX_SIZES];
+    int numSizes = sweepSizes(config, sizes);
+    int exceeded = 0;
+    FILE *out = speedtest_openOutput(config);
+    // Large enough to be kept off the stack
+    BackendSweep *s = malloc(sizeof(BackendSweep));
+
+    if (config->format == FORMAT_CSV) {
+        fprintf(out, "backend,phase,distribution,workload,size,ops,key_type,"
+                "ns_per_op,p50_ns,p99_ns,max_ns\n");
+        fprintf(stderr, "backend,phase,distribution,workload,exponent,"
+                "expected,exceeds\n");
+    } else if (config->format == FORMAT_JSON) {
+        fprintf(out, "{\"tolerance\": %g, \"backends\": [",
+                config->tolerance);
+    }
+
+    // Every implementation is printed as soon as its sweep is done, since
+    // the whole sweep may take long
+    for(int b=0;b<n;b++) {
+        Fit fits[MAX_RESULTS];
+        s->backend = backends[b];
+        sweepBackend(config, s, sizes, numSizes);
+        for(int j=0;j<s->numPhases;j++) {
+            fits[j] = fitPhase(s, j, config->tolerance);
+            if (fits[j].exceeds)
+                exceeded++;
+        }
+        switch (config->format) {
+        case FORMAT_TEXT:
+            printText(out, s, fits);
+            break;
+        case FORMAT_CSV:
+            printCsv(out, config, s);
+            printFitsCsv(stderr, s, fits);
+            break;
+        case FORMAT_JSON:
+            fprintf(out, "%s\n  ", b ? "," : "");
+            printJson(out, s, fits);
+            break;
+        }
+        fflush(out);
+    }
+
+    if (config->format == FORMAT_JSON)
+        fprintf(out, "\n]}\n");
+    else if (config->format == FORMAT_TEXT && exceeded > 0)
+        fprintf(out, "%d phase(s) grow faster than expected\n", exceeded);
+    free(s);
+    speedtest_closeOutput(out);
+    return exceeded;
+}
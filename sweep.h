@@ -0,0 +1,31 @@
+/*
+ * Size sweep for the benchmark.
+ *
+ * Runs the speed test on each table implementation at a series of table
+ * sizes growing geometrically, by default 10^2 to 10^7 with one size per
+ * decade, until the largest size or the time budget of the implementation
+ * is reached. For every phase the growth exponent k of the time per
+ * operation, t(n) ~ n^k, is fitted with least squares on log-log scale
+ * over the larger half of the sizes. Phases whose exponent exceeds the
+ * complexity the implementation declares in its TableBackend by more than
+ * the tolerance are flagged, which catches for example an O(n) lookup in
+ * a table meant to be O(1), or a remove that makes removing all entries
+ * O(n^2) when it should be O(n).
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "speedtest.h"
+
+/* Runs the size sweep and prints the time per operation at each size
+ * (CSV with --format csv, plottable with one line per backend and phase)
+ * followed by the fitted exponents.
+ *  config   - The settings, the sweep* fields decide the sizes.
+ *  backends - The table implementations to sweep.
+ *  n        - The number of implementations.
+ * Returns: The number of phases whose growth exceeds the declared bound. */
+int sweep_run(const SpeedConfig *config,
+              const TableBackend *const backends[], int n);
+
+#endif
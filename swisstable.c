@@ -0,0 +1,445 @@
+/*
+ * The table as an open addressing hash table with control bytes, in the
+ * style of the Swiss tables of Abseil.
+ *
+ * Every slot has a control byte, kept apart from the keys and values.
+ * The byte of a slot in use holds 7 bits of the hash of its key, the
+ * other bytes mark the slot as empty or deleted. The slots are probed a
+ * group of SWISS_GROUP at a time: the control bytes of a group are
+ * loaded into an SSE2 register and compared with the 7 bits of the key
+ * in one instruction, and the compare function is only called for the
+ * slots that match, about one in 128 of the others. A lookup ends at the
+ * first group with an empty slot, so most misses read a single group of
+ * control bytes. The groups are visited in triangular order, which
+ * visits every group of the table once.
+ *
+ * The table holds up to 7/8 of its slots, with one control byte of
+ * overhead per slot. A removed entry only leaves a deleted mark when its
+ * group is full, since a lookup can only have passed a full group. The
+ * table is rebuilt when it runs out of empty slots, at twice the size or,
+ * if deleted marks take up the room, at the same size.
+ *
+ * The keys are hashed with the function from table_setHashFunction,
+ * which has to be set before the first insert. Its hashes are mixed
+ * before the group and the 7 bits are taken from them, since the group
+ * comes from the low bits and the 7 bits from the high ones, which a
+ * weak hash function may leave the same for many keys. A key that is
+ * inserted again replaces the old entry.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "table.h"
+
+// Slots probed together, the control bytes of a group fill an SSE2
+// register
+#define SWISS_GROUP 16
+// Control byte of a slot that has never been used since the table was
+// built
+#define SWISS_EMPTY ((int8_t)0x80)
+// Control byte of a slot whose entry was removed
+#define SWISS_DELETED ((int8_t)0xfe)
+// Slots of a new table
+#define SWISS_MIN_CAPACITY SWISS_GROUP
+
+typedef struct SwissEntry {
+    KEY key;
+    VALUE value;
+} SwissEntry;
+
+typedef struct SwissTable {
+    int8_t *ctrl;               // the control bytes, one per slot
+    SwissEntry *entries;
+    size_t capacity;            // slots, a power of two
+    size_t size;
+    size_t growthLeft;          // empty slots that can still be used
+    CompareFunction *cf;
+    HashFunction *hash;
+    KeyFreeFunc *keyFree;
+    ValueFreeFunc *valueFree;
+    TableStats stats;
+} SwissTable;
+
+/* Hashes a key with the hash function of the table and mixes the bits of
+ * the hash with the finalizer of MurmurHash3
+ *    t - the table
+ *    key - the key
+ * Returns
+ *    the hash
+ */
+static uint64_t hashOf(const SwissTable *t, KEY key) {
+    uint64_t h = t->hash(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* Returns the 7 bits of a hash stored in the control byte
+ *    h - the hash of a key
+ */
+static int8_t h2(uint64_t h) {
+    return h >> 57;
+}
+
+/* Returns the group a key is looked for in first
+ *    t - the table
+ *    h - the hash of the key
+ */
+static size_t firstGroup(const SwissTable *t, uint64_t h) {
+    return h & (t->capacity/SWISS_GROUP-1);
+}
+
+/* Finds the slots of a group with a control byte
+ *    ctrl - the control bytes of the group
+ *    byte - the control byte
+ * Returns
+ *    bit i set if slot i has the byte
+ */
+static unsigned int matchByte(const int8_t *ctrl, int8_t byte) {
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(byte)));
+#else
+    unsigned int mask = 0;
+    for(int i=0;i<SWISS_GROUP;i++) {
+        if (ctrl[i] == byte)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+/* Finds the slots of a group that are empty or deleted
+ *    ctrl - the control bytes of the group
+ * Returns
+ *    bit i set if slot i is free
+ */
+static unsigned int matchFree(const int8_t *ctrl) {
+#ifdef __SSE2__
+    // Only the free slots have the top bit set
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    unsigned int mask = 0;
+    for(int i=0;i<SWISS_GROUP;i++) {
+        if (ctrl[i] < 0)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+/* Finds the slot of a key
+ *    t - the table
+ *    key - the key
+ *    h - the hash of the key
+ *    count - true if the search is a lookup, counted in the statistics
+ * Returns
+ *    the index of the slot, -1 if the key is not in the table
+ */
+static long findSlot(SwissTable *t, KEY key, uint64_t h, bool count) {
+    size_t groupMask = t->capacity/SWISS_GROUP-1;
+    size_t g = firstGroup(t, h);
+    int8_t tag = h2(h);
+    unsigned long long compares = 0;
+    for(size_t probe=1;;probe++) {
+        const int8_t *ctrl = t->ctrl+g*SWISS_GROUP;
+        unsigned int mask = matchByte(ctrl, tag);
+        while (mask != 0) {
+            long slot = g*SWISS_GROUP + __builtin_ctz(mask);
+            mask &= mask-1;
+            compares++;
+            if (t->cf(t->entries[slot].key, key) == 0) {
+                if (count) {
+                    tablestats_lookup(&t->stats, true, compares);
+                    tablestats_probes(&t->stats, probe);
+                }
+                return slot;
+            }
+        }
+        // There is always an empty slot somewhere, since the table is
+        // never more than 7/8 full
+        if (matchByte(ctrl, SWISS_EMPTY) != 0) {
+            if (count) {
+                tablestats_lookup(&t->stats, false, compares);
+                tablestats_probes(&t->stats, probe);
+            }
+            return -1;
+        }
+        g = (g+probe) & groupMask;
+    }
+}
+
+/* Finds the first free slot for a key, which is not in the table
+ *    t - the table
+ *    h - the hash of the key
+ * Returns
+ *    the index of the slot
+ */
+static size_t findFree(const SwissTable *t, uint64_t h) {
+    size_t groupMask = t->capacity/SWISS_GROUP-1;
+    size_t g = firstGroup(t, h);
+    for(size_t probe=1;;probe++) {
+        unsigned int mask = matchFree(t->ctrl+g*SWISS_GROUP);
+        if (mask != 0)
+            return g*SWISS_GROUP + __builtin_ctz(mask);
+        g = (g+probe) & groupMask;
+    }
+}
+
+/* Allocates empty slots
+ *    t - the table
+ *    capacity - the number of slots, a power of two of at least
+ *               SWISS_GROUP
+ */
+static void allocateSlots(SwissTable *t, size_t capacity) {
+    t->capacity = capacity;
+    t->ctrl = malloc(capacity);
+    memset(t->ctrl, SWISS_EMPTY, capacity);
+    t->entries = malloc(capacity*sizeof(SwissEntry));
+    t->growthLeft = capacity/8*7-t->size;
+}
+
+/* Puts an entry in a free slot, the key is not in the table and there is
+ * an empty slot to spare
+ *    t - the table
+ *    e - the entry
+ *    h - the hash of the key
+ */
+static void place(SwissTable *t, const SwissEntry *e, uint64_t h) {
+    size_t slot = findFree(t, h);
+    if (t->ctrl[slot] == SWISS_EMPTY)
+        t->growthLeft--;
+    t->ctrl[slot] = h2(h);
+    t->entries[slot] = *e;
+}
+
+/* Moves the entries to new slots, leaving out the deleted marks
+ *    t - the table
+ *    capacity - the number of new slots
+ */
+static void rebuild(SwissTable *t, size_t capacity) {
+    int8_t *oldCtrl = t->ctrl;
+    SwissEntry *oldEntries = t->entries;
+    size_t oldCapacity = t->capacity;
+    allocateSlots(t, capacity);
+    t->growthLeft += t->size;
+    for(size_t slot=0;slot<oldCapacity;slot++) {
+        if (oldCtrl[slot] >= 0)
+            place(t, &oldEntries[slot], hashOf(t, oldEntries[slot].key));
+    }
+    free(oldCtrl);
+    free(oldEntries);
+}
+
+/* Creates a table.
+ *  compare_function - Pointer to a function that is called for comparing
+ *                     two keys. The function should return <0 if the left
+ *                     parameter is smaller than the right parameter, 0 if
+ *                     the parameters are equal, and >0 if the left
+ *                     parameter is larger than the right item.
+ * Returns: A pointer to the table. NULL if creation of the table failed. */
+Table *table_create(CompareFunction *compare_function) {
+    SwissTable *t = calloc(1, sizeof(SwissTable));
+    t->cf = compare_function;
+    allocateSlots(t, SWISS_MIN_CAPACITY);
+    return t;
+}
+
+/* Install a memory handling function responsible for removing a key when
+ * removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by keys inserted into the table*/
+void table_setKeyMemHandler(Table *table, KeyFreeFunc *freeFunc) {
+    SwissTable *t = table;
+    t->keyFree = freeFunc;
+}
+
+/* Install a memory handling function responsible for removing a value
+ * when removed from the table
+ *  table - Pointer to the table.
+ *  freeFunc- Pointer to a function that is called for  freeing all
+ *                     the memory used by values inserted into the table*/
+void table_setValueMemHandler(Table *table, ValueFreeFunc *freeFunc) {
+    SwissTable *t = table;
+    t->valueFree = freeFunc;
+}
+
+/* Install the function hashing the keys, needed before the first
+ * insert.
+ *  table - Pointer to the table.
+ *  hash  - Pointer to the hash function. */
+void table_setHashFunction(Table *table, HashFunction *hash) {
+    SwissTable *t = table;
+    t->hash = hash;
+}
+
+/* The keys are hashed, so the bytes of the keys are not used */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes) {
+    (void)table;
+    (void)bytes;
+}
+
+/* Determines if the table is empty.
+ *  table - Pointer to the table.
+ * Returns: false if the table is not empty, true if it is. */
+bool table_isEmpty(Table *table) {
+    SwissTable *t = table;
+    return t->size == 0;
+}
+
+/* Inserts a key and value pair into the table, replacing the entry of
+ * the key if it is already in the table.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the key.
+ *  value - Pointer to the value.
+ */
+void table_insert(Table *table, KEY key, VALUE value) {
+    SwissTable *t = table;
+    uint64_t h = hashOf(t, key);
+    tablestats_insert(&t->stats);
+
+    long slot = findSlot(t, key, h, false);
+    if (slot >= 0) {
+        SwissEntry *old = &t->entries[slot];
+        if (t->keyFree != NULL)
+            t->keyFree(old->key);
+        if (t->valueFree != NULL)
+            t->valueFree(old->value);
+        old->key = key;
+        old->value = value;
+        return;
+    }
+
+    if (t->growthLeft == 0) {
+        // Deleted marks take up more than half of the room if the
+        // entries fit in half of the slots, then the same size will do
+        size_t capacity = t->size+1 > t->capacity/16*7 ? 2*t->capacity :
+                                                         t->capacity;
+        rebuild(t, capacity);
+    }
+    SwissEntry e = {key, value};
+    place(t, &e, h);
+    t->size++;
+}
+
+/* Finds a value given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ * Returns: Pointer to the item's value if the lookup succeded. NULL if the
+ *          lookup failed. */
+VALUE table_lookup(Table *table, KEY key) {
+    SwissTable *t = table;
+    long slot = findSlot(t, key, hashOf(t, key), true);
+    return slot >= 0 ? t->entries[slot].value : NULL;
+}
+
+/* Removes an item from the table given its key.
+ *  table - Pointer to the table.
+ *  key   - Pointer to the item's key.
+ */
+void table_remove(Table *table, KEY key) {
+    SwissTable *t = table;
+    tablestats_remove(&t->stats);
+    long slot = findSlot(t, key, hashOf(t, key), false);
+    if (slot < 0)
+        return;
+    SwissEntry *e = &t->entries[slot];
+    if (t->keyFree != NULL)
+        t->keyFree(e->key);
+    if (t->valueFree != NULL)
+        t->valueFree(e->value);
+    // A lookup never went past a group with an empty slot, so no key
+    // depends on this slot being in use
+    const int8_t *group = t->ctrl+slot/SWISS_GROUP*SWISS_GROUP;
+    if (matchByte(group, SWISS_EMPTY) != 0) {
+        t->ctrl[slot] = SWISS_EMPTY;
+        t->growthLeft++;
+    } else {
+        t->ctrl[slot] = SWISS_DELETED;
+    }
+    t->size--;
+}
+
+/* Destroys a table, deallocating all the memory it uses.
+ *  table - Pointer to the table. After the function completes this pointer
+ *          will be invalid for further use. */
+void table_free(Table *table) {
+    SwissTable *t = table;
+    for(size_t slot=0;slot<t->capacity;slot++) {
+        if (t->ctrl[slot] < 0)
+            continue;
+        if (t->keyFree != NULL)
+            t->keyFree(t->entries[slot].key);
+        if (t->valueFree != NULL)
+            t->valueFree(t->entries[slot].value);
+    }
+    free(t->ctrl);
+    free(t->entries);
+    free(t);
+}
+
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h. The probes are the groups a lookup looked in. */
+bool table_getStats(Table *table, TableStats *stats) {
+    SwissTable *t = table;
+    return tablestats_get(&t->stats, stats);
+}
+
+/* Saves the entries to a snapshot file in the order of the slots. */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values) {
+    SwissTable *t = table;
+    SnapshotWriter *w = snapshot_openWriter(path, keys, values);
+    if (w == NULL)
+        return false;
+    for(size_t slot=0;slot<t->capacity;slot++) {
+        if (t->ctrl[slot] >= 0)
+            snapshot_write(w, t->entries[slot].key, t->entries[slot].value);
+    }
+    return snapshot_closeWriter(w);
+}
+
+/* Creates a table from a snapshot file, hashed with the hash function of
+ * the key serializer. The slots are allocated for all entries at once,
+ * so the table is never rebuilt while it is loaded. Of duplicate keys,
+ * which the list tables may save, the first one is kept and the others
+ * are deallocated with free. */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values) {
+    if (keys->hash == NULL)
+        return NULL;
+    SnapshotReader *r = snapshot_openReader(path, keys, values);
+    if (r == NULL)
+        return NULL;
+    SwissTable *t = calloc(1, sizeof(SwissTable));
+    t->cf = compare_function;
+    t->hash = keys->hash;
+    size_t capacity = SWISS_MIN_CAPACITY;
+    while (snapshot_count(r) > capacity/8*7)
+        capacity *= 2;
+    allocateSlots(t, capacity);
+
+    SwissEntry e;
+    while (snapshot_read(r, &e.key, &e.value)) {
+        uint64_t h = hashOf(t, e.key);
+        if (findSlot(t, e.key, h, false) >= 0) {
+            free(e.key);
+            free(e.value);
+            continue;
+        }
+        place(t, &e, h);
+        t->size++;
+    }
+    snapshot_closeReader(r);
+    // Building the table is not counted as lookups
+    memset(&t->stats, 0, sizeof(t->stats));
+    return t;
+}
@@ -0,0 +1,45 @@
+/*
+ * Registry of table implementations for the benchmarks, see
+ * tablebackend.h. New implementations are added with a backend_*.c file
+ * and an entry in tablebackend_all.
+ */
+
+#include <string.h>
+#include "tablebackend.h"
+
+extern const TableBackend dlisttable_backend;
+extern const TableBackend mtftable_backend;
+extern const TableBackend arraytable_backend;
+extern const TableBackend cuckootable_backend;
+extern const TableBackend swisstable_backend;
+extern const TableBackend robinhoodtable_backend;
+extern const TableBackend chainedtable_backend;
+extern const TableBackend chainedinctable_backend;
+extern const TableBackend adaptivetable_backend;
+extern const TableBackend lrutable_backend;
+extern const TableBackend arttable_backend;
+extern const TableBackend rcutable_backend;
+
+const TableBackend *const tablebackend_all[] = {
+    &dlisttable_backend,
+    &mtftable_backend,
+    &arraytable_backend,
+    &cuckootable_backend,
+    &swisstable_backend,
+    &robinhoodtable_backend,
+    &chainedtable_backend,
+    &chainedinctable_backend,
+    &adaptivetable_backend,
+    &lrutable_backend,
+    &arttable_backend,
+    &rcutable_backend,
+    NULL
+};
+
+const TableBackend *tablebackend_find(const char *name) {
+    for(int i=0;tablebackend_all[i]!=NULL;i++) {
+        if (strcmp(tablebackend_all[i]->name, name) == 0)
+            return tablebackend_all[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,86 @@
+/*
+ * Registry of table implementations for the benchmarks.
+ *
+ * Every table implementation (table.c, mtftable.c, arraytable.c, ...)
+ * defines the functions in table.h under the same names, so only one of
+ * them can be linked into a program. To let the benchmark compare them in
+ * a single run each implementation is also compiled through a small
+ * backend_*.c file that renames its functions with tablerename.h and
+ * describes it with a TableBackend. The implementations themselves are
+ * unchanged and can still be built on their own with the test program.
+ */
+
+#ifndef TABLEBACKEND_H
+#define TABLEBACKEND_H
+
+#include "table.h"
+
+/* Declared growth of the time per operation of a table implementation,
+ * as the exponent k in O(n^k) for a table with n entries. O(1) is 0, O(n)
+ * is 1 and O(log n) is close enough to 0. The size sweep of the benchmark
+ * flags implementations whose measured growth is larger. */
+typedef struct TableComplexity {
+    double insert;
+    double lookup;      // both for existing and non-existing keys
+    double remove;
+} TableComplexity;
+
+/* The table.h functions of one table implementation */
+typedef struct TableBackend {
+    const char *name;
+    Table *(*create)(CompareFunction *compare_function);
+    void (*setKeyMemHandler)(Table *table, KeyFreeFunc *freeFunc);
+    void (*setValueMemHandler)(Table *table, ValueFreeFunc *freeFunc);
+    void (*setHashFunction)(Table *table, HashFunction *hash);
+    void (*setKeyBytesFunction)(Table *table, KeyBytesFunction *bytes);
+    bool (*isEmpty)(Table *table);
+    void (*insert)(Table *table, KEY key, VALUE value);
+    VALUE (*lookup)(Table *table, KEY key);
+    void (*remove)(Table *table, KEY key);
+    void (*free)(Table *table);
+    bool (*getStats)(Table *table, TableStats *stats);
+    bool (*save)(Table *table, const char *path, const TableSerializer *keys,
+                 const TableSerializer *values);
+    Table *(*load)(const char *path, CompareFunction *compare_function,
+                   const TableSerializer *keys,
+                   const TableSerializer *values);
+    int maxEntries;     // most entries the table can hold, 0 if unbounded
+    TableComplexity complexity;
+    bool threadSafe;    // the functions may be called from several threads
+                        // at once, otherwise they are serialized by a lock
+} TableBackend;
+
+/* Designated initializers for the TableBackend functions from the table.h
+ * functions in scope, used by the backend_*.c files after including an
+ * implementation, for example
+ *
+ *   const TableBackend mtftable_backend = {
+ *       .name = "mtf",
+ *       TABLE_BACKEND_FUNCTIONS,
+ *       .complexity = {.insert = 0, .lookup = 1, .remove = 1}
+ *   };
+ */
+#define TABLE_BACKEND_FUNCTIONS \
+    .create = table_create, \
+    .setKeyMemHandler = table_setKeyMemHandler, \
+    .setValueMemHandler = table_setValueMemHandler, \
+    .setHashFunction = table_setHashFunction, \
+    .setKeyBytesFunction = table_setKeyBytesFunction, \
+    .isEmpty = table_isEmpty, \
+    .insert = table_insert, \
+    .lookup = table_lookup, \
+    .remove = table_remove, \
+    .free = table_free, \
+    .getStats = table_getStats, \
+    .save = table_save, \
+    .load = table_load
+
+/* All registered implementations, terminated by NULL */
+extern const TableBackend *const tablebackend_all[];
+
+/* Finds a registered implementation by name.
+ *  name - The name of the implementation.
+ * Returns: The implementation, NULL if there is none with the name. */
+const TableBackend *tablebackend_find(const char *name);
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * Renames the table.h functions to TABLE_PREFIX_create, ... so that a
+ * table implementation can be linked together with other ones, see
+ * tablebackend.h. Define TABLE_PREFIX and include this file before the
+ * implementation, for example
+ *
+ *   #define TABLE_PREFIX mtftable
+ *   #include "tablerename.h"
+ *   #include "mtftable.c"
+ */
+
+#ifndef TABLE_PREFIX
+#error "TABLE_PREFIX must be defined before including tablerename.h"
+#endif
+
+#define TABLE_RENAME_(prefix, name) prefix##_##name
+#define TABLE_RENAME(prefix, name) TABLE_RENAME_(prefix, name)
+
+#define table_create TABLE_RENAME(TABLE_PREFIX, create)
+#define table_setKeyMemHandler TABLE_RENAME(TABLE_PREFIX, setKeyMemHandler)
+#define table_setValueMemHandler TABLE_RENAME(TABLE_PREFIX, setValueMemHandler)
+#define table_setHashFunction TABLE_RENAME(TABLE_PREFIX, setHashFunction)
+#define table_setKeyBytesFunction \
+    TABLE_RENAME(TABLE_PREFIX, setKeyBytesFunction)
+#define table_isEmpty TABLE_RENAME(TABLE_PREFIX, isEmpty)
+#define table_insert TABLE_RENAME(TABLE_PREFIX, insert)
+#define table_lookup TABLE_RENAME(TABLE_PREFIX, lookup)
+#define table_remove TABLE_RENAME(TABLE_PREFIX, remove)
+#define table_free TABLE_RENAME(TABLE_PREFIX, free)
+#define table_getStats TABLE_RENAME(TABLE_PREFIX, getStats)
+#define table_save TABLE_RENAME(TABLE_PREFIX, save)
+#define table_load TABLE_RENAME(TABLE_PREFIX, load)
@@ -0,0 +1,149 @@
+/*
+ * Operation statistics kept by the table implementations.
+ *
+ * Every table keeps a TableStats block, read with table_getStats. The
+ * counters are only updated when the program is compiled with
+ * -DTABLE_STATS. They are plain increments in the table's own memory, so
+ * they are cheap enough to leave on, and without the flag the functions
+ * below are empty and the compiler removes them and the counting in the
+ * loops that feeds them. The counters are not atomic, a table that is
+ * used from several threads counts approximately.
+ */
+
+#ifndef TABLESTATS_H
+#define TABLESTATS_H
+
+#include <stdbool.h>
+
+/* The operations a table has done since it was created, and for some
+ * tables how the entries are laid out. Members an implementation has no
+ * use for stay 0. */
+typedef struct TableStats {
+    unsigned long long lookups;
+    unsigned long long hits;            // lookups that found their key
+    unsigned long long misses;          // lookups that did not
+    unsigned long long compares;        // comparator calls of the lookups
+    unsigned long long maxCompares;     // most calls in one lookup
+    unsigned long long inserts;
+    unsigned long long removes;
+    unsigned long long moves;           // entries moved to the front
+    unsigned long long probes;          // slots probed by the lookups of
+                                        // hash tables
+    unsigned long long maxProbes;       // most slots probed in one lookup
+    unsigned long long depth;           // nodes visited by the lookups of
+                                        // trees
+    unsigned long long maxDepth;        // most nodes visited in one lookup
+    // The state of open addressing tables when the statistics were read
+    unsigned long long entries;         // entries in the table
+    unsigned long long displacement;    // summed distance of the entries
+                                        // from their home slots
+    unsigned long long maxDisplacement; // longest distance
+} TableStats;
+
+/* Returns: true if the program counts the operations of the tables. */
+static inline bool tablestats_enabled(void) {
+#ifdef TABLE_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/* Counts a lookup.
+ *  stats    - The statistics of the table.
+ *  hit      - The key was found.
+ *  compares - The comparator calls of the lookup. */
+static inline void tablestats_lookup(TableStats *stats, bool hit,
+                                     unsigned long long compares) {
+#ifdef TABLE_STATS
+    stats->lookups++;
+    if (hit)
+        stats->hits++;
+    else
+        stats->misses++;
+    stats->compares += compares;
+    if (compares > stats->maxCompares)
+        stats->maxCompares = compares;
+#else
+    (void)stats;
+    (void)hit;
+    (void)compares;
+#endif
+}
+
+/* Counts the slots a lookup in a hash table probed.
+ *  stats  - The statistics of the table.
+ *  probes - The number of slots. */
+static inline void tablestats_probes(TableStats *stats,
+                                     unsigned long long probes) {
+#ifdef TABLE_STATS
+    stats->probes += probes;
+    if (probes > stats->maxProbes)
+        stats->maxProbes = probes;
+#else
+    (void)stats;
+    (void)probes;
+#endif
+}
+
+/* Counts the nodes a lookup in a tree visited.
+ *  stats - The statistics of the table.
+ *  depth - The number of nodes. */
+static inline void tablestats_depth(TableStats *stats,
+                                    unsigned long long depth) {
+#ifdef TABLE_STATS
+    stats->depth += depth;
+    if (depth > stats->maxDepth)
+        stats->maxDepth = depth;
+#else
+    (void)stats;
+    (void)depth;
+#endif
+}
+
+/* Counts an insert.
+ *  stats - The statistics of the table. */
+static inline void tablestats_insert(TableStats *stats) {
+#ifdef TABLE_STATS
+    stats->inserts++;
+#else
+    (void)stats;
+#endif
+}
+
+/* Counts a remove.
+ *  stats - The statistics of the table. */
+static inline void tablestats_remove(TableStats *stats) {
+#ifdef TABLE_STATS
+    stats->removes++;
+#else
+    (void)stats;
+#endif
+}
+
+/* Counts an entry moved to the front of the table.
+ *  stats - The statistics of the table. */
+static inline void tablestats_move(TableStats *stats) {
+#ifdef TABLE_STATS
+    stats->moves++;
+#else
+    (void)stats;
+#endif
+}
+
+/* Copies the statistics of a table for table_getStats.
+ *  stats - The statistics of the table.
+ *  copy  - The copy, all 0 if the operations are not counted.
+ * Returns: true if the operations are counted. */
+static inline bool tablestats_get(const TableStats *stats, TableStats *copy) {
+#ifdef TABLE_STATS
+    *copy = *stats;
+    return true;
+#else
+    (void)stats;
+    *copy = (TableStats){0};
+    return false;
+#endif
+}
+
+#endif
@@ -0,0 +1,293 @@
+/*
+ * Helpers for creating the keys and values used by the test program and
+ * the benchmarks, see testkeys.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "testkeys.h"
+
+
+/* Helper function to allocate for string and fill it with content.
+ * The size should be of the content. The pointer returned contains
+ * size+1 chars and is null-terminated.
+ *
+ * Warning: Only checks if size < 1. Unsafe, do not reuse. 
+ * Author: dali vt17
+ */
+char *buildString(const char *content, int size) {
+    /* Content with no size makes no sense */
+    if (size < 1)
+        return NULL;
+
+    /* Allocate new string for content, with an extra char for \0 */
+    char *string = malloc(sizeof(char)*(size+1));
+
+    /* Malloc failed, return nothing */
+    if (string == NULL)
+        return NULL;
+
+    /* Copy content to new memory */
+    strncpy(string, content, size);
+
+    /* Strings should be null terminated */
+    string[size] = '\0';
+    return string;
+}
+
+/* Helper function to allocate memory for and initialize a integer pointer
+ * the value pointed to will be i
+ *   i the value to point at
+ * Returns
+ *   a int pointer to i
+ */
+int *intPtrFromInt(int i){
+    int *ip=malloc(sizeof(int));
+    *ip=i;
+    return ip;
+}
+
+/*Compare function used to compare two int values (pointed to by ip and ip2) are equal
+ * ip, ip2 - pointers to two integers
+ * Returns
+ *    0 if values are equal, nonzero otherwize
+ */
+int compareInt(void *ip,void *ip2){
+    return (*(int*)ip) - (*(int*)ip2);
+}
+
+/*Compare function used to compare two string values (pointed to by ip and ip2) are equal
+ * ip, ip2 - pointers to two integers
+ * Returns
+ *    0 if values are equal, nonzero otherwize
+ */
+int compareString(void *ip,void *ip2){
+    return strcmp((char*)ip, (char*)ip2);
+}
+
+/* Spreads the bits of a number over the whole hash, the finalizer of
+ * splitmix64, so the tables can use any of the bits
+ *    x - the number
+ * Returns
+ *    the mixed number
+ */
+static unsigned long long mix(unsigned long long x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/* Hash function for keys pointing to ints
+ *    ip - pointer to the integer
+ * Returns
+ *    the hash
+ */
+unsigned long long hashInt(void *ip){
+    return mix((unsigned int)*(int*)ip);
+}
+
+/* Hash function for keys pointing to strings, FNV-1a of the characters
+ *    ip - pointer to the string
+ * Returns
+ *    the hash
+ */
+unsigned long long hashString(void *ip){
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    for(const unsigned char *c=ip;*c!='\0';c++) {
+        hash ^= *c;
+        hash *= 0x100000001b3ULL;
+    }
+    return mix(hash);
+}
+
+/* Key bytes function for keys pointing to ints
+ *    ip - pointer to the integer
+ *    bytes - pointed at the bytes of the integer
+ * Returns
+ *    the number of bytes
+ */
+size_t keyBytesInt(void *ip, const unsigned char **bytes) {
+    *bytes = ip;
+    return sizeof(int);
+}
+
+/* Key bytes function for keys pointing to strings
+ *    ip - pointer to the string
+ *    bytes - pointed at the characters of the string
+ * Returns
+ *    the number of characters, without the terminating null
+ */
+size_t keyBytesString(void *ip, const unsigned char **bytes) {
+    *bytes = ip;
+    return strlen(ip);
+}
+
+/* Shuffles the numbers stored in seq, with Fisher-Yates so that every
+ * order is equally likely
+ *    seq - an array of randomnumbers to be shuffled
+ *    n - the number of elements in seq to shuffle, i.e the indexes [0, n] 
+ *        will be shuffled. However, seq might be larger than n...
+ *    rng - the random numbers to shuffle with
+ */
+void randomshuffle(int seq[], int n, Rng *rng) {
+    for(int i=n-1;i>0;i--) {
+        int switchPos=rng_below(rng, i+1);
+        if(i!=switchPos) {
+            int temp=seq[i];
+            seq[i]=seq[switchPos];
+            seq[switchPos]=temp;
+        }
+    }
+}
+
+/* Generate n unique random numbers. The numbers will be stored i seq
+ *    seq - an array of randomnumbers created in the function
+ *    n - the number of elements in seq
+ *    rng - the random numbers to shuffle with
+ */
+void createRandomSample(int seq[], int n, Rng *rng) {
+    for(int i=0;i<n;i++) {
+        seq[i]=i;
+    }
+    randomshuffle(seq,n,rng);
+}
+
+/* Helper function to allocate a string key of a given length from an
+ * integer. The integer is written zero padded so all keys have the same
+ * length and share a common prefix, the key is longer than length if the
+ * integer does not fit.
+ *    i - the integer to build the key from
+ *    length - the length of the key
+ * Returns
+ *    a null-terminated string
+ */
+char *stringKeyFromInt(int i, int length) {
+    int size = snprintf(NULL, 0, "%0*d", length, i);
+    char *string = malloc(size+1);
+    snprintf(string, size+1, "%0*d", length, i);
+    return string;
+}
+
+/* Creates n unique keys in random order
+ *    type - the type of the keys
+ *    keyLength - the length of string keys
+ *    n - the number of keys to create
+ *    rng - the random numbers that decide the order
+ * Returns
+ *    the keys, deallocated with freeKeySet
+ */
+KeySet *createKeySet(KeyType type, int keyLength, int n, Rng *rng) {
+    KeySet *ks = calloc(1, sizeof(KeySet));
+    ks->type = type;
+    ks->n = n;
+    ks->ints = malloc(n*sizeof(int));
+    ks->keys = malloc(n*sizeof(void *));
+    createRandomSample(ks->ints, n, rng);
+    if (ks->type == KEY_STRING) {
+        ks->strings = malloc(n*sizeof(char *));
+        for(int i=0;i<n;i++) {
+            ks->strings[i] = stringKeyFromInt(ks->ints[i], keyLength);
+            ks->keys[i] = ks->strings[i];
+        }
+        free(ks->ints);
+        ks->ints = NULL;
+    } else {
+        for(int i=0;i<n;i++) {
+            ks->keys[i] = &ks->ints[i];
+        }
+    }
+    return ks;
+}
+
+/* Deallocates the keys created by createKeySet
+ *    ks - the keys
+ */
+void freeKeySet(KeySet *ks) {
+    if (ks->strings != NULL) {
+        for(int i=0;i<ks->n;i++) {
+            free(ks->strings[i]);
+        }
+        free(ks->strings);
+    }
+    free(ks->ints);
+    free(ks->keys);
+    free(ks);
+}
+
+/* Allocates a copy of a key that can be handed over to the table
+ *    ks - the keys
+ *    i - index of the key to copy
+ * Returns
+ *    the copy, deallocated with free
+ */
+void *copyKey(KeySet *ks, int i) {
+    if (ks->type == KEY_STRING)
+        return buildString(ks->strings[i], strlen(ks->strings[i]));
+    return intPtrFromInt(ks->ints[i]);
+}
+
+/* Returns the compare function matching a key type
+ *    type - the type of the keys
+ */
+CompareFunction *compareFunctionFor(KeyType type) {
+    return type == KEY_STRING ? compareString : compareInt;
+}
+
+/* Returns the hash function matching a key type
+ *    type - the type of the keys
+ */
+HashFunction *hashFunctionFor(KeyType type) {
+    return type == KEY_STRING ? hashString : hashInt;
+}
+
+/* Returns the key bytes function matching a key type
+ *    type - the type of the keys
+ */
+KeyBytesFunction *keyBytesFunctionFor(KeyType type) {
+    return type == KEY_STRING ? keyBytesString : keyBytesInt;
+}
+
+/* Returns the bytes of a string key in a snapshot
+ *    item - the key
+ */
+static size_t stringSize(const void *item) {
+    return strlen(item);
+}
+
+/* Stores a string key in a snapshot, without the null
+ *    item - the key
+ *    bytes - the bytes are stored here
+ */
+static void writeString(const void *item, void *bytes) {
+    memcpy(bytes, item, strlen(item));
+}
+
+/* Creates a string key from a snapshot
+ *    bytes - the bytes of the key
+ *    size - the number of bytes
+ * Returns
+ *    the key, deallocated with free
+ */
+static void *readString(const void *bytes, size_t size) {
+    char *string = malloc(size+1);
+    memcpy(string, bytes, size);
+    string[size] = '\0';
+    return string;
+}
+
+/* Returns the serializer matching a key type
+ *    type - the type of the keys
+ */
+const TableSerializer *serializerFor(KeyType type) {
+    static const TableSerializer intSerializer = {
+        .fixedSize = sizeof(int), .hash = hashInt, .bytes = keyBytesInt
+    };
+    static const TableSerializer stringSerializer = {
+        .size = stringSize, .write = writeString, .read = readString,
+        .hash = hashString, .bytes = keyBytesString
+    };
+    return type == KEY_STRING ? &stringSerializer : &intSerializer;
+}
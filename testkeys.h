@@ -0,0 +1,103 @@
+/*
+ * Helpers for creating the keys and values used by the test program and
+ * the benchmarks.
+ */
+
+#ifndef TESTKEYS_H
+#define TESTKEYS_H
+
+#include "rng.h"
+#include "table.h"
+
+/* Key types the speed tests can be run with */
+typedef enum KeyType {
+    KEY_INT,
+    KEY_STRING
+} KeyType;
+
+/* A set of unique keys in random order. keys[i] points to the i:th key in
+ * the form table_lookup expects it.
+ */
+typedef struct KeySet {
+    KeyType type;
+    int n;
+    int *ints;          // the integer keys, NULL for string keys
+    char **strings;     // the string keys, NULL for integer keys
+    void **keys;
+} KeySet;
+
+/* Helper function to allocate for string and fill it with content.
+ * The size should be of the content. The pointer returned contains
+ * size+1 chars and is null-terminated.
+ */
+char *buildString(const char *content, int size);
+
+/* Helper function to allocate memory for and initialize a integer pointer
+ * the value pointed to will be i
+ */
+int *intPtrFromInt(int i);
+
+/* Compare function for keys pointing to ints, 0 if the values are equal */
+int compareInt(void *ip,void *ip2);
+
+/* Compare function for keys pointing to strings, 0 if they are equal */
+int compareString(void *ip,void *ip2);
+
+/* Hash function for keys pointing to ints */
+unsigned long long hashInt(void *ip);
+
+/* Hash function for keys pointing to strings */
+unsigned long long hashString(void *ip);
+
+/* Key bytes function for keys pointing to ints, the bytes of the int in
+ * the order of the machine */
+size_t keyBytesInt(void *ip, const unsigned char **bytes);
+
+/* Key bytes function for keys pointing to strings, the characters without
+ * the terminating null */
+size_t keyBytesString(void *ip, const unsigned char **bytes);
+
+/* Shuffles the first n numbers stored in seq using the random numbers
+ * from rng */
+void randomshuffle(int seq[], int n, Rng *rng);
+
+/* Stores the numbers 0 to n-1 in random order, decided by rng, in seq */
+void createRandomSample(int seq[], int n, Rng *rng);
+
+/* Allocates a zero padded string key of (at least) a given length built
+ * from the integer i. */
+char *stringKeyFromInt(int i, int length);
+
+/* Creates n unique keys in random order
+ *    type - the type of the keys
+ *    keyLength - the length of string keys
+ *    n - the number of keys to create
+ *    rng - the random numbers that decide the order
+ * Returns
+ *    the keys, deallocated with freeKeySet
+ */
+KeySet *createKeySet(KeyType type, int keyLength, int n, Rng *rng);
+
+/* Deallocates the keys created by createKeySet */
+void freeKeySet(KeySet *ks);
+
+/* Allocates a copy of the i:th key in ks that can be handed over to a
+ * table, deallocated with free */
+void *copyKey(KeySet *ks, int i);
+
+/* Returns the compare function matching a key type */
+CompareFunction *compareFunctionFor(KeyType type);
+
+/* Returns the hash function matching a key type */
+HashFunction *hashFunctionFor(KeyType type);
+
+/* Returns the key bytes function matching a key type */
+KeyBytesFunction *keyBytesFunctionFor(KeyType type);
+
+/* Returns the serializer for table_save and table_load matching a key
+ * type, the int keys and values are copied as they are and the string
+ * keys without their terminating null. The keys are hashed with the hash
+ * function of the type and give their bytes with its key bytes function. */
+const TableSerializer *serializerFor(KeyType type);
+
+#endif
@@ -26,230 +26,42 @@ Usage exept those listed above requires permission by the author.
  * 8. Tests a table by creating it and inserting three key-value-pairs where
  *    all three pairs have identical keys. After that the element is removed
  *    and it is checked that the table is empty.
+ * 9. Tests a table by creating it and inserting three key-value-pairs where
+ *    two pairs have identical keys. After that the table is saved to a
+ *    snapshot file and loaded into a new table, and it is checked that
+ *    lookups in the new table return the values expected.
  *
- * There is also a module measuring time for insertions, lookups etc.
+ * There is also a module measuring time for insertions, lookups etc. The
+ * speed test is configured from the command line, run the program with
+ * --help for a list of the options. Each phase reports its total time,
+ * the latency percentiles of the individual operations and, since
+ * alloctrack.c is linked in, the allocations per operation. The bytes per
+ * entry of the full table are reported at the end.
+ *
+ * The speed test itself is in speedtest.c, which is shared with the
+ * benchmark program that compares all table implementations in one run.
+ * Here it is run on the table implementation the program is linked with.
+ *
+ * Build with for example
+ *   gcc -std=c99 -o testprogram testprogram.c mtftable.c dlist.c \
+ *       speedtest.c testkeys.c rng.c histogram.c nanoclock.c \
+ *       workload.c perfcounters.c alloctrack.c snapshot.c -lm
  * */
-#include "mtftable.h"
+#include "table.h"
+#include "speedtest.h"
+#include "tablebackend.h"
+#include "testkeys.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
-
-// Size of the table to generate
-#define TABLESIZE 500
-#define SAMPLESIZE TABLESIZE*2
-
-/* Helper function to allocate for string and fill it with content.
- * The size should be of the content. The pointer returned contains
- * size+1 chars and is null-terminated.
- *
- * Warning: Only checks if size < 1. Unsafe, do not reuse. 
- * Author: dali vt17
- */
-char *buildString(const char *content, int size) {
-    /* Content with no size makes no sense */
-    if (size < 1)
-        return NULL;
-
-    /* Allocate new string for content, with an extra char for \0 */
-    char *string = malloc(sizeof(char)*(size+1));
-
-    /* Malloc failed, return nothing */
-    if (string == NULL)
-        return NULL;
-
-    /* Copy content to new memory */
-    strncpy(string, content, size);
-
-    /* Strings should be null terminated */
-    string[size] = '\0';
-    return string;
-}
-
-/* Helper function to allocate memory for and initialize a integer pointer
- * the value pointed to will be i
- *   i the value to point at
- * Returns
- *   a int pointer to i
- */
-int *intPtrFromInt(int i){
-    int *ip=malloc(sizeof(int));
-    *ip=i;
-    return ip;
-}
-
-/* Function to get time in ms
- * Returns
- *    current time in ms
- */
-unsigned long get_milliseconds()
-{
-	struct timeval tv;
-	gettimeofday(&tv, 0);
-	return (unsigned long)(tv.tv_sec*1000 + tv.tv_usec/1000);
-}
-
-/*Compare function used to compare two int values (pointed to by ip and ip2) are equal
- * ip, ip2 - pointers to two integers
- * Returns
- *    0 if values are equal, nonzero otherwize
- */
-int compareInt(void *ip,void *ip2){
-    return (*(int*)ip) - (*(int*)ip2);
-}
-
-/*Compare function used to compare two string values (pointed to by ip and ip2) are equal
- * ip, ip2 - pointers to two integers
- * Returns
- *    0 if values are equal, nonzero otherwize
- */
-int compareString(void *ip,void *ip2){
-    return strcmp((char*)ip, (char*)ip2);
-}
-
-/* Shuffles the numbers stored in seq
- *    seq - an array of randomnumbers to be shuffled
- *    n - the number of elements in seq to shuffle, i.e the indexes [0, n] 
- *        will be shuffled. However, seq might be larger than n...
- */
-void randomshuffle(int seq[], int n) {
-    for(int i=0;i<n;i++) {
-        int switchPos=rand()%n;
-        if(i!=switchPos) {
-            int temp=seq[i];
-            seq[i]=seq[switchPos];
-            seq[switchPos]=temp;
-        }
-    }
-}
-
-/* Generate n unique random numbers. The numbers will be stored i seq
- *    seq - an array of randomnumbers created in the function
- *    n - the number of elements in seq
- */
-void createRandomSample(int seq[], int n) {
-    for(int i=0;i<n;i++) {
-        seq[i]=i;
-    }
-    randomshuffle(seq,n);
-}
-
-/* Measures time taken to fill a table with values
- *    table - the table to fill
- *    keys - a list of keys to use
- *    values - a list of values to use
- */
-void getInsertSpeed(Table *table, int *keys, int *values){
-    unsigned long start;
-    unsigned long end;
-    
-    // Insert all items
-    printf("Insert %d items: \n", TABLESIZE);
-    start = get_milliseconds();
-    for(int i=0;i<TABLESIZE;i++) {
-        table_insert(table, intPtrFromInt(keys[i]), intPtrFromInt(values[i]));
-    }
-    end =  get_milliseconds();
-    printf("%lu ms.\n",end-start);
-}
-
-/* Measures time taken to do n lookups of existing keys in a table
- *    table - the table to fill
- *    keys - a list of keys to use
- *    values - a list of values to use
- *    n - the number of lookups to perform
- */
-void getRandomExistingLookupSpeed(Table *table, int *keys, int n){
-    unsigned long start;
-    unsigned long end;
-
-    printf("%d random lookups: \n",n );
-    start = get_milliseconds();
-    for(int i=0;i<n;i++) {
-        // The existing keys in the table are stored in index [0, TABLESIZE-1] 
-        // in the key-array
-        int pos = rand()%TABLESIZE;
-        table_lookup(table,&keys[pos]);
-    }
-    end = get_milliseconds();
-    printf("%lu ms.\n", end-start);
-}
-
-/* Measures time taken to do n lookups of non-existing keys in a table
- *    table - the table to fill
- *    keys - a list of keys to use
- *    values - a list of values to use
- *    n - the number of lookups to perform
- */
-void getRandomNonExistingLookupSpeed(Table *table, int *keys, int n){
-    unsigned long start;
-    unsigned long end;
-
-    printf("%d lookups with non-existent keys: \n", n);
-    // We know the exisiting keys have indexes in [0, TABLESIZE-1] so if we
-    // try to lookup keys in the area [TABLESIZE, 2*TABLESIZE-1]
-    // they will not exist
-    start =  get_milliseconds();
-    int startindex = TABLESIZE;
-    for(int i=0;i<n;i++){
-        table_lookup(table,&keys[startindex + (i%TABLESIZE)]);
-    }
-    end = get_milliseconds();
-    printf("%lu ms.\n" ,end-start);
-}
-
-/* Measures time taken to do n lookups of existing keys in a table when the
- * keys chosen are from only a part of all available keys
- *    table - the table to fill
- *    keys - a list of keys to use
- *    values - a list of values to use
- *    n - the number of lookups to perform
- */
-void getSkewedLookupSpeed(Table *table, int *keys, int n){
-    unsigned long start;
-    unsigned long end;
-
-    // Lookup skewed to a certain range (in this case the middle third
-    // of the keys used)
-    int startindex = TABLESIZE/3;
-    int stopindex = TABLESIZE*2/3;
-    int partition = stopindex - startindex + 1;
-
-    printf("%d skewed lookups: \n" ,n);
-    start =  get_milliseconds();
-    for(int i=0;i<n;i++) {
-        int pos = rand()%partition + startindex;
-        table_lookup(table,&keys[pos]);
-    }
-    end = get_milliseconds();
-    printf("%lu ms.\n" ,end-start);
-}
-
-/* Measures time taken remove all keys from a table
- *    table - the table to fill
- *    keys - a list of keys to use
- *    values - a list of values to use
- */
-void getRemoveSpeed(Table *table, int *keys){
-    unsigned long start;
-    unsigned long end;
-
-    // Remove all items, not in the same order as they were inserted
-    printf("Remove all items: \n");
-    start = get_milliseconds();
-    randomshuffle(keys, TABLESIZE);  // to get a new order of the keys
-    for(int i=0;i<TABLESIZE;i++) {
-        table_remove(table,&keys[i]);
-    }
-    end = get_milliseconds();
-    printf("%lu ms.\n" ,end-start);
-}
 
 /* Tests if isempty returns true directly after a table is created.
  */
 void testIsempty(){
     Table *table = table_create(compareInt);
+    table_setHashFunction(table, hashInt);
+    table_setKeyBytesFunction(table, keyBytesInt);
 
     if (!table_isEmpty(table)){
         printf("An newly created empty table is said to be nonempty.\n");
@@ -264,6 +76,8 @@ void testIsempty(){
  */
 void testInsertSingleElement(){
     Table *table = table_create(compareString);
+    table_setHashFunction(table, hashString);
+    table_setKeyBytesFunction(table, keyBytesString);
     table_setKeyMemHandler(table, free);
     table_setValueMemHandler(table, free);
 
@@ -309,6 +123,8 @@ void testLookupExistingKey(Table *table, char *key, char *value){
  */
 void testLookupSingleElement(){
     Table *table = table_create(compareString);
+    table_setHashFunction(table, hashString);
+    table_setKeyBytesFunction(table, keyBytesString);
     table_setKeyMemHandler(table, free);
     table_setValueMemHandler(table, free);
 
@@ -343,6 +159,8 @@ void testLookupSingleElement(){
  */
 void testInsertLookupDifferentKeys(){
     Table *table = table_create(compareString);
+    table_setHashFunction(table, hashString);
+    table_setKeyBytesFunction(table, keyBytesString);
     table_setKeyMemHandler(table, free);
     table_setValueMemHandler(table, free);
 
@@ -378,6 +196,8 @@ void testInsertLookupDifferentKeys(){
  */
 void testInsertLookupSameKeys(){
     Table *table = table_create(compareString);
+    table_setHashFunction(table, hashString);
+    table_setKeyBytesFunction(table, keyBytesString);
     table_setKeyMemHandler(table, free);
     table_setValueMemHandler(table, free);
 
@@ -414,6 +234,8 @@ void testInsertLookupSameKeys(){
  */
 void testRemoveSingleElement(){
     Table *table = table_create(compareString);
+    table_setHashFunction(table, hashString);
+    table_setKeyBytesFunction(table, keyBytesString);
     table_setKeyMemHandler(table, free);
     table_setValueMemHandler(table, free);
 
@@ -443,6 +265,8 @@ void testRemoveSingleElement(){
  */
 void testRemoveElementsDifferentKeys(){
     Table *table = table_create(compareString);
+    table_setHashFunction(table, hashString);
+    table_setKeyBytesFunction(table, keyBytesString);
     table_setKeyMemHandler(table, free);
     table_setValueMemHandler(table, free);
 
@@ -489,6 +313,8 @@ void testRemoveElementsDifferentKeys(){
  */
 void testRemoveElementsSameKeys(){
     Table *table = table_create(compareString);
+    table_setHashFunction(table, hashString);
+    table_setKeyBytesFunction(table, keyBytesString);
     table_setKeyMemHandler(table, free);
     table_setValueMemHandler(table, free);
 
@@ -521,6 +347,51 @@ void testRemoveElementsSameKeys(){
     table_free(table);
 }
 
+/* Tests a table by creating it and inserting three key-value-pairs where
+ *  two pairs have identical keys. After that the table is saved to a
+ *  snapshot file and loaded into a new table, and it is checked that
+ *  lookups in the new table return the values expected.
+ *
+ *  It is assumed that testInsertLookupDifferentKeys and
+ *  testInsertLookupSameKeys have been run before calling this test.
+ */
+void testSaveLoad(){
+    const char *path = "table_snapshot.tmp";
+    const TableSerializer *strings = serializerFor(KEY_STRING);
+    Table *table = table_create(compareString);
+    table_setHashFunction(table, hashString);
+    table_setKeyBytesFunction(table, keyBytesString);
+    table_setKeyMemHandler(table, free);
+    table_setValueMemHandler(table, free);
+
+    table_insert(table, buildString("key1", 4), buildString("value1", 6));
+    table_insert(table, buildString("key2", 4), buildString("value2", 6));
+    table_insert(table, buildString("key1", 4), buildString("value3", 6));
+
+    if (!table_save(table, path, strings, strings)) {
+        printf("Saving a table with three elements failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    Table *loaded = table_load(path, compareString, strings, strings);
+    remove(path);
+    if (loaded == NULL) {
+        printf("Loading a saved table with three elements failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    table_setKeyMemHandler(loaded, free);
+    table_setValueMemHandler(loaded, free);
+
+    testLookupExistingKey(loaded, "key1", "value3");
+    testLookupExistingKey(loaded, "key2", "value2");
+    if (table_lookup(loaded, "key3") != NULL) {
+        printf("Looking up non-existing key in a loaded table, expected NULL\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("Saving a table with three elements and looking them up in the loaded table - OK\n");
+    table_free(table);
+    table_free(loaded);
+}
+
 /*  Tests a table by performing a set of tests. Program exits if any
  *  error is found.
  */
@@ -533,40 +404,35 @@ void correctnessTest() {
     testRemoveSingleElement();
     testRemoveElementsDifferentKeys();
     testRemoveElementsSameKeys();
+    testSaveLoad();
 }
 
-/* Tests the speed of a table using random numbers. First a number of
- * elements are inserted. Second a random lookup among the elements are
- * done followed by a skewed lookup (where a subset of the keys are
- * looked up more frequently). Finally all elements are removed.
- */
-void speedTest() {
-    Table *table = table_create(compareInt);
-    table_setKeyMemHandler(table, free);
-    table_setValueMemHandler(table, free);
-
-    int randomsize = 2*TABLESIZE; // To make it easier testing non-existing keys later
-    int *keys = malloc(randomsize*sizeof(int));
-    int *values = malloc(randomsize*sizeof(int));
-    createRandomSample(keys, randomsize);
-    createRandomSample(values, TABLESIZE);
-
-    getInsertSpeed(table, keys, values);
-    getRandomExistingLookupSpeed(table, keys, SAMPLESIZE);
-    getRandomNonExistingLookupSpeed(table, keys, SAMPLESIZE);
-    getSkewedLookupSpeed(table, keys, SAMPLESIZE);
-    getRemoveSpeed(table, keys);
-
-    free(keys);
-    free(values);
-    table_free(table);
-}
-
-int main() {
-    correctnessTest();
-    printf("All correctness tests succeeded! Press enter to continue!\n");
-    getchar();
-    speedTest();
-    printf("Test completed.\n");
+/* The table implementation the program is linked with */
+static const TableBackend linkedTable = {
+    .name = "linked",
+    TABLE_BACKEND_FUNCTIONS
+};
+
+int main(int argc, char *argv[]) {
+    SpeedConfig config;
+    SpeedResults results;
+    const TableBackend *backend = &linkedTable;
+
+    speedtest_parseArguments(argc, argv, &config, false);
+    if (config.check) {
+        correctnessTest();
+        printf("All correctness tests succeeded!");
+        if (config.pause) {
+            printf(" Press enter to continue!\n");
+            getchar();
+        } else {
+            printf("\n");
+        }
+    }
+    speedtest_run(backend, &config, &results);
+    speedtest_report(&config, &backend, &results, 1);
+    speedtest_freeResults(&results);
+    if (config.format == FORMAT_TEXT)
+        printf("Test completed.\n");
     return 0;
-}
\ No newline at end of file
+}
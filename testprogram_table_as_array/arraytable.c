@@ -20,13 +20,14 @@ typedef struct ArrayTable{
 	KeyFreeFunc *keyFree;
 	ValueFreeFunc *valueFree;
 	int nrOccupied;
+	TableStats stats;
 } ArrayTable;
 
 /*
  * 
  * 
  */
- void table_setValue(Table *table, KEY key, VALUE value, int index){
+ static void table_setValue(Table *table, KEY key, VALUE value, int index){
 	ArrayTable *a = (ArrayTable*)table;
 	array_setMemHandler(a->keys, a->keyFree); 			
 	array_setValue(a->keys,key,index,0);
@@ -76,6 +77,18 @@ void table_setValueMemHandler(Table *table,ValueFreeFunc *freeFunc){
 	a->valueFree = freeFunc;
 }
 
+/* The table is not hashed, so the hash function is not used */
+void table_setHashFunction(Table *table, HashFunction *hash){
+	(void)table;
+	(void)hash;
+}
+
+/* The keys are only compared, so the bytes of the keys are not used */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes){
+	(void)table;
+	(void)bytes;
+}
+
 /* Determines if the table is empty.
  *  table - Pointer to the table.
  * Returns: false if the table is not empty, true if it is. */
@@ -96,6 +109,7 @@ void table_insert(Table *table, KEY key, VALUE value){
 	KEY key2;
 	int key_set = 0;
 	int i = 0;
+	tablestats_insert(&a->stats);
 	while(array_hasValue(a->values,i)){ // kolla om det finns dubletter
 		key2 = array_inspectValue(a->keys,i);
 		if(a->cf(key,key2) == 0){
@@ -131,16 +145,22 @@ VALUE table_lookup(Table *table, KEY key){
 	ArrayTable *a = (ArrayTable*)table;
 	KEY key2;
 	int i = 0;
+	bool hit = false;
+	unsigned long long compares = 0;
 	while(array_hasValue(a->keys,i)){ // söker nyckel
 		key2 = array_inspectValue(a->keys,i);
+		compares++;
 		if(a->cf(key,key2) == 0){
+			hit = true;
 			break;
 		}
 		i++;
 		if(i>NUM_ELEMENTS-1){
+			tablestats_lookup(&a->stats, false, compares);
 			return NULL;
 		}
 	}
+	tablestats_lookup(&a->stats, hit, compares);
 	return array_inspectValue(a->values,i,1);
 }
 
@@ -152,26 +172,23 @@ VALUE table_lookup(Table *table, KEY key){
 void table_remove(Table *table, KEY key){
 	ArrayTable *a = (ArrayTable*)table;
 	KEY key2;
-	VALUE value2;
-	const int memsize = sizeof key2; // för att komma runt att memcpy inte gillar (key2, XXX, sizeof(key2)) som arg med -Wall
 	int i = 0;
 	int j = 0;
+	tablestats_remove(&a->stats);
 	while(array_hasValue(a->values,i)){ // söker nyckel
 		key2 = array_inspectValue(a->keys,i);
 		if(a->cf(key,key2) == 0){
+			table_setValue(a, NULL, NULL, j); // avallokerar nyckel och värde
+			array_setMemHandler(a->keys, NULL); // flyttar resten utan att avallokera dem
+			array_setMemHandler(a->values, NULL);
 			while(array_hasValue(a->values,j+1)){ //moves every item behind 'key' one step forward, removes 'key'
-				
-				key2 = array_inspectValue(a->keys,j+1);
-				value2 = array_inspectValue(a->values,j+1);
-				KEY key_move = malloc(sizeof key_move);
-				VALUE value_move = malloc(sizeof value_move);
-				memcpy(key_move, key2, memsize);
-				memcpy(value_move, value2, memsize);
-				
-				table_setValue(a, key_move, value_move, j);
+				array_setValue(a->keys,array_inspectValue(a->keys,j+1),j);
+				array_setValue(a->values,array_inspectValue(a->values,j+1),j);
 				j++;
 			}
-			table_setValue(a, NULL, NULL, j);
+			array_setValue(a->keys,NULL,j);
+			array_setValue(a->values,NULL,j);
+			a->nrOccupied--;
 			break;
 		}
 		j++;
@@ -194,4 +211,51 @@ void table_free(Table *table){
 	array_free(a->keys);
 	}
 	free(a);
+}
+
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h. */
+bool table_getStats(Table *table, TableStats *stats){
+	ArrayTable *a = (ArrayTable*)table;
+	return tablestats_get(&a->stats, stats);
+}
+
+/* Saves the occupied elements of the array to a snapshot file */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values){
+	ArrayTable *a = (ArrayTable*)table;
+	SnapshotWriter *w = snapshot_openWriter(path, keys, values);
+	if(w == NULL){
+		return false;
+	}
+	for(int i = 0; i < NUM_ELEMENTS && array_hasValue(a->keys,i); i++){
+		snapshot_write(w, array_inspectValue(a->keys,i),
+		               array_inspectValue(a->values,i));
+	}
+	return snapshot_closeWriter(w);
+}
+
+/* Creates a table from a snapshot file, the entries are put in the
+ * first elements of the array in the order they were saved */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values){
+	SnapshotReader *r = snapshot_openReader(path, keys, values);
+	if(r == NULL){
+		return NULL;
+	}
+	if(snapshot_count(r) > NUM_ELEMENTS){
+		fprintf(stderr, "%s: the table holds at most %d entries\n", path,
+		        NUM_ELEMENTS);
+		snapshot_closeReader(r);
+		return NULL;
+	}
+	ArrayTable *a = table_create(compare_function);
+	KEY key;
+	VALUE value;
+	while(snapshot_read(r, &key, &value)){
+		table_setValue(a, key, value, a->nrOccupied);
+		a->nrOccupied++;
+	}
+	snapshot_closeReader(r);
+	return a;
 }
\ No newline at end of file
@@ -13,14 +13,26 @@
 
 #define NUM_ELEMENTS 100
 
+/* Marks the elements that have been removed, compared by address */
+static char FREE_SLOT[] = "FREE";
+
 typedef struct ArrayTable{
 	array *values;
 	CompareFunction *cf;
 	KeyFreeFunc *keyFree;
 	ValueFreeFunc *valueFree;
 	int nrOccupied;
+	TableStats stats;
 } ArrayTable;
 
+/* Determines if an element of the array holds a key and value, elements
+ * that were removed are marked with FREE_SLOT */
+static bool isOccupied(ArrayTable *a, int i){
+	return array_hasValue(a->values,i,0) &&
+	       array_inspectValue(a->values,i,0) != NULL &&
+	       array_inspectValue(a->values,i,0) != FREE_SLOT;
+}
+
 /* Creates a table.
  *  compare_function - Pointer to a function that is called for comparing
  *                     two keys. The function should return <0 if the left
@@ -59,6 +71,18 @@ void table_setValueMemHandler(Table *table,ValueFreeFunc *freeFunc){
 	a->valueFree = freeFunc;
 }
 
+/* The table is not hashed, so the hash function is not used */
+void table_setHashFunction(Table *table, HashFunction *hash){
+	(void)table;
+	(void)hash;
+}
+
+/* The keys are only compared, so the bytes of the keys are not used */
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes){
+	(void)table;
+	(void)bytes;
+}
+
 /* Determines if the table is empty.
  *  table - Pointer to the table.
  * Returns: false if the table is not empty, true if it is. */
@@ -108,6 +132,7 @@ void table_insert(Table *table, KEY key, VALUE value){
 	ArrayTable *a = (ArrayTable*)table;
 	KEY key2;
 	int i = 0;
+	tablestats_insert(&a->stats);
 	while(i<NUM_ELEMENTS-1){ // kolla om det finns dubletter
 		if(array_hasValue(a->values,i,0)){ 
 			key2 = array_inspectValue(a->values,i,0);
@@ -116,7 +141,7 @@ void table_insert(Table *table, KEY key, VALUE value){
 				break;
 			}
 		}
-		else if((array_inspectValue(a->values,i,0) == NULL) || (array_inspectValue(a->values,i,0) == "FREE")){
+		else if((array_inspectValue(a->values,i,0) == NULL) || (array_inspectValue(a->values,i,0) == FREE_SLOT)){
 			array_setValue(a->values,key,i,0);
 			array_setValue(a->values,value,i,1);
 			a->nrOccupied++;
@@ -155,13 +180,16 @@ VALUE table_lookup(Table *table, KEY key){
 	ArrayTable *a = (ArrayTable*)table;
 	KEY key2;
 	int i = 0;
+	unsigned long long compares = 0;
 	while(i<NUM_ELEMENTS-1){ // söker nyckel
 		key2 = array_inspectValue(a->values,i,0);
+		compares++;
 		if(a->cf(key,key2) == 0){
 			break;
 		}
 		i++;
 	}
+	tablestats_lookup(&a->stats, i<NUM_ELEMENTS-1, compares);
 	return array_inspectValue(a->values,i,1);
 }
 
@@ -230,12 +258,13 @@ void table_remove(Table *table, KEY key){
 	ArrayTable *a = (ArrayTable*)table;
 	KEY key2;
 	int i = 0;
+	tablestats_remove(&a->stats);
 	while(i<NUM_ELEMENTS-1){ // söker nyckel
 		key2 = array_inspectValue(a->values,i,0);
 		if(a->cf(key,key2) == 0){
 				
-			array_setValue(a->values,"FREE",i,0);
-			array_setValue(a->values,"FREE",i,1);
+			array_setValue(a->values,FREE_SLOT,i,0);
+			array_setValue(a->values,FREE_SLOT,i,1);
 			a->nrOccupied--;
 			break;
 		}
@@ -250,3 +279,53 @@ void table_free(Table *table){
 	free(table);
 }
 
+/* Gets the statistics of the operations done on the table, see
+ * tablestats.h. */
+bool table_getStats(Table *table, TableStats *stats){
+	ArrayTable *a = (ArrayTable*)table;
+	return tablestats_get(&a->stats, stats);
+}
+
+/* Saves the occupied elements of the array to a snapshot file */
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values){
+	ArrayTable *a = (ArrayTable*)table;
+	SnapshotWriter *w = snapshot_openWriter(path, keys, values);
+	if(w == NULL){
+		return false;
+	}
+	for(int i = 0; i < NUM_ELEMENTS-1; i++){
+		if(isOccupied(a,i)){
+			snapshot_write(w, array_inspectValue(a->values,i,0),
+			               array_inspectValue(a->values,i,1));
+		}
+	}
+	return snapshot_closeWriter(w);
+}
+
+/* Creates a table from a snapshot file, the entries are put in the
+ * first elements of the array in the order they were saved */
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys, const TableSerializer *values){
+	SnapshotReader *r = snapshot_openReader(path, keys, values);
+	if(r == NULL){
+		return NULL;
+	}
+	if(snapshot_count(r) > NUM_ELEMENTS-1){
+		fprintf(stderr, "%s: the table holds at most %d entries\n", path,
+		        NUM_ELEMENTS-1);
+		snapshot_closeReader(r);
+		return NULL;
+	}
+	ArrayTable *a = table_create(compare_function);
+	KEY key;
+	VALUE value;
+	while(snapshot_read(r, &key, &value)){
+		array_setValue(a->values,key,a->nrOccupied,0);
+		array_setValue(a->values,value,a->nrOccupied,1);
+		a->nrOccupied++;
+	}
+	snapshot_closeReader(r);
+	return a;
+}
+
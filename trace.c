@@ -0,0 +1,186 @@
+/*
+ * Binary trace files of table operations, see trace.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nanoclock.h"
+#include "trace.h"
+
+#define TRACE_MAGIC "TBLTRACE"
+#define TRACE_MAGIC_LENGTH 8
+#define TRACE_VERSION 1
+// Bytes in the header, the magic, version and key type
+#define TRACE_HEADER_LENGTH (TRACE_MAGIC_LENGTH+2)
+// Buffer of the writer, so recording seldom calls the system
+#define TRACE_BUFFER_SIZE (1<<20)
+
+static const char *opNames[TRACE_NUM_OPS] = {
+    "create", "insert", "lookup", "remove", "free"
+};
+
+struct TraceWriter {
+    FILE *file;
+    TraceKeyType keyType;
+    unsigned long long last;    // time of the previous record
+};
+
+struct TraceReader {
+    unsigned char *data;
+    size_t length;
+    size_t pos;
+    TraceKeyType keyType;
+    unsigned long long ns;      // time of the previous record
+};
+
+/* Writes a varint
+ *    file - the file to write to
+ *    value - the value
+ */
+static void writeVarint(FILE *file, unsigned long long value) {
+    while (value >= 0x80) {
+        putc((int)(value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    putc((int)value, file);
+}
+
+/* Reads a varint
+ *    r - the reader
+ *    value - the value is stored here
+ * Returns
+ *    false if the data ends before the varint does
+ */
+static bool readVarint(TraceReader *r, unsigned long long *value) {
+    *value = 0;
+    for(int shift=0;r->pos<r->length && shift<64;shift+=7) {
+        unsigned char byte = r->data[r->pos++];
+        *value |= (unsigned long long)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+TraceWriter *trace_openWriter(const char *path, TraceKeyType keyType) {
+    TraceWriter *w = malloc(sizeof(TraceWriter));
+    w->file = fopen(path, "wb");
+    if (w->file == NULL) {
+        free(w);
+        return NULL;
+    }
+    setvbuf(w->file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+    w->keyType = keyType;
+    w->last = nanoclock_now();
+    fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LENGTH, w->file);
+    putc(TRACE_VERSION, w->file);
+    putc(keyType, w->file);
+    return w;
+}
+
+void trace_write(TraceWriter *w, TraceOp op, unsigned int table,
+                 const void *key) {
+    unsigned long long now = nanoclock_now();
+    putc(op, w->file);
+    writeVarint(w->file, table);
+    writeVarint(w->file, now-w->last);
+    w->last = now;
+    if (op == TRACE_CREATE || op == TRACE_FREE)
+        return;
+    if (w->keyType == TRACE_KEY_INT) {
+        unsigned int i = *(const int *)key;
+        writeVarint(w->file, 4);
+        for(int b=0;b<4;b++)
+            putc((i >> 8*b) & 0xff, w->file);
+    } else {
+        size_t length = strlen(key);
+        writeVarint(w->file, length);
+        fwrite(key, 1, length, w->file);
+    }
+}
+
+bool trace_closeWriter(TraceWriter *w) {
+    bool ok = !ferror(w->file);
+    ok = fclose(w->file) == 0 && ok;
+    free(w);
+    return ok;
+}
+
+TraceReader *trace_openReader(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return NULL;
+    }
+    TraceReader *r = calloc(1, sizeof(TraceReader));
+    size_t capacity = 1<<16;
+    r->data = malloc(capacity);
+    size_t n;
+    while ((n = fread(r->data+r->length, 1, capacity-r->length, file)) > 0) {
+        r->length += n;
+        if (r->length == capacity) {
+            capacity *= 2;
+            r->data = realloc(r->data, capacity);
+        }
+    }
+    bool failed = ferror(file);
+    fclose(file);
+    if (failed) {
+        perror(path);
+    } else if (r->length < TRACE_HEADER_LENGTH ||
+               memcmp(r->data, TRACE_MAGIC, TRACE_MAGIC_LENGTH) != 0 ||
+               r->data[TRACE_MAGIC_LENGTH] != TRACE_VERSION ||
+               r->data[TRACE_MAGIC_LENGTH+1] > TRACE_KEY_STRING) {
+        fprintf(stderr, "%s: not a trace file of version %d\n", path,
+                TRACE_VERSION);
+        failed = true;
+    }
+    if (failed) {
+        trace_closeReader(r);
+        return NULL;
+    }
+    r->keyType = r->data[TRACE_MAGIC_LENGTH+1];
+    trace_rewind(r);
+    return r;
+}
+
+TraceKeyType trace_keyType(const TraceReader *r) {
+    return r->keyType;
+}
+
+bool trace_next(TraceReader *r, TraceRecord *record) {
+    unsigned long long table, delta, keyLength;
+    if (r->pos >= r->length || r->data[r->pos] >= TRACE_NUM_OPS)
+        return false;
+    record->op = r->data[r->pos++];
+    if (!readVarint(r, &table) || !readVarint(r, &delta))
+        return false;
+    r->ns += delta;
+    record->table = table;
+    record->ns = r->ns;
+    record->key = NULL;
+    record->keyLength = 0;
+    if (record->op == TRACE_CREATE || record->op == TRACE_FREE)
+        return true;
+    if (!readVarint(r, &keyLength) || keyLength > r->length-r->pos)
+        return false;
+    record->key = r->data+r->pos;
+    record->keyLength = keyLength;
+    r->pos += keyLength;
+    return true;
+}
+
+void trace_rewind(TraceReader *r) {
+    r->pos = TRACE_HEADER_LENGTH;
+    r->ns = 0;
+}
+
+void trace_closeReader(TraceReader *r) {
+    free(r->data);
+    free(r);
+}
+
+const char *trace_opName(TraceOp op) {
+    return opNames[op];
+}
@@ -0,0 +1,102 @@
+/*
+ * Binary trace files of table operations.
+ *
+ * A trace is the sequence of table.h calls a program made, recorded by
+ * the shim in tracetable.c and played back against any table
+ * implementation by the replay tool. The file starts with the magic
+ * bytes "TBLTRACE", a version byte and a byte with the key type, followed
+ * by one record per operation:
+ *
+ *   op         1 byte, a TraceOp
+ *   table      varint, numbered from 0 in the order the tables were created
+ *   delta      varint, nanoseconds since the previous record
+ *   key length varint, only for insert, lookup and remove
+ *   key        the key bytes, an int in 4 bytes little endian or the
+ *              characters of a string without the terminating zero
+ *
+ * where a varint is an unsigned number in 7 bit groups, lowest first,
+ * with the top bit set on all bytes but the last. Values are not
+ * recorded, only that an insert was made.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* The recorded operations */
+typedef enum TraceOp {
+    TRACE_CREATE,
+    TRACE_INSERT,
+    TRACE_LOOKUP,
+    TRACE_REMOVE,
+    TRACE_FREE,
+    TRACE_NUM_OPS
+} TraceOp;
+
+/* How the keys of a trace are encoded */
+typedef enum TraceKeyType {
+    TRACE_KEY_INT,      // int keys, compared with compareInt
+    TRACE_KEY_STRING    // zero terminated strings, compared with strcmp
+} TraceKeyType;
+
+/* One recorded operation */
+typedef struct TraceRecord {
+    TraceOp op;
+    unsigned int table;
+    unsigned long long ns;      // time since the recording started
+    const unsigned char *key;   // NULL for create and free
+    size_t keyLength;
+} TraceRecord;
+
+typedef struct TraceWriter TraceWriter;
+typedef struct TraceReader TraceReader;
+
+/* Creates a trace file.
+ *  path    - The name of the file.
+ *  keyType - The type of the keys that will be recorded.
+ * Returns: The writer, NULL if the file could not be created. */
+TraceWriter *trace_openWriter(const char *path, TraceKeyType keyType);
+
+/* Appends a record to a trace, timestamped with the current time.
+ *  w     - The writer.
+ *  op    - The operation.
+ *  table - The number of the table.
+ *  key   - The key, ignored for create and free. */
+void trace_write(TraceWriter *w, TraceOp op, unsigned int table,
+                 const void *key);
+
+/* Writes the remaining records and closes the file.
+ *  w - The writer. After the call the pointer is invalid.
+ * Returns: false if writing the file failed. */
+bool trace_closeWriter(TraceWriter *w);
+
+/* Reads a whole trace file into memory.
+ *  path - The name of the file.
+ * Returns: The reader, NULL if the file could not be read or is not a
+ *          trace, with the reason printed on stderr. */
+TraceReader *trace_openReader(const char *path);
+
+/* Returns: The type of the keys in a trace. */
+TraceKeyType trace_keyType(const TraceReader *r);
+
+/* Reads the next record.
+ *  r      - The reader.
+ *  record - The record is stored here, its key points into the reader.
+ * Returns: false at the end of the trace or if the rest of it is
+ *          corrupt. */
+bool trace_next(TraceReader *r, TraceRecord *record);
+
+/* Starts reading from the first record again.
+ *  r - The reader. */
+void trace_rewind(TraceReader *r);
+
+/* Frees a reader.
+ *  r - The reader. After the call the pointer is invalid. */
+void trace_closeReader(TraceReader *r);
+
+/* Returns: The name of an operation, used in the replay output. */
+const char *trace_opName(TraceOp op);
+
+#endif
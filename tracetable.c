@@ -0,0 +1,159 @@
+/*
+ * Recording shim for the table.h API, see tracetable.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "table.h"
+#include "tablebackend.h"
+#include "tracetable.h"
+
+/* A table handed out by the shim */
+typedef struct TracedTable {
+    const TableBackend *backend;    // the implementation of the table
+    Table *table;                   // the table in that implementation
+    unsigned int id;                // number in the trace
+    unsigned int recording;         // the recording it was created in
+} TracedTable;
+
+static TraceWriter *writer = NULL;
+static const TableBackend *backend = NULL;
+static unsigned int numTables = 0;
+// Number of the current recording, 0 when not recording
+static unsigned int recording = 0;
+static unsigned int numRecordings = 0;
+
+/* Records an operation if the table is traced
+ *    t - the table
+ *    op - the operation
+ *    key - the key, NULL for create and free
+ */
+static void record(const TracedTable *t, TraceOp op, const void *key) {
+    if (recording != 0 && t->recording == recording)
+        trace_write(writer, op, t->id, key);
+}
+
+/* Stops recording at exit */
+static void stopAtExit(void) {
+    tracetable_stop();
+}
+
+bool tracetable_start(const char *path, const char *name,
+                      TraceKeyType keyType) {
+    const TableBackend *b = name != NULL ? tablebackend_find(name) :
+                                           tablebackend_all[0];
+    if (b == NULL) {
+        fprintf(stderr, "Unknown backend: %s\n", name);
+        return false;
+    }
+    tracetable_stop();
+    writer = trace_openWriter(path, keyType);
+    if (writer == NULL) {
+        perror(path);
+        return false;
+    }
+    static bool registered = false;
+    if (!registered)
+        registered = atexit(stopAtExit) == 0;
+    backend = b;
+    numTables = 0;
+    recording = ++numRecordings;
+    return true;
+}
+
+bool tracetable_stop(void) {
+    if (writer == NULL)
+        return true;
+    bool ok = trace_closeWriter(writer);
+    writer = NULL;
+    recording = 0;
+    return ok;
+}
+
+Table *table_create(CompareFunction *compare_function) {
+    TracedTable *t = malloc(sizeof(TracedTable));
+    t->backend = backend != NULL ? backend : tablebackend_all[0];
+    t->table = t->backend->create(compare_function);
+    t->recording = recording;
+    t->id = recording != 0 ? numTables++ : 0;
+    record(t, TRACE_CREATE, NULL);
+    return t;
+}
+
+void table_setKeyMemHandler(Table *table, KeyFreeFunc *freeFunc) {
+    TracedTable *t = table;
+    t->backend->setKeyMemHandler(t->table, freeFunc);
+}
+
+void table_setValueMemHandler(Table *table, ValueFreeFunc *freeFunc) {
+    TracedTable *t = table;
+    t->backend->setValueMemHandler(t->table, freeFunc);
+}
+
+void table_setHashFunction(Table *table, HashFunction *hash) {
+    TracedTable *t = table;
+    t->backend->setHashFunction(t->table, hash);
+}
+
+void table_setKeyBytesFunction(Table *table, KeyBytesFunction *bytes) {
+    TracedTable *t = table;
+    t->backend->setKeyBytesFunction(t->table, bytes);
+}
+
+bool table_isEmpty(Table *table) {
+    TracedTable *t = table;
+    return t->backend->isEmpty(t->table);
+}
+
+void table_insert(Table *table, KEY key, VALUE value) {
+    TracedTable *t = table;
+    record(t, TRACE_INSERT, key);
+    t->backend->insert(t->table, key, value);
+}
+
+VALUE table_lookup(Table *table, KEY key) {
+    TracedTable *t = table;
+    record(t, TRACE_LOOKUP, key);
+    return t->backend->lookup(t->table, key);
+}
+
+void table_remove(Table *table, KEY key) {
+    TracedTable *t = table;
+    record(t, TRACE_REMOVE, key);
+    t->backend->remove(t->table, key);
+}
+
+void table_free(Table *table) {
+    TracedTable *t = table;
+    record(t, TRACE_FREE, NULL);
+    t->backend->free(t->table);
+    free(t);
+}
+
+bool table_getStats(Table *table, TableStats *stats) {
+    TracedTable *t = table;
+    return t->backend->getStats(t->table, stats);
+}
+
+bool table_save(Table *table, const char *path, const TableSerializer *keys,
+                const TableSerializer *values) {
+    TracedTable *t = table;
+    return t->backend->save(t->table, path, keys, values);
+}
+
+Table *table_load(const char *path, CompareFunction *compare_function,
+                  const TableSerializer *keys,
+                  const TableSerializer *values) {
+    const TableBackend *b = backend != NULL ? backend : tablebackend_all[0];
+    Table *loaded = b->load(path, compare_function, keys, values);
+    if (loaded == NULL)
+        return NULL;
+    // The entries of a loaded table are not in the trace, so it is not
+    // traced
+    TracedTable *t = malloc(sizeof(TracedTable));
+    t->backend = b;
+    t->table = loaded;
+    t->recording = 0;
+    t->id = 0;
+    return t;
+}
@@ -0,0 +1,44 @@
+/*
+ * Recording shim for the table.h API.
+ *
+ * tracetable.c defines the table.h functions itself, so a program is
+ * traced by linking it with tracetable.c, trace.c and the benchmark
+ * backends (tablebackend.c, backend_*.c and what they need) instead of
+ * with one table implementation, for example
+ *
+ *   gcc -std=c99 -o program program.c tracetable.c trace.c \
+ *       nanoclock.c snapshot.c tablebackend.c backend_*.c dlist.c \
+ *       testprogram_table_as_array/array.c
+ *
+ * and calling tracetable_start before the first table is created. Every
+ * create, insert, lookup, remove and free is then written to the trace
+ * with its key and a timestamp before it is handed on to the chosen
+ * implementation. The trace can be played back with the replay tool.
+ * Tables created by table_load are not traced, their entries are not in
+ * the trace.
+ * Like the tables themselves the shim must not be used from several
+ * threads at once.
+ */
+
+#ifndef TRACETABLE_H
+#define TRACETABLE_H
+
+#include <stdbool.h>
+#include "trace.h"
+
+/* Starts recording. Tables created before the call are not recorded.
+ *  path    - The trace file to create.
+ *  backend - Name of the implementation the calls are handed on to, as
+ *            registered in tablebackend.c, NULL for the first one.
+ *  keyType - The type of the keys the program uses.
+ * Returns: false if the file could not be created or there is no such
+ *          implementation, nothing is recorded then. */
+bool tracetable_start(const char *path, const char *backend,
+                      TraceKeyType keyType);
+
+/* Stops recording and writes the end of the trace. Called at exit if
+ * the program does not.
+ * Returns: false if writing the trace failed. */
+bool tracetable_stop(void);
+
+#endif
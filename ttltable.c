@@ -0,0 +1,298 @@
+/*
+ * Tables whose entries expire, see ttltable.h.
+ *
+ * The table of the chosen implementation maps every key to a TtlEntry
+ * that holds the key, the value and the deadline, and is deallocated by
+ * this file rather than by the table. Each entry that expires is also in
+ * a doubly linked list of one slot of the timing wheel, so it can be
+ * taken out of the wheel when it is removed or replaced. The entries
+ * that never expire are in a list of their own, so all entries can be
+ * found when the table is deallocated.
+ *
+ * The wheel keeps the number of ticks it has turned since the table was
+ * created. An entry whose deadline is d ticks away goes in level l, the
+ * lowest level with d < TTL_WHEEL_SLOTS^(l+1), in the slot picked by
+ * bits 6l and up of the tick of its deadline. Each time the tick count
+ * reaches a multiple of TTL_WHEEL_SLOTS^l the current slot of level l is
+ * emptied into the levels below, the entries that expire at that very
+ * tick into the current slot of level 0. That slot is emptied last, and
+ * holds the entries that expire at that tick. Ticks with nothing to do are
+ * skipped, so a wheel that is turned seldom does not step through every
+ * tick it missed.
+ */
+
+#include <stdlib.h>
+#include "nanoclock.h"
+#include "ttltable.h"
+
+// Bits of the slot index in each level
+#define TTL_WHEEL_BITS 6
+
+#if (1 << TTL_WHEEL_BITS) != TTL_WHEEL_SLOTS
+#error "TTL_WHEEL_BITS does not match TTL_WHEEL_SLOTS"
+#endif
+
+typedef struct TtlEntry {
+    KEY key;
+    VALUE value;
+    unsigned long long deadline;        // by the clock, 0 for never
+    unsigned long long deadlineTick;    // rounded up to a whole tick
+    int level;                          // in the wheel, TTL_WHEEL_LEVELS
+                                        // if it never expires
+    int slot;
+    struct TtlEntry *prev;              // in the slot
+    struct TtlEntry *next;
+} TtlEntry;
+
+struct TtlTable {
+    TtlConfig config;
+    Table *table;
+    unsigned long long start;           // clock when created
+    unsigned long long now;             // ticks the wheel has turned
+    TtlEntry *wheel[TTL_WHEEL_LEVELS][TTL_WHEEL_SLOTS];
+    TtlEntry *forever;                  // the entries that never expire
+    size_t levelCount[TTL_WHEEL_LEVELS];
+    size_t size;
+    TtlStats stats;
+};
+
+/* Returns the ticks of one slot of a level
+ *    level - the level, or TTL_WHEEL_LEVELS for the reach of the wheel
+ */
+static unsigned long long span(int level) {
+    return 1ULL << (TTL_WHEEL_BITS*level);
+}
+
+/* Returns the list an entry is in
+ *    t - the table
+ *    e - the entry
+ */
+static TtlEntry **listOf(TtlTable *t, const TtlEntry *e) {
+    if (e->level == TTL_WHEEL_LEVELS)
+        return &t->forever;
+    return &t->wheel[e->level][e->slot];
+}
+
+/* Puts an entry first in its list
+ *    t - the table
+ *    e - the entry, with the level and slot set
+ */
+static void pushEntry(TtlTable *t, TtlEntry *e) {
+    TtlEntry **head = listOf(t, e);
+    e->prev = NULL;
+    e->next = *head;
+    if (e->next != NULL)
+        e->next->prev = e;
+    *head = e;
+    if (e->level < TTL_WHEEL_LEVELS)
+        t->levelCount[e->level]++;
+}
+
+/* Puts an entry in the slot of the wheel that holds its deadline
+ *    t - the table
+ *    e - the entry, in no list
+ */
+static void place(TtlTable *t, TtlEntry *e) {
+    // An entry moved down a level in the tick it expires goes in the
+    // current slot of level 0, which turn empties after the cascades
+    unsigned long long tick = e->deadlineTick > t->now ? e->deadlineTick :
+                                                         t->now;
+    int level = 0;
+    while (level < TTL_WHEEL_LEVELS-1 && tick-t->now >= span(level+1))
+        level++;
+    // Out of reach, moved down again when the wheel gets there
+    if (tick-t->now >= span(TTL_WHEEL_LEVELS))
+        tick = t->now+span(TTL_WHEEL_LEVELS)-1;
+    int slot = (tick >> (TTL_WHEEL_BITS*level)) & (TTL_WHEEL_SLOTS-1);
+    e->level = level;
+    e->slot = slot;
+    pushEntry(t, e);
+}
+
+/* Takes an entry out of its list
+ *    t - the table
+ *    e - the entry
+ */
+static void takeOut(TtlTable *t, TtlEntry *e) {
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        *listOf(t, e) = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    if (e->level < TTL_WHEEL_LEVELS)
+        t->levelCount[e->level]--;
+}
+
+/* Removes an entry from the table and the wheel and deallocates it
+ *    t - the table
+ *    e - the entry
+ */
+static void drop(TtlTable *t, TtlEntry *e) {
+    takeOut(t, e);
+    t->config.backend->remove(t->table, e->key);
+    t->config.keyFree(e->key);
+    t->config.valueFree(e->value);
+    free(e);
+    t->size--;
+}
+
+/* Moves the entries of the current slot of a level to the levels below
+ *    t - the table
+ *    level - the level
+ */
+static void cascade(TtlTable *t, int level) {
+    int slot = (t->now >> (TTL_WHEEL_BITS*level)) & (TTL_WHEEL_SLOTS-1);
+    while (t->wheel[level][slot] != NULL) {
+        TtlEntry *e = t->wheel[level][slot];
+        takeOut(t, e);
+        place(t, e);
+        t->stats.cascaded++;
+    }
+}
+
+/* Turns the wheel one tick and removes the entries that expire then
+ *    t - the table
+ * Returns
+ *    the number of entries removed
+ */
+static size_t turn(TtlTable *t) {
+    t->now++;
+    t->stats.ticks++;
+    for(int level=TTL_WHEEL_LEVELS-1;level>0;level--) {
+        if (t->now % span(level) == 0)
+            cascade(t, level);
+    }
+    size_t removed = 0;
+    TtlEntry **head = &t->wheel[0][t->now & (TTL_WHEEL_SLOTS-1)];
+    while (*head != NULL) {
+        TtlEntry *e = *head;
+        if (e->deadlineTick <= t->now) {
+            drop(t, e);
+            removed++;
+        } else {
+            takeOut(t, e);
+            place(t, e);
+        }
+    }
+    return removed;
+}
+
+TtlTable *ttltable_create(const TtlConfig *config) {
+    TtlTable *t = calloc(1, sizeof(TtlTable));
+    t->config = *config;
+    if (t->config.backend == NULL)
+        t->config.backend = tablebackend_find(TTL_DEFAULT_BACKEND);
+    if (t->config.keyFree == NULL)
+        t->config.keyFree = free;
+    if (t->config.valueFree == NULL)
+        t->config.valueFree = free;
+    if (t->config.tickNs == 0)
+        t->config.tickNs = TTL_DEFAULT_TICK_NS;
+    if (t->config.clock == NULL)
+        t->config.clock = nanoclock_now;
+    t->start = t->config.clock();
+
+    // The entries are deallocated here, not by the table
+    const TableBackend *b = t->config.backend;
+    t->table = b->create(config->compare);
+    b->setHashFunction(t->table, config->hash);
+    b->setKeyBytesFunction(t->table, config->keyBytes);
+    return t;
+}
+
+void ttltable_insert(TtlTable *t, KEY key, VALUE value,
+                     unsigned long long ttlNs) {
+    const TableBackend *b = t->config.backend;
+    TtlEntry *old = b->lookup(t->table, key);
+    if (old != NULL)
+        drop(t, old);
+
+    TtlEntry *e = malloc(sizeof(TtlEntry));
+    e->key = key;
+    e->value = value;
+    if (ttlNs == 0) {
+        e->deadline = 0;
+        e->level = TTL_WHEEL_LEVELS;
+        pushEntry(t, e);
+    } else {
+        unsigned long long tickNs = t->config.tickNs;
+        e->deadline = t->config.clock()+ttlNs;
+        e->deadlineTick = (e->deadline-t->start+tickNs-1)/tickNs;
+        place(t, e);
+    }
+    b->insert(t->table, key, e);
+    t->size++;
+}
+
+VALUE ttltable_lookup(TtlTable *t, KEY key) {
+    TtlEntry *e = t->config.backend->lookup(t->table, key);
+    if (e == NULL)
+        return NULL;
+    if (e->deadline != 0 && t->config.clock() >= e->deadline) {
+        drop(t, e);
+        t->stats.expiredByLookup++;
+        return NULL;
+    }
+    return e->value;
+}
+
+void ttltable_remove(TtlTable *t, KEY key) {
+    TtlEntry *e = t->config.backend->lookup(t->table, key);
+    if (e != NULL)
+        drop(t, e);
+}
+
+size_t ttltable_tick(TtlTable *t) {
+    unsigned long long target = (t->config.clock()-t->start) /
+                                t->config.tickNs;
+    size_t removed = 0;
+    while (t->now < target) {
+        int lowest = 0;
+        while (lowest < TTL_WHEEL_LEVELS && t->levelCount[lowest] == 0)
+            lowest++;
+        if (lowest == TTL_WHEEL_LEVELS) {
+            t->stats.ticks += target-t->now;
+            t->now = target;
+            break;
+        }
+        if (lowest > 0) {
+            // Nothing happens before the next slot of that level
+            unsigned long long next = (t->now/span(lowest)+1)*span(lowest);
+            unsigned long long skip = (next < target ? next : target) -
+                                      1-t->now;
+            t->now += skip;
+            t->stats.ticks += skip;
+        }
+        removed += turn(t);
+    }
+    t->stats.expiredByTick += removed;
+    return removed;
+}
+
+size_t ttltable_size(const TtlTable *t) {
+    return t->size;
+}
+
+void ttltable_getStats(const TtlTable *t, TtlStats *stats) {
+    *stats = t->stats;
+}
+
+void ttltable_free(TtlTable *t) {
+    // The table only holds pointers to the entries
+    t->config.backend->free(t->table);
+    for(int level=0;level<=TTL_WHEEL_LEVELS;level++) {
+        for(int slot=0;slot<TTL_WHEEL_SLOTS;slot++) {
+            TtlEntry *e = level < TTL_WHEEL_LEVELS ? t->wheel[level][slot] :
+                          slot == 0 ? t->forever : NULL;
+            while (e != NULL) {
+                TtlEntry *next = e->next;
+                t->config.keyFree(e->key);
+                t->config.valueFree(e->value);
+                free(e);
+                e = next;
+            }
+        }
+    }
+    free(t);
+}
@@ -0,0 +1,120 @@
+/*
+ * Tables whose entries expire after a time to live.
+ *
+ * A TtlTable is a table of one of the implementations registered in
+ * tablebackend.c whose entries may be given a time to live when they are
+ * inserted. An entry whose time is up is invisible to ttltable_lookup at
+ * once, and is removed from the table the first time a lookup meets it
+ * or ttltable_tick passes it, whichever comes first.
+ *
+ * The entries that will expire are kept in a hierarchical timing wheel.
+ * The wheel turns one slot per tick of tickNs nanoseconds, and has
+ * levels of TTL_WHEEL_SLOTS slots, each level a tick TTL_WHEEL_SLOTS
+ * times longer than the one below it. An entry is put in the slot of the
+ * level that holds its deadline, and moves down a level each time the
+ * wheel reaches its slot, so every entry is moved at most once per level
+ * before it expires. Together with the remove from the table, which is
+ * constant time for the hash tables, expiring an entry thus costs
+ * amortized constant time. The deadlines are rounded up to whole ticks,
+ * an entry is never removed before its time is up.
+ *
+ * Nothing runs in the background. A single-threaded program calls
+ * ttltable_tick periodically, for example from its event loop, to
+ * reclaim the entries no lookup meets. Like the tables themselves a
+ * TtlTable must not be used from several threads at once.
+ *
+ * Build with the benchmark backends, for example
+ *   gcc -std=c99 -o program program.c ttltable.c nanoclock.c snapshot.c \
+ *       tablebackend.c backend_*.c dlist.c \
+ *       testprogram_table_as_array/array.c
+ */
+
+#ifndef TTLTABLE_H
+#define TTLTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "tablebackend.h"
+
+// Length of a tick if the settings do not say, 1 ms
+#define TTL_DEFAULT_TICK_NS 1000000ULL
+// Table implementation if the settings do not say, see tablebackend.c
+#define TTL_DEFAULT_BACKEND "swiss"
+// Slots in each level of the timing wheel, a power of two
+#define TTL_WHEEL_SLOTS 64
+// Levels of the timing wheel, deadlines past the last level are moved
+// down once the wheel gets within reach of them
+#define TTL_WHEEL_LEVELS 4
+
+/* Type for function reading the clock in nanoseconds */
+typedef unsigned long long TtlClock(void);
+
+/* Settings of a table with expiry, members left 0 get the defaults */
+typedef struct TtlConfig {
+    const TableBackend *backend;    // NULL for TTL_DEFAULT_BACKEND
+    CompareFunction *compare;
+    HashFunction *hash;             // for the hash tables
+    KeyBytesFunction *keyBytes;     // for the tables of key bytes
+    KeyFreeFunc *keyFree;           // NULL for free
+    ValueFreeFunc *valueFree;       // NULL for free
+    unsigned long long tickNs;      // 0 for TTL_DEFAULT_TICK_NS
+    TtlClock *clock;                // NULL for nanoclock_now
+} TtlConfig;
+
+/* What a table with expiry has done since it was created */
+typedef struct TtlStats {
+    unsigned long long expiredByLookup;     // met expired by a lookup
+    unsigned long long expiredByTick;       // reclaimed by the wheel
+    unsigned long long cascaded;            // entries moved down a level
+    unsigned long long ticks;               // slots the wheel turned
+} TtlStats;
+
+typedef struct TtlTable TtlTable;
+
+/* Creates an empty table with expiry.
+ *  config - The settings, copied.
+ * Returns: The table. */
+TtlTable *ttltable_create(const TtlConfig *config);
+
+/* Inserts a key and value pair into the table, replacing the entry of
+ * the key if there is one.
+ *  t     - The table.
+ *  key   - The key, owned by the table.
+ *  value - The value, owned by the table.
+ *  ttlNs - Nanoseconds until the entry expires, 0 for never. */
+void ttltable_insert(TtlTable *t, KEY key, VALUE value,
+                     unsigned long long ttlNs);
+
+/* Looks up a key in the table, removing its entry if it has expired.
+ *  t   - The table.
+ *  key - The key to look up.
+ * Returns: The value of the key, NULL if it is not in the table or has
+ *          expired. */
+VALUE ttltable_lookup(TtlTable *t, KEY key);
+
+/* Removes a key from the table.
+ *  t   - The table.
+ *  key - The key to remove. */
+void ttltable_remove(TtlTable *t, KEY key);
+
+/* Turns the timing wheel up to the current time, removing the entries
+ * that have expired.
+ *  t - The table.
+ * Returns: The number of entries removed. */
+size_t ttltable_tick(TtlTable *t);
+
+/* Returns: The number of entries in the table. Expired entries are
+ *          counted until a lookup or a tick removes them.
+ *  t - The table. */
+size_t ttltable_size(const TtlTable *t);
+
+/* Returns what a table has done since it was created.
+ *  t     - The table.
+ *  stats - The statistics are stored here. */
+void ttltable_getStats(const TtlTable *t, TtlStats *stats);
+
+/* Deallocates the table and all its entries.
+ *  t - The table. */
+void ttltable_free(TtlTable *t);
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ * Tests that the entries of ttltable.c are reclaimed by the timing wheel
+ * at the tick of their deadline, in particular deadlines on the
+ * boundaries of the levels of the wheel, where the entries are moved
+ * down a level in the same tick they expire.
+ *
+ * The table reads a clock of its own that the test sets, so nothing
+ * sleeps. For every deadline an entry is inserted some ticks into the
+ * life of a new table, the clock is set to the tick before the deadline,
+ * where the entry must still be there, and then to the deadline, where
+ * ttltable_tick must remove it.
+ *
+ * Build with
+ *   gcc -std=c99 -O2 -o ttltest ttltest.c ttltable.c testkeys.c rng.c \
+ *       nanoclock.c snapshot.c tablebackend.c backend_*.c dlist.c \
+ *       testprogram_table_as_array/array.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "testkeys.h"
+#include "ttltable.h"
+
+// Length of a tick of the tables
+#define TICK_NS 1000ULL
+// Clock when the tables are created
+#define START_NS 1000000ULL
+
+// The clock the tables read
+static unsigned long long fakeNow;
+
+/* Returns the time set by the test */
+static unsigned long long fakeClock(void) {
+    return fakeNow;
+}
+
+/* Checks that an entry is reclaimed at the tick of its deadline
+ *    b - the table implementation
+ *    insertTick - the tick the entry is inserted at
+ *    deadlineTick - the tick the entry expires at
+ * Returns
+ *    false if the entry was reclaimed too early or too late
+ */
+static bool expiresOnTime(const TableBackend *b,
+                          unsigned long long insertTick,
+                          unsigned long long deadlineTick) {
+    TtlConfig config = {
+        .backend = b,
+        .compare = compareInt,
+        .hash = hashInt,
+        .keyBytes = keyBytesInt,
+        .tickNs = TICK_NS,
+        .clock = fakeClock
+    };
+    bool ok = true;
+    fakeNow = START_NS;
+    TtlTable *t = ttltable_create(&config);
+
+    fakeNow = START_NS+insertTick*TICK_NS;
+    ttltable_tick(t);
+    ttltable_insert(t, intPtrFromInt(1), intPtrFromInt(1),
+                    (deadlineTick-insertTick)*TICK_NS);
+    fakeNow = START_NS+(deadlineTick-1)*TICK_NS;
+    if (ttltable_tick(t) != 0 || ttltable_size(t) != 1) {
+        fprintf(stderr, "Inserted at tick %llu, expiring at tick %llu: "
+                "reclaimed early\n", insertTick, deadlineTick);
+        ok = false;
+    }
+    fakeNow = START_NS+deadlineTick*TICK_NS;
+    if (ok && (ttltable_tick(t) != 1 || ttltable_size(t) != 0)) {
+        fprintf(stderr, "Inserted at tick %llu, expiring at tick %llu: "
+                "not reclaimed at its deadline\n", insertTick,
+                deadlineTick);
+        ok = false;
+    }
+    ttltable_free(t);
+    return ok;
+}
+
+int main(void) {
+    const TableBackend *b = tablebackend_find(TTL_DEFAULT_BACKEND);
+    const unsigned long long insertTicks[] = {0, 1, 37, 63};
+    unsigned long long boundary = 1;
+    bool ok = true;
+
+    // The deadline is the first tick of a slot of every level, and the
+    // ticks on either side of it. A time to live of 0 never expires.
+    for(int level=1;level<=TTL_WHEEL_LEVELS;level++) {
+        boundary *= TTL_WHEEL_SLOTS;
+        for(int i=0;i<4;i++) {
+            for(int d=-1;d<=1;d++) {
+                if (boundary+d > insertTicks[i])
+                    ok &= expiresOnTime(b, insertTicks[i], boundary+d);
+            }
+        }
+    }
+    if (!ok)
+        return EXIT_FAILURE;
+    printf("Entries are reclaimed at the tick of their deadline on the "
+           "boundaries of the wheel - OK\n");
+    return EXIT_SUCCESS;
+}
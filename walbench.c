@@ -0,0 +1,356 @@
+/*
+ * Measures the durable tables of waltable.c with each sync policy.
+ *
+ * For every policy the same stream of inserts and removes is done on a
+ * new durable table in a temporary directory and the throughput and the
+ * number of flushes to the disk are reported, showing what committing
+ * the log in groups saves. The table is then closed and opened again
+ * from its log, compacted into a snapshot and opened again from the
+ * snapshot, and after each reopening every key is looked up to check
+ * that nothing was lost. Run with --help for the options.
+ *
+ * Build with
+ *   gcc -std=c99 -O2 -o walbench walbench.c waltable.c snapshot.c \
+ *       testkeys.c rng.c nanoclock.c tablebackend.c backend_*.c dlist.c \
+ *       testprogram_table_as_array/array.c
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "nanoclock.h"
+#include "testkeys.h"
+#include "waltable.h"
+
+// Share of the operations that remove a key in the table
+#define REMOVE_SHARE 0.2
+
+/* The sync policies that are measured */
+static const struct {
+    const char *name;
+    WalSync sync;
+    int groupSize;
+} policies[] = {
+    {"always", WAL_SYNC_ALWAYS, 1},
+    {"group 8", WAL_SYNC_GROUP, 8},
+    {"group 64", WAL_SYNC_GROUP, 64},
+    {"group 512", WAL_SYNC_GROUP, 512},
+    {"none", WAL_SYNC_NONE, 64}
+};
+#define NUM_POLICIES (int)(sizeof(policies)/sizeof(policies[0]))
+
+/* Settings from the command line */
+typedef struct WalBenchConfig {
+    int n;                  // number of operations
+    KeyType keyType;
+    int keyLength;
+    unsigned long long seed;
+    const char *backend;    // NULL for WAL_DEFAULT_BACKEND
+    const char *dir;        // where the temporary tables are made
+} WalBenchConfig;
+
+/* The operations of a run, decided before it starts */
+typedef struct Plan {
+    int n;
+    bool *removes;          // the i:th operation is a remove
+    int *keys;              // the key of the i:th operation
+    bool *present;          // the keys in the table at the end
+} Plan;
+
+/* Decides the operations, every insert has a new key and every remove
+ * a key in the table
+ *    n - the number of operations
+ *    rng - the random numbers
+ * Returns
+ *    the plan, deallocated with freePlan
+ */
+static Plan createPlan(int n, Rng *rng) {
+    Plan p = {.n = n, .removes = malloc(n*sizeof(bool)),
+              .keys = malloc(n*sizeof(int)),
+              .present = calloc(n, sizeof(bool))};
+    int *live = malloc(n*sizeof(int));
+    int numLive = 0, numKeys = 0;
+    for(int i=0;i<n;i++) {
+        p.removes[i] = numLive > 0 && rng_double(rng) < REMOVE_SHARE;
+        if (p.removes[i]) {
+            int j = rng_below(rng, numLive);
+            p.keys[i] = live[j];
+            p.present[live[j]] = false;
+            live[j] = live[--numLive];
+        } else {
+            p.keys[i] = numKeys;
+            p.present[numKeys] = true;
+            live[numLive++] = numKeys++;
+        }
+    }
+    free(live);
+    return p;
+}
+
+/* Deallocates a plan
+ *    p - the plan
+ */
+static void freePlan(Plan *p) {
+    free(p->removes);
+    free(p->keys);
+    free(p->present);
+}
+
+/* Checks that a table holds the keys the plan leaves in it
+ *    t - the table
+ *    p - the plan
+ *    ks - the keys
+ * Returns
+ *    the number of keys with the wrong value or missing
+ */
+static int verify(WalTable *t, const Plan *p, KeySet *ks) {
+    int wrong = 0;
+    for(int i=0;i<p->n;i++) {
+        int *value = waltable_lookup(t, ks->keys[i]);
+        if (p->present[i] ? value == NULL || *value != i : value != NULL)
+            wrong++;
+    }
+    return wrong;
+}
+
+/* Opens a table and prints why if it fails
+ *    path - the files of the table
+ *    config - the settings of the table
+ * Returns
+ *    the table, exits if it could not be opened
+ */
+static WalTable *openOrExit(const char *path, const WalConfig *config) {
+    WalTable *t = waltable_open(path, config);
+    if (t == NULL) {
+        fprintf(stderr, "Could not open the table %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    return t;
+}
+
+/* Runs the plan with one sync policy and prints a line of results
+ *    config - the settings
+ *    b - the table implementation
+ *    policy - index into policies
+ *    p - the operations
+ *    ks - the keys
+ * Returns
+ *    false if a reopened table did not hold the right entries
+ */
+static bool runPolicy(const WalBenchConfig *config, const TableBackend *b,
+                      int policy, const Plan *p, KeySet *ks) {
+    char dir[4096];
+    char path[4096+16];
+    snprintf(dir, sizeof(dir), "%s/walbench-XXXXXX", config->dir);
+    if (mkdtemp(dir) == NULL) {
+        perror(dir);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(path, sizeof(path), "%s/table", dir);
+    WalConfig wc = {
+        .backend = b,
+        .compare = compareFunctionFor(config->keyType),
+        .keys = serializerFor(config->keyType),
+        .values = serializerFor(KEY_INT),
+        .sync = policies[policy].sync,
+        .groupSize = policies[policy].groupSize
+    };
+
+    // The keys and values handed over to the table are made before the
+    // time starts
+    void **keys = malloc(p->n*sizeof(void *));
+    int **values = malloc(p->n*sizeof(int *));
+    for(int i=0;i<p->n;i++) {
+        if (!p->removes[i]) {
+            keys[i] = copyKey(ks, p->keys[i]);
+            values[i] = intPtrFromInt(p->keys[i]);
+        }
+    }
+
+    WalStats stats;
+    WalTable *t = openOrExit(path, &wc);
+    unsigned long long start = nanoclock_now();
+    for(int i=0;i<p->n;i++) {
+        if (p->removes[i])
+            waltable_remove(t, ks->keys[p->keys[i]]);
+        else
+            waltable_insert(t, keys[i], values[i]);
+    }
+    bool ok = waltable_sync(t);
+    unsigned long long ns = nanoclock_now()-start;
+    waltable_getStats(t, &stats);
+    ok = waltable_close(t) && ok;
+    free(keys);
+    free(values);
+
+    // Reopening replays the log
+    start = nanoclock_now();
+    t = openOrExit(path, &wc);
+    unsigned long long replayNs = nanoclock_now()-start;
+    int wrong = verify(t, p, ks);
+    start = nanoclock_now();
+    ok = waltable_compact(t) && ok;
+    unsigned long long compactNs = nanoclock_now()-start;
+    ok = waltable_close(t) && ok;
+
+    // and after the compaction loads the snapshot
+    start = nanoclock_now();
+    t = openOrExit(path, &wc);
+    unsigned long long loadNs = nanoclock_now()-start;
+    wrong += verify(t, p, ks);
+    waltable_close(t);
+
+    printf("%-10s %10.1f %10.0f %8llu %10llu %10.3f %10.3f %10.3f  %s\n",
+           policies[policy].name, (double)ns/p->n, p->n*1e9/ns, stats.syncs,
+           stats.logBytes, replayNs/1e6, compactNs/1e6, loadNs/1e6,
+           !ok ? "I/O ERROR" : wrong > 0 ? "LOST ENTRIES" : "ok");
+
+    char file[4096+32];
+    snprintf(file, sizeof(file), "%s.wal", path);
+    remove(file);
+    snprintf(file, sizeof(file), "%s.snap", path);
+    remove(file);
+    rmdir(dir);
+    return ok && wrong == 0;
+}
+
+/* Prints the command line options
+ *    out - the stream to print to
+ *    program - the name of the program
+ */
+static void usage(FILE *out, const char *program) {
+    fprintf(out,
+        "Usage: %s [options]\n"
+        "  -n, --ops N           number of inserts and removes (default "
+        "10000)\n"
+        "  -x, --backend NAME    table implementation to use (default "
+        WAL_DEFAULT_BACKEND ")\n"
+        "  -L, --list            list the table implementations\n"
+        "  -k, --keys TYPE       int or string (default int)\n"
+        "  -l, --key-length N    length of string keys (default 16)\n"
+        "  -s, --seed N          seed of the random numbers (default 1)\n"
+        "  -d, --dir DIR         where the tables are made (default /tmp)\n"
+        "  -h, --help            show this text\n", program);
+}
+
+/* Fills in the settings from the command line, prints the usage and
+ * exits for --help and on errors
+ *    argc, argv - the arguments given to main
+ *    config - the settings to fill in
+ */
+static void parseArguments(int argc, char *argv[], WalBenchConfig *config) {
+    static const struct option options[] = {
+        {"ops", required_argument, NULL, 'n'},
+        {"backend", required_argument, NULL, 'x'},
+        {"list", no_argument, NULL, 'L'},
+        {"keys", required_argument, NULL, 'k'},
+        {"key-length", required_argument, NULL, 'l'},
+        {"seed", required_argument, NULL, 's'},
+        {"dir", required_argument, NULL, 'd'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    char *end;
+
+    *config = (WalBenchConfig){.n = 10000, .keyType = KEY_INT,
+                               .keyLength = 16, .seed = 1, .dir = "/tmp"};
+    while ((opt = getopt_long(argc, argv, "n:x:Lk:l:s:d:h", options,
+                              NULL)) != -1) {
+        switch (opt) {
+        case 'n':
+            config->n = strtol(optarg, &end, 10);
+            if (*end != '\0' || config->n <= 0) {
+                fprintf(stderr, "Invalid value for --ops: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'x':
+            config->backend = optarg;
+            break;
+        case 'L':
+            for(int i=0;tablebackend_all[i]!=NULL;i++)
+                printf("%s\n", tablebackend_all[i]->name);
+            exit(EXIT_SUCCESS);
+        case 'k':
+            if (strcmp(optarg, "int") == 0)
+                config->keyType = KEY_INT;
+            else if (strcmp(optarg, "string") == 0)
+                config->keyType = KEY_STRING;
+            else {
+                fprintf(stderr, "Unknown key type: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'l':
+            config->keyLength = strtol(optarg, &end, 10);
+            if (*end != '\0' || config->keyLength <= 0) {
+                fprintf(stderr, "Invalid value for --key-length: %s\n",
+                        optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 's':
+            config->seed = strtoull(optarg, &end, 10);
+            if (*end != '\0') {
+                fprintf(stderr, "Invalid value for --seed: %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'd':
+            config->dir = optarg;
+            break;
+        case 'h':
+            usage(stdout, argv[0]);
+            exit(EXIT_SUCCESS);
+        default:
+            usage(stderr, argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc) {
+        usage(stderr, argv[0]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    WalBenchConfig config;
+    Rng rng;
+
+    parseArguments(argc, argv, &config);
+    const TableBackend *b = config.backend != NULL ?
+        tablebackend_find(config.backend) :
+        tablebackend_find(WAL_DEFAULT_BACKEND);
+    if (b == NULL) {
+        fprintf(stderr, "Unknown backend: %s\n", config.backend);
+        return EXIT_FAILURE;
+    }
+    if (b->maxEntries != 0 && b->maxEntries < config.n) {
+        fprintf(stderr, "%s holds at most %d entries\n", b->name,
+                b->maxEntries);
+        return EXIT_FAILURE;
+    }
+
+    rng_seed(&rng, config.seed);
+    KeySet *ks = createKeySet(config.keyType, config.keyLength, config.n,
+                              &rng);
+    Plan plan = createPlan(config.n, &rng);
+
+    printf("%d inserts and removes on %s with %s keys in %s\n\n", config.n,
+           b->name, config.keyType == KEY_STRING ? "string" : "int",
+           config.dir);
+    printf("%-10s %10s %10s %8s %10s %10s %10s %10s\n", "policy", "ns/op",
+           "ops/s", "syncs", "log bytes", "replay ms", "compact ms",
+           "load ms");
+    bool ok = true;
+    for(int i=0;i<NUM_POLICIES;i++)
+        ok = runPolicy(&config, b, i, &plan, ks) && ok;
+
+    freePlan(&plan);
+    freeKeySet(ks);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,559 @@
+/*
+ * Durable tables kept in a write-ahead log, see waltable.h.
+ *
+ * The log starts with the magic "TBLWAL01" and the fixed sizes of the
+ * keys and the values as 4 bytes little endian each, 0 for items whose
+ * size varies, like a snapshot. Then come the records:
+ *
+ *   op         1 byte, 'I' for insert or 'R' for remove
+ *   key        the key bytes, preceded by their size as a varint if the
+ *              size varies
+ *   value      only for insert, stored like the key
+ *   checksum   4 bytes, FNV-1a of the bytes of the record before it
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "nanoclock.h"
+#include "waltable.h"
+
+#define WAL_MAGIC "TBLWAL01"
+#define WAL_MAGIC_LENGTH 8
+#define WAL_HEADER_LENGTH (WAL_MAGIC_LENGTH+4+4)
+#define WAL_INSERT 'I'
+#define WAL_REMOVE 'R'
+#define WAL_CHECKSUM_LENGTH 4
+
+struct WalTable {
+    WalConfig config;
+    Table *table;
+    char *logPath;
+    char *snapshotPath;
+    char *tmpPath;              // the new snapshot while it is written
+    int fd;                     // the log
+    unsigned char *group;       // the records not yet written
+    size_t groupLength;
+    size_t groupCapacity;
+    int groupRecords;
+    unsigned long long groupStart;  // time of the first record in the group
+    bool failed;                // writing the log has failed
+    WalStats stats;
+};
+
+/* Computes the FNV-1a checksum of a record
+ *    bytes - the record
+ *    length - the number of bytes
+ * Returns
+ *    the checksum
+ */
+static unsigned int checksum(const unsigned char *bytes, size_t length) {
+    unsigned int hash = 2166136261u;
+    for(size_t i=0;i<length;i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Makes room for more bytes at the end of the group
+ *    t - the table
+ *    length - the number of bytes
+ * Returns
+ *    where the bytes go
+ */
+static unsigned char *reserve(WalTable *t, size_t length) {
+    if (t->groupLength+length > t->groupCapacity) {
+        while (t->groupLength+length > t->groupCapacity)
+            t->groupCapacity *= 2;
+        t->group = realloc(t->group, t->groupCapacity);
+    }
+    unsigned char *bytes = t->group+t->groupLength;
+    t->groupLength += length;
+    return bytes;
+}
+
+/* Stores a number as little endian bytes
+ *    bytes - where the number goes
+ *    value - the number
+ *    length - the number of bytes
+ */
+static void putLittleEndian(unsigned char *bytes, unsigned long long value,
+                            int length) {
+    for(int b=0;b<length;b++)
+        bytes[b] = (value >> 8*b) & 0xff;
+}
+
+/* Reads a number stored as little endian bytes
+ *    bytes - the bytes
+ *    length - the number of bytes
+ * Returns
+ *    the number
+ */
+static unsigned long long getLittleEndian(const unsigned char *bytes,
+                                          int length) {
+    unsigned long long value = 0;
+    for(int b=0;b<length;b++)
+        value |= (unsigned long long)bytes[b] << 8*b;
+    return value;
+}
+
+/* Appends a key or a value to the group
+ *    t - the table
+ *    s - the serializer of the item
+ *    item - the item
+ */
+static void appendItem(WalTable *t, const TableSerializer *s,
+                       const void *item) {
+    size_t size = s->fixedSize;
+    if (size == 0) {
+        size = s->size(item);
+        unsigned long long v = size;
+        while (v >= 0x80) {
+            *reserve(t, 1) = (v & 0x7f) | 0x80;
+            v >>= 7;
+        }
+        *reserve(t, 1) = v;
+    }
+    unsigned char *bytes = reserve(t, size);
+    if (s->write == NULL)
+        memcpy(bytes, item, size);
+    else
+        s->write(item, bytes);
+}
+
+/* Finds the next key or value in a log
+ *    data - the log
+ *    length - the number of bytes in the log
+ *    pos - the position of the item, moved past it
+ *    s - the serializer of the item
+ *    size - the size of the item is stored here
+ * Returns
+ *    the bytes of the item, NULL if the log ends before the item does
+ */
+static const unsigned char *nextItem(const unsigned char *data,
+                                     size_t length, size_t *pos,
+                                     const TableSerializer *s,
+                                     size_t *size) {
+    unsigned long long itemLength = s->fixedSize;
+    if (itemLength == 0) {
+        int shift = 0;
+        for(;;) {
+            if (*pos == length || shift >= 64)
+                return NULL;
+            unsigned char byte = data[(*pos)++];
+            itemLength |= (unsigned long long)(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                break;
+            shift += 7;
+        }
+    }
+    if (itemLength > length-*pos)
+        return NULL;
+    const unsigned char *bytes = data+*pos;
+    *pos += itemLength;
+    *size = itemLength;
+    return bytes;
+}
+
+/* Creates a key or a value from its bytes
+ *    s - the serializer of the item
+ *    bytes - the bytes
+ *    size - the number of bytes
+ * Returns
+ *    the item
+ */
+static void *readItem(const TableSerializer *s, const unsigned char *bytes,
+                      size_t size) {
+    if (s->read != NULL)
+        return s->read(bytes, size);
+    void *item = malloc(size > 0 ? size : 1);
+    memcpy(item, bytes, size);
+    return item;
+}
+
+/* Writes all of a buffer to a file
+ *    fd - the file
+ *    bytes - the buffer
+ *    length - the number of bytes
+ * Returns
+ *    false if the write failed
+ */
+static bool writeAll(int fd, const unsigned char *bytes, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, bytes, length);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        bytes += n;
+        length -= n;
+    }
+    return true;
+}
+
+/* Writes the group to the log and flushes it to the disk as the sync
+ * policy says
+ *    t - the table
+ */
+static void commit(WalTable *t) {
+    if (t->groupRecords == 0)
+        return;
+    if (!t->failed) {
+        if (!writeAll(t->fd, t->group, t->groupLength)) {
+            perror(t->logPath);
+            t->failed = true;
+        } else if (t->config.sync != WAL_SYNC_NONE) {
+            t->stats.syncs++;
+            if (fdatasync(t->fd) != 0) {
+                perror(t->logPath);
+                t->failed = true;
+            }
+        }
+    }
+    t->stats.commits++;
+    t->stats.logBytes += t->groupLength;
+    t->groupLength = 0;
+    t->groupRecords = 0;
+}
+
+/* Ends a record in the group with its checksum and commits the group if
+ * it is complete
+ *    t - the table
+ *    start - where the record starts in the group
+ */
+static void endRecord(WalTable *t, size_t start) {
+    unsigned int sum = checksum(t->group+start, t->groupLength-start);
+    putLittleEndian(reserve(t, WAL_CHECKSUM_LENGTH), sum,
+                    WAL_CHECKSUM_LENGTH);
+    t->stats.records++;
+    if (t->groupRecords++ == 0 && t->config.groupNs > 0)
+        t->groupStart = nanoclock_now();
+    if (t->config.sync == WAL_SYNC_ALWAYS ||
+        t->groupRecords >= t->config.groupSize ||
+        (t->config.groupNs > 0 &&
+         nanoclock_now()-t->groupStart >= t->config.groupNs))
+        commit(t);
+    if (t->config.compactBytes > 0 &&
+        t->stats.logBytes >= t->config.compactBytes)
+        waltable_compact(t);
+}
+
+/* Empties the log, leaving only its header
+ *    t - the table
+ * Returns
+ *    false if the log could not be written
+ */
+static bool resetLog(WalTable *t) {
+    unsigned char header[WAL_HEADER_LENGTH];
+    memcpy(header, WAL_MAGIC, WAL_MAGIC_LENGTH);
+    putLittleEndian(header+WAL_MAGIC_LENGTH, t->config.keys->fixedSize, 4);
+    putLittleEndian(header+WAL_MAGIC_LENGTH+4, t->config.values->fixedSize,
+                    4);
+    t->stats.syncs++;
+    if (ftruncate(t->fd, 0) != 0 || lseek(t->fd, 0, SEEK_SET) != 0 ||
+        !writeAll(t->fd, header, WAL_HEADER_LENGTH) ||
+        fdatasync(t->fd) != 0) {
+        perror(t->logPath);
+        return false;
+    }
+    t->stats.logBytes = WAL_HEADER_LENGTH;
+    return true;
+}
+
+/* Reads the whole log
+ *    t - the table
+ *    length - the number of bytes is stored here
+ * Returns
+ *    the bytes of the log, NULL if it could not be read
+ */
+static unsigned char *readLog(WalTable *t, size_t *length) {
+    size_t capacity = 1<<16;
+    unsigned char *data = malloc(capacity);
+    ssize_t n;
+    *length = 0;
+    while ((n = read(t->fd, data+*length, capacity-*length)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror(t->logPath);
+            free(data);
+            return NULL;
+        }
+        *length += n;
+        if (*length == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+    return data;
+}
+
+/* Applies the records of the log to the table and cuts the log off
+ * after the last complete record
+ *    t - the table
+ * Returns
+ *    false if the log could not be read or was written with other
+ *    serializers
+ */
+static bool replay(WalTable *t) {
+    const TableSerializer *keys = t->config.keys;
+    const TableSerializer *values = t->config.values;
+    size_t length;
+    unsigned char *data = readLog(t, &length);
+    if (data == NULL)
+        return false;
+    if (length == 0) {
+        free(data);
+        return resetLog(t);
+    }
+    if (length < WAL_HEADER_LENGTH ||
+        memcmp(data, WAL_MAGIC, WAL_MAGIC_LENGTH) != 0) {
+        fprintf(stderr, "%s: not a table log\n", t->logPath);
+        free(data);
+        return false;
+    }
+    if (getLittleEndian(data+WAL_MAGIC_LENGTH, 4) != keys->fixedSize ||
+        getLittleEndian(data+WAL_MAGIC_LENGTH+4, 4) != values->fixedSize) {
+        fprintf(stderr, "%s: the keys or values have other sizes than the "
+                "log\n", t->logPath);
+        free(data);
+        return false;
+    }
+
+    size_t pos = WAL_HEADER_LENGTH;
+    while (pos < length) {
+        size_t start = pos, keySize, valueSize = 0;
+        const unsigned char *key = NULL, *value = NULL;
+        unsigned char op = data[pos++];
+        if (op == WAL_INSERT || op == WAL_REMOVE)
+            key = nextItem(data, length, &pos, keys, &keySize);
+        if (key != NULL && op == WAL_INSERT)
+            value = nextItem(data, length, &pos, values, &valueSize);
+        if (key == NULL || (op == WAL_INSERT && value == NULL) ||
+            length-pos < WAL_CHECKSUM_LENGTH ||
+            getLittleEndian(data+pos, WAL_CHECKSUM_LENGTH) !=
+                checksum(data+start, pos-start)) {
+            pos = start;
+            break;
+        }
+        pos += WAL_CHECKSUM_LENGTH;
+        if (op == WAL_INSERT) {
+            t->config.backend->insert(t->table, readItem(keys, key, keySize),
+                                      readItem(values, value, valueSize));
+        } else {
+            void *removed = readItem(keys, key, keySize);
+            t->config.backend->remove(t->table, removed);
+            t->config.keyFree(removed);
+        }
+        t->stats.replayed++;
+    }
+    free(data);
+
+    // A record the program was writing when it stopped
+    if (pos < length) {
+        fprintf(stderr, "%s: dropping %zu bytes of an incomplete record\n",
+                t->logPath, length-pos);
+        t->stats.syncs++;
+        if (ftruncate(t->fd, pos) != 0 || fdatasync(t->fd) != 0) {
+            perror(t->logPath);
+            return false;
+        }
+    }
+    if (lseek(t->fd, pos, SEEK_SET) < 0) {
+        perror(t->logPath);
+        return false;
+    }
+    t->stats.logBytes = pos;
+    return true;
+}
+
+/* Allocates a path with a suffix
+ *    path - the path
+ *    suffix - the suffix
+ * Returns
+ *    the new path, deallocated with free
+ */
+static char *withSuffix(const char *path, const char *suffix) {
+    char *s = malloc(strlen(path)+strlen(suffix)+1);
+    strcpy(s, path);
+    strcat(s, suffix);
+    return s;
+}
+
+/* Flushes a file to the disk
+ *    path - the file, or a directory
+ * Returns
+ *    false if it failed
+ */
+static bool syncPath(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+/* Flushes the directory holding a file to the disk, so a rename in it is
+ * durable
+ *    path - the file
+ * Returns
+ *    false if it failed
+ */
+static bool syncDirectory(const char *path) {
+    const char *slash = strrchr(path, '/');
+    if (slash == NULL)
+        return syncPath(".");
+    if (slash == path)
+        return syncPath("/");
+    char *dir = malloc(slash-path+1);
+    memcpy(dir, path, slash-path);
+    dir[slash-path] = '\0';
+    bool ok = syncPath(dir);
+    free(dir);
+    return ok;
+}
+
+/* Deallocates a table and its paths
+ *    t - the table
+ */
+static void freeTable(WalTable *t) {
+    if (t->table != NULL)
+        t->config.backend->free(t->table);
+    if (t->fd >= 0)
+        close(t->fd);
+    free(t->logPath);
+    free(t->snapshotPath);
+    free(t->tmpPath);
+    free(t->group);
+    free(t);
+}
+
+WalTable *waltable_open(const char *path, const WalConfig *config) {
+    WalTable *t = calloc(1, sizeof(WalTable));
+    t->config = *config;
+    if (t->config.backend == NULL)
+        t->config.backend = tablebackend_find(WAL_DEFAULT_BACKEND);
+    if (t->config.keyFree == NULL)
+        t->config.keyFree = free;
+    if (t->config.valueFree == NULL)
+        t->config.valueFree = free;
+    if (t->config.groupSize <= 0)
+        t->config.groupSize = WAL_DEFAULT_GROUP_SIZE;
+    t->logPath = withSuffix(path, ".wal");
+    t->snapshotPath = withSuffix(path, ".snap");
+    t->tmpPath = withSuffix(path, ".snap.tmp");
+    t->groupCapacity = 4096;
+    t->group = malloc(t->groupCapacity);
+    t->fd = -1;
+
+    const TableBackend *b = t->config.backend;
+    if (access(t->snapshotPath, F_OK) == 0) {
+        t->table = b->load(t->snapshotPath, config->compare,
+                           config->keys, config->values);
+        if (t->table == NULL) {
+            freeTable(t);
+            return NULL;
+        }
+    } else {
+        t->table = b->create(config->compare);
+        b->setHashFunction(t->table, config->keys->hash);
+        b->setKeyBytesFunction(t->table, config->keys->bytes);
+    }
+    b->setKeyMemHandler(t->table, t->config.keyFree);
+    b->setValueMemHandler(t->table, t->config.valueFree);
+
+    bool created = access(t->logPath, F_OK) != 0;
+    t->fd = open(t->logPath, O_RDWR | O_CREAT, 0644);
+    if (t->fd < 0) {
+        perror(t->logPath);
+        freeTable(t);
+        return NULL;
+    }
+    if (!replay(t)) {
+        freeTable(t);
+        return NULL;
+    }
+    // A new log is lost in a crash until its directory entry is on the
+    // disk, together with every record written to it
+    if (created) {
+        t->stats.syncs++;
+        if (!syncDirectory(t->logPath)) {
+            perror(t->logPath);
+            freeTable(t);
+            return NULL;
+        }
+    }
+    return t;
+}
+
+void waltable_insert(WalTable *t, KEY key, VALUE value) {
+    size_t start = t->groupLength;
+    *reserve(t, 1) = WAL_INSERT;
+    appendItem(t, t->config.keys, key);
+    appendItem(t, t->config.values, value);
+    t->config.backend->insert(t->table, key, value);
+    endRecord(t, start);
+}
+
+VALUE waltable_lookup(WalTable *t, KEY key) {
+    return t->config.backend->lookup(t->table, key);
+}
+
+void waltable_remove(WalTable *t, KEY key) {
+    size_t start = t->groupLength;
+    *reserve(t, 1) = WAL_REMOVE;
+    appendItem(t, t->config.keys, key);
+    t->config.backend->remove(t->table, key);
+    endRecord(t, start);
+}
+
+bool waltable_isEmpty(WalTable *t) {
+    return t->config.backend->isEmpty(t->table);
+}
+
+bool waltable_sync(WalTable *t) {
+    commit(t);
+    return !t->failed;
+}
+
+bool waltable_compact(WalTable *t) {
+    commit(t);
+    if (t->failed)
+        return false;
+    if (!t->config.backend->save(t->table, t->tmpPath, t->config.keys,
+                                 t->config.values))
+        return false;
+    t->stats.syncs += 2;
+    if (!syncPath(t->tmpPath) || rename(t->tmpPath, t->snapshotPath) != 0 ||
+        !syncDirectory(t->snapshotPath)) {
+        perror(t->snapshotPath);
+        remove(t->tmpPath);
+        return false;
+    }
+    t->stats.compactions++;
+    // The new snapshot holds everything in the log
+    if (!resetLog(t)) {
+        t->failed = true;
+        return false;
+    }
+    return true;
+}
+
+void waltable_getStats(const WalTable *t, WalStats *stats) {
+    *stats = t->stats;
+}
+
+bool waltable_close(WalTable *t) {
+    commit(t);
+    bool ok = !t->failed;
+    freeTable(t);
+    return ok;
+}
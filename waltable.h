@@ -0,0 +1,144 @@
+/*
+ * Durable tables kept in a write-ahead log.
+ *
+ * A WalTable is a table of one of the implementations registered in
+ * tablebackend.c whose inserts and removes are also appended to a log
+ * file, so the table survives the program crashing. The table is stored
+ * in two files next to each other, PATH.snap with a snapshot of the
+ * entries, see snapshot.h, and PATH.wal with the mutations since the
+ * snapshot was taken. Opening the table loads the snapshot and replays
+ * the log on top of it.
+ *
+ * The records of the log are collected in memory and written together
+ * with a single write and fdatasync when a group is complete, which is
+ * when it has groupSize records or its first record is groupNs old. A
+ * mutation is durable once its group has been committed, or after
+ * waltable_sync. Nothing runs in the background, a group that is not yet
+ * complete waits for the next mutation or for waltable_sync. The sync
+ * policy trades durability for speed: WAL_SYNC_ALWAYS commits every
+ * mutation on its own, WAL_SYNC_NONE writes the groups but leaves it to
+ * the operating system when they reach the disk.
+ *
+ * Every record ends with a checksum. A record that was only partly
+ * written when the program crashed fails it, and the log is cut off
+ * before it when the table is opened.
+ *
+ * waltable_compact, or the log growing past compactBytes, writes a new
+ * snapshot of the whole table, moves it in place with rename and empties
+ * the log. If the program crashes after the rename but before the log is
+ * emptied the old log is replayed on top of the new snapshot. That leaves
+ * the table with the same values, since every key ends up as the last
+ * record for it in the log left it, but the list tables may keep extra
+ * copies of the entries the log inserted until the next compaction.
+ *
+ * The table owns its keys and values, the entries replayed from the log
+ * are created by the serializers and are deallocated by the free
+ * functions in the settings like the ones given to waltable_insert. Like
+ * the tables themselves a WalTable must not be used from several threads
+ * at once.
+ *
+ * Build with the benchmark backends, for example
+ *   gcc -std=c99 -o program program.c waltable.c snapshot.c nanoclock.c \
+ *       tablebackend.c backend_*.c dlist.c \
+ *       testprogram_table_as_array/array.c
+ */
+
+#ifndef WALTABLE_H
+#define WALTABLE_H
+
+#include <stdbool.h>
+#include "tablebackend.h"
+
+// Records in a group if the settings do not say
+#define WAL_DEFAULT_GROUP_SIZE 64
+// Table implementation if the settings do not say, see tablebackend.c
+#define WAL_DEFAULT_BACKEND "swiss"
+
+/* When the log is flushed to the disk */
+typedef enum WalSync {
+    WAL_SYNC_GROUP,     // once per group of records
+    WAL_SYNC_ALWAYS,    // after every record, groups are not used
+    WAL_SYNC_NONE       // never, the groups are only written
+} WalSync;
+
+/* Settings of a durable table, members left 0 get the defaults */
+typedef struct WalConfig {
+    const TableBackend *backend;    // NULL for WAL_DEFAULT_BACKEND
+    CompareFunction *compare;
+    const TableSerializer *keys;    // turns the keys into bytes, and
+                                    // hashes them for the hash tables
+    const TableSerializer *values;  // turns the values into bytes
+    KeyFreeFunc *keyFree;           // NULL for free
+    ValueFreeFunc *valueFree;       // NULL for free
+    WalSync sync;
+    int groupSize;                  // records in a group, 0 for
+                                    // WAL_DEFAULT_GROUP_SIZE
+    unsigned long long groupNs;     // oldest record a group waits with,
+                                    // 0 for no limit
+    unsigned long long compactBytes;    // log size that starts a
+                                        // compaction, 0 for never
+} WalConfig;
+
+/* What a durable table has done since it was opened */
+typedef struct WalStats {
+    unsigned long long replayed;    // records replayed when opened
+    unsigned long long records;     // records appended
+    unsigned long long commits;     // groups written
+    unsigned long long syncs;       // calls to fdatasync and fsync
+    unsigned long long compactions;
+    unsigned long long logBytes;    // current size of the log
+} WalStats;
+
+typedef struct WalTable WalTable;
+
+/* Opens a durable table, creating it if the files do not exist. Prints a
+ * message if it fails.
+ *  path   - The files are PATH.snap and PATH.wal.
+ *  config - The settings, copied.
+ * Returns: The table, NULL if the files could not be created or read. */
+WalTable *waltable_open(const char *path, const WalConfig *config);
+
+/* Inserts a key and value pair into the table and the log.
+ *  t     - The table.
+ *  key   - The key, owned by the table.
+ *  value - The value, owned by the table. */
+void waltable_insert(WalTable *t, KEY key, VALUE value);
+
+/* Looks up a key in the table.
+ *  t   - The table.
+ *  key - The key to look up.
+ * Returns: The value of the key, NULL if it is not in the table. */
+VALUE waltable_lookup(WalTable *t, KEY key);
+
+/* Removes a key from the table and appends the remove to the log.
+ *  t   - The table.
+ *  key - The key to remove. */
+void waltable_remove(WalTable *t, KEY key);
+
+/* Returns: true if the table is empty.
+ *  t - The table. */
+bool waltable_isEmpty(WalTable *t);
+
+/* Commits the records that are waiting for their group to complete.
+ *  t - The table.
+ * Returns: false if writing the log has failed since the table was
+ *          opened. */
+bool waltable_sync(WalTable *t);
+
+/* Writes a snapshot of the table and empties the log.
+ *  t - The table.
+ * Returns: false if the snapshot or the log could not be written. */
+bool waltable_compact(WalTable *t);
+
+/* Returns what a table has done since it was opened.
+ *  t     - The table.
+ *  stats - The statistics are stored here. */
+void waltable_getStats(const WalTable *t, WalStats *stats);
+
+/* Commits the waiting records, closes the log and deallocates the table.
+ *  t - The table.
+ * Returns: false if writing the log has failed since the table was
+ *          opened. */
+bool waltable_close(WalTable *t);
+
+#endif
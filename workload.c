@@ -0,0 +1,226 @@
+/*
+ * Key distributions for the lookup benchmarks, see workload.h.
+ *
+ * Zipfian numbers are drawn with the method from Gray et al., "Quickly
+ * generating billion-record synthetic databases" (SIGMOD 1994), which
+ * needs O(n) setup to compute zeta(n, theta) and O(1) per draw.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "workload.h"
+
+struct Workload {
+    WorkloadSpec spec;
+    int n;
+    Rng rng;            // the random numbers of the draws
+    int *order;         // random permutation of the indexes, or NULL
+    // Zipfian constants
+    double zetan;
+    double alpha;
+    double eta;
+    double half;        // 0.5^theta
+    // Hot set
+    int hotCount;
+    int hotStart;       // first position in order of the hot set
+    int drawn;          // draws since the hot set last moved
+};
+
+/* Returns a uniform random number in [0, 1) */
+static double uniform(Workload *w) {
+    return rng_double(&w->rng);
+}
+
+/* Returns a uniform random integer in [0, n) */
+static int uniformInt(Workload *w, int n) {
+    return rng_below(&w->rng, n);
+}
+
+/* Draws a Zipfian rank in [0, n), rank 0 being the most popular */
+static int zipfNext(Workload *w) {
+    double u = uniform(w);
+    double uz = u*w->zetan;
+    if (uz < 1.0)
+        return 0;
+    if (uz < 1.0 + w->half)
+        return 1;
+    int rank = (int)(w->n*pow(w->eta*u - w->eta + 1.0, w->alpha));
+    return rank < w->n ? rank : w->n-1;
+}
+
+/* Draws a hotspot index, hot draws land in positions
+ * [hotStart, hotStart+hotCount) of the permutation */
+static int hotspotNext(Workload *w) {
+    int pos;
+    if (w->hotCount == w->n || uniform(w) < w->spec.hotOps)
+        pos = w->hotStart + uniformInt(w, w->hotCount);
+    else
+        pos = w->hotStart + w->hotCount + uniformInt(w, w->n - w->hotCount);
+    return w->order[pos % w->n];
+}
+
+/* Parses a number in [min, max] followed by ':' or the end of the string.
+ *  text - the text, moved past the number on success
+ *  value - the parsed number is stored here
+ * Returns: true if a valid number was parsed */
+static bool parseParam(const char **text, double min, double max,
+                       double *value) {
+    char *end;
+    double d = strtod(*text, &end);
+    if (end == *text || (*end != ':' && *end != '\0') || d < min || d > max)
+        return false;
+    *value = d;
+    *text = *end == ':' ? end+1 : end;
+    return true;
+}
+
+bool workload_parse(const char *text, WorkloadSpec *spec) {
+    static const struct {
+        const char *name;
+        WorkloadKind kind;
+    } names[] = {
+        {"uniform", WORKLOAD_UNIFORM},
+        {"middle", WORKLOAD_MIDDLE},
+        {"zipf", WORKLOAD_ZIPF},
+        {"hotspot", WORKLOAD_HOTSPOT},
+        {"latest", WORKLOAD_LATEST},
+        {"shifting", WORKLOAD_SHIFTING},
+    };
+    size_t len = strcspn(text, ":");
+    size_t i;
+
+    for(i=0;i<sizeof(names)/sizeof(names[0]);i++)
+        if (strlen(names[i].name) == len && !strncmp(names[i].name, text, len))
+            break;
+    if (i == sizeof(names)/sizeof(names[0]))
+        return false;
+
+    *spec = (WorkloadSpec){names[i].kind, 0.99, 0.9, 0.1, 1000};
+    text += len;
+    if (*text == ':')
+        text++;
+    else if (*text == '\0')
+        return true;
+
+    double interval = spec->interval;
+    switch (spec->kind) {
+    case WORKLOAD_ZIPF:
+    case WORKLOAD_LATEST:
+        if (!parseParam(&text, 1e-6, 0.999999, &spec->theta))
+            return false;
+        break;
+    case WORKLOAD_SHIFTING:
+    case WORKLOAD_HOTSPOT:
+        if (!parseParam(&text, 0, 1, &spec->hotOps) ||
+            (*text && !parseParam(&text, 1e-9, 1, &spec->hotKeys)))
+            return false;
+        if (spec->kind == WORKLOAD_SHIFTING && *text &&
+            !parseParam(&text, 1, 1e9, &interval))
+            return false;
+        spec->interval = (int)interval;
+        break;
+    default:
+        return false;
+    }
+    return *text == '\0';
+}
+
+Workload *workload_create(const WorkloadSpec *spec, int n, Rng *rng) {
+    Workload *w = calloc(1, sizeof(Workload));
+    if (!w)
+        return NULL;
+    w->spec = *spec;
+    w->n = n;
+    rng_seed(&w->rng, rng_next(rng));
+
+    if (spec->kind == WORKLOAD_ZIPF || spec->kind == WORKLOAD_HOTSPOT ||
+        spec->kind == WORKLOAD_SHIFTING) {
+        // Spread the popular keys randomly over the insertion order
+        w->order = malloc(n*sizeof(int));
+        if (!w->order) {
+            free(w);
+            return NULL;
+        }
+        for(int i=0;i<n;i++)
+            w->order[i] = i;
+        for(int i=n-1;i>0;i--) {
+            int j = uniformInt(w, i+1);
+            int temp = w->order[i];
+            w->order[i] = w->order[j];
+            w->order[j] = temp;
+        }
+    }
+    if (spec->kind == WORKLOAD_ZIPF || spec->kind == WORKLOAD_LATEST) {
+        double theta = spec->theta;
+        double zeta2 = 1.0 + pow(0.5, theta);
+        for(int i=1;i<=n;i++)
+            w->zetan += 1.0/pow(i, theta);
+        w->alpha = 1.0/(1.0-theta);
+        w->eta = (1.0 - pow(2.0/n, 1.0-theta))/(1.0 - zeta2/w->zetan);
+        w->half = pow(0.5, theta);
+    }
+    w->hotCount = (int)(spec->hotKeys*n);
+    if (w->hotCount < 1)
+        w->hotCount = 1;
+    return w;
+}
+
+int workload_next(Workload *w) {
+    switch (w->spec.kind) {
+    case WORKLOAD_UNIFORM:
+        return uniformInt(w, w->n);
+    case WORKLOAD_MIDDLE: {
+        int startindex = w->n/3;
+        int stopindex = w->n*2/3;
+        return startindex + uniformInt(w, stopindex - startindex + 1);
+    }
+    case WORKLOAD_ZIPF:
+        return w->order[zipfNext(w)];
+    case WORKLOAD_HOTSPOT:
+        return hotspotNext(w);
+    case WORKLOAD_LATEST:
+        return w->n-1 - zipfNext(w);
+    case WORKLOAD_SHIFTING:
+        if (++w->drawn > w->spec.interval) {
+            w->drawn = 1;
+            w->hotStart = (w->hotStart + w->hotCount) % w->n;
+        }
+        return hotspotNext(w);
+    }
+    return 0;
+}
+
+void workload_free(Workload *w) {
+    free(w->order);
+    free(w);
+}
+
+bool workload_parsePreset(const char *text, WorkloadPreset *preset) {
+    static const WorkloadPreset presets[] = {
+        {"a", "update-heavy", {50, 50, 0, 0}, "zipf", {0}},
+        {"b", "read-mostly", {95, 5, 0, 0}, "zipf", {0}},
+        {"c", "read-only", {100, 0, 0, 0}, "zipf", {0}},
+        {"d", "read-latest", {95, 0, 5, 0}, "latest", {0}},
+        {"e", "insert-heavy", {10, 0, 90, 0}, "zipf", {0}},
+        {"f", "read-modify-write", {50, 0, 0, 50}, "zipf", {0}},
+    };
+    size_t len = strcspn(text, "@");
+    size_t i;
+
+    for(i=0;i<sizeof(presets)/sizeof(presets[0]);i++) {
+        const WorkloadPreset *p = &presets[i];
+        if ((strlen(p->name) == len && !strncmp(p->name, text, len)) ||
+            (strlen(p->description) == len &&
+             !strncmp(p->description, text, len)))
+            break;
+    }
+    if (i == sizeof(presets)/sizeof(presets[0]))
+        return false;
+
+    *preset = presets[i];
+    if (text[len] == '@')
+        preset->distributionName = text+len+1;
+    return workload_parse(preset->distributionName, &preset->distribution);
+}
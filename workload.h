@@ -0,0 +1,109 @@
+/*
+ * Key distributions for the lookup benchmarks, and the mixed workload
+ * presets built on them.
+ *
+ * A workload draws indexes in [0, n) where index i is the i:th key
+ * inserted into the table, so n-1 is the most recently inserted key. The
+ * distributions are
+ *   uniform  - every key equally likely.
+ *   middle   - uniform over the middle third of the indexes, the original
+ *              skewed lookup of the test program.
+ *   zipf     - Zipfian, the key with popularity rank r is drawn with
+ *              probability proportional to 1/r^theta. The ranks are spread
+ *              over the keys in random order.
+ *   hotspot  - a fraction hotOps of the draws go to a fixed random set
+ *              holding a fraction hotKeys of the keys, the rest are uniform
+ *              over the other keys.
+ *   latest   - Zipfian over insertion order, the most recently inserted
+ *              keys are the most popular.
+ *   shifting - like hotspot, but the hot set moves to the next hotKeys*n
+ *              keys every interval draws.
+ */
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdbool.h>
+#include "rng.h"
+
+typedef enum WorkloadKind {
+    WORKLOAD_UNIFORM,
+    WORKLOAD_MIDDLE,
+    WORKLOAD_ZIPF,
+    WORKLOAD_HOTSPOT,
+    WORKLOAD_LATEST,
+    WORKLOAD_SHIFTING
+} WorkloadKind;
+
+/* Parameters of a workload, only the ones used by the kind are read */
+typedef struct WorkloadSpec {
+    WorkloadKind kind;
+    double theta;       // zipf, latest: skew, 0 < theta < 1
+    double hotOps;      // hotspot, shifting: fraction of draws that are hot
+    double hotKeys;     // hotspot, shifting: fraction of keys that are hot
+    int interval;       // shifting: draws between moves of the hot set
+} WorkloadSpec;
+
+typedef struct Workload Workload;
+
+/* The operations of a mixed workload preset */
+typedef enum PresetOp {
+    PRESET_READ,        // lookup of an existing key
+    PRESET_UPDATE,      // new value for an existing key
+    PRESET_INSERT,      // insert of a new key
+    PRESET_RMW,         // lookup followed by an update of the same key
+    PRESET_NUM_OPS
+} PresetOp;
+
+/* A named mix of operations run against a filled table, modelled on the
+ * YCSB core workloads. The tables have no range scans, so insert-heavy
+ * takes the place of YCSB's scan workload E. */
+typedef struct WorkloadPreset {
+    const char *name;           // a to f
+    const char *description;    // for example update-heavy
+    int percent[PRESET_NUM_OPS];    // percent of each PresetOp
+    const char *distributionName;
+    WorkloadSpec distribution;  // the keys read and updated
+} WorkloadPreset;
+
+/* Parses a workload description of the form name[:param[:param...]], for
+ * example "zipf:0.99", "hotspot:0.9:0.1" or "shifting:0.9:0.1:1000".
+ * Parameters left out get their default values.
+ *  text - The description.
+ *  spec - The parsed description is stored here.
+ * Returns: true if text was a valid description, false otherwise. */
+bool workload_parse(const char *text, WorkloadSpec *spec);
+
+/* Parses a workload preset of the form name[@distribution], where name
+ * is a letter or description from
+ *   a  update-heavy   50% reads, 50% updates, zipf
+ *   b  read-mostly    95% reads, 5% updates, zipf
+ *   c  read-only      100% reads, zipf
+ *   d  read-latest    95% reads, 5% inserts, latest
+ *   e  insert-heavy   10% reads, 90% inserts, zipf
+ *   f  read-modify-write  50% reads, 50% read-modify-writes, zipf
+ * and the distribution, as for workload_parse, replaces the default one.
+ *  text   - The description, it must outlive the preset.
+ *  preset - The parsed preset is stored here.
+ * Returns: true if text was a valid preset, false otherwise. */
+bool workload_parsePreset(const char *text, WorkloadPreset *preset);
+
+/* Creates a workload over n keys. The draws use a random number stream
+ * of their own, seeded from rng, so the sequence is decided by the seed
+ * of rng.
+ *  spec - The distribution to draw from.
+ *  n    - The number of keys, at least 1.
+ *  rng  - The random numbers the workload is seeded from.
+ * Returns: A pointer to the workload. NULL if creation failed. */
+Workload *workload_create(const WorkloadSpec *spec, int n, Rng *rng);
+
+/* Draws the next key index.
+ *  w - Pointer to the workload.
+ * Returns: An index in [0, n). */
+int workload_next(Workload *w);
+
+/* Deallocates a workload.
+ *  w - Pointer to the workload. After the call the pointer is invalid. */
+void workload_free(Workload *w);
+
+#endif